@@ -0,0 +1,635 @@
+#include "ArchiveScan.h"
+#include "Inflate.h"
+#include "SortGrouping.h"
+#include "DigestIndex.h"
+#include "IoScheduler.h"
+#include "Throttle.h"
+#include "Utilities.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <cstring>
+#include <cwctype>
+#include <map>
+#include <unordered_map>
+
+#define WIN32_LEAN_AND_MEAN
+#include <Windows.h>
+
+namespace
+{
+    const size_t ARCHIVE_READ_SIZE = 64 * 1024;
+    const size_t TAR_BLOCK_SIZE = 512;
+    const size_t TAR_MAX_LONG_NAME = 64 * 1024;           // GNU long names and pax headers read into memory
+    const size_t ZIP_DIRECTORY_READ_SIZE = 64 * 1024;     // the central directory is read in pieces of this size
+
+    const uint32_t ZIP_LOCAL_HEADER = 0x04034b50;
+    const uint32_t ZIP_CENTRAL_HEADER = 0x02014b50;
+    const uint32_t ZIP_END = 0x06054b50;
+    const uint32_t ZIP64_END = 0x06064b50;
+    const uint32_t ZIP64_LOCATOR = 0x07064b50;
+    const size_t ZIP_END_SIZE = 22;
+    const size_t ZIP_END_SEARCH = ZIP_END_SIZE + 0xFFFF; // the end record is followed by a comment of up to 64 KB
+
+    uint16_t le16(const unsigned char* p) { return static_cast<uint16_t>(p[0] | p[1] << 8); }
+    uint32_t le32(const unsigned char* p) { return static_cast<uint32_t>(le16(p)) | static_cast<uint32_t>(le16(p + 2)) << 16; }
+    uint64_t le64(const unsigned char* p) { return static_cast<uint64_t>(le32(p)) | static_cast<uint64_t>(le32(p + 4)) << 32; }
+
+    // Reads exactly length bytes at offset
+    bool readAt(HANDLE hFile, uint64_t offset, void* buffer, size_t length, ReadStats* stats = nullptr)
+    {
+        LARGE_INTEGER position;
+        position.QuadPart = static_cast<LONGLONG>(offset);
+        if (!SetFilePointerEx(hFile, position, nullptr, FILE_BEGIN)) return false;
+
+        size_t done = 0;
+        while (done < length)
+        {
+            DWORD toRead = static_cast<DWORD>(std::min<size_t>(length - done, 1u << 20));
+            DWORD bytesRead = 0;
+            ioThrottle().beforeRead(toRead);
+            if (!ReadFile(hFile, static_cast<unsigned char*>(buffer) + done, toRead, &bytesRead, NULL) || bytesRead == 0) return false;
+            done += bytesRead;
+            if (stats) stats->bytesRead += bytesRead;
+        }
+        return true;
+    }
+
+    // Archives are read at arbitrary offsets, which unbuffered reads cannot do
+    HANDLE openArchive(const fs::path& archivePath, ReadPolicy policy)
+    {
+        return openForRead(archivePath, policy == ReadPolicy::Direct ? ReadPolicy::Sequential : policy);
+    }
+
+    std::wstring memberName(const std::string& raw, bool utf8)
+    {
+        std::wstring name;
+        if (utf8)
+        {
+            name = utf8ToWstring(raw);
+        }
+        else if (!raw.empty())
+        {
+            // Zip names without the UTF-8 flag are in the original IBM PC code page
+            int length = MultiByteToWideChar(437, 0, raw.data(), static_cast<int>(raw.size()), nullptr, 0);
+            name.resize(length > 0 ? length : 0);
+            if (length > 0) MultiByteToWideChar(437, 0, raw.data(), static_cast<int>(raw.size()), name.data(), length);
+        }
+
+        std::replace(name.begin(), name.end(), L'\\', L'/');
+        while (name.rfind(L"./", 0) == 0) name.erase(0, 2);
+        return name;
+    }
+
+    bool listZip(HANDLE hFile, uint64_t fileSize, std::vector<ArchiveMember>& members)
+    {
+        if (fileSize < ZIP_END_SIZE) return false;
+
+        size_t tailLength = static_cast<size_t>(std::min<uint64_t>(fileSize, ZIP_END_SEARCH));
+        std::vector<unsigned char> tail(tailLength);
+        if (!readAt(hFile, fileSize - tailLength, tail.data(), tailLength)) return false;
+
+        size_t end = SIZE_MAX;
+        for (size_t i = tailLength - ZIP_END_SIZE + 1; i-- > 0;)
+        {
+            if (le32(&tail[i]) == ZIP_END)
+            {
+                end = i;
+                break;
+            }
+        }
+        if (end == SIZE_MAX) return false;
+
+        uint64_t entryCount = le16(&tail[end + 10]);
+        uint64_t directorySize = le32(&tail[end + 12]);
+        uint64_t directoryOffset = le32(&tail[end + 16]);
+
+        // Archives past 4 GB or 65535 members keep the real values in a ZIP64 end record, found through a locator
+        bool zip64 = entryCount == 0xFFFF || directorySize == 0xFFFFFFFF || directoryOffset == 0xFFFFFFFF;
+        if (zip64 && end >= 20 && le32(&tail[end - 20]) == ZIP64_LOCATOR)
+        {
+            unsigned char record[56];
+            if (!readAt(hFile, le64(&tail[end - 20 + 8]), record, sizeof(record)) || le32(record) != ZIP64_END) return false;
+            entryCount = le64(record + 32);
+            directorySize = le64(record + 40);
+            directoryOffset = le64(record + 48);
+        }
+
+        if (directoryOffset > fileSize || directorySize > fileSize - directoryOffset) return false;
+        const uint64_t directoryEnd = directoryOffset + directorySize;
+
+        // The directory is read a piece at a time, so listing takes the same memory however many members there are.
+        // Returns length bytes at the file offset, reading a new piece when they are not all in the current one.
+        std::vector<unsigned char> piece;
+        uint64_t pieceOffset = 0;
+        auto directoryBytes = [&](uint64_t offset, size_t length) -> const unsigned char*
+        {
+            if (length > directoryEnd - offset) return nullptr;
+            if (offset < pieceOffset || offset + length > pieceOffset + piece.size())
+            {
+                piece.resize(static_cast<size_t>(std::min<uint64_t>(std::max<size_t>(length, ZIP_DIRECTORY_READ_SIZE), directoryEnd - offset)));
+                if (!readAt(hFile, offset, piece.data(), piece.size())) return nullptr;
+                pieceOffset = offset;
+            }
+            return piece.data() + (offset - pieceOffset);
+        };
+
+        uint64_t position = directoryOffset;
+        for (uint64_t entry = 0; entry < entryCount; ++entry)
+        {
+            const unsigned char* header = directoryBytes(position, 46);
+            if (!header || le32(header) != ZIP_CENTRAL_HEADER) return false;
+
+            uint16_t flags = le16(header + 8);
+            uint16_t method = le16(header + 10);
+            uint32_t crc = le32(header + 16);
+            uint64_t storedSize = le32(header + 20);
+            uint64_t size = le32(header + 24);
+            size_t nameLength = le16(header + 28);
+            size_t extraLength = le16(header + 30);
+            size_t commentLength = le16(header + 32);
+            uint64_t offset = le32(header + 42);
+
+            // A record is at most about 192 KB, so it fits in one piece; reading it may move the piece
+            header = directoryBytes(position, 46 + nameLength + extraLength + commentLength);
+            if (!header) return false;
+
+            const unsigned char* name = header + 46;
+            const unsigned char* extra = name + nameLength;
+            position += 46 + nameLength + extraLength + commentLength;
+
+            // The ZIP64 extra field holds, in this order, whichever of the three did not fit in 32 bits
+            for (size_t field = 0; field + 4 <= extraLength;)
+            {
+                uint16_t id = le16(extra + field);
+                size_t length = le16(extra + field + 2);
+                if (field + 4 + length > extraLength) break;
+
+                if (id == 0x0001)
+                {
+                    const unsigned char* value = extra + field + 4;
+                    const unsigned char* valueEnd = value + length;
+                    for (uint64_t* target : { &size, &storedSize, &offset })
+                    {
+                        if (*target != 0xFFFFFFFF || value + 8 > valueEnd) continue;
+                        *target = le64(value);
+                        value += 8;
+                    }
+                }
+                field += 4 + length;
+            }
+
+            std::string rawName(reinterpret_cast<const char*>(name), nameLength);
+            bool isDirectory = !rawName.empty() && (rawName.back() == '/' || rawName.back() == '\\');
+            bool encrypted = (flags & 0x0001) != 0;
+            bool readable = method == 8 || (method == 0 && storedSize == size);
+            if (isDirectory || encrypted || !readable || size == 0 || offset >= fileSize) continue;
+
+            ArchiveMember member;
+            member.name = memberName(rawName, (flags & 0x0800) != 0);
+            member.size = size;
+            member.storedSize = storedSize;
+            member.offset = offset;
+            member.crc = crc;
+            member.method = method;
+            members.push_back(std::move(member));
+        }
+        return true;
+    }
+
+    // Octal, or base-256 with the high bit of the first byte set for values that do not fit
+    bool parseTarNumber(const unsigned char* field, size_t length, uint64_t& value)
+    {
+        value = 0;
+        if (field[0] & 0x80)
+        {
+            for (size_t i = 1; i < length; ++i) value = value << 8 | field[i];
+            return true;
+        }
+
+        size_t i = 0;
+        while (i < length && (field[i] == ' ' || field[i] == 0)) ++i;
+        bool any = false;
+        for (; i < length && field[i] >= '0' && field[i] <= '7'; ++i)
+        {
+            value = value << 3 | static_cast<uint64_t>(field[i] - '0');
+            any = true;
+        }
+        return any;
+    }
+
+    bool tarChecksumMatches(const unsigned char* header)
+    {
+        uint64_t stored = 0;
+        if (!parseTarNumber(header + 148, 8, stored)) return false;
+
+        uint64_t sum = 0;
+        for (size_t i = 0; i < TAR_BLOCK_SIZE; ++i) sum += i >= 148 && i < 156 ? ' ' : header[i];
+        return sum == stored;
+    }
+
+    std::string tarField(const unsigned char* field, size_t length)
+    {
+        size_t used = 0;
+        while (used < length && field[used] != 0) ++used;
+        return std::string(reinterpret_cast<const char*>(field), used);
+    }
+
+    // "<length> <key>=<value>\n" records; only the path and size matter here
+    void parsePaxHeader(const std::string& text, std::string& path, uint64_t& size)
+    {
+        size_t position = 0;
+        while (position < text.size())
+        {
+            size_t space = text.find(' ', position);
+            if (space == std::string::npos) return;
+            size_t length = std::strtoull(text.c_str() + position, nullptr, 10);
+            if (length == 0 || position + length > text.size()) return;
+
+            std::string record = text.substr(space + 1, position + length - space - 2); // without the newline
+            size_t equals = record.find('=');
+            if (equals != std::string::npos)
+            {
+                std::string key = record.substr(0, equals);
+                if (key == "path") path = record.substr(equals + 1);
+                else if (key == "size") size = std::strtoull(record.c_str() + equals + 1, nullptr, 10);
+            }
+            position += length;
+        }
+    }
+
+    bool listTar(HANDLE hFile, uint64_t fileSize, std::vector<ArchiveMember>& members)
+    {
+        unsigned char header[TAR_BLOCK_SIZE];
+        uint64_t position = 0;
+        bool sawHeader = false;
+
+        // GNU long names and pax headers describe the entry that follows them
+        std::string nextName;
+        uint64_t nextSize = UINT64_MAX;
+
+        while (position + TAR_BLOCK_SIZE <= fileSize)
+        {
+            if (!readAt(hFile, position, header, sizeof(header))) return sawHeader;
+            if (std::all_of(header, header + TAR_BLOCK_SIZE, [](unsigned char byte) { return byte == 0; })) break; // end of archive
+            if (!tarChecksumMatches(header)) return sawHeader;
+            sawHeader = true;
+
+            uint64_t size = 0;
+            if (!parseTarNumber(header + 124, 12, size)) return true;
+            char type = static_cast<char>(header[156]);
+            bool regular = type == '0' || type == '\0' || type == '7';
+            if (regular && nextSize != UINT64_MAX) size = nextSize; // a pax size replaces one too large for the header
+
+            uint64_t content = position + TAR_BLOCK_SIZE;
+            if (size > fileSize - content) return true;
+            position = content + (size + TAR_BLOCK_SIZE - 1) / TAR_BLOCK_SIZE * TAR_BLOCK_SIZE;
+
+            if (type == 'L' || type == 'x')
+            {
+                if (size > TAR_MAX_LONG_NAME) continue;
+                std::string text(static_cast<size_t>(size), '\0');
+                if (!readAt(hFile, content, text.data(), text.size())) return true;
+
+                if (type == 'L') nextName = text.substr(0, text.find('\0'));
+                else parsePaxHeader(text, nextName, nextSize);
+                continue;
+            }
+
+            if (regular)
+            {
+                std::string name = nextName;
+                if (name.empty())
+                {
+                    name = tarField(header, 100);
+                    std::string prefix = std::memcmp(header + 257, "ustar", 5) == 0 ? tarField(header + 345, 155) : std::string();
+                    if (!prefix.empty()) name = prefix + "/" + name;
+                }
+
+                if (size > 0 && size <= fileSize - content)
+                {
+                    ArchiveMember member;
+                    member.name = memberName(name, true);
+                    member.size = size;
+                    member.storedSize = size;
+                    member.offset = content;
+                    members.push_back(std::move(member));
+                }
+            }
+
+            nextName.clear();
+            nextSize = UINT64_MAX;
+        }
+        return sawHeader;
+    }
+}
+
+ArchiveKind archiveKindOf(const fs::path& filePath)
+{
+    std::wstring extension = filePath.extension().native();
+    std::transform(extension.begin(), extension.end(), extension.begin(), [](wchar_t c) { return static_cast<wchar_t>(std::towlower(c)); });
+
+    if (extension == L".zip" || extension == L".jar" || extension == L".nupkg" || extension == L".vsix") return ArchiveKind::Zip;
+    if (extension == L".tar") return ArchiveKind::Tar;
+    return ArchiveKind::None;
+}
+
+bool listArchiveMembers(const fs::path& archivePath, ArchiveKind kind, std::vector<ArchiveMember>& members)
+{
+    HANDLE hFile = openArchive(archivePath, ReadPolicy::Sequential);
+    if (hFile == INVALID_HANDLE_VALUE) return false;
+
+    LARGE_INTEGER fileSize;
+    bool ok = GetFileSizeEx(hFile, &fileSize) != FALSE;
+    if (ok && kind == ArchiveKind::Zip) ok = listZip(hFile, static_cast<uint64_t>(fileSize.QuadPart), members);
+    else if (ok && kind == ArchiveKind::Tar) ok = listTar(hFile, static_cast<uint64_t>(fileSize.QuadPart), members);
+    else ok = false;
+
+    CloseHandle(hFile);
+    return ok;
+}
+
+bool hashArchiveMember(void* handle, ArchiveKind kind, const ArchiveMember& member, Sha256Digest& digest, ReadStats* stats)
+{
+    thread_local Sha256Hasher hasher;
+
+    uint64_t dataOffset = member.offset;
+    if (kind == ArchiveKind::Zip)
+    {
+        // The local header repeats the name but may carry a different extra field, so its lengths are read again
+        unsigned char local[30];
+        if (!readAt(handle, member.offset, local, sizeof(local), stats) || le32(local) != ZIP_LOCAL_HEADER) return false;
+        dataOffset += sizeof(local) + le16(local + 26) + le16(local + 28);
+    }
+
+    LARGE_INTEGER position;
+    position.QuadPart = static_cast<LONGLONG>(dataOffset);
+    if (!hasher.begin() || !SetFilePointerEx(handle, position, nullptr, FILE_BEGIN)) return false;
+
+    uint64_t remaining = member.storedSize;
+    auto readNext = [&](unsigned char* buffer, size_t capacity) -> size_t
+    {
+        DWORD toRead = static_cast<DWORD>(std::min<uint64_t>(capacity, remaining));
+        DWORD bytesRead = 0;
+        if (toRead == 0) return 0;
+
+        ioThrottle().beforeRead(toRead);
+        if (!ReadFile(handle, buffer, toRead, &bytesRead, NULL)) return 0;
+        remaining -= bytesRead;
+        if (stats) stats->bytesRead += bytesRead;
+        return bytesRead;
+    };
+
+    uint32_t crc = 0;
+    uint64_t produced = 0;
+    auto consume = [&](const unsigned char* data, size_t length)
+    {
+        if (kind == ArchiveKind::Zip) crc = crc32Update(crc, data, length);
+        produced += length;
+        return produced <= member.size && hasher.update(data, length);
+    };
+
+    bool ok = true;
+    if (member.method == 8)
+    {
+        ok = inflateRaw(readNext, consume) == InflateResult::Done;
+    }
+    else
+    {
+        std::vector<unsigned char> buffer(ARCHIVE_READ_SIZE);
+        while (size_t bytesRead = readNext(buffer.data(), buffer.size()))
+        {
+            if (!consume(buffer.data(), bytesRead))
+            {
+                ok = false;
+                break;
+            }
+        }
+    }
+
+    Sha256Digest result;
+    if (!hasher.finish(result)) return false;
+    if (!ok || produced != member.size || (kind == ArchiveKind::Zip && crc != member.crc)) return false;
+
+    digest = result;
+    if (stats) stats->filesRead++;
+    return true;
+}
+
+fs::path archiveMemberPath(const fs::path& archivePath, const ArchiveMember& member)
+{
+    return fs::path(archivePath.native() + L"!/" + member.name);
+}
+
+ArchiveDuplicates findArchiveDuplicates(const std::vector<fs::path>& paths, const std::vector<ScanNode>& nodes,
+    std::vector<std::optional<Sha256Digest>>& fileDigests, const HashOptions& options)
+{
+    ArchiveDuplicates result;
+    if (fileDigests.size() < paths.size()) fileDigests.resize(paths.size());
+
+    struct ListedArchive
+    {
+        uint32_t pathIndex = 0;
+        ArchiveKind kind = ArchiveKind::None;
+        std::vector<ArchiveMember> members;
+    };
+
+    // Listing reads only the headers: the tail of a zip file, or one block per tar member
+    std::vector<ListedArchive> archives;
+    std::vector<std::pair<uint32_t, uint32_t>> memberRefs; // (archive, member) for every listed member
+    for (size_t i = 0; i < paths.size() && i < nodes.size(); ++i)
+    {
+        if (options.stopToken.stop_requested()) return result;
+        if (nodes[i].isDirectory) continue;
+
+        ArchiveKind kind = archiveKindOf(paths[i]);
+        if (kind == ArchiveKind::None) continue;
+
+        ListedArchive archive{ static_cast<uint32_t>(i), kind, {} };
+        if (!listArchiveMembers(paths[i], kind, archive.members)) continue;
+
+        result.archives++;
+        result.members += archive.members.size();
+        if (archive.members.empty()) continue;
+
+        for (size_t member = 0; member < archive.members.size(); ++member)
+        {
+            memberRefs.push_back({ static_cast<uint32_t>(archives.size()), static_cast<uint32_t>(member) });
+        }
+        archives.push_back(std::move(archive));
+    }
+    if (memberRefs.empty()) return result;
+
+    // Loose files are entries 0 to paths.size() - 1 and members follow, so one sort finds every size they share
+    const uint32_t firstMember = static_cast<uint32_t>(paths.size());
+    auto memberOf = [&](uint32_t entryIndex) -> const ArchiveMember&
+    {
+        const auto& [archive, member] = memberRefs[entryIndex - firstMember];
+        return archives[archive].members[member];
+    };
+
+    std::vector<GroupRecord> records;
+    for (size_t i = 0; i < paths.size() && i < nodes.size(); ++i)
+    {
+        if (!nodes[i].isDirectory && nodes[i].size > 0) records.push_back({ nodes[i].size, 0, static_cast<uint32_t>(i) });
+    }
+    for (size_t m = 0; m < memberRefs.size(); ++m)
+    {
+        records.push_back({ memberOf(firstMember + static_cast<uint32_t>(m)).size, 0, firstMember + static_cast<uint32_t>(m) });
+    }
+
+    std::vector<char> neededMembers(memberRefs.size(), 0);
+    std::vector<size_t> looseToHash;
+    std::vector<uint32_t> candidates;
+    for (const auto& run : findEqualKeyRuns(records))
+    {
+        size_t looseCount = 0;
+        size_t tarCount = 0;
+        std::unordered_map<uint32_t, size_t> crcCounts;
+        for (size_t i = run.begin; i < run.end; ++i)
+        {
+            uint32_t entryIndex = records[i].entryIndex;
+            if (entryIndex < firstMember)
+            {
+                looseCount++;
+                continue;
+            }
+            const auto& [archive, member] = memberRefs[entryIndex - firstMember];
+            if (archives[archive].kind == ArchiveKind::Zip) crcCounts[archives[archive].members[member].crc]++;
+            else tarCount++;
+        }
+        if (looseCount == run.end - run.begin) continue; // loose files alone were grouped by hashing
+
+        for (size_t i = run.begin; i < run.end; ++i)
+        {
+            uint32_t entryIndex = records[i].entryIndex;
+            if (entryIndex < firstMember)
+            {
+                candidates.push_back(entryIndex);
+                if (!fileDigests[entryIndex]) looseToHash.push_back(entryIndex);
+                continue;
+            }
+
+            // Against other zip members only, the stored CRC settles it: a CRC no other member has cannot match
+            const auto& [archive, member] = memberRefs[entryIndex - firstMember];
+            if (looseCount == 0 && tarCount == 0 && crcCounts[archives[archive].members[member].crc] < 2)
+            {
+                result.membersSkippedByCrc++;
+                continue;
+            }
+            candidates.push_back(entryIndex);
+            neededMembers[entryIndex - firstMember] = 1;
+        }
+    }
+
+    // Loose files that only shared their size with archive members were skipped by hashing
+    if (!looseToHash.empty())
+    {
+        std::vector<ReadJob> jobs;
+        for (size_t index : looseToHash) jobs.push_back({ paths[index], nodes[index].size });
+
+        runScheduledReads(jobs, [&](size_t job) -> uint64_t
+        {
+            if (options.stopToken.stop_requested()) return 0;
+
+            ReadStats stats;
+            Sha256Digest digest;
+            if (calculateSHA256(jobs[job].path, digest, options.readPolicy, &stats)) fileDigests[looseToHash[job]] = digest;
+            return stats.bytesRead;
+        }, options.scheduling);
+    }
+
+    // Members are read archive by archive, each in the order they are stored, so an archive is read front to back once
+    std::vector<std::optional<Sha256Digest>> memberDigests(memberRefs.size());
+    std::vector<std::vector<uint32_t>> membersByArchive(archives.size());
+    for (size_t m = 0; m < memberRefs.size(); ++m)
+    {
+        if (neededMembers[m]) membersByArchive[memberRefs[m].first].push_back(static_cast<uint32_t>(m));
+    }
+
+    std::vector<ReadJob> jobs;
+    std::vector<size_t> jobArchives;
+    for (size_t archive = 0; archive < archives.size(); ++archive)
+    {
+        if (membersByArchive[archive].empty()) continue;
+
+        uint64_t bytes = 0;
+        for (uint32_t m : membersByArchive[archive]) bytes += archives[archive].members[memberRefs[m].second].storedSize;
+        jobs.push_back({ paths[archives[archive].pathIndex], bytes });
+        jobArchives.push_back(archive);
+
+        std::sort(membersByArchive[archive].begin(), membersByArchive[archive].end(), [&](uint32_t a, uint32_t b)
+        {
+            return archives[archive].members[memberRefs[a].second].offset < archives[archive].members[memberRefs[b].second].offset;
+        });
+    }
+
+    if (!jobs.empty() && options.showProgress)
+    {
+        size_t needed = static_cast<size_t>(std::count(neededMembers.begin(), neededMembers.end(), 1));
+        printMessage(&options.onMessage, L"Reading ", std::to_wstring(needed), L" archive members from ", std::to_wstring(jobs.size()), L" archives...");
+    }
+
+    std::atomic<size_t> membersHashed{ 0 };
+    runScheduledReads(jobs, [&](size_t job) -> uint64_t
+    {
+        const ListedArchive& archive = archives[jobArchives[job]];
+        HANDLE hFile = openArchive(jobs[job].path, options.readPolicy);
+        if (hFile == INVALID_HANDLE_VALUE) return 0;
+
+        ReadStats stats;
+        for (uint32_t m : membersByArchive[jobArchives[job]])
+        {
+            if (options.stopToken.stop_requested()) break;
+
+            Sha256Digest digest;
+            if (hashArchiveMember(hFile, archive.kind, archive.members[memberRefs[m].second], digest, &stats))
+            {
+                memberDigests[m] = digest;
+                membersHashed++;
+            }
+        }
+        CloseHandle(hFile);
+        return stats.bytesRead;
+    }, options.scheduling);
+    result.membersHashed = membersHashed;
+
+    std::map<Sha256Digest, ArchiveGroup> byDigest;
+    for (uint32_t entryIndex : candidates)
+    {
+        if (entryIndex < firstMember)
+        {
+            std::error_code ec;
+            if (!fileDigests[entryIndex] || !fs::exists(paths[entryIndex], ec)) continue; // removed earlier in the run
+
+            ArchiveGroup& group = byDigest[*fileDigests[entryIndex]];
+            group.size = nodes[entryIndex].size;
+            group.files.push_back(paths[entryIndex]);
+        }
+        else
+        {
+            const std::optional<Sha256Digest>& digest = memberDigests[entryIndex - firstMember];
+            if (!digest) continue;
+
+            const auto& [archive, member] = memberRefs[entryIndex - firstMember];
+            ArchiveGroup& group = byDigest[*digest];
+            group.size = archives[archive].members[member].size;
+            group.members.push_back(archiveMemberPath(paths[archives[archive].pathIndex], archives[archive].members[member]));
+        }
+    }
+
+    for (auto& [digest, group] : byDigest)
+    {
+        if (group.members.empty() || group.files.size() + group.members.size() < 2) continue;
+        group.hash = digestToHex(digest);
+        result.groups.push_back(std::move(group));
+    }
+
+    // Most space first, as with folder groups
+    std::stable_sort(result.groups.begin(), result.groups.end(), [](const ArchiveGroup& a, const ArchiveGroup& b)
+    {
+        return a.size * (a.files.size() + a.members.size()) > b.size * (b.files.size() + b.members.size());
+    });
+    return result;
+}
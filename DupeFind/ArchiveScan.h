@@ -0,0 +1,74 @@
+#pragma once
+
+#include "HashCalculator.h"
+#include "FileScanner.h"
+
+#include <filesystem>
+#include <optional>
+#include <string>
+#include <vector>
+#include <cstdint>
+
+namespace fs = std::filesystem;
+
+// Duplicates inside zip and tar files, found without extracting anything. Members are listed from the zip central
+// directory or the tar headers, and only members whose size matches a loose file or another member are read.
+// Those are streamed through the hasher straight from the archive, through the deflate decoder for compressed zip
+// members. The archive's own CRC and size prefilter members against each other for free.
+
+enum class ArchiveKind
+{
+    None,
+    Zip,
+    Tar
+};
+
+// By extension: .zip and the zip-based .jar, .nupkg and .vsix; .tar. Compressed tarballs are a single deflate
+// stream that would have to be decoded in full just to list them, so they stay opaque.
+ArchiveKind archiveKindOf(const fs::path& filePath);
+
+struct ArchiveMember
+{
+    std::wstring name;        // path inside the archive, with forward slashes
+    uint64_t size = 0;        // uncompressed
+    uint64_t storedSize = 0;  // as stored in the archive
+    uint64_t offset = 0;      // zip: the member's local header; tar: its first content byte
+    uint32_t crc = 0;         // zip only
+    uint16_t method = 0;      // zip: 0 stored, 8 deflate
+};
+
+// Regular, unencrypted members with contents the reader can decode; directories, links and empty members are left
+// out. False if the file is not a readable archive of that kind.
+bool listArchiveMembers(const fs::path& archivePath, ArchiveKind kind, std::vector<ArchiveMember>& members);
+
+// Streams one member's contents through the hasher. Zip members are also checked against their stored CRC, so a
+// damaged member is never reported as a duplicate. handle is the archive, opened for reading.
+bool hashArchiveMember(void* handle, ArchiveKind kind, const ArchiveMember& member, Sha256Digest& digest, ReadStats* stats = nullptr);
+
+// Shown as "<archive>!/<member>", the form Java and most archive tools use
+fs::path archiveMemberPath(const fs::path& archivePath, const ArchiveMember& member);
+
+struct ArchiveGroup
+{
+    std::string hash;
+    uint64_t size = 0;               // uncompressed size of one copy
+    std::vector<fs::path> files;     // loose copies, which could be removed
+    std::vector<fs::path> members;   // copies inside archives, as archiveMemberPath
+};
+
+struct ArchiveDuplicates
+{
+    std::vector<ArchiveGroup> groups;
+    size_t archives = 0;             // archives that could be listed
+    size_t members = 0;              // members listed in them
+    size_t membersHashed = 0;
+    size_t membersSkippedByCrc = 0;  // shared a size only with members of another CRC
+};
+
+// Looks inside the zip and tar files among paths for members with the same contents as a loose file or another
+// member. fileDigests holds the loose digests from hashing, parallel to paths; loose files that shared their size
+// only with archive members were never hashed, so they are hashed here and filled in. Only groups with at least one
+// member are returned, since groups of loose files alone were reported by hashing already. Archives are read one
+// member at a time in the order they are stored, through the I/O scheduler like any other read.
+ArchiveDuplicates findArchiveDuplicates(const std::vector<fs::path>& paths, const std::vector<ScanNode>& nodes,
+    std::vector<std::optional<Sha256Digest>>& fileDigests, const HashOptions& options);
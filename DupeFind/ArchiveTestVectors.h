@@ -0,0 +1,277 @@
+#pragma once
+
+#include <cstddef>
+
+// Inputs for "DupeFind test archives", written by Python's zlib, zipfile and tarfile modules rather than by this
+// program, so the reader is checked against other writers. The contents they hold are built again by the test:
+//   hello  "Hello, DupeFind!\n"
+//   abc    "abc" 20 times and "\n"
+//   lines  "line <i>: the quick brown fox jumps over the lazy dog\n" for i from 0 to 39
+//
+// Raw deflate streams (wbits -15):
+//   DEFLATE_STORED      hello at level 0, one stored block
+//   DEFLATE_FIXED       abc at level 9, one fixed Huffman block
+//   DEFLATE_DYNAMIC     lines at level 9, one dynamic Huffman block
+//   DEFLATE_WINDOW      lines 30 times, 63 KB of output that wraps the 32 KB window twice
+//   DEFLATE_TRUNCATED   the first half of DEFLATE_DYNAMIC
+//   DEFLATE_BAD_BLOCK   a final block of the reserved type 3
+//   DEFLATE_BAD_LENGTH  a stored block whose length complement does not match
+//
+// BASIC_ZIP holds, in this order: hello.txt (stored), dir/ (a folder), dir/abc.txt (deflated), empty.txt (empty),
+// lines.txt (deflated) and caf\u00E9.txt (abc, stored, with the UTF-8 name flag). The offsets after the arrays are where
+// the test damages it: the CRC of hello.txt in the central directory, a byte of lines.txt's compressed data, and the
+// start of the central directory.
+//
+// ZIP64_ZIP is written by hand, since zipfile only uses ZIP64 for large archives: big/one.txt (hello, stored) and
+// two.txt (lines, deflated), with every size and offset in the central directory moved to the ZIP64 extra field,
+// and an end record of 0xFFFF and 0xFFFFFFFF that points on to a ZIP64 end record.
+//
+// The tar files are mostly zero padding, so they are kept deflated and inflated by the test, after the deflate
+// streams above have passed. Their sizes follow the arrays.
+//   USTAR_TAR  hello.txt, deep/ (a folder), a 130-character path split into the ustar prefix and name (abc), lines.txt
+//   GNU_TAR    a 154-character name in a GNU 'L' long name entry (abc), hello.txt
+//   PAX_TAR    \u00FCnic\u00F6de.txt (abc) named by a pax path record, and sized.txt (hello) whose ustar size field was
+//              zeroed after writing, so only its pax size record is right
+
+const unsigned char DEFLATE_STORED[] =
+{
+    0x01, 0x11, 0x00, 0xEE, 0xFF, 0x48, 0x65, 0x6C, 0x6C, 0x6F, 0x2C, 0x20, 0x44, 0x75, 0x70, 0x65,
+    0x46, 0x69, 0x6E, 0x64, 0x21, 0x0A,
+};
+
+const unsigned char DEFLATE_FIXED[] =
+{
+    0x4B, 0x4C, 0x4A, 0x4E, 0x24, 0x17, 0x71, 0x01, 0x00,
+};
+
+const unsigned char DEFLATE_DYNAMIC[] =
+{
+    0x9D, 0xD5, 0x5B, 0x16, 0xC1, 0x50, 0x0C, 0x46, 0xE1, 0x77, 0xA3, 0xC8, 0x10, 0xE4, 0x0F, 0x2D,
+    0x66, 0xE3, 0x72, 0x68, 0x39, 0x7A, 0x68, 0xD5, 0x6D, 0xF4, 0x16, 0x33, 0xB0, 0x9F, 0xB3, 0xF6,
+    0x53, 0xBE, 0x95, 0xE4, 0xB6, 0x4B, 0x36, 0x5D, 0xD9, 0xAD, 0x49, 0x76, 0x1D, 0xDB, 0xED, 0xC9,
+    0x36, 0x7D, 0x79, 0x74, 0xB6, 0x2F, 0x4F, 0x3B, 0x8E, 0xE7, 0xCB, 0x60, 0xE5, 0x9E, 0xFA, 0xDF,
+    0x38, 0xAF, 0xDF, 0x2F, 0xDB, 0x95, 0xC3, 0x24, 0x7F, 0x1B, 0x07, 0x8D, 0x40, 0x13, 0xA0, 0x99,
+    0x81, 0x66, 0x0E, 0x9A, 0x0A, 0x34, 0x35, 0x68, 0x16, 0xA0, 0x59, 0x92, 0x9D, 0x22, 0x08, 0x44,
+    0x82, 0x13, 0x0A, 0x4E, 0x2C, 0x38, 0xC1, 0xE0, 0x44, 0x83, 0x13, 0x0E, 0x4E, 0x3C, 0x38, 0x01,
+    0xE1, 0x44, 0x84, 0x88, 0x08, 0xA1, 0xDB, 0x40, 0x44, 0x88, 0x88, 0x10, 0x11, 0x21, 0x22, 0x42,
+    0x44, 0x84, 0x88, 0x08, 0x11, 0x11, 0x22, 0x22, 0x82, 0x88, 0x08, 0x22, 0x22, 0xD0, 0xBB, 0x20,
+    0x22, 0x82, 0x88, 0x08, 0x22, 0x22, 0x88, 0x88, 0x20, 0x22, 0x82, 0x88, 0x88, 0x3F, 0x45, 0x7C,
+    0x00,
+};
+
+const unsigned char DEFLATE_WINDOW[] =
+{
+    0xED, 0xD6, 0x4D, 0x32, 0x43, 0x41, 0x18, 0x85, 0xE1, 0xB9, 0x55, 0xF4, 0x12, 0xF4, 0xD7, 0x08,
+    0x76, 0xE3, 0xE7, 0x22, 0x5C, 0xB9, 0x11, 0x22, 0x58, 0xBD, 0x8A, 0x15, 0xA8, 0x33, 0x7E, 0xC6,
+    0x5D, 0x67, 0xD4, 0x6F, 0x75, 0x3F, 0xF3, 0x7A, 0x33, 0xB5, 0xD3, 0xEB, 0xF6, 0xF1, 0x34, 0xB5,
+    0xB7, 0xFD, 0xFA, 0xEE, 0xA5, 0xDD, 0xEE, 0x96, 0xC3, 0xA6, 0x3D, 0x2C, 0x5F, 0xED, 0x79, 0xFF,
+    0xBA, 0x7D, 0x6F, 0xCB, 0xE7, 0xB4, 0xFB, 0x3B, 0x9E, 0x6F, 0x7E, 0xBE, 0xDB, 0xFD, 0xF2, 0x78,
+    0x32, 0x1F, 0x37, 0x3D, 0xD8, 0x54, 0xB0, 0x19, 0xC1, 0xE6, 0x2C, 0xD8, 0x9C, 0x07, 0x9B, 0x8B,
+    0x60, 0xB3, 0x0A, 0x36, 0x97, 0xC1, 0xE6, 0x2A, 0xB9, 0xD3, 0x28, 0x84, 0xA4, 0x84, 0x9E, 0xA4,
+    0xD0, 0x93, 0x16, 0x7A, 0x12, 0x43, 0x4F, 0x6A, 0xE8, 0x49, 0x0E, 0x3D, 0xE9, 0xA1, 0x27, 0x41,
+    0xF4, 0xA4, 0x88, 0x4A, 0x8A, 0xA8, 0xE8, 0x6D, 0x48, 0x8A, 0xA8, 0xA4, 0x88, 0x4A, 0x8A, 0xA8,
+    0xA4, 0x88, 0x4A, 0x8A, 0xA8, 0xA4, 0x88, 0x4A, 0x8A, 0xA8, 0xA4, 0x88, 0x91, 0x14, 0x31, 0x92,
+    0x22, 0x46, 0xF4, 0x5D, 0x24, 0x45, 0x8C, 0xA4, 0x88, 0x91, 0x14, 0x31, 0x92, 0x22, 0x46, 0x52,
+    0xC4, 0x48, 0x8A, 0x18, 0x49, 0x11, 0xF4, 0x40, 0x0F, 0xF4, 0x40, 0x0F, 0xF4, 0x40, 0x0F, 0xF4,
+    0x40, 0x0F, 0xF4, 0x40, 0x0F, 0xF4, 0x40, 0x0F, 0xF4, 0x40, 0x0F, 0xF4, 0x40, 0x0F, 0xF4, 0x40,
+    0x0F, 0xF4, 0x40, 0x0F, 0xF4, 0x40, 0x0F, 0xF4, 0x40, 0x0F, 0xF4, 0x40, 0x0F, 0xF4, 0x40, 0x0F,
+    0xF4, 0x40, 0x0F, 0xF4, 0x40, 0x0F, 0xF4, 0x40, 0x0F, 0xF4, 0x40, 0x0F, 0xF4, 0x40, 0x0F, 0xF4,
+    0x40, 0x0F, 0xF4, 0x40, 0x0F, 0xF4, 0x40, 0x0F, 0xF4, 0x40, 0x0F, 0xF4, 0x40, 0x0F, 0xF4, 0x40,
+    0x0F, 0xF4, 0x40, 0x0F, 0xF4, 0x40, 0x0F, 0xF4, 0x40, 0x0F, 0xF4, 0x40, 0x0F, 0xF4, 0x40, 0x0F,
+    0xF4, 0x40, 0x0F, 0xF4, 0x40, 0x0F, 0xF4, 0x40, 0x0F, 0xF4, 0x40, 0x0F, 0xF4, 0x40, 0x0F, 0xF4,
+    0x40, 0x0F, 0xF4, 0x40, 0x0F, 0xF4, 0x40, 0x0F, 0xF4, 0x40, 0x0F, 0xF4, 0x40, 0x0F, 0xF4, 0x40,
+    0x0F, 0xF4, 0x40, 0x0F, 0xF4, 0x40, 0x0F, 0xF4, 0x40, 0x0F, 0xF4, 0x40, 0x0F, 0xF4, 0x40, 0x0F,
+    0xF4, 0x40, 0x0F, 0xF4, 0x40, 0x0F, 0xF4, 0x40, 0x0F, 0xF4, 0x40, 0x0F, 0xF4, 0x40, 0x0F, 0xF4,
+    0x40, 0x0F, 0xF4, 0x40, 0x0F, 0xF4, 0x40, 0x0F, 0xF4, 0x40, 0x0F, 0xF4, 0x40, 0x0F, 0xF4, 0x40,
+    0x0F, 0xF4, 0x40, 0x0F, 0xF4, 0x40, 0x0F, 0xF4, 0x40, 0x0F, 0xF4, 0x40, 0x0F, 0xF4, 0x40, 0x0F,
+    0xF4, 0x40, 0x0F, 0xF4, 0x40, 0x0F, 0xF4, 0x40, 0x0F, 0xF4, 0x40, 0x0F, 0xF4, 0x40, 0x0F, 0xF4,
+    0x40, 0x0F, 0xF4, 0x40, 0x0F, 0xF4, 0x40, 0x0F, 0xF4, 0x40, 0x0F, 0xF4, 0x40, 0x0F, 0xF4, 0x40,
+    0x0F, 0xF4, 0x40, 0x0F, 0xF4, 0x40, 0x0F, 0xF4, 0x40, 0x0F, 0xF4, 0x40, 0x0F, 0xF4, 0x40, 0x0F,
+    0xF4, 0x40, 0x0F, 0xF4, 0x40, 0x0F, 0xF4, 0x40, 0x0F, 0xF4, 0x40, 0x0F, 0xF4, 0x40, 0x0F, 0xF4,
+    0x40, 0x0F, 0xF4, 0x40, 0x0F, 0xF4, 0x40, 0x0F, 0xF4, 0x40, 0x0F, 0xF4, 0x40, 0x0F, 0xF4, 0x40,
+    0x0F, 0xF4, 0x40, 0x0F, 0xF4, 0x40, 0x0F, 0xF4, 0x40, 0x0F, 0xF4, 0x40, 0x0F, 0xF4, 0x40, 0x0F,
+    0xF4, 0x40, 0x0F, 0xF4, 0x40, 0x0F, 0xF4, 0x40, 0x0F, 0xF4, 0x40, 0x0F, 0xF4, 0x40, 0x0F, 0xF4,
+    0x40, 0x0F, 0xF4, 0x40, 0x0F, 0xF4, 0x40, 0x0F, 0xF4, 0x40, 0x0F, 0xF4, 0x40, 0x0F, 0xF4, 0x40,
+    0x0F, 0xF4, 0x40, 0x0F, 0xF4, 0x40, 0x0F, 0xF4, 0x40, 0x0F, 0xF4, 0x40, 0x0F, 0xF4, 0x40, 0x0F,
+    0xF4, 0x40, 0x0F, 0xF4, 0x40, 0x0F, 0xF4, 0x40, 0x0F, 0xF4, 0x40, 0x0F, 0xF4, 0x40, 0x0F, 0xF4,
+    0x40, 0x0F, 0xF4, 0x40, 0x0F, 0xF4, 0x40, 0x0F, 0xF4, 0xF0, 0xCF, 0xD1, 0x2F,
+};
+
+const unsigned char DEFLATE_TRUNCATED[] =
+{
+    0x9D, 0xD5, 0x5B, 0x16, 0xC1, 0x50, 0x0C, 0x46, 0xE1, 0x77, 0xA3, 0xC8, 0x10, 0xE4, 0x0F, 0x2D,
+    0x66, 0xE3, 0x72, 0x68, 0x39, 0x7A, 0x68, 0xD5, 0x6D, 0xF4, 0x16, 0x33, 0xB0, 0x9F, 0xB3, 0xF6,
+    0x53, 0xBE, 0x95, 0xE4, 0xB6, 0x4B, 0x36, 0x5D, 0xD9, 0xAD, 0x49, 0x76, 0x1D, 0xDB, 0xED, 0xC9,
+    0x36, 0x7D, 0x79, 0x74, 0xB6, 0x2F, 0x4F, 0x3B, 0x8E, 0xE7, 0xCB, 0x60, 0xE5, 0x9E, 0xFA, 0xDF,
+    0x38, 0xAF, 0xDF, 0x2F, 0xDB, 0x95, 0xC3, 0x24, 0x7F, 0x1B, 0x07, 0x8D, 0x40, 0x13, 0xA0, 0x99,
+};
+
+const unsigned char DEFLATE_BAD_BLOCK[] =
+{
+    0x07, 0x00,
+};
+
+const unsigned char DEFLATE_BAD_LENGTH[] =
+{
+    0x01, 0x05, 0x00, 0x00, 0x00, 0x68, 0x65, 0x6C, 0x6C, 0x6F,
+};
+
+const unsigned char BASIC_ZIP[] =
+{
+    0x50, 0x4B, 0x03, 0x04, 0x14, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x21, 0x58, 0x6E, 0x5F,
+    0x93, 0xCF, 0x11, 0x00, 0x00, 0x00, 0x11, 0x00, 0x00, 0x00, 0x09, 0x00, 0x00, 0x00, 0x68, 0x65,
+    0x6C, 0x6C, 0x6F, 0x2E, 0x74, 0x78, 0x74, 0x48, 0x65, 0x6C, 0x6C, 0x6F, 0x2C, 0x20, 0x44, 0x75,
+    0x70, 0x65, 0x46, 0x69, 0x6E, 0x64, 0x21, 0x0A, 0x50, 0x4B, 0x03, 0x04, 0x14, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x21, 0x58, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x04, 0x00, 0x00, 0x00, 0x64, 0x69, 0x72, 0x2F, 0x50, 0x4B, 0x03, 0x04, 0x14, 0x00,
+    0x00, 0x00, 0x08, 0x00, 0x00, 0x00, 0x21, 0x58, 0x1C, 0xCB, 0xE9, 0x77, 0x09, 0x00, 0x00, 0x00,
+    0x3D, 0x00, 0x00, 0x00, 0x0B, 0x00, 0x00, 0x00, 0x64, 0x69, 0x72, 0x2F, 0x61, 0x62, 0x63, 0x2E,
+    0x74, 0x78, 0x74, 0x4B, 0x4C, 0x4A, 0x4E, 0x24, 0x17, 0x71, 0x01, 0x00, 0x50, 0x4B, 0x03, 0x04,
+    0x14, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x21, 0x58, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x09, 0x00, 0x00, 0x00, 0x65, 0x6D, 0x70, 0x74, 0x79, 0x2E,
+    0x74, 0x78, 0x74, 0x50, 0x4B, 0x03, 0x04, 0x14, 0x00, 0x00, 0x00, 0x08, 0x00, 0x00, 0x00, 0x21,
+    0x58, 0x64, 0x58, 0x7B, 0x18, 0xA1, 0x00, 0x00, 0x00, 0x3E, 0x08, 0x00, 0x00, 0x09, 0x00, 0x00,
+    0x00, 0x6C, 0x69, 0x6E, 0x65, 0x73, 0x2E, 0x74, 0x78, 0x74, 0x9D, 0xD5, 0x5B, 0x16, 0xC1, 0x50,
+    0x0C, 0x46, 0xE1, 0x77, 0xA3, 0xC8, 0x10, 0xE4, 0x0F, 0x2D, 0x66, 0xE3, 0x72, 0x68, 0x39, 0x7A,
+    0x68, 0xD5, 0x6D, 0xF4, 0x16, 0x33, 0xB0, 0x9F, 0xB3, 0xF6, 0x53, 0xBE, 0x95, 0xE4, 0xB6, 0x4B,
+    0x36, 0x5D, 0xD9, 0xAD, 0x49, 0x76, 0x1D, 0xDB, 0xED, 0xC9, 0x36, 0x7D, 0x79, 0x74, 0xB6, 0x2F,
+    0x4F, 0x3B, 0x8E, 0xE7, 0xCB, 0x60, 0xE5, 0x9E, 0xFA, 0xDF, 0x38, 0xAF, 0xDF, 0x2F, 0xDB, 0x95,
+    0xC3, 0x24, 0x7F, 0x1B, 0x07, 0x8D, 0x40, 0x13, 0xA0, 0x99, 0x81, 0x66, 0x0E, 0x9A, 0x0A, 0x34,
+    0x35, 0x68, 0x16, 0xA0, 0x59, 0x92, 0x9D, 0x22, 0x08, 0x44, 0x82, 0x13, 0x0A, 0x4E, 0x2C, 0x38,
+    0xC1, 0xE0, 0x44, 0x83, 0x13, 0x0E, 0x4E, 0x3C, 0x38, 0x01, 0xE1, 0x44, 0x84, 0x88, 0x08, 0xA1,
+    0xDB, 0x40, 0x44, 0x88, 0x88, 0x10, 0x11, 0x21, 0x22, 0x42, 0x44, 0x84, 0x88, 0x08, 0x11, 0x11,
+    0x22, 0x22, 0x82, 0x88, 0x08, 0x22, 0x22, 0xD0, 0xBB, 0x20, 0x22, 0x82, 0x88, 0x08, 0x22, 0x22,
+    0x88, 0x88, 0x20, 0x22, 0x82, 0x88, 0x88, 0x3F, 0x45, 0x7C, 0x00, 0x50, 0x4B, 0x03, 0x04, 0x14,
+    0x00, 0x00, 0x08, 0x00, 0x00, 0x00, 0x00, 0x21, 0x58, 0x1C, 0xCB, 0xE9, 0x77, 0x3D, 0x00, 0x00,
+    0x00, 0x3D, 0x00, 0x00, 0x00, 0x09, 0x00, 0x00, 0x00, 0x63, 0x61, 0x66, 0xC3, 0xA9, 0x2E, 0x74,
+    0x78, 0x74, 0x61, 0x62, 0x63, 0x61, 0x62, 0x63, 0x61, 0x62, 0x63, 0x61, 0x62, 0x63, 0x61, 0x62,
+    0x63, 0x61, 0x62, 0x63, 0x61, 0x62, 0x63, 0x61, 0x62, 0x63, 0x61, 0x62, 0x63, 0x61, 0x62, 0x63,
+    0x61, 0x62, 0x63, 0x61, 0x62, 0x63, 0x61, 0x62, 0x63, 0x61, 0x62, 0x63, 0x61, 0x62, 0x63, 0x61,
+    0x62, 0x63, 0x61, 0x62, 0x63, 0x61, 0x62, 0x63, 0x61, 0x62, 0x63, 0x61, 0x62, 0x63, 0x0A, 0x50,
+    0x4B, 0x01, 0x02, 0x14, 0x03, 0x14, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x21, 0x58, 0x6E,
+    0x5F, 0x93, 0xCF, 0x11, 0x00, 0x00, 0x00, 0x11, 0x00, 0x00, 0x00, 0x09, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x80, 0x01, 0x00, 0x00, 0x00, 0x00, 0x68, 0x65, 0x6C,
+    0x6C, 0x6F, 0x2E, 0x74, 0x78, 0x74, 0x50, 0x4B, 0x01, 0x02, 0x14, 0x03, 0x14, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x21, 0x58, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x04, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x80, 0x01,
+    0x38, 0x00, 0x00, 0x00, 0x64, 0x69, 0x72, 0x2F, 0x50, 0x4B, 0x01, 0x02, 0x14, 0x03, 0x14, 0x00,
+    0x00, 0x00, 0x08, 0x00, 0x00, 0x00, 0x21, 0x58, 0x1C, 0xCB, 0xE9, 0x77, 0x09, 0x00, 0x00, 0x00,
+    0x3D, 0x00, 0x00, 0x00, 0x0B, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x80, 0x01, 0x5A, 0x00, 0x00, 0x00, 0x64, 0x69, 0x72, 0x2F, 0x61, 0x62, 0x63, 0x2E, 0x74, 0x78,
+    0x74, 0x50, 0x4B, 0x01, 0x02, 0x14, 0x03, 0x14, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x21,
+    0x58, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x09, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x80, 0x01, 0x8C, 0x00, 0x00, 0x00, 0x65,
+    0x6D, 0x70, 0x74, 0x79, 0x2E, 0x74, 0x78, 0x74, 0x50, 0x4B, 0x01, 0x02, 0x14, 0x03, 0x14, 0x00,
+    0x00, 0x00, 0x08, 0x00, 0x00, 0x00, 0x21, 0x58, 0x64, 0x58, 0x7B, 0x18, 0xA1, 0x00, 0x00, 0x00,
+    0x3E, 0x08, 0x00, 0x00, 0x09, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x80, 0x01, 0xB3, 0x00, 0x00, 0x00, 0x6C, 0x69, 0x6E, 0x65, 0x73, 0x2E, 0x74, 0x78, 0x74, 0x50,
+    0x4B, 0x01, 0x02, 0x14, 0x03, 0x14, 0x00, 0x00, 0x08, 0x00, 0x00, 0x00, 0x00, 0x21, 0x58, 0x1C,
+    0xCB, 0xE9, 0x77, 0x3D, 0x00, 0x00, 0x00, 0x3D, 0x00, 0x00, 0x00, 0x09, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x80, 0x01, 0x7B, 0x01, 0x00, 0x00, 0x63, 0x61, 0x66,
+    0xC3, 0xA9, 0x2E, 0x74, 0x78, 0x74, 0x50, 0x4B, 0x05, 0x06, 0x00, 0x00, 0x00, 0x00, 0x06, 0x00,
+    0x06, 0x00, 0x47, 0x01, 0x00, 0x00, 0xDF, 0x01, 0x00, 0x00, 0x00, 0x00,
+};
+
+const unsigned char ZIP64_ZIP[] =
+{
+    0x50, 0x4B, 0x03, 0x04, 0x2D, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x21, 0x58, 0x6E, 0x5F,
+    0x93, 0xCF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0x0B, 0x00, 0x14, 0x00, 0x62, 0x69,
+    0x67, 0x2F, 0x6F, 0x6E, 0x65, 0x2E, 0x74, 0x78, 0x74, 0x01, 0x00, 0x10, 0x00, 0x11, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x11, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x48, 0x65, 0x6C,
+    0x6C, 0x6F, 0x2C, 0x20, 0x44, 0x75, 0x70, 0x65, 0x46, 0x69, 0x6E, 0x64, 0x21, 0x0A, 0x50, 0x4B,
+    0x03, 0x04, 0x2D, 0x00, 0x00, 0x00, 0x08, 0x00, 0x00, 0x00, 0x21, 0x58, 0x64, 0x58, 0x7B, 0x18,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0x07, 0x00, 0x14, 0x00, 0x74, 0x77, 0x6F, 0x2E,
+    0x74, 0x78, 0x74, 0x01, 0x00, 0x10, 0x00, 0x3E, 0x08, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xA1,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x9D, 0xD5, 0x5B, 0x16, 0xC1, 0x50, 0x0C, 0x46, 0xE1,
+    0x77, 0xA3, 0xC8, 0x10, 0xE4, 0x0F, 0x2D, 0x66, 0xE3, 0x72, 0x68, 0x39, 0x7A, 0x68, 0xD5, 0x6D,
+    0xF4, 0x16, 0x33, 0xB0, 0x9F, 0xB3, 0xF6, 0x53, 0xBE, 0x95, 0xE4, 0xB6, 0x4B, 0x36, 0x5D, 0xD9,
+    0xAD, 0x49, 0x76, 0x1D, 0xDB, 0xED, 0xC9, 0x36, 0x7D, 0x79, 0x74, 0xB6, 0x2F, 0x4F, 0x3B, 0x8E,
+    0xE7, 0xCB, 0x60, 0xE5, 0x9E, 0xFA, 0xDF, 0x38, 0xAF, 0xDF, 0x2F, 0xDB, 0x95, 0xC3, 0x24, 0x7F,
+    0x1B, 0x07, 0x8D, 0x40, 0x13, 0xA0, 0x99, 0x81, 0x66, 0x0E, 0x9A, 0x0A, 0x34, 0x35, 0x68, 0x16,
+    0xA0, 0x59, 0x92, 0x9D, 0x22, 0x08, 0x44, 0x82, 0x13, 0x0A, 0x4E, 0x2C, 0x38, 0xC1, 0xE0, 0x44,
+    0x83, 0x13, 0x0E, 0x4E, 0x3C, 0x38, 0x01, 0xE1, 0x44, 0x84, 0x88, 0x08, 0xA1, 0xDB, 0x40, 0x44,
+    0x88, 0x88, 0x10, 0x11, 0x21, 0x22, 0x42, 0x44, 0x84, 0x88, 0x08, 0x11, 0x11, 0x22, 0x22, 0x82,
+    0x88, 0x08, 0x22, 0x22, 0xD0, 0xBB, 0x20, 0x22, 0x82, 0x88, 0x08, 0x22, 0x22, 0x88, 0x88, 0x20,
+    0x22, 0x82, 0x88, 0x88, 0x3F, 0x45, 0x7C, 0x00, 0x50, 0x4B, 0x01, 0x02, 0x2D, 0x00, 0x2D, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x21, 0x58, 0x6E, 0x5F, 0x93, 0xCF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0x0B, 0x00, 0x1C, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0xFF, 0xFF, 0xFF, 0xFF, 0x62, 0x69, 0x67, 0x2F, 0x6F, 0x6E, 0x65, 0x2E, 0x74, 0x78,
+    0x74, 0x01, 0x00, 0x18, 0x00, 0x11, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x11, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x50, 0x4B, 0x01,
+    0x02, 0x2D, 0x00, 0x2D, 0x00, 0x00, 0x00, 0x08, 0x00, 0x00, 0x00, 0x21, 0x58, 0x64, 0x58, 0x7B,
+    0x18, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0x07, 0x00, 0x1C, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xFF, 0xFF, 0xFF, 0xFF, 0x74, 0x77, 0x6F, 0x2E, 0x74,
+    0x78, 0x74, 0x01, 0x00, 0x18, 0x00, 0x3E, 0x08, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xA1, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x4E, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x50, 0x4B,
+    0x06, 0x06, 0x2C, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x2D, 0x00, 0x2D, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x02, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x02, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xA6, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x28, 0x01,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x50, 0x4B, 0x06, 0x07, 0x00, 0x00, 0x00, 0x00, 0xCE, 0x01,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x01, 0x00, 0x00, 0x00, 0x50, 0x4B, 0x05, 0x06, 0x00, 0x00,
+    0x00, 0x00, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0x00, 0x00,
+};
+
+const unsigned char USTAR_TAR_DEFLATED[] =
+{
+    0xED, 0x96, 0xCB, 0x4E, 0xC3, 0x30, 0x10, 0x45, 0xBD, 0xEE, 0x57, 0x98, 0x3D, 0x02, 0xCF, 0x8C,
+    0x13, 0x03, 0x6B, 0x84, 0xF8, 0x8D, 0xB4, 0x31, 0x34, 0x34, 0x24, 0x21, 0x0F, 0x28, 0x7C, 0x3D,
+    0x26, 0xBB, 0xC2, 0xA2, 0x70, 0xAB, 0x04, 0x55, 0xF5, 0x51, 0xA4, 0x58, 0x89, 0xAE, 0xBC, 0x98,
+    0x33, 0xF6, 0xAC, 0x7D, 0x59, 0xD6, 0x17, 0xFD, 0xB6, 0x57, 0xD3, 0x61, 0x02, 0xA9, 0xB5, 0xE3,
+    0x3B, 0xF0, 0xFD, 0x6D, 0x0C, 0x93, 0x22, 0x9B, 0x58, 0x6B, 0xC3, 0x72, 0xFC, 0xEE, 0x52, 0x61,
+    0xA5, 0x8D, 0x9A, 0x81, 0xA1, 0xEB, 0xB3, 0x36, 0x6C, 0xA9, 0x4E, 0x93, 0xFB, 0xAF, 0xFA, 0x9F,
+    0xEB, 0xDB, 0xA1, 0xF1, 0x77, 0x45, 0x95, 0x9F, 0x2D, 0x54, 0xE4, 0x94, 0xC8, 0xBD, 0x6F, 0x2E,
+    0x27, 0xDE, 0x63, 0x6F, 0xFF, 0x87, 0xF5, 0x6E, 0xFF, 0xA7, 0xCE, 0x38, 0xA5, 0x93, 0xD8, 0xFF,
+    0x93, 0x53, 0x1D, 0xC0, 0x6F, 0xAF, 0x8D, 0xBD, 0xF5, 0x77, 0xC9, 0x6E, 0xFD, 0xAD, 0x61, 0xB6,
+    0x47, 0x7E, 0xFE, 0x8F, 0x8D, 0x95, 0x1F, 0xC0, 0x3C, 0xF5, 0xCF, 0x96, 0x2B, 0xF8, 0x89, 0x77,
+    0xC5, 0xF1, 0x53, 0x16, 0x95, 0xEF, 0xFE, 0x77, 0xFE, 0xB3, 0x61, 0xDC, 0xFB, 0x31, 0xFF, 0x25,
+    0x2E, 0xCE, 0x7F, 0x73, 0xD5, 0x5F, 0x9B, 0x1B, 0xDD, 0xAF, 0xBD, 0x7E, 0x19, 0x8A, 0xD5, 0x46,
+    0x2F, 0xDB, 0xFA, 0xAD, 0xD2, 0x0F, 0xF5, 0x56, 0x3F, 0x0D, 0xCF, 0x4D, 0xA7, 0xEB, 0x57, 0xDF,
+    0x8E, 0xBF, 0xCB, 0xEC, 0xE3, 0x5D, 0xE7, 0xF5, 0xE3, 0x62, 0xCC, 0x10, 0x90, 0x61, 0x20, 0x23,
+    0x40, 0xC6, 0x02, 0x99, 0x04, 0xC8, 0xA4, 0x40, 0xC6, 0x01, 0x99, 0x2B, 0x20, 0x73, 0x8D, 0xD4,
+    0x14, 0x12, 0x01, 0x31, 0x81, 0x10, 0x15, 0x08, 0x71, 0x81, 0x10, 0x19, 0x08, 0xB1, 0x81, 0x10,
+    0x1D, 0x08, 0xF1, 0x81, 0x10, 0x21, 0x08, 0x31, 0x82, 0x11, 0x23, 0x18, 0x3A, 0x1B, 0x10, 0x23,
+    0x18, 0x31, 0x82, 0x11, 0x23, 0x18, 0x31, 0x82, 0x11, 0x23, 0x18, 0x31, 0x82, 0x11, 0x23, 0x18,
+    0x31, 0x42, 0x10, 0x23, 0x04, 0x31, 0x42, 0xA0, 0xEB, 0x02, 0x31, 0x42, 0x10, 0x23, 0x04, 0x31,
+    0x42, 0x10, 0x23, 0x04, 0x31, 0x42, 0x10, 0x23, 0xE4, 0x8F, 0x46, 0xC4, 0xF9, 0x39, 0x12, 0x89,
+    0x44, 0x8E, 0x95, 0x4F,
+};
+
+const unsigned char GNU_TAR_DEFLATED[] =
+{
+    0xED, 0xD4, 0xB1, 0x0A, 0xC2, 0x30, 0x10, 0x80, 0xE1, 0x9B, 0x7D, 0x8A, 0xB8, 0x4B, 0x9A, 0x26,
+    0x17, 0xB3, 0x3A, 0x14, 0x71, 0xC8, 0x4B, 0x54, 0x2D, 0xB5, 0x58, 0xD2, 0x62, 0x53, 0xF0, 0xF1,
+    0x6D, 0x28, 0x08, 0x0E, 0x45, 0x10, 0x52, 0xD4, 0xDE, 0x47, 0x20, 0xE1, 0xD6, 0xF0, 0x1F, 0x4F,
+    0x78, 0xB2, 0xB3, 0x8D, 0x2B, 0x6D, 0xE5, 0xAE, 0x10, 0x87, 0x18, 0x4D, 0xDD, 0x42, 0x2A, 0xF5,
+    0x7C, 0x8F, 0x73, 0x63, 0xB4, 0x02, 0x66, 0x61, 0x06, 0x7D, 0xE7, 0xF3, 0x1B, 0x63, 0xB0, 0x50,
+    0xE5, 0x57, 0xE2, 0xFE, 0xEE, 0x81, 0xFC, 0xC9, 0xFF, 0x87, 0xA8, 0xB7, 0x88, 0x93, 0xFD, 0x0B,
+    0xA3, 0x21, 0x45, 0x8D, 0x88, 0xC3, 0x2E, 0x08, 0x73, 0x25, 0x85, 0xD2, 0xC0, 0x04, 0xF5, 0x1F,
+    0x5D, 0x7E, 0x3C, 0x7D, 0x7C, 0x56, 0x94, 0xCF, 0xCF, 0xBB, 0x14, 0x75, 0xDD, 0x44, 0x5E, 0xB7,
+    0x6F, 0xFB, 0x97, 0xE9, 0x6B, 0xFF, 0xC3, 0x42, 0x30, 0x92, 0xFA, 0x9F, 0xC3, 0x21, 0xFC, 0xFF,
+    0x86, 0x65, 0x7D, 0x5B, 0xEC, 0x2B, 0x77, 0x5E, 0x53, 0xD3, 0x84, 0x10, 0xB2, 0x0C, 0x0F,
+};
+
+const unsigned char PAX_TAR_DEFLATED[] =
+{
+    0xED, 0x95, 0xB1, 0x0A, 0xC2, 0x30, 0x10, 0x86, 0x33, 0xFB, 0x14, 0x71, 0x97, 0x34, 0x89, 0x69,
+    0x3B, 0x95, 0x3A, 0x88, 0x74, 0xF4, 0x15, 0x62, 0x13, 0xB0, 0x50, 0x6A, 0x69, 0x53, 0x28, 0x3E,
+    0x98, 0x93, 0x5B, 0x5F, 0xCC, 0x94, 0x0E, 0xA2, 0x50, 0x10, 0x21, 0x45, 0xC9, 0x7D, 0x04, 0xEE,
+    0xC8, 0x72, 0xC3, 0xF1, 0xDF, 0x47, 0x02, 0x12, 0xEC, 0x8E, 0xB2, 0xCF, 0xB4, 0x54, 0xBA, 0x41,
+    0x4E, 0xA0, 0x13, 0x73, 0x95, 0x52, 0x1E, 0x3D, 0xFB, 0xF1, 0x9F, 0x51, 0xCE, 0xB6, 0x08, 0xF7,
+    0x68, 0x01, 0xBA, 0xD6, 0xC8, 0xC6, 0x8E, 0x47, 0x7E, 0xC2, 0x39, 0xAE, 0xA5, 0x39, 0x27, 0xC3,
+    0xBD, 0x2A, 0xF2, 0xE1, 0xA6, 0x34, 0x31, 0xBD, 0x59, 0x21, 0xC0, 0x13, 0x52, 0xBB, 0xF6, 0x74,
+    0xDA, 0xBA, 0xB3, 0x19, 0x63, 0xA8, 0x23, 0x21, 0xE6, 0xF3, 0x1F, 0x87, 0x88, 0x89, 0x50, 0x08,
+    0x61, 0x4F, 0xC1, 0x94, 0x7F, 0x5B, 0x11, 0xA6, 0x90, 0x7F, 0xE7, 0xC8, 0x53, 0xFE, 0xF5, 0x83,
+    0x33, 0xF1, 0xFF, 0x90, 0x5F, 0xF0, 0xBF, 0x95, 0xFD, 0xBB, 0xFF, 0x69, 0x0C, 0xFE, 0x5F, 0x02,
+    0xC6, 0x70, 0x5B, 0x5C, 0x75, 0xC2, 0x62, 0x48, 0xB3, 0x8F, 0x8C, 0xCB, 0x57, 0x4E, 0xED, 0xFF,
+    0x81, 0xFF, 0x6D, 0xFF, 0xE2, 0x7F, 0x1A, 0x47, 0x82, 0x83, 0xFF, 0x97, 0x20, 0xD3, 0x65, 0x79,
+    0xD9, 0xE0, 0x7D, 0x57, 0xEB, 0x43, 0x51, 0xA9, 0x35, 0x5C, 0x01, 0x00, 0x00, 0x00, 0x3F, 0x78,
+    0x00,
+};
+
+const size_t BASIC_ZIP_HELLO_CRC = 495;
+const size_t BASIC_ZIP_LINES_DATA = 258;
+const size_t BASIC_ZIP_DIRECTORY = 479;
+const size_t USTAR_TAR_LINES_CONTENT = 3072;
+const size_t USTAR_TAR_SIZE = 6656;
+const size_t GNU_TAR_SIZE = 4096;
+const size_t PAX_TAR_SIZE = 5120;
@@ -0,0 +1,103 @@
+#include "Async.h"
+
+#include <algorithm>
+
+#define WIN32_LEAN_AND_MEAN
+#include <Windows.h>
+
+namespace
+{
+    // Posted with a null OVERLAPPED and no coroutine, tells one worker to exit
+    const ULONG_PTR QUIT_KEY = 0;
+}
+
+IoExecutor::IoExecutor(unsigned threadCount)
+{
+    static_assert(sizeof(OVERLAPPED) <= sizeof(ReadAwaiter::overlapped), "ReadAwaiter cannot hold an OVERLAPPED");
+
+    if (threadCount == 0) threadCount = std::max<unsigned>(1, std::thread::hardware_concurrency());
+
+    completionPort = CreateIoCompletionPort(INVALID_HANDLE_VALUE, nullptr, 0, threadCount);
+
+    for (unsigned i = 0; i < threadCount; ++i)
+    {
+        threads.emplace_back(&IoExecutor::workerLoop, this);
+    }
+}
+
+IoExecutor::~IoExecutor()
+{
+    for (size_t i = 0; i < threads.size(); ++i)
+    {
+        PostQueuedCompletionStatus(completionPort, 0, QUIT_KEY, nullptr);
+    }
+    for (auto& thread : threads)
+    {
+        thread.join();
+    }
+    if (completionPort) CloseHandle(completionPort);
+}
+
+bool IoExecutor::associate(void* fileHandle)
+{
+    return CreateIoCompletionPort(fileHandle, completionPort, 0, 0) != nullptr;
+}
+
+void IoExecutor::post(std::coroutine_handle<> handle)
+{
+    PostQueuedCompletionStatus(completionPort, 0, reinterpret_cast<ULONG_PTR>(handle.address()), nullptr);
+}
+
+bool IoExecutor::ReadAwaiter::await_suspend(std::coroutine_handle<> handle)
+{
+    continuation = handle;
+
+    OVERLAPPED* request = reinterpret_cast<OVERLAPPED*>(overlapped);
+    request->Offset = static_cast<DWORD>(offset);
+    request->OffsetHigh = static_cast<DWORD>(offset >> 32);
+
+    // Keep a copy: once the read is queued another thread may resume the coroutine and end this awaiter
+    IoExecutor& owner = executor;
+    uint64_t inFlight = owner.readsInFlight.fetch_add(1, std::memory_order_relaxed) + 1;
+    uint64_t peak = owner.peakReads.load(std::memory_order_relaxed);
+    while (inFlight > peak && !owner.peakReads.compare_exchange_weak(peak, inFlight, std::memory_order_relaxed)) {}
+
+    // Even a read that completes at once is reported through the port, so the coroutine always resumes there
+    if (ReadFile(fileHandle, buffer, length, nullptr, request) || GetLastError() == ERROR_IO_PENDING) return true;
+
+    DWORD error = GetLastError();
+    owner.readsInFlight.fetch_sub(1, std::memory_order_relaxed);
+    result = { 0, error == ERROR_HANDLE_EOF ? 0u : static_cast<uint32_t>(error) };
+    return false;
+}
+
+void IoExecutor::workerLoop()
+{
+    while (true)
+    {
+        DWORD bytesTransferred = 0;
+        ULONG_PTR key = 0;
+        OVERLAPPED* completed = nullptr;
+        BOOL ok = GetQueuedCompletionStatus(completionPort, &bytesTransferred, &key, &completed, INFINITE);
+
+        if (completed)
+        {
+            // A finished read; the awaiter that started it begins with its OVERLAPPED
+            ReadAwaiter* read = reinterpret_cast<ReadAwaiter*>(completed);
+            DWORD error = ok ? 0 : GetLastError();
+            read->result = { bytesTransferred, error == ERROR_HANDLE_EOF ? 0u : static_cast<uint32_t>(error) };
+            readsInFlight.fetch_sub(1, std::memory_order_relaxed);
+            resumptions.fetch_add(1, std::memory_order_relaxed);
+            read->continuation.resume();
+        }
+        else if (key != QUIT_KEY)
+        {
+            resumptions.fetch_add(1, std::memory_order_relaxed);
+            std::coroutine_handle<>::from_address(reinterpret_cast<void*>(key)).resume();
+        }
+        else
+        {
+            break; // asked to quit, or the port is gone
+        }
+    }
+}
@@ -0,0 +1,415 @@
+#pragma once
+
+#include <coroutine>
+#include <algorithm>
+#include <exception>
+#include <optional>
+#include <utility>
+#include <vector>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <atomic>
+#include <future>
+#include <cstdint>
+#include <cstddef>
+
+// Coroutine support for the scan and hash stages. A Task is a lazily started coroutine that resumes whoever
+// awaits it when it finishes. An IoExecutor runs them on a few threads that wait on one I/O completion port:
+// a file read started with co_await executor.read(...) parks the coroutine without holding a thread, and
+// whichever thread dequeues the completion resumes it. That way thousands of reads can be in flight at once
+// while the per-file logic still reads top to bottom.
+
+template <typename T>
+class Task;
+
+namespace detail
+{
+    struct TaskPromiseBase
+    {
+        std::coroutine_handle<> continuation;
+        std::exception_ptr exception;
+
+        std::suspend_always initial_suspend() noexcept { return {}; }
+
+        // Hands the thread straight to the awaiting coroutine, so long chains do not grow the stack
+        struct FinalAwaiter
+        {
+            bool await_ready() noexcept { return false; }
+
+            template <typename Promise>
+            std::coroutine_handle<> await_suspend(std::coroutine_handle<Promise> finished) noexcept
+            {
+                std::coroutine_handle<> next = finished.promise().continuation;
+                return next ? next : std::noop_coroutine();
+            }
+
+            void await_resume() noexcept {}
+        };
+
+        FinalAwaiter final_suspend() noexcept { return {}; }
+
+        void unhandled_exception() { exception = std::current_exception(); }
+    };
+
+    template <typename T>
+    struct TaskPromise : TaskPromiseBase
+    {
+        std::optional<T> value;
+
+        Task<T> get_return_object();
+        void return_value(T result) { value = std::move(result); }
+
+        T take()
+        {
+            if (exception) std::rethrow_exception(exception);
+            return std::move(*value);
+        }
+    };
+
+    template <>
+    struct TaskPromise<void> : TaskPromiseBase
+    {
+        Task<void> get_return_object();
+        void return_void() {}
+
+        void take()
+        {
+            if (exception) std::rethrow_exception(exception);
+        }
+    };
+
+    // Fire-and-forget coroutine that destroys itself when it finishes, used to start Tasks concurrently
+    struct DetachedTask
+    {
+        struct promise_type
+        {
+            DetachedTask get_return_object() { return {}; }
+            std::suspend_never initial_suspend() noexcept { return {}; }
+            std::suspend_never final_suspend() noexcept { return {}; }
+            void return_void() {}
+            void unhandled_exception() { std::terminate(); }
+        };
+    };
+}
+
+template <typename T = void>
+class Task
+{
+public:
+    using promise_type = detail::TaskPromise<T>;
+
+    explicit Task(std::coroutine_handle<promise_type> handle) : handle(handle) {}
+    Task(Task&& other) noexcept : handle(std::exchange(other.handle, {})) {}
+    Task& operator=(Task&& other) noexcept
+    {
+        if (this != &other)
+        {
+            if (handle) handle.destroy();
+            handle = std::exchange(other.handle, {});
+        }
+        return *this;
+    }
+    ~Task()
+    {
+        if (handle) handle.destroy();
+    }
+
+    Task(const Task&) = delete;
+    Task& operator=(const Task&) = delete;
+
+    bool await_ready() const noexcept { return false; }
+
+    std::coroutine_handle<> await_suspend(std::coroutine_handle<> awaiting) noexcept
+    {
+        handle.promise().continuation = awaiting;
+        return handle;
+    }
+
+    T await_resume() { return handle.promise().take(); }
+
+private:
+    std::coroutine_handle<promise_type> handle;
+};
+
+template <typename T>
+Task<T> detail::TaskPromise<T>::get_return_object()
+{
+    return Task<T>(std::coroutine_handle<TaskPromise<T>>::from_promise(*this));
+}
+
+inline Task<void> detail::TaskPromise<void>::get_return_object()
+{
+    return Task<void>(std::coroutine_handle<TaskPromise<void>>::from_promise(*this));
+}
+
+// Result of an overlapped read. error is a Win32 error code, 0 on success; reading at the end of the file
+// completes with 0 bytes and no error.
+struct IoResult
+{
+    uint32_t bytesTransferred = 0;
+    uint32_t error = 0;
+};
+
+class IoExecutor
+{
+public:
+    // threadCount 0 uses one thread per logical processor
+    explicit IoExecutor(unsigned threadCount = 0);
+    ~IoExecutor();
+
+    IoExecutor(const IoExecutor&) = delete;
+    IoExecutor& operator=(const IoExecutor&) = delete;
+
+    unsigned threadCount() const { return static_cast<unsigned>(threads.size()); }
+
+    // Every coroutine resumption, posted or completed, so switching overhead can be compared with a thread pool
+    uint64_t resumptionCount() const { return resumptions.load(std::memory_order_relaxed); }
+    uint64_t peakReadsInFlight() const { return peakReads.load(std::memory_order_relaxed); }
+
+    // Handles must be opened with FILE_FLAG_OVERLAPPED and associated once before they are read
+    bool associate(void* fileHandle);
+
+    // Resumes the coroutine on one of the executor's threads
+    void post(std::coroutine_handle<> handle);
+
+    struct ScheduleAwaiter
+    {
+        IoExecutor& executor;
+
+        bool await_ready() const noexcept { return false; }
+        void await_suspend(std::coroutine_handle<> handle) { executor.post(handle); }
+        void await_resume() const noexcept {}
+    };
+
+    // co_await executor.schedule() moves the rest of the coroutine onto the executor
+    ScheduleAwaiter schedule() { return { *this }; }
+
+    struct ReadAwaiter
+    {
+        // Must be the first member: the completion port hands back a pointer to it
+        alignas(void*) unsigned char overlapped[32];
+        IoExecutor& executor;
+        void* fileHandle;
+        uint64_t offset;
+        void* buffer;
+        uint32_t length;
+        std::coroutine_handle<> continuation;
+        IoResult result;
+
+        ReadAwaiter(IoExecutor& executor, void* fileHandle, uint64_t offset, void* buffer, uint32_t length)
+            : overlapped{}, executor(executor), fileHandle(fileHandle), offset(offset), buffer(buffer), length(length) {}
+
+        bool await_ready() const noexcept { return false; }
+        bool await_suspend(std::coroutine_handle<> handle);
+        IoResult await_resume() const noexcept { return result; }
+    };
+
+    ReadAwaiter read(void* fileHandle, uint64_t offset, void* buffer, uint32_t length) { return { *this, fileHandle, offset, buffer, length }; }
+
+private:
+    void workerLoop();
+
+    void* completionPort = nullptr;
+    std::vector<std::thread> threads;
+    std::atomic<uint64_t> resumptions{ 0 };
+    std::atomic<uint64_t> readsInFlight{ 0 };
+    std::atomic<uint64_t> peakReads{ 0 };
+};
+
+// Caps how much coroutines hold inside a section at once, e.g. how many files are open or how many bytes of
+// buffers are allocated. Waiters are resumed in arrival order on the executor rather than inside release, so a
+// release never runs someone else's work, and a large request is not passed over by smaller ones behind it.
+class AsyncLimiter
+{
+public:
+    AsyncLimiter(IoExecutor& executor, size_t limit) : executor(executor), limit(limit > 0 ? limit : 1), available(this->limit) {}
+
+    struct AcquireAwaiter
+    {
+        AsyncLimiter& limiter;
+        size_t count;
+
+        bool await_ready() const noexcept { return false; }
+        bool await_suspend(std::coroutine_handle<> handle)
+        {
+            std::lock_guard<std::mutex> lock(limiter.mutex);
+            if (limiter.waiters.empty() && limiter.available >= count)
+            {
+                limiter.available -= count;
+                return false;
+            }
+            limiter.waiters.push_back({ handle, count });
+            return true;
+        }
+        void await_resume() const noexcept {}
+    };
+
+    // More than the limit is clamped to it, so a request that could never fit waits for everything else instead
+    AcquireAwaiter acquire(size_t count = 1) { return { *this, std::min<size_t>(count, limit) }; }
+
+    // With the count that was acquired
+    void release(size_t count = 1)
+    {
+        std::vector<std::coroutine_handle<>> ready;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            available += std::min<size_t>(count, limit);
+            while (!waiters.empty() && waiters.front().second <= available)
+            {
+                available -= waiters.front().second; // what is freed passes straight to the waiters it covers
+                ready.push_back(waiters.front().first);
+                waiters.pop_front();
+            }
+        }
+        for (auto handle : ready)
+        {
+            executor.post(handle);
+        }
+    }
+
+private:
+    IoExecutor& executor;
+    std::mutex mutex;
+    const size_t limit;
+    size_t available;
+    std::deque<std::pair<std::coroutine_handle<>, size_t>> waiters;
+};
+
+// Starts every task on the executor and finishes when the last one has, with the results in task order
+template <typename T>
+Task<std::vector<T>> whenAll(IoExecutor& executor, std::vector<Task<T>> tasks);
+
+Task<void> whenAll(IoExecutor& executor, std::vector<Task<void>> tasks);
+
+namespace detail
+{
+    // Counts outstanding tasks plus one for the awaiting coroutine, so whichever side finishes last resumes it
+    struct JoinState
+    {
+        std::atomic<size_t> remaining;
+        std::coroutine_handle<> continuation;
+
+        explicit JoinState(size_t count) : remaining(count + 1) {}
+
+        void arrive()
+        {
+            if (remaining.fetch_sub(1, std::memory_order_acq_rel) == 1) continuation.resume();
+        }
+    };
+
+    struct JoinAwaiter
+    {
+        JoinState& state;
+
+        bool await_ready() const noexcept { return false; }
+        bool await_suspend(std::coroutine_handle<> handle)
+        {
+            state.continuation = handle;
+            return state.remaining.fetch_sub(1, std::memory_order_acq_rel) != 1;
+        }
+        void await_resume() const noexcept {}
+    };
+
+    template <typename T>
+    DetachedTask runJoined(IoExecutor& executor, Task<T> task, std::optional<T>& result, std::exception_ptr& exception, JoinState& state)
+    {
+        co_await executor.schedule();
+        try
+        {
+            result = co_await task;
+        }
+        catch (...)
+        {
+            exception = std::current_exception();
+        }
+        state.arrive();
+    }
+
+    inline DetachedTask runJoined(IoExecutor& executor, Task<void> task, std::exception_ptr& exception, JoinState& state)
+    {
+        co_await executor.schedule();
+        try
+        {
+            co_await task;
+        }
+        catch (...)
+        {
+            exception = std::current_exception();
+        }
+        state.arrive();
+    }
+
+    template <typename T>
+    DetachedTask runBlocking(IoExecutor& executor, Task<T> task, std::promise<T>& done)
+    {
+        co_await executor.schedule();
+        try
+        {
+            if constexpr (std::is_void_v<T>)
+            {
+                co_await task;
+                done.set_value();
+            }
+            else
+            {
+                done.set_value(co_await task);
+            }
+        }
+        catch (...)
+        {
+            done.set_exception(std::current_exception());
+        }
+    }
+}
+
+template <typename T>
+Task<std::vector<T>> whenAll(IoExecutor& executor, std::vector<Task<T>> tasks)
+{
+    std::vector<std::optional<T>> results(tasks.size());
+    std::vector<std::exception_ptr> exceptions(tasks.size());
+    detail::JoinState state(tasks.size());
+
+    for (size_t i = 0; i < tasks.size(); ++i)
+    {
+        detail::runJoined(executor, std::move(tasks[i]), results[i], exceptions[i], state);
+    }
+    co_await detail::JoinAwaiter{ state };
+
+    std::vector<T> values;
+    values.reserve(results.size());
+    for (size_t i = 0; i < results.size(); ++i)
+    {
+        if (exceptions[i]) std::rethrow_exception(exceptions[i]);
+        values.push_back(std::move(*results[i]));
+    }
+    co_return values;
+}
+
+inline Task<void> whenAll(IoExecutor& executor, std::vector<Task<void>> tasks)
+{
+    std::vector<std::exception_ptr> exceptions(tasks.size());
+    detail::JoinState state(tasks.size());
+
+    for (size_t i = 0; i < tasks.size(); ++i)
+    {
+        detail::runJoined(executor, std::move(tasks[i]), exceptions[i], state);
+    }
+    co_await detail::JoinAwaiter{ state };
+
+    for (const auto& exception : exceptions)
+    {
+        if (exception) std::rethrow_exception(exception);
+    }
+}
+
+// Runs a task to completion from ordinary code, blocking the calling thread (which is not one of the
+// executor's) until it is done
+template <typename T>
+T runBlocking(IoExecutor& executor, Task<T> task)
+{
+    std::promise<T> done;
+    std::future<T> result = done.get_future();
+    detail::runBlocking(executor, std::move(task), done);
+    return result.get();
+}
@@ -0,0 +1,150 @@
+#include "BenchCommands.h"
+#include "SortGrouping.h"
+#include "Utilities.h"
+
+#include <string>
+#include <vector>
+#include <map>
+#include <random>
+#include <chrono>
+#include <algorithm>
+
+namespace
+{
+    // Record counts "bench grouping" uses when none are given
+    const size_t DEFAULT_BENCH_COUNTS[] = { 1000000, 10000000 };
+
+    using Clock = std::chrono::steady_clock;
+
+    double millisecondsSince(Clock::time_point start)
+    {
+        return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+    }
+
+    // A synthetic scan with the shape of a real one: sizes are spread over a wide, skewed range so most are unique,
+    // and a tenth of the files are copies of an earlier file, with the same size and digest. Seeded, so every run
+    // and every machine benchmarks the same input.
+    std::vector<GroupRecord> makeRecords(size_t count)
+    {
+        std::mt19937_64 random(count);
+        std::vector<GroupRecord> records(count);
+        for (size_t i = 0; i < count; ++i)
+        {
+            GroupRecord& record = records[i];
+            record.entryIndex = static_cast<uint32_t>(i);
+            if (i > 0 && random() % 10 == 0)
+            {
+                const GroupRecord& original = records[random() % i];
+                record.size = original.size;
+                record.digestPrefix = original.digestPrefix;
+                continue;
+            }
+            record.size = random() >> (random() % 48);
+            record.digestPrefix = random();
+        }
+        return records;
+    }
+
+    bool sameOrder(const std::vector<GroupRecord>& a, const std::vector<GroupRecord>& b)
+    {
+        return a.size() == b.size() && std::equal(a.begin(), a.end(), b.begin(), [](const GroupRecord& x, const GroupRecord& y)
+        {
+            return x.size == y.size && x.digestPrefix == y.digestPrefix && x.entryIndex == y.entryIndex;
+        });
+    }
+
+    // Times the three ways to group the same records and checks that they agree: the std::map keyed by size and
+    // digest that grouping used before, the radix sort with its run scan, and std::stable_sort as the reference order
+    bool benchGrouping(size_t count)
+    {
+        printUnicodeMulti(true, L"\n", std::to_wstring(count), L" records:");
+        const std::vector<GroupRecord> input = makeRecords(count);
+
+        Clock::time_point start = Clock::now();
+        std::map<std::pair<uint64_t, uint64_t>, std::vector<uint32_t>> byKey;
+        for (const auto& record : input)
+        {
+            byKey[{ record.size, record.digestPrefix }].push_back(record.entryIndex);
+        }
+        std::vector<std::vector<uint32_t>> mapGroups;
+        for (auto& [key, entries] : byKey)
+        {
+            if (entries.size() >= 2) mapGroups.push_back(std::move(entries));
+        }
+        double mapTime = millisecondsSince(start);
+        byKey.clear();
+
+        std::vector<GroupRecord> sorted = input;
+        start = Clock::now();
+        std::vector<RecordRun> runs = findEqualKeyRuns(sorted);
+        double radixTime = millisecondsSince(start);
+
+        std::vector<GroupRecord> reference = input;
+        start = Clock::now();
+        std::stable_sort(reference.begin(), reference.end(), [](const GroupRecord& a, const GroupRecord& b)
+        {
+            return a.size != b.size ? a.size < b.size : a.digestPrefix < b.digestPrefix;
+        });
+        double stableSortTime = millisecondsSince(start);
+
+        // Same groups in the same order, each listing its entries in scan order
+        bool groupsMatch = runs.size() == mapGroups.size();
+        for (size_t g = 0; groupsMatch && g < runs.size(); ++g)
+        {
+            const RecordRun& run = runs[g];
+            groupsMatch = run.end - run.begin == mapGroups[g].size();
+            for (size_t i = run.begin; groupsMatch && i < run.end; ++i)
+            {
+                groupsMatch = sorted[i].entryIndex == mapGroups[g][i - run.begin];
+            }
+        }
+        bool orderMatches = sameOrder(sorted, reference);
+
+        printUnicodeMulti(true, L"  std::map grouping:      ", std::to_wstring(static_cast<uint64_t>(mapTime)), L" ms");
+        printUnicodeMulti(true, L"  radix sort + run scan:  ", std::to_wstring(static_cast<uint64_t>(radixTime)), L" ms");
+        printUnicodeMulti(true, L"  std::stable_sort:       ", std::to_wstring(static_cast<uint64_t>(stableSortTime)), L" ms");
+        printUnicodeMulti(true, L"  groups: ", std::to_wstring(runs.size()), groupsMatch ? L", same as std::map" : L", DIFFERENT from std::map",
+            orderMatches ? L"; order same as std::stable_sort" : L"; order DIFFERENT from std::stable_sort");
+        return groupsMatch && orderMatches;
+    }
+
+    int groupingCommand(const ProgramOptions& options)
+    {
+        std::vector<size_t> counts;
+        for (size_t i = 2; i < options.command.size(); ++i)
+        {
+            size_t count = 0;
+            try
+            {
+                count = static_cast<size_t>(std::stoull(options.command[i]));
+            }
+            catch (const std::exception&)
+            {
+            }
+            if (count == 0 || count > UINT32_MAX)
+            {
+                printUnicodeMulti(true, L"Not a record count: ", options.command[i]);
+                return 1;
+            }
+            counts.push_back(count);
+        }
+        if (counts.empty()) counts.assign(std::begin(DEFAULT_BENCH_COUNTS), std::end(DEFAULT_BENCH_COUNTS));
+
+        bool allMatch = true;
+        for (size_t count : counts)
+        {
+            allMatch = benchGrouping(count) && allMatch;
+        }
+        return allMatch ? 0 : 1;
+    }
+}
+
+int runBenchCommand(const ProgramOptions& options)
+{
+    const std::wstring subcommand = options.command.size() > 1 ? options.command[1] : L"";
+
+    if (subcommand == L"grouping") return groupingCommand(options);
+
+    printUnicodeMulti(true, L"Unknown bench command: ", subcommand, L" (expected grouping)");
+    return 1;
+}
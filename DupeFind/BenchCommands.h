@@ -0,0 +1,6 @@
+#pragma once
+
+#include "Options.h"
+
+// Runs "DupeFind bench ..." and returns the process exit code
+int runBenchCommand(const ProgramOptions& options);
@@ -0,0 +1,94 @@
+#include "BloomFilter.h"
+
+#include <cmath>
+#include <algorithm>
+
+namespace
+{
+    const uint32_t MAX_HASHES = 16;
+
+    uint64_t mix(uint64_t value)
+    {
+        // splitmix64 finalizer
+        value ^= value >> 30;
+        value *= 0xBF58476D1CE4E5B9ull;
+        value ^= value >> 27;
+        value *= 0x94D049BB133111EBull;
+        value ^= value >> 31;
+        return value;
+    }
+}
+
+BloomParameters bloomParametersFor(uint64_t expectedKeys, double falsePositiveRate)
+{
+    falsePositiveRate = std::clamp(falsePositiveRate, 1e-9, 0.5);
+    double keys = static_cast<double>(std::max<uint64_t>(expectedKeys, 1));
+    const double ln2 = std::log(2.0);
+
+    // m = -n ln p / (ln 2)^2 bits, k = m / n * ln 2 hashes
+    double bitCount = -keys * std::log(falsePositiveRate) / (ln2 * ln2);
+
+    BloomParameters parameters;
+    parameters.words = std::max<uint64_t>(1, static_cast<uint64_t>(std::ceil(bitCount / 64.0)));
+    double hashes = std::round(parameters.words * 64.0 / keys * ln2);
+    parameters.hashes = static_cast<uint32_t>(std::clamp(hashes, 1.0, static_cast<double>(MAX_HASHES)));
+    return parameters;
+}
+
+double bloomFalsePositiveRate(const BloomParameters& parameters, uint64_t keys)
+{
+    if (parameters.words == 0) return 1.0;
+
+    double bitCount = parameters.words * 64.0;
+    return std::pow(1.0 - std::exp(-static_cast<double>(parameters.hashes) * keys / bitCount), parameters.hashes);
+}
+
+uint64_t prefilterKey(uint64_t size, uint64_t headDigest)
+{
+    return mix(headDigest ^ mix(size));
+}
+
+BloomFilter::BloomFilter(const BloomParameters& parameters)
+    : parameters(parameters), ownedBits(parameters.words, 0)
+{
+}
+
+BloomFilter BloomFilter::view(const uint64_t* words, const BloomParameters& parameters)
+{
+    BloomFilter filter;
+    filter.parameters = parameters;
+    filter.viewedBits = words;
+    return filter;
+}
+
+void BloomFilter::add(uint64_t key)
+{
+    if (ownedBits.empty()) return;
+
+    const uint64_t bitCount = parameters.words * 64;
+    uint64_t h1 = key;
+    uint64_t h2 = mix(key) | 1;
+
+    for (uint32_t i = 0; i < parameters.hashes; ++i)
+    {
+        uint64_t bit = (h1 + i * h2) % bitCount;
+        ownedBits[bit / 64] |= 1ull << (bit % 64);
+    }
+}
+
+bool BloomFilter::mightContain(uint64_t key) const
+{
+    const uint64_t* bits = data();
+    if (!bits || parameters.words == 0) return true; // no filter, so nothing can be ruled out
+
+    const uint64_t bitCount = parameters.words * 64;
+    uint64_t h1 = key;
+    uint64_t h2 = mix(key) | 1;
+
+    for (uint32_t i = 0; i < parameters.hashes; ++i)
+    {
+        uint64_t bit = (h1 + i * h2) % bitCount;
+        if (!(bits[bit / 64] & (1ull << (bit % 64)))) return false;
+    }
+    return true;
+}
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+struct BloomParameters
+{
+    uint64_t words = 0;   // filter size in 64-bit words
+    uint32_t hashes = 0;  // bits set per key
+};
+
+// Smallest filter that keeps the false-positive rate at or below the target for this many keys
+BloomParameters bloomParametersFor(uint64_t expectedKeys, double falsePositiveRate);
+
+// False-positive rate a filter of this shape has once it holds this many keys
+double bloomFalsePositiveRate(const BloomParameters& parameters, uint64_t keys);
+
+// Key of a file for the prefilter: its size and the digest of its first bytes, mixed into one well-spread value
+uint64_t prefilterKey(uint64_t size, uint64_t headDigest);
+
+// Bloom filter over 64-bit keys. It either owns its bits or reads them from memory it does not own,
+// such as a section of a memory-mapped file. Bit positions come from double hashing of the key.
+class BloomFilter
+{
+public:
+    BloomFilter() = default;
+    explicit BloomFilter(const BloomParameters& parameters);
+
+    // Read-only filter over words that outlive it
+    static BloomFilter view(const uint64_t* words, const BloomParameters& parameters);
+
+    void add(uint64_t key);
+    bool mightContain(uint64_t key) const;
+
+    bool isEmpty() const { return parameters.words == 0; }
+    const BloomParameters& shape() const { return parameters; }
+    const uint64_t* data() const { return ownedBits.empty() ? viewedBits : ownedBits.data(); }
+    size_t sizeInBytes() const { return static_cast<size_t>(parameters.words * sizeof(uint64_t)); }
+
+private:
+    BloomParameters parameters;
+    std::vector<uint64_t> ownedBits;
+    const uint64_t* viewedBits = nullptr;
+};
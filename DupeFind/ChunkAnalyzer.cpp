@@ -0,0 +1,347 @@
+#include "ChunkAnalyzer.h"
+#include "HashCalculator.h"
+#include "Throttle.h"
+#include "Utilities.h"
+
+#include <iostream>
+#include <sstream>
+#include <vector>
+#include <string>
+#include <unordered_map>
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+
+#define WIN32_LEAN_AND_MEAN
+#include <Windows.h>
+
+namespace
+{
+    const size_t READ_BLOCK_SIZE = 1024 * 1024;
+    const size_t GEAR_WINDOW = 64; // a Gear fingerprint only depends on the last 64 bytes
+    const size_t HISTORY_SPACE = 4096; // room for the window in front of each block, keeping the block page-aligned for unbuffered reads
+    const size_t GEAR_LANES = 4;
+    const size_t REPORT_LIMIT = 100;
+
+    const uint8_t NO_CUT = 0;
+    const uint8_t WEAK_CUT = 1;   // boundary once the chunk has reached the average size
+    const uint8_t STRONG_CUT = 2; // boundary as soon as the chunk has reached the minimum size
+
+    struct GearTable
+    {
+        uint64_t values[256];
+
+        GearTable()
+        {
+            // Fixed pseudo-random table (splitmix64) so chunk boundaries are the same on every run
+            uint64_t state = 0x9E3779B97F4A7C15ull;
+            for (auto& value : values)
+            {
+                state += 0x9E3779B97F4A7C15ull;
+                uint64_t z = state;
+                z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+                z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+                value = z ^ (z >> 31);
+            }
+        }
+    };
+
+    const GearTable& gearTable()
+    {
+        static const GearTable table;
+        return table;
+    }
+
+    // The top bits of a Gear fingerprint depend on the whole window, so the masks select those
+    uint64_t topBitsMask(unsigned bits)
+    {
+        return bits == 0 ? 0 : ~0ull << (64 - bits);
+    }
+
+    // Marks every position of a block as a strong, weak or no cut candidate. A Gear fingerprint is a pure
+    // function of the last 64 bytes, so the block is split into lanes that each warm up on the 63 bytes before
+    // their start and then advance in lockstep. The lanes have no dependency on each other, which lets the CPU
+    // (and the compiler) overlap them instead of waiting on one long shift-add chain.
+    // data[-historyLength, 0) holds the tail of the previous block.
+    void computeCutFlags(const uint8_t* data, size_t length, size_t historyLength, uint64_t strongMask, uint64_t weakMask, uint8_t* flags)
+    {
+        const uint64_t* gear = gearTable().values;
+        const size_t laneLength = (length + GEAR_LANES - 1) / GEAR_LANES;
+
+        uint64_t fingerprint[GEAR_LANES] = {};
+        size_t laneStart[GEAR_LANES];
+        size_t laneEnd[GEAR_LANES];
+
+        for (size_t lane = 0; lane < GEAR_LANES; ++lane)
+        {
+            laneStart[lane] = std::min<size_t>(lane * laneLength, length);
+            laneEnd[lane] = std::min<size_t>(laneStart[lane] + laneLength, length);
+
+            size_t warmUp = std::min<size_t>(GEAR_WINDOW - 1, laneStart[lane] + historyLength);
+            for (const uint8_t* p = data + laneStart[lane] - warmUp; p < data + laneStart[lane]; ++p)
+            {
+                fingerprint[lane] = (fingerprint[lane] << 1) + gear[*p];
+            }
+        }
+
+        for (size_t i = 0; i < laneLength; ++i)
+        {
+            for (size_t lane = 0; lane < GEAR_LANES; ++lane)
+            {
+                size_t pos = laneStart[lane] + i;
+                if (pos >= laneEnd[lane]) continue;
+
+                fingerprint[lane] = (fingerprint[lane] << 1) + gear[data[pos]];
+                flags[pos] = (fingerprint[lane] & strongMask) == 0 ? STRONG_CUT : ((fingerprint[lane] & weakMask) == 0 ? WEAK_CUT : NO_CUT);
+            }
+        }
+    }
+
+    struct ChunkKey
+    {
+        Sha256Digest digest;
+
+        bool operator==(const ChunkKey& other) const { return digest == other.digest; }
+    };
+
+    struct ChunkKeyHash
+    {
+        size_t operator()(const ChunkKey& key) const
+        {
+            size_t value;
+            std::memcpy(&value, key.digest.data(), sizeof(value)); // SHA-256 output is already uniformly distributed
+            return value;
+        }
+    };
+
+    struct ChunkIndex
+    {
+        std::unordered_map<ChunkKey, uint32_t, ChunkKeyHash> chunkOwners; // chunk -> first file that contained it
+        std::unordered_map<uint64_t, uint64_t> pairSharedBytes;           // (owner file, later file) -> bytes
+        std::vector<uint64_t> fileDuplicateBytes;
+
+        uint64_t chunkCount = 0;
+        uint64_t totalBytes = 0;
+        uint64_t duplicateBytes = 0;
+
+        void add(uint32_t fileIndex, const Sha256Digest& digest, uint64_t length)
+        {
+            ++chunkCount;
+            totalBytes += length;
+
+            auto [it, inserted] = chunkOwners.try_emplace(ChunkKey{ digest }, fileIndex);
+            if (inserted) return;
+
+            duplicateBytes += length;
+            fileDuplicateBytes[fileIndex] += length;
+            pairSharedBytes[(static_cast<uint64_t>(it->second) << 32) | fileIndex] += length;
+        }
+    };
+
+    bool chunkFile(const fs::path& filePath, uint32_t fileIndex, const ChunkingOptions& options, Sha256Hasher& hasher, ChunkIndex& index)
+    {
+        HANDLE hFile = openForRead(filePath, options.readPolicy);
+        if (hFile == INVALID_HANDLE_VALUE)
+        {
+            printUnicodeMulti(true, L"Error opening file: ", filePath.wstring(), L" (Error code: ", std::to_wstring(GetLastError()), L")");
+            return false;
+        }
+
+        unsigned averageBits = 0;
+        while ((static_cast<size_t>(1) << (averageBits + 1)) <= options.averageChunkSize) ++averageBits;
+
+        // Normalized chunking: harder to cut before the average size, easier after it
+        const uint64_t strongMask = topBitsMask(averageBits + 2);
+        const uint64_t weakMask = topBitsMask(averageBits > 2 ? averageBits - 2 : 0);
+
+        static thread_local ReadBuffer buffer(HISTORY_SPACE + READ_BLOCK_SIZE);
+        static thread_local std::vector<uint8_t> flags(READ_BLOCK_SIZE);
+        uint8_t* block = buffer.data() + HISTORY_SPACE;
+        ScopedReadCachePriority cachePriority(options.readPolicy);
+
+        size_t historyLength = 0;
+        uint64_t chunkLength = 0;
+        Sha256Digest digest;
+        bool ok = hasher.begin();
+        DWORD bytesRead = 0;
+
+        // Blocks are read from offset 0 in whole multiples of the sector size, so Direct reads need no extra alignment
+        while (ok)
+        {
+            ioThrottle().beforeRead(READ_BLOCK_SIZE);
+            if (!ReadFile(hFile, block, static_cast<DWORD>(READ_BLOCK_SIZE), &bytesRead, NULL) || bytesRead == 0) break;
+
+            computeCutFlags(block, bytesRead, historyLength, strongMask, weakMask, flags.data());
+
+            size_t segmentStart = 0;
+            size_t pos = 0;
+            while (pos < bytesRead)
+            {
+                // Nothing can be cut before the minimum size, so skip straight past it
+                if (chunkLength + 1 < options.minChunkSize)
+                {
+                    size_t skip = std::min<size_t>(options.minChunkSize - 1 - chunkLength, bytesRead - pos);
+                    chunkLength += skip;
+                    pos += skip;
+                    continue;
+                }
+
+                ++chunkLength;
+                uint8_t flag = flags[pos];
+                bool cut = chunkLength >= options.maxChunkSize
+                    || flag == STRONG_CUT
+                    || (flag == WEAK_CUT && chunkLength >= options.averageChunkSize);
+                ++pos;
+
+                if (cut)
+                {
+                    ok = hasher.update(block + segmentStart, pos - segmentStart) && hasher.finish(digest) && hasher.begin();
+                    if (!ok) break;
+
+                    index.add(fileIndex, digest, chunkLength);
+                    chunkLength = 0;
+                    segmentStart = pos;
+                }
+            }
+
+            ok = ok && hasher.update(block + segmentStart, bytesRead - segmentStart);
+
+            // Keep the tail of this block as warm-up history for the first lane of the next one
+            size_t newHistory = std::min<size_t>(GEAR_WINDOW, historyLength + bytesRead);
+            std::memmove(block - newHistory, block + bytesRead - newHistory, newHistory);
+            historyLength = newHistory;
+        }
+
+        if (ok && chunkLength > 0)
+        {
+            ok = hasher.finish(digest);
+            if (ok) index.add(fileIndex, digest, chunkLength);
+        }
+
+        CloseHandle(hFile);
+
+        if (!ok)
+        {
+            std::wcerr << L"Error: Failed to hash chunks of " << filePath.wstring() << std::endl;
+        }
+        return ok;
+    }
+
+    std::wstring formatSize(uint64_t bytes)
+    {
+        std::string sizeStr = formatFileSize(bytes);
+        return utf8ToWstring(sizeStr);
+    }
+
+    std::wstring formatPercent(uint64_t part, uint64_t whole)
+    {
+        std::wstringstream wss;
+        wss.precision(1);
+        wss << std::fixed << (whole ? 100.0 * static_cast<double>(part) / static_cast<double>(whole) : 0.0) << L"%";
+        return wss.str();
+    }
+}
+
+void analyzeChunkDuplication(const std::vector<fs::path>& paths, const ChunkingOptions& options)
+{
+    const std::wstring logFileName = L"chunk_log.txt";
+
+    std::vector<fs::path> files;
+    std::vector<uint64_t> fileSizes;
+    for (const auto& path : paths)
+    {
+        std::error_code ec;
+        if (!fs::is_regular_file(path, ec)) continue;
+
+        uintmax_t fileSize = fs::file_size(path, ec);
+        if (ec || fileSize == 0) continue;
+
+        files.push_back(path);
+        fileSizes.push_back(fileSize);
+    }
+
+    std::wcout << L"\nRunning block-level analysis on " << files.size() << L" files..." << std::endl;
+
+    Sha256Hasher hasher;
+    if (!hasher.isValid()) return;
+
+    ChunkIndex index;
+    index.fileDuplicateBytes.assign(files.size(), 0);
+
+    auto startTime = std::chrono::steady_clock::now();
+
+    for (size_t i = 0; i < files.size(); ++i)
+    {
+        if (files.size() <= 100 || (i + 1) % 100 == 0)
+        {
+            printUnicodeMulti(true, L"Chunking: ", std::to_wstring(i + 1), L"/", std::to_wstring(files.size()), L" - ", files[i].wstring());
+        }
+
+        chunkFile(files[i], static_cast<uint32_t>(i), options, hasher, index);
+    }
+
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+    double throughput = seconds > 0 ? static_cast<double>(index.totalBytes) / seconds : 0.0;
+
+    // Rank file pairs and directories by the bytes block-level dedup would save
+    std::vector<std::pair<uint64_t, uint64_t>> pairs(index.pairSharedBytes.begin(), index.pairSharedBytes.end());
+    std::sort(pairs.begin(), pairs.end(), [](const auto& a, const auto& b) { return a.second > b.second; });
+
+    std::unordered_map<std::wstring, std::pair<uint64_t, uint64_t>> directoryBytes; // directory -> (duplicate, total)
+    for (size_t i = 0; i < files.size(); ++i)
+    {
+        auto& entry = directoryBytes[files[i].parent_path().wstring()];
+        entry.first += index.fileDuplicateBytes[i];
+        entry.second += fileSizes[i];
+    }
+
+    std::vector<std::pair<std::wstring, std::pair<uint64_t, uint64_t>>> directories;
+    for (const auto& entry : directoryBytes)
+    {
+        if (entry.second.first > 0) directories.push_back(entry);
+    }
+    std::sort(directories.begin(), directories.end(), [](const auto& a, const auto& b) { return a.second.first > b.second.first; });
+
+    std::wstringstream logContent;
+    logContent << L"=== BLOCK-LEVEL DUPLICATION ANALYSIS ===" << std::endl;
+    logContent << L"Chunk sizes: min " << formatSize(options.minChunkSize) << L", average " << formatSize(options.averageChunkSize) << L", max " << formatSize(options.maxChunkSize) << std::endl;
+    logContent << L"Files analyzed: " << files.size() << std::endl;
+    logContent << L"Chunks: " << index.chunkCount << L" (" << index.chunkOwners.size() << L" unique)" << std::endl;
+    logContent << L"Total data: " << formatSize(index.totalBytes) << std::endl;
+    logContent << L"Potential block-level savings: " << formatSize(index.duplicateBytes) << L" (" << formatPercent(index.duplicateBytes, index.totalBytes) << L")" << std::endl;
+    logContent << L"Throughput: " << formatSize(static_cast<uint64_t>(throughput)) << L"/s" << std::endl << std::endl;
+
+    logContent << L"=== TOP FILE PAIRS BY SHARED DATA ===" << std::endl;
+    for (size_t i = 0; i < pairs.size() && i < REPORT_LIMIT; ++i)
+    {
+        uint32_t owner = static_cast<uint32_t>(pairs[i].first >> 32);
+        uint32_t later = static_cast<uint32_t>(pairs[i].first & 0xFFFFFFFFu);
+
+        logContent << formatSize(pairs[i].second) << L" (" << formatPercent(pairs[i].second, fileSizes[later]) << L" of the second file)" << std::endl;
+        if (owner == later)
+        {
+            logContent << L"  " << files[later].wstring() << L" (repeated within the file)" << std::endl;
+        }
+        else
+        {
+            logContent << L"  " << files[owner].wstring() << std::endl;
+            logContent << L"  " << files[later].wstring() << std::endl;
+        }
+    }
+    logContent << std::endl;
+
+    logContent << L"=== TOP DIRECTORIES BY POTENTIAL SAVINGS ===" << std::endl;
+    for (size_t i = 0; i < directories.size() && i < REPORT_LIMIT; ++i)
+    {
+        const auto& [directory, bytes] = directories[i];
+        logContent << formatSize(bytes.first) << L" of " << formatSize(bytes.second) << L" (" << formatPercent(bytes.first, bytes.second) << L")  " << directory << std::endl;
+    }
+
+    writeUnicodeToFile(logContent.str(), logFileName, false, false);
+
+    printUnicode(L"\n=== BLOCK-LEVEL SUMMARY ===", true);
+    printUnicode(L"Total data: " + formatSize(index.totalBytes), true);
+    printUnicode(L"Potential block-level savings: " + formatSize(index.duplicateBytes) + L" (" + formatPercent(index.duplicateBytes, index.totalBytes) + L")", true);
+    printUnicode(L"Throughput: " + formatSize(static_cast<uint64_t>(throughput)) + L"/s", true);
+    printUnicode(L"Block-level analysis written to: " + logFileName, true);
+}
@@ -0,0 +1,21 @@
+#pragma once
+
+#include "ReadPolicy.h"
+
+#include <filesystem>
+#include <vector>
+#include <cstddef>
+
+namespace fs = std::filesystem;
+
+struct ChunkingOptions
+{
+    size_t minChunkSize = 2 * 1024;
+    size_t averageChunkSize = 8 * 1024; // must be a power of two
+    size_t maxChunkSize = 64 * 1024;
+    ReadPolicy readPolicy = ReadPolicy::Sequential;
+};
+
+// Splits every file into content-defined chunks (FastCDC) and reports how many bytes block-level
+// deduplication could save, per file pair and per directory. Results are written to chunk_log.txt.
+void analyzeChunkDuplication(const std::vector<fs::path>& paths, const ChunkingOptions& options = {});
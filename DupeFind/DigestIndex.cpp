@@ -0,0 +1,392 @@
+#include "DigestIndex.h"
+#include "Utilities.h"
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <map>
+#include <cstring>
+#include <algorithm>
+
+#define WIN32_LEAN_AND_MEAN
+#include <Windows.h>
+
+namespace
+{
+    const char INDEX_MAGIC[4] = { 'D', 'F', 'X', '1' };
+    const uint32_t INDEX_VERSION = 2;
+    const uint64_t MIN_SLOTS = 16;
+
+    struct IndexHeader
+    {
+        char magic[4];
+        uint32_t version;
+        uint64_t slotCount;
+        uint64_t entryCount;
+        uint64_t pathBytes;        // padded to a multiple of 8 so the filter words are aligned
+        uint64_t filterWords;
+        uint32_t filterHashes;
+        uint32_t reserved;
+        double filterTargetRate;
+    };
+
+    uint64_t slotHash(uint64_t size, const Sha256Digest& digest)
+    {
+        // The digest is already uniformly distributed; mixing in the size separates equal-content edge cases
+        uint64_t prefix = 0;
+        std::memcpy(&prefix, digest.data(), sizeof(prefix));
+        return prefix ^ (size * 0x9E3779B97F4A7C15ull);
+    }
+
+    bool writeAll(HANDLE hFile, const void* data, uint64_t length)
+    {
+        const char* bytes = static_cast<const char*>(data);
+        while (length > 0)
+        {
+            DWORD chunk = static_cast<DWORD>(std::min<uint64_t>(length, 1u << 30));
+            DWORD written = 0;
+            if (!WriteFile(hFile, bytes, chunk, &written, nullptr) || written != chunk) return false;
+            bytes += chunk;
+            length -= chunk;
+        }
+        return true;
+    }
+}
+
+struct DigestIndex::Slot
+{
+    uint64_t size;
+    unsigned char digest[32];
+    uint64_t headDigest;
+    uint64_t pathOffset; // 1-based offset into the path blob, 0 marks an empty slot
+};
+
+static_assert(sizeof(IndexHeader) == 56, "index header layout changed");
+
+DigestIndex::~DigestIndex()
+{
+    close();
+}
+
+bool DigestIndex::open(const fs::path& path)
+{
+    close();
+    indexPath = path;
+
+    HANDLE hFile = CreateFileW(indexPath.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_DELETE, nullptr, OPEN_EXISTING, FILE_FLAG_RANDOM_ACCESS, nullptr);
+    if (hFile == INVALID_HANDLE_VALUE)
+    {
+        return GetLastError() == ERROR_FILE_NOT_FOUND; // no index yet
+    }
+
+    LARGE_INTEGER fileSize;
+    if (!GetFileSizeEx(hFile, &fileSize))
+    {
+        CloseHandle(hFile);
+        return false;
+    }
+    if (fileSize.QuadPart == 0)
+    {
+        CloseHandle(hFile);
+        return true; // an empty file cannot be mapped, and holds no entries anyway
+    }
+
+    HANDLE hMapping = CreateFileMappingW(hFile, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    const unsigned char* mapped = hMapping ? static_cast<const unsigned char*>(MapViewOfFile(hMapping, FILE_MAP_READ, 0, 0, 0)) : nullptr;
+    if (!mapped)
+    {
+        if (hMapping) CloseHandle(hMapping);
+        CloseHandle(hFile);
+        return false;
+    }
+
+    fileHandle = hFile;
+    mappingHandle = hMapping;
+    view = mapped;
+    viewSize = static_cast<uint64_t>(fileSize.QuadPart);
+
+    IndexHeader header = {};
+    bool valid = viewSize >= sizeof(header);
+    if (valid)
+    {
+        std::memcpy(&header, view, sizeof(header));
+        valid = std::memcmp(header.magic, INDEX_MAGIC, sizeof(INDEX_MAGIC)) == 0
+            && header.version == INDEX_VERSION
+            && header.slotCount >= MIN_SLOTS
+            && (header.slotCount & (header.slotCount - 1)) == 0
+            && header.slotCount <= (viewSize - sizeof(header)) / sizeof(Slot)
+            && header.pathBytes % sizeof(uint64_t) == 0
+            && header.filterWords <= viewSize / sizeof(uint64_t)
+            && sizeof(header) + header.slotCount * sizeof(Slot) + header.pathBytes + header.filterWords * sizeof(uint64_t) == viewSize;
+    }
+
+    if (!valid)
+    {
+        printMessage(&onMessage, L"Error: ", indexPath.wstring(), L" is not a valid digest index.");
+        close();
+        return false;
+    }
+
+    slotCount = header.slotCount;
+    prefilterTarget = header.filterTargetRate;
+    if (header.filterWords > 0)
+    {
+        const auto* words = reinterpret_cast<const uint64_t*>(view + sizeof(header) + slotCount * sizeof(Slot) + header.pathBytes);
+        prefilter = BloomFilter::view(words, { header.filterWords, header.filterHashes });
+    }
+    return true;
+}
+
+void DigestIndex::close()
+{
+    if (view) UnmapViewOfFile(view);
+    if (mappingHandle) CloseHandle(mappingHandle);
+    if (fileHandle) CloseHandle(fileHandle);
+
+    view = nullptr;
+    mappingHandle = nullptr;
+    fileHandle = nullptr;
+    viewSize = 0;
+    slotCount = 0;
+    prefilter = BloomFilter();
+    prefilterTarget = 0;
+}
+
+const DigestIndex::Slot* DigestIndex::slotAt(uint64_t index) const
+{
+    return reinterpret_cast<const Slot*>(view + sizeof(IndexHeader)) + index;
+}
+
+std::string_view DigestIndex::pathAt(uint64_t pathOffset) const
+{
+    uint64_t blobStart = sizeof(IndexHeader) + slotCount * sizeof(Slot);
+    uint64_t position = blobStart + pathOffset - 1;
+
+    uint32_t length = 0;
+    if (position + sizeof(length) > viewSize) return {};
+    std::memcpy(&length, view + position, sizeof(length));
+    position += sizeof(length);
+
+    if (length > viewSize - position) return {};
+    return std::string_view(reinterpret_cast<const char*>(view + position), length);
+}
+
+uint64_t DigestIndex::homeSlot(uint64_t size, const Sha256Digest& digest) const
+{
+    return slotHash(size, digest) & (slotCount - 1);
+}
+
+bool DigestIndex::contains(uint64_t size, const Sha256Digest& digest) const
+{
+    if (slotCount == 0) return false;
+
+    for (uint64_t i = homeSlot(size, digest); ; i = (i + 1) & (slotCount - 1))
+    {
+        const Slot* slot = slotAt(i);
+        if (slot->pathOffset == 0) return false;
+        if (slot->size == size && std::memcmp(slot->digest, digest.data(), digest.size()) == 0) return true;
+    }
+}
+
+std::vector<std::wstring> DigestIndex::lookup(uint64_t size, const Sha256Digest& digest) const
+{
+    std::vector<std::wstring> paths;
+    if (slotCount == 0) return paths;
+
+    // Every copy of this content lies between its home slot and the next empty slot
+    for (uint64_t i = homeSlot(size, digest); ; i = (i + 1) & (slotCount - 1))
+    {
+        const Slot* slot = slotAt(i);
+        if (slot->pathOffset == 0) break;
+        if (slot->size == size && std::memcmp(slot->digest, digest.data(), digest.size()) == 0)
+        {
+            paths.push_back(utf8ToWstring(pathAt(slot->pathOffset)));
+        }
+    }
+
+    return paths;
+}
+
+std::vector<IndexedFile> DigestIndex::entries() const
+{
+    std::vector<IndexedFile> result;
+    result.reserve(entryCount());
+
+    for (uint64_t i = 0; i < slotCount; ++i)
+    {
+        const Slot* slot = slotAt(i);
+        if (slot->pathOffset == 0) continue;
+
+        IndexedFile entry;
+        entry.size = slot->size;
+        entry.headDigest = slot->headDigest;
+        std::memcpy(entry.digest.data(), slot->digest, entry.digest.size());
+        entry.path = utf8ToWstring(pathAt(slot->pathOffset));
+        result.push_back(std::move(entry));
+    }
+
+    return result;
+}
+
+bool DigestIndex::insert(const std::vector<IndexedFile>& files, double falsePositiveRate)
+{
+    // Path -> entry, sorted so the same contents always produce the same file
+    std::map<std::string, IndexedFile> byPath;
+    for (auto& entry : entries())
+    {
+        std::string key = wstringToUtf8(entry.path);
+        byPath[key] = std::move(entry);
+    }
+    for (const auto& entry : files)
+    {
+        byPath[wstringToUtf8(entry.path)] = entry;
+    }
+
+    uint64_t slots = MIN_SLOTS;
+    while (slots * 7 < byPath.size() * 10) slots *= 2;
+
+    std::vector<Slot> table(slots);
+    std::memset(table.data(), 0, table.size() * sizeof(Slot));
+    std::string blob;
+    BloomFilter filter(bloomParametersFor(byPath.size(), falsePositiveRate));
+
+    for (const auto& [path, entry] : byPath)
+    {
+        uint64_t pathOffset = blob.size() + 1;
+        uint32_t length = static_cast<uint32_t>(path.size());
+        blob.append(reinterpret_cast<const char*>(&length), sizeof(length));
+        blob.append(path);
+
+        uint64_t i = slotHash(entry.size, entry.digest) & (slots - 1);
+        while (table[i].pathOffset != 0) i = (i + 1) & (slots - 1);
+
+        table[i].size = entry.size;
+        std::memcpy(table[i].digest, entry.digest.data(), entry.digest.size());
+        table[i].headDigest = entry.headDigest;
+        table[i].pathOffset = pathOffset;
+
+        filter.add(prefilterKey(entry.size, entry.headDigest));
+    }
+    blob.resize((blob.size() + sizeof(uint64_t) - 1) / sizeof(uint64_t) * sizeof(uint64_t), '\0');
+
+    IndexHeader header = {};
+    std::memcpy(header.magic, INDEX_MAGIC, sizeof(INDEX_MAGIC));
+    header.version = INDEX_VERSION;
+    header.slotCount = slots;
+    header.entryCount = byPath.size();
+    header.pathBytes = blob.size();
+    header.filterWords = filter.shape().words;
+    header.filterHashes = filter.shape().hashes;
+    header.filterTargetRate = falsePositiveRate;
+
+    fs::path tempPath = indexPath;
+    tempPath += L".tmp";
+
+    HANDLE hFile = CreateFileW(tempPath.c_str(), GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (hFile == INVALID_HANDLE_VALUE)
+    {
+        printMessage(&onMessage, L"Error: Could not create ", tempPath.wstring());
+        return false;
+    }
+
+    bool written = writeAll(hFile, &header, sizeof(header))
+        && writeAll(hFile, table.data(), table.size() * sizeof(Slot))
+        && writeAll(hFile, blob.data(), blob.size())
+        && writeAll(hFile, filter.data(), filter.sizeInBytes())
+        && FlushFileBuffers(hFile);
+    CloseHandle(hFile);
+
+    if (!written)
+    {
+        printMessage(&onMessage, L"Error: Could not write ", tempPath.wstring());
+        DeleteFileW(tempPath.c_str());
+        return false;
+    }
+
+    // Swap the finished file in; until then every reader keeps seeing the old index
+    fs::path target = indexPath;
+    close();
+    if (!MoveFileExW(tempPath.c_str(), target.c_str(), MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH))
+    {
+        DWORD error = GetLastError();
+        printMessage(&onMessage, L"Error: Could not replace ", target.wstring(), L" (Error code: ", std::to_wstring(error), L"). Is it being served?");
+        DeleteFileW(tempPath.c_str());
+        open(target);
+        return false;
+    }
+
+    return open(target);
+}
+
+size_t DigestIndex::entryCount() const
+{
+    if (!view) return 0;
+
+    IndexHeader header;
+    std::memcpy(&header, view, sizeof(header));
+    return static_cast<size_t>(header.entryCount);
+}
+
+DigestIndexStats DigestIndex::stats() const
+{
+    DigestIndexStats result;
+    result.entries = entryCount();
+    result.slots = slotCount;
+    result.fileBytes = viewSize;
+
+    uint64_t probeTotal = 0;
+    for (uint64_t i = 0; i < slotCount; ++i)
+    {
+        const Slot* slot = slotAt(i);
+        if (slot->pathOffset == 0) continue;
+
+        Sha256Digest digest;
+        std::memcpy(digest.data(), slot->digest, digest.size());
+        probeTotal += ((i - homeSlot(slot->size, digest)) & (slotCount - 1)) + 1;
+    }
+
+    if (result.entries > 0) result.averageProbe = static_cast<double>(probeTotal) / result.entries;
+
+    result.prefilterBytes = prefilter.sizeInBytes();
+    result.prefilterHashes = prefilter.shape().hashes;
+    result.targetFalsePositiveRate = prefilterTarget;
+    result.expectedFalsePositiveRate = hasPrefilter() ? bloomFalsePositiveRate(prefilter.shape(), result.entries) : 1.0;
+    return result;
+}
+
+bool parseDigestHex(const std::string& hex, Sha256Digest& digest)
+{
+    if (hex.size() != digest.size() * 2) return false;
+
+    auto nibble = [](char c) -> int
+    {
+        if (c >= '0' && c <= '9') return c - '0';
+        if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+        if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+        return -1;
+    };
+
+    for (size_t i = 0; i < digest.size(); ++i)
+    {
+        int high = nibble(hex[2 * i]);
+        int low = nibble(hex[2 * i + 1]);
+        if (high < 0 || low < 0) return false;
+        digest[i] = static_cast<unsigned char>(high << 4 | low);
+    }
+
+    return true;
+}
+
+std::string digestToHex(const Sha256Digest& digest)
+{
+    static const char HEX[] = "0123456789abcdef";
+
+    std::string hex;
+    hex.reserve(digest.size() * 2);
+    for (unsigned char byte : digest)
+    {
+        hex.push_back(HEX[byte >> 4]);
+        hex.push_back(HEX[byte & 15]);
+    }
+    return hex;
+}
@@ -0,0 +1,101 @@
+#pragma once
+
+#include "HashCalculator.h"
+#include "BloomFilter.h"
+
+#include <filesystem>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+namespace fs = std::filesystem;
+
+struct IndexedFile
+{
+    uint64_t size = 0;
+    Sha256Digest digest = {};
+    uint64_t headDigest = 0;
+    std::wstring path;
+};
+
+const double DEFAULT_PREFILTER_FALSE_POSITIVE_RATE = 0.01;
+
+struct DigestIndexStats
+{
+    uint64_t entries = 0;
+    uint64_t slots = 0;
+    uint64_t fileBytes = 0;
+    double averageProbe = 0; // slots visited per successful lookup
+
+    uint64_t prefilterBytes = 0;
+    uint32_t prefilterHashes = 0;
+    double targetFalsePositiveRate = 0;
+    double expectedFalsePositiveRate = 0;
+};
+
+// Persistent (size, digest) -> paths table that lives in one file and is memory-mapped for lookups.
+// Open addressing with linear probing over fixed 56-byte slots, load factor at most 0.7, followed by
+// a blob of UTF-8 paths. A lookup touches one or two cache lines of the mapping and never reads the
+// whole file, so any number of readers can share an index of millions of files.
+//
+// The file ends with a Bloom filter over (size, head digest) of every entry. Most files checked against
+// a large corpus are not in it, and the filter rejects those after reading only their first few KB,
+// without a full hash or a table probe.
+//
+// The mapping is read-only. Inserts are done in bulk: the table is rebuilt with the new entries into a
+// temporary file that then replaces the old one, so readers never see a half-written index.
+class DigestIndex
+{
+public:
+    // Errors go to onMessage, or the console without one
+    explicit DigestIndex(MessageHandler onMessage = {}) : onMessage(std::move(onMessage)) {}
+    ~DigestIndex();
+
+    DigestIndex(const DigestIndex&) = delete;
+    DigestIndex& operator=(const DigestIndex&) = delete;
+
+    // Maps an existing index. A missing file opens as an empty index; a damaged one fails.
+    bool open(const fs::path& indexPath);
+    void close();
+
+    bool contains(uint64_t size, const Sha256Digest& digest) const;
+
+    // False means no indexed file has this size and head digest. True means the full digest has to be checked.
+    bool mightContain(uint64_t size, uint64_t headDigest) const { return prefilter.mightContain(prefilterKey(size, headDigest)); }
+    bool hasPrefilter() const { return !prefilter.isEmpty(); }
+
+    // Every path stored under this size and digest
+    std::vector<std::wstring> lookup(uint64_t size, const Sha256Digest& digest) const;
+
+    // Adds the files and rewrites the index. A path that is already indexed is replaced by its new entry.
+    // The prefilter is rebuilt to keep its false-positive rate at falsePositiveRate; lower rates cost more memory.
+    bool insert(const std::vector<IndexedFile>& files, double falsePositiveRate = DEFAULT_PREFILTER_FALSE_POSITIVE_RATE);
+
+    // Every entry, in slot order
+    std::vector<IndexedFile> entries() const;
+
+    size_t entryCount() const;
+    DigestIndexStats stats() const;
+
+private:
+    struct Slot;
+
+    const Slot* slotAt(uint64_t index) const;
+    std::string_view pathAt(uint64_t pathOffset) const;
+    uint64_t homeSlot(uint64_t size, const Sha256Digest& digest) const;
+
+    MessageHandler onMessage;
+    fs::path indexPath;
+    void* fileHandle = nullptr;
+    void* mappingHandle = nullptr;
+    const unsigned char* view = nullptr;
+    uint64_t viewSize = 0;
+    uint64_t slotCount = 0;
+    BloomFilter prefilter;
+    double prefilterTarget = 0;
+};
+
+bool parseDigestHex(const std::string& hex, Sha256Digest& digest);
+std::string digestToHex(const Sha256Digest& digest);
@@ -0,0 +1,271 @@
+#include "DirectoryDigest.h"
+#include "DigestIndex.h"
+#include "Throttle.h"
+
+#include <algorithm>
+#include <map>
+#include <string_view>
+#include <unordered_set>
+
+namespace
+{
+    using NameView = std::basic_string_view<fs::path::value_type>;
+
+    // The last component of a scanned path, without building a new path for it
+    NameView nameOf(const fs::path& path)
+    {
+        const fs::path::string_type& native = path.native();
+        size_t separator = native.find_last_of(fs::path::string_type{ fs::path::preferred_separator, '/' });
+        return NameView(native).substr(separator == fs::path::string_type::npos ? 0 : separator + 1);
+    }
+
+    const unsigned char ENTRY_FILE = 'F';
+    const unsigned char ENTRY_DIRECTORY = 'D';
+
+    bool byRelativePath(const FolderEntry& a, const FolderEntry& b)
+    {
+        return a.relativePath.native() < b.relativePath.native();
+    }
+}
+
+DirectoryDuplicates findDuplicateDirectories(const std::vector<fs::path>& paths, const std::vector<ScanNode>& nodes,
+    const std::vector<std::optional<Sha256Digest>>& fileDigests)
+{
+    const size_t count = std::min<size_t>(paths.size(), nodes.size());
+    DirectoryDuplicates result;
+    result.covered.assign(paths.size(), false);
+
+    std::vector<NameView> names(count);
+    for (size_t i = 0; i < count; ++i)
+    {
+        names[i] = nameOf(paths[i]);
+    }
+
+    // Entries sorted by (parent, name), so each folder's entries form one run in a stable order
+    std::vector<uint32_t> order(count);
+    for (size_t i = 0; i < count; ++i) order[i] = static_cast<uint32_t>(i);
+    std::sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b)
+    {
+        if (nodes[a].parent != nodes[b].parent) return nodes[a].parent < nodes[b].parent;
+        return names[a] < names[b];
+    });
+
+    std::vector<size_t> firstChild(count + 1, count);
+    std::vector<size_t> childEnd(count + 1, count);
+    for (size_t position = count; position-- > 0;)
+    {
+        uint32_t parent = nodes[order[position]].parent;
+        if (parent == NO_PARENT) continue;
+        if (firstChild[parent] == count) childEnd[parent] = position + 1;
+        firstChild[parent] = position;
+    }
+
+    // Children always come after their folder in the depth-first order, so walking it backwards finishes every
+    // folder's entries before the folder itself. A folder with any entry lacking a digest gets none either, and
+    // neither does one the scan left entries out of, so both carry up to every folder above.
+    std::vector<std::optional<Sha256Digest>> digests(count);
+    std::vector<uint32_t> subtreeSize(count, 1);
+    std::vector<uint64_t> subtreeBytes(count, 0);
+    std::vector<size_t> subtreeFiles(count, 0);
+    Sha256Hasher hasher;
+
+    for (size_t i = count; i-- > 0;)
+    {
+        if (!nodes[i].isDirectory)
+        {
+            if (i < fileDigests.size()) digests[i] = fileDigests[i];
+            subtreeBytes[i] = nodes[i].size;
+            subtreeFiles[i] = 1;
+        }
+        else
+        {
+            bool complete = nodes[i].complete && hasher.begin();
+            for (size_t position = firstChild[i]; position < childEnd[i]; ++position)
+            {
+                uint32_t child = order[position];
+                subtreeSize[i] += subtreeSize[child];
+                subtreeBytes[i] += subtreeBytes[child];
+                subtreeFiles[i] += subtreeFiles[child];
+
+                if (!complete || !digests[child])
+                {
+                    complete = false;
+                    continue;
+                }
+
+                uint32_t nameLength = static_cast<uint32_t>(names[child].size());
+                unsigned char kind = nodes[child].isDirectory ? ENTRY_DIRECTORY : ENTRY_FILE;
+                complete = hasher.update(&nameLength, sizeof(nameLength))
+                    && hasher.update(names[child].data(), names[child].size() * sizeof(fs::path::value_type))
+                    && hasher.update(&kind, sizeof(kind))
+                    && hasher.update(digests[child]->data(), digests[child]->size());
+            }
+
+            Sha256Digest digest;
+            if (complete && hasher.finish(digest)) digests[i] = digest;
+        }
+    }
+
+    // Folders without files are all alike and not worth reporting, but they still count towards their parents
+    std::map<Sha256Digest, std::vector<uint32_t>> byDigest;
+    for (size_t i = 0; i < count; ++i)
+    {
+        if (nodes[i].isDirectory && digests[i] && subtreeFiles[i] > 0) byDigest[*digests[i]].push_back(static_cast<uint32_t>(i));
+    }
+
+    auto duplicated = [&](uint32_t index)
+    {
+        if (index == NO_PARENT || !digests[index]) return false;
+        auto it = byDigest.find(*digests[index]);
+        return it != byDigest.end() && it->second.size() > 1;
+    };
+
+    for (const auto& [digest, members] : byDigest)
+    {
+        if (members.size() < 2) continue;
+
+        // Copies inside a duplicated parent are handled with that parent
+        std::vector<uint32_t> reported;
+        uint32_t insideDuplicate = NO_PARENT;
+        for (uint32_t member : members)
+        {
+            if (!duplicated(nodes[member].parent)) reported.push_back(member);
+            else if (insideDuplicate == NO_PARENT) insideDuplicate = member;
+        }
+        if (reported.empty()) continue;
+
+        // A lone outer copy is still a duplicate of the nested ones, so one of those is listed next to it
+        if (reported.size() == 1) reported.push_back(insideDuplicate);
+
+        DirectoryGroup group;
+        group.hash = digestToHex(digest);
+        group.bytes = subtreeBytes[members.front()];
+        group.files = subtreeFiles[members.front()];
+
+        // The subtree follows its folder in the depth-first order. Every copy holds the same names, so sorted by
+        // relative path their entries line up and one list serves them all.
+        std::vector<uint32_t> kept;
+        for (uint32_t member : reported)
+        {
+            const size_t prefixLength = paths[member].native().size() + 1;
+            std::vector<std::pair<FolderEntry, uint32_t>> contents;
+            for (uint32_t inside = member + 1; inside < member + subtreeSize[member]; ++inside)
+            {
+                contents.push_back({ { paths[inside].native().substr(prefixLength), nodes[inside].isDirectory }, inside });
+            }
+            std::sort(contents.begin(), contents.end(), [](const auto& a, const auto& b) { return byRelativePath(a.first, b.first); });
+
+            bool unchanged = group.entries.empty() || group.entries.size() == contents.size();
+            std::vector<FileFingerprint> fingerprints(contents.size());
+            for (size_t i = 0; unchanged && i < contents.size(); ++i)
+            {
+                const ScanNode& node = nodes[contents[i].second];
+                if (node.isDirectory) continue;
+
+                FileFingerprint scanned;
+                scanned.size = node.size;
+                scanned.writeTime = node.writeTime;
+                unchanged = queryFileFingerprint(paths[contents[i].second], fingerprints[i]) && fingerprintsMatch(scanned, fingerprints[i]);
+            }
+            if (!unchanged) continue; // its digest no longer describes it
+
+            if (group.entries.empty())
+            {
+                for (auto& [entry, index] : contents) group.entries.push_back(std::move(entry));
+            }
+            group.directories.push_back(paths[member]);
+            group.fingerprints.push_back(std::move(fingerprints));
+            kept.push_back(member);
+        }
+        if (kept.size() < 2) continue;
+
+        for (uint32_t member : kept)
+        {
+            std::fill(result.covered.begin() + member, result.covered.begin() + member + subtreeSize[member], true);
+        }
+        result.groups.push_back(std::move(group));
+    }
+
+    // Largest first, since those are the ones worth looking at
+    std::stable_sort(result.groups.begin(), result.groups.end(), [](const DirectoryGroup& a, const DirectoryGroup& b)
+    {
+        return a.bytes > b.bytes;
+    });
+
+    return result;
+}
+
+bool directoryUnchanged(const fs::path& directory, const std::vector<FolderEntry>& entries, const std::vector<FileFingerprint>& fingerprints)
+{
+    if (fingerprints.size() != entries.size()) return false;
+
+    // Listed the way the scanner lists, with links kept as entries and not followed, but with nothing skipped
+    std::vector<FolderEntry> found;
+    std::vector<fs::path> pending{ fs::path() };
+    while (!pending.empty())
+    {
+        fs::path relative = std::move(pending.back());
+        pending.pop_back();
+
+        ioThrottle().beforeMetadata();
+        std::error_code error;
+        for (fs::directory_iterator it(relative.empty() ? directory : directory / relative, error), end; !error && it != end; it.increment(error))
+        {
+            std::error_code entryError;
+            bool isDirectory = it->is_directory(entryError) && !it->is_symlink(entryError);
+            if (entryError) return false;
+
+            fs::path child = relative / it->path().filename();
+            if (isDirectory) pending.push_back(child);
+            found.push_back({ std::move(child), isDirectory });
+            if (found.size() > entries.size()) return false;
+        }
+        if (error) return false;
+    }
+
+    if (found.size() != entries.size()) return false;
+    std::sort(found.begin(), found.end(), byRelativePath);
+
+    for (size_t i = 0; i < entries.size(); ++i)
+    {
+        if (found[i].relativePath.native() != entries[i].relativePath.native() || found[i].isDirectory != entries[i].isDirectory) return false;
+        if (entries[i].isDirectory) continue;
+
+        FileFingerprint current;
+        if (!queryFileFingerprint(directory / entries[i].relativePath, current) || !fingerprintsMatch(fingerprints[i], current)) return false;
+    }
+    return true;
+}
+
+void removeCoveredFiles(std::vector<DuplicateGroup>& groups, const std::vector<fs::path>& paths, const std::vector<bool>& covered)
+{
+    std::unordered_set<fs::path::string_type> coveredPaths;
+    for (size_t i = 0; i < paths.size() && i < covered.size(); ++i)
+    {
+        if (covered[i]) coveredPaths.insert(paths[i].native());
+    }
+    if (coveredPaths.empty()) return;
+
+    size_t kept = 0;
+    for (auto& group : groups)
+    {
+        // The fingerprints run parallel to the files, so both are compacted together
+        size_t keptFiles = 0;
+        for (size_t i = 0; i < group.files.size(); ++i)
+        {
+            if (coveredPaths.count(group.files[i].native())) continue;
+
+            if (keptFiles != i)
+            {
+                if (i < group.fingerprints.size()) group.fingerprints[keptFiles] = group.fingerprints[i];
+                group.files[keptFiles] = std::move(group.files[i]);
+            }
+            ++keptFiles;
+        }
+        group.files.resize(keptFiles);
+        group.fingerprints.resize(std::min<size_t>(group.fingerprints.size(), keptFiles));
+
+        if (group.files.size() > 1) groups[kept++] = std::move(group);
+    }
+    groups.resize(kept);
+}
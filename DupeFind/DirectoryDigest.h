@@ -0,0 +1,60 @@
+#pragma once
+
+#include "HashCalculator.h"
+#include "FileScanner.h"
+
+#include <filesystem>
+#include <optional>
+#include <string>
+#include <vector>
+#include <cstdint>
+
+namespace fs = std::filesystem;
+
+// Folders whose whole subtrees are identical. A folder's digest is the SHA-256 of its entries in name order: each
+// entry's name, kind and digest, so it is computed bottom-up from the file digests and two folders share one
+// exactly when they hold the same names with the same contents. A folder the scan did not see whole, with an entry
+// filtered, skipped or unlisted anywhere below it, gets no digest and is never reported, since removing it would
+// take files that were never compared.
+// One file or folder inside a duplicate folder, relative to it. Every copy holds the same ones.
+struct FolderEntry
+{
+    fs::path relativePath;
+    bool isDirectory = false;
+};
+
+struct DirectoryGroup
+{
+    std::string hash;
+    std::vector<fs::path> directories;
+    uint64_t bytes = 0; // of one copy
+    size_t files = 0;   // in one copy
+
+    // What was inside each copy when the group was found, so removal can check it still holds exactly that:
+    // the entries sorted by relative path, and per directory one fingerprint per entry (left empty for folders)
+    std::vector<FolderEntry> entries;
+    std::vector<std::vector<FileFingerprint>> fingerprints;
+};
+
+struct DirectoryDuplicates
+{
+    std::vector<DirectoryGroup> groups;
+
+    // One flag per scanned path: set for everything inside a reported folder, whose file groups are then redundant
+    std::vector<bool> covered;
+};
+
+// paths and nodes as the scanner returned them, fileDigests indexed the same way as streamFilesByHash fills them.
+// A file it left without a digest has no duplicate, so no folder holding it can have one either and none is computed.
+// A folder is only reported if no folder containing it is reported as well, so a copied tree is one group.
+// Every file in a reported folder is fingerprinted; one that no longer has the size and write time it was scanned
+// with, as after a snapshot went stale, leaves its folder out of the group.
+DirectoryDuplicates findDuplicateDirectories(const std::vector<fs::path>& paths, const std::vector<ScanNode>& nodes,
+    const std::vector<std::optional<Sha256Digest>>& fileDigests);
+
+// Lists the directory again, without any filter, and checks that it holds exactly the entries recorded for it with
+// each file still matching its fingerprint. Anything added, missing, unreadable or changed makes it false.
+bool directoryUnchanged(const fs::path& directory, const std::vector<FolderEntry>& entries, const std::vector<FileFingerprint>& fingerprints);
+
+// Drops the files inside reported folders from file groups, and the groups left with fewer than two files
+void removeCoveredFiles(std::vector<DuplicateGroup>& groups, const std::vector<fs::path>& paths, const std::vector<bool>& covered);
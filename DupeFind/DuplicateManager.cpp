@@ -2,12 +2,14 @@
 #include "InputHandler.h"
 #include "Utilities.h" 
 #include "ReportGenerator.h"
+#include "DigestIndex.h"
 
 #include <iostream>
 #include <filesystem>
 #include <map>
 #include <vector>
 #include <string>
+#include <algorithm>
 
 #define WiN32_LEAN_AND_MEAN
 #include <Windows.h>
@@ -15,223 +17,323 @@
 
 
 
-void handleDuplicateRemoval(const std::map<std::string, std::vector<fs::path>>& duplicateGroups)
+RemovalMode chooseRemovalMode()
 {
     std::wcout << L"\n=== DUPLICATE REMOVAL OPTIONS ===" << std::endl;
+    std::wcout << L"Interactive removal handles each group as soon as it is confirmed, while the rest are still being hashed." << std::endl;
     std::wcout << L"Would you like to remove duplicate files?" << std::endl;
     std::wcout << L"[1] Keep all files" << std::endl;
     std::wcout << L"[2] Interactive removal" << std::endl;
     std::wcout << L"[3] Automatic removal (keeps the file with the shortest path)" << std::endl;
+    std::wcout << L"[4] Review after hashing, largest reclaimable space first (best for many groups)" << std::endl;
 
-    int choice = getUserChoiceRange(L"Please enter your choice (1-3): ", 1, 3);
+    int choice = getUserChoiceRange(L"Please enter your choice (1-4): ", 1, 4);
 
     switch (choice)
     {
-    case 1:
-        std::wcout << L"Keeping all files. No duplicates will be removed." << std::endl;
-        break;
     case 2:
-        interactiveRemoval(duplicateGroups);
-        break;
+        return RemovalMode::Interactive;
+    case 4:
+        std::wcout << L"Groups are kept in a results file while hashing and listed a page at a time once it is done." << std::endl;
+        return RemovalMode::Review;
     case 3:
-        automaticRemoval(duplicateGroups);
-        break;
+        // The groups are not known yet, so the confirmation comes once they are, with a preview of what goes
+        std::wcout << L"\nThe file with the shortest path in each duplicate group will be kept." << std::endl;
+        std::wcout << L"Once hashing is done you will see what would be moved to the Recycle Bin and confirm it first." << std::endl;
+        return RemovalMode::Automatic;
+    default:
+        std::wcout << L"Keeping all files. No duplicates will be removed." << std::endl;
+        return RemovalMode::KeepAll;
     }
 }
 
-void interactiveRemoval(const std::map<std::string, std::vector<fs::path>>& duplicateGroups)
+DuplicateRemover::DuplicateRemover(RemovalMode mode) : mode(mode)
 {
-    std::wcout << L"\n=== INTERACTIVE DUPLICATE REMOVAL ===" << std::endl;
-    std::wcout << L"For each duplicate group, you can choose which files to keep/delete." << std::endl;
-    std::wcout << L"Files will be moved to recycle bin for safety.\n" << std::endl;
+    if (mode == RemovalMode::Interactive)
+    {
+        std::wcout << L"\n=== INTERACTIVE DUPLICATE REMOVAL ===" << std::endl;
+        std::wcout << L"For each duplicate group, you can choose which files to keep/delete." << std::endl;
+        std::wcout << L"Files will be moved to recycle bin for safety.\n" << std::endl;
+    }
+}
 
-    size_t groupNumber = 1;
-    size_t totalDeleted = 0;
-    uintmax_t totalSizeDeleted = 0;
+void DuplicateRemover::handleGroup(const DuplicateGroup& group)
+{
+    // Automatic and review mode get their groups from the stored results once hashing is done
+    if (group.files.size() <= 1 || mode != RemovalMode::Interactive) return;
 
-    // Collect all deletion operations for logging
-    std::vector<fs::path> allDeletedFiles;
-    std::vector<fs::path> allKeptFiles;
+    // The files of a group are identical, so the size listed for them serves for all
+    handleEntries(group.files, group.fileSize, &group, nullptr);
+}
 
-    for (const auto& [hash, files] : duplicateGroups)
-    {
-        if (files.size() <= 1) continue;
+void DuplicateRemover::handleDirectoryGroup(const DirectoryGroup& group)
+{
+    if (group.directories.size() <= 1 || mode != RemovalMode::Interactive) return;
 
-        std::wcout << L"--- Duplicate Group #" << groupNumber << L" ---" << std::endl;
+    handleEntries(group.directories, group.bytes, nullptr, &group);
+}
 
-        uintmax_t fileSize = 0;
-        try
-        {
-            fileSize = fs::file_size(files[0]);
-            std::string fileSizeStr = formatFileSize(fileSize);
-            std::wcout << L"File size: " << std::wstring(fileSizeStr.begin(), fileSizeStr.end()) << std::endl;
-        }
-        catch (const fs::filesystem_error& e)
-        {
-            std::wcerr << L"Error getting file size: " << e.what() << std::endl;
-        }
+void DuplicateRemover::reviewGroup(const DuplicateGroup& group, size_t number)
+{
+    if (group.files.size() <= 1) return;
 
-        for (size_t i = 0; i < files.size(); ++i)
-        {
-            printUnicodeMulti(true, L"  ", std::to_wstring(i + 1), L". ", files[i].wstring());
-        }
+    groupNumber = number;
+    removeInteractively(group.files, group.fileSize, &group, nullptr);
+}
 
-        std::wcout << L"\nOptions:" << std::endl;
-        std::wcout << L"[0] Keep all files in this group" << std::endl;
-        std::wcout << L"[1-" << files.size() << L"] Keep only the selected file (delete all others)" << std::endl;
-        std::wcout << L"Press enter or enter -1 to auto-select (keep shortest path)" << std::endl;
+void DuplicateRemover::reviewGroup(const DirectoryGroup& group, size_t number)
+{
+    if (group.directories.size() <= 1) return;
 
-        int choice = getUserChoiceRange(L"Please enter your choice: ", 0, static_cast<int>(files.size()), true);
+    groupNumber = number;
+    removeInteractively(group.directories, group.bytes, nullptr, &group);
+}
 
-        if (choice == 0)
-        {
-            std::wcout << L"Keeping all files in this group.\n" << std::endl;
-            groupNumber++;
-            continue;
-        }
+void DuplicateRemover::removeKeepingBest(const DuplicateGroup& group, const std::vector<bool>* removable)
+{
+    if (group.files.size() <= 1) return;
 
-        fs::path fileToKeep;
-        if (choice == -1)
-        {
-            fileToKeep = selectBestFileToKeep(files);
-			printUnicodeMulti(true, L"Auto-selected: ", fileToKeep.wstring());
-        }
-        else
-        {
-            fileToKeep = files[choice - 1];
-            printUnicodeMulti(true, L"Keeping file: ", fileToKeep.wstring());
-        }
+    removeAutomatically(group.files, group.fileSize, &group, nullptr, removable);
+}
+
+void DuplicateRemover::removeKeepingBest(const DirectoryGroup& group, const std::vector<bool>* removable)
+{
+    if (group.directories.size() <= 1) return;
+
+    removeAutomatically(group.directories, group.bytes, nullptr, &group, removable);
+}
+
+void DuplicateRemover::handleEntries(const std::vector<fs::path>& entries, uintmax_t entrySize, const DuplicateGroup* group, const DirectoryGroup* folders)
+{
+    switch (mode)
+    {
+    case RemovalMode::Interactive:
+        removeInteractively(entries, entrySize, group, folders);
+        break;
+    case RemovalMode::Automatic:
+        removeAutomatically(entries, entrySize, group, folders);
+        break;
+    case RemovalMode::KeepAll:
+    case RemovalMode::Review:
+        break;
+    }
+    groupNumber++;
+}
 
-        // Collect files to delete
-        std::vector<fs::path> filesToDelete;
-        for (const auto& file : files)
+void DuplicateRemover::finish()
+{
+    if (mode == RemovalMode::KeepAll) return;
+
+    if (!deletedFiles.empty() || !keptFiles.empty() || !changedFiles.empty())
+    {
+        // TODO: Update this to handle special characters
+        const char* removalType = mode == RemovalMode::Interactive ? "INTERACTIVE" : mode == RemovalMode::Review ? "REVIEW" : "AUTOMATIC";
+        writeDeletionLog(deletedFiles, keptFiles, removalType, totalDeleted, totalSizeDeleted,
+            changedFiles, recheckedFiles);
+    }
+    else if (mode == RemovalMode::Automatic)
+    {
+        std::wcout << L"No files to delete." << std::endl;
+    }
+}
+
+std::vector<bool> DuplicateRemover::confirmUnchanged(const DuplicateGroup& group)
+{
+    std::vector<bool> unchanged(group.files.size(), true);
+    if (group.fingerprints.size() != group.files.size()) return unchanged; // not recorded, nothing to compare against
+
+    Sha256Digest expected;
+    bool hasDigest = parseDigestHex(group.hash, expected); // "empty_file" has none, only its size is compared
+
+    for (size_t i = 0; i < group.files.size(); ++i)
+    {
+        const fs::path& file = group.files[i];
+        FileFingerprint current;
+        if (queryFileFingerprint(file, current) && fingerprintsMatch(group.fingerprints[i], current)) continue;
+
+        // A different size is a different file; otherwise it may only have been touched, and reading it once settles it
+        Sha256Digest digest;
+        bool same = hasDigest && current.size == group.fingerprints[i].size && calculateSHA256(file, digest) && digest == expected;
+        if (same)
         {
-            if (file != fileToKeep)
-            {
-                filesToDelete.push_back(file);
-            }
+            recheckedFiles.push_back(file);
+            continue;
         }
 
-        std::wcout << L"\nFiles to be moved to Recycle Bin:" << std::endl;
-        for (const auto& file : filesToDelete)
+        unchanged[i] = false;
+        changedFiles.push_back(file);
+        printUnicodeMulti(true, L"Changed since it was hashed, left alone: ", file.wstring());
+    }
+    return unchanged;
+}
+
+std::vector<bool> DuplicateRemover::confirmUnchanged(const std::vector<fs::path>& directories, const DirectoryGroup* folders)
+{
+    std::vector<bool> unchanged(directories.size(), false);
+    for (size_t i = 0; i < directories.size(); ++i)
+    {
+        // Without a record of its contents a folder cannot be checked, and an unchecked folder is never removed
+        if (!folders || folders->fingerprints.size() != directories.size())
         {
-            printUnicodeMulti(true, L"  ", file.wstring());
+            printUnicodeMulti(true, L"Contents not recorded, left alone: ", directories[i].wstring());
         }
-
-        if (getUserConfirmation(L"Are you sure you want to continue? "))
+        else if (directoryUnchanged(directories[i], folders->entries, folders->fingerprints[i]))
         {
-            size_t deletedCount = 0;
-            for (const auto& file : filesToDelete)
-            {
-                if (safeDeleteFile(file, true)) // Moves it to recycle bin
-                {
-                    deletedCount++;
-                    totalSizeDeleted += fileSize;
-                    allDeletedFiles.push_back(file);
-                }
-            }
-            totalDeleted += deletedCount;
-            allKeptFiles.push_back(fileToKeep);
-            std::wcout << L"Successfully moved " << deletedCount << L" files to Recycle Bin." << std::endl;
+            unchanged[i] = true;
+            continue;
         }
         else
         {
-            std::wcout << L"Skipping deletion for this group." << std::endl;
+            printUnicodeMulti(true, L"Changed since it was scanned, left alone: ", directories[i].wstring());
         }
-
-        std::wcout << std::endl;
-        groupNumber++;
+        changedFiles.push_back(directories[i]);
     }
+    return unchanged;
+}
 
-    if (!allDeletedFiles.empty() || !allKeptFiles.empty())
-    {
-        // TODO: Update this to handle special characters
-        writeDeletionLog(allDeletedFiles, allKeptFiles, "INTERACTIVE", totalDeleted, totalSizeDeleted);
-    }
+std::vector<bool> DuplicateRemover::confirmUnchanged(const std::vector<fs::path>& entries, const DuplicateGroup* group, const DirectoryGroup* folders)
+{
+    return group ? confirmUnchanged(*group) : confirmUnchanged(entries, folders);
 }
 
-void automaticRemoval(const std::map<std::string, std::vector<fs::path>>& duplicateGroups)
+void DuplicateRemover::removeInteractively(const std::vector<fs::path>& entries, uintmax_t entrySize, const DuplicateGroup* group, const DirectoryGroup* folders)
 {
-	std::wcout << L"\n=== AUTOMATIC DUPLICATE REMOVAL ===" << std::endl;
-	std::wcout << L"This will automatically keep the file with the shortest path in each duplicate group." << std::endl;
-	std::wcout << L"All other duplicates will be moved to the Recycle Bin." << std::endl;
+    const bool directories = group == nullptr;
+    const wchar_t* noun = directories ? L"folders" : L"files";
 
-	std::vector<fs::path> filesToDelete;
-	std::vector<fs::path> filesToKeep;
+    std::wcout << L"--- Duplicate " << (directories ? L"Folder " : L"") << L"Group #" << groupNumber << L" ---" << std::endl;
 
-    for (const auto& [hash, files] : duplicateGroups)
+    std::string entrySizeStr = formatFileSize(entrySize);
+    std::wcout << (directories ? L"Folder size: " : L"File size: ") << utf8ToWstring(entrySizeStr) << std::endl;
+
+    for (size_t i = 0; i < entries.size(); ++i)
+    {
+        printUnicodeMulti(true, L"  ", std::to_wstring(i + 1), L". ", entries[i].wstring());
+    }
+
+    std::wcout << L"\nOptions:" << std::endl;
+    std::wcout << L"[0] Keep all " << noun << L" in this group" << std::endl;
+    std::wcout << L"[1-" << entries.size() << L"] Keep only the selected " << (directories ? L"folder" : L"file") << L" (delete all others)" << std::endl;
+    std::wcout << L"Press enter or enter -1 to auto-select (keep shortest path)" << std::endl;
+
+    int choice = getUserChoiceRange(L"Please enter your choice: ", 0, static_cast<int>(entries.size()), true);
+
+    if (choice == 0)
+    {
+        std::wcout << L"Keeping all " << noun << L" in this group.\n" << std::endl;
+        return;
+    }
+
+    fs::path entryToKeep;
+    if (choice == -1)
+    {
+        entryToKeep = selectBestFileToKeep(entries);
+        printUnicodeMulti(true, L"Auto-selected: ", entryToKeep.wstring());
+    }
+    else
     {
-        if (files.size() <= 1) continue;
+        entryToKeep = entries[choice - 1];
+        printUnicodeMulti(true, directories ? L"Keeping folder: " : L"Keeping file: ", entryToKeep.wstring());
+    }
 
-        fs::path fileToKeep = selectBestFileToKeep(files);
-        filesToKeep.push_back(fileToKeep);
-        for (const auto& file : files)
+    // Collect entries to delete
+    std::vector<fs::path> entriesToDelete;
+    for (const auto& entry : entries)
+    {
+        if (entry != entryToKeep)
         {
-            if (file != fileToKeep)
-            {
-                filesToDelete.push_back(file);
-            }
-		}
+            entriesToDelete.push_back(entry);
+        }
     }
 
-    if (filesToDelete.empty())
+    std::wcout << L"\n" << (directories ? L"Folders" : L"Files") << L" to be moved to Recycle Bin:" << std::endl;
+    for (const auto& entry : entriesToDelete)
     {
-        std::wcout << L"No files to delete." << std::endl;
-        return;
-	}
+        printUnicodeMulti(true, L"  ", entry.wstring());
+    }
 
-	std::wcout << L"\nFiles to be kept (shortest paths):" << std::endl;
-    for (const auto& file : filesToKeep)
+    if (getUserConfirmation(L"Are you sure you want to continue? "))
     {
-        printUnicodeMulti(true, L"  KEEP: ", file.wstring());
-	}
+        // Checked only now, since the review may have taken a while
+        std::vector<bool> unchanged = confirmUnchanged(entries, group, folders);
+        size_t keepIndex = static_cast<size_t>(std::find(entries.begin(), entries.end(), entryToKeep) - entries.begin());
+        if (!unchanged[keepIndex])
+        {
+            std::wcout << (directories ? L"The folder to keep is not as it was scanned" : L"The file to keep changed since it was hashed")
+                << L", so nothing in this group is removed.\n" << std::endl;
+            return;
+        }
+
+        size_t deletedCount = 0;
+        for (size_t i = 0; i < entries.size(); ++i)
+        {
+            const fs::path& entry = entries[i];
+            if (i == keepIndex || !unchanged[i]) continue;
 
-    std::wcout << L"\nFiles to be moved to Recycle Bin:" << std::endl;
-    for (const auto& file : filesToDelete)
+            if (safeDeleteFile(entry, true)) // Moves it to recycle bin, a folder with everything in it
+            {
+                deletedCount++;
+                totalSizeDeleted += entrySize;
+                deletedFiles.push_back(entry);
+            }
+        }
+        totalDeleted += deletedCount;
+        keptFiles.push_back(entryToKeep);
+        std::wcout << L"Successfully moved " << deletedCount << L" " << noun << L" to Recycle Bin." << std::endl;
+    }
+    else
     {
-        printUnicodeMulti(true, L"  DELETE: ", file.wstring());
+        std::wcout << L"Skipping deletion for this group." << std::endl;
     }
 
-	std::wcout << L"\nTotal files to delete: " << filesToDelete.size() << std::endl;
+    std::wcout << std::endl;
+}
+
+void DuplicateRemover::removeAutomatically(const std::vector<fs::path>& entries, uintmax_t entrySize, const DuplicateGroup* group, const DirectoryGroup* folders,
+    const std::vector<bool>* removable)
+{
+    size_t keepIndex = selectEntryToKeep(entries, removable);
+    const fs::path& entryToKeep = entries[keepIndex];
 
-    if (!getUserConfirmation(L"Are you sure you want to continue? (Y/n): "))
+    std::vector<bool> unchanged = confirmUnchanged(entries, group, folders);
+    if (!unchanged[keepIndex])
     {
-        std::wcout << L"Aborting automatic removal." << std::endl;
+        printUnicodeMulti(true, group ? L"  The file to keep changed since it was hashed, nothing removed: " : L"  The folder to keep is not as it was scanned, nothing removed: ",
+            entryToKeep.wstring());
         return;
-	}
+    }
 
-	// Perform deletion
-	size_t successCount = 0;
-	uintmax_t totalSizeDeleted = 0;
+    keptFiles.push_back(entryToKeep);
+    printUnicodeMulti(true, L"  KEEP: ", entryToKeep.wstring());
 
-    for (const auto& file : filesToDelete)
+    for (size_t i = 0; i < entries.size(); ++i)
     {
+        const fs::path& entry = entries[i];
+        if (i == keepIndex || !unchanged[i] || (removable && !(*removable)[i])) continue;
+
         try
         {
-			uintmax_t fileSize = fs::file_size(file);
-            if (safeDeleteFile(file, true)) // Moves it to recycle bin
+            if (safeDeleteFile(entry, true)) // Moves it to recycle bin
             {
-                successCount++;
-				totalSizeDeleted += fileSize;
-                printUnicodeMulti(true, L"Moved to Recycle Bin: ", file.wstring());
+                totalDeleted++;
+                totalSizeDeleted += entrySize;
+                deletedFiles.push_back(entry);
+                printUnicodeMulti(true, L"Moved to Recycle Bin: ", entry.wstring());
             }
         }
         catch (const fs::filesystem_error& e)
         {
-            printUnicodeMulti(false, L"Error deleting file: ", file.wstring(), L": ");
-            std::wcerr << e.what() << std::endl;
-		}
+            printUnicodeMulti(true, L"Error deleting file: ", entry.wstring(), L": ", errorMessage(e));
+        }
         catch (const std::exception& e)
         {
-            printUnicodeMulti(false, L"Unexpected error deleting file: ", file.wstring(), L": ");
-            std::wcerr << e.what() << std::endl;
+            printUnicodeMulti(true, L"Unexpected error deleting file: ", entry.wstring(), L": ", errorMessage(e));
         }
         catch (...)
         {
-            printUnicodeMulti(true, L"Unknown error deleting file: ", file.wstring());
+            printUnicodeMulti(true, L"Unknown error deleting file: ", entry.wstring());
         }
     }
-    writeDeletionLog(filesToDelete, filesToKeep, "AUTOMATIC", successCount, totalSizeDeleted);
 }
 
 fs::path selectBestFileToKeep(const std::vector<fs::path>& files)
@@ -249,6 +351,20 @@ fs::path selectBestFileToKeep(const std::vector<fs::path>& files)
 	return bestFile;
 }
 
+size_t selectEntryToKeep(const std::vector<fs::path>& entries, const std::vector<bool>* removable)
+{
+    size_t keep = SIZE_MAX;
+    for (size_t i = 0; i < entries.size(); ++i)
+    {
+        if (removable && (*removable)[i]) continue;
+        if (keep == SIZE_MAX || entries[i].native().length() < entries[keep].native().length()) keep = i;
+    }
+    if (keep != SIZE_MAX) return keep;
+
+    fs::path best = selectBestFileToKeep(entries);
+    return static_cast<size_t>(std::find(entries.begin(), entries.end(), best) - entries.begin());
+}
+
 bool safeDeleteFile(const fs::path& filePath, bool useRecycleBin)
 {
     if (!fs::exists(filePath))
@@ -285,9 +401,7 @@ bool safeDeleteFile(const fs::path& filePath, bool useRecycleBin)
         }
         catch (const fs::filesystem_error& e)
         {
-            std::string errorMsg = e.what();
-            std::wstring wErrorMsg(errorMsg.begin(), errorMsg.end());
-            printUnicodeMulti(true, L"Error deleting file: ", wErrorMsg);
+            printUnicodeMulti(true, L"Error deleting file: ", errorMessage(e));
             return false;
 		}
     }
@@ -1,18 +1,80 @@
 #pragma once
 
+#include "HashCalculator.h"
+#include "DirectoryDigest.h"
+
 #include <filesystem>
 #include <map>
 #include <string>
 #include <vector>
+#include <cstdint>
 
 namespace fs = std::filesystem;
 
-void handleDuplicateRemoval(const std::map<std::string, std::vector<fs::path>>& duplicateGroups);
+enum class RemovalMode
+{
+    KeepAll,
+    Interactive,
+    Automatic,   // groups are stored while hashing, previewed and removed after one confirmation
+    Review       // groups are stored while hashing and reviewed page by page afterwards, largest first
+};
+
+// Asked before hashing starts, so each duplicate group can be acted on as soon as it is confirmed. Automatic removal
+// waits for hashing to finish instead, so what it would remove can be shown and confirmed before the first deletion.
+RemovalMode chooseRemovalMode();
+
+// Removal stage of the pipeline: handles duplicate groups one at a time, in the order they are confirmed
+class DuplicateRemover
+{
+public:
+    explicit DuplicateRemover(RemovalMode mode);
+
+    // Before anything is removed, each file is checked against the fingerprint taken when it was hashed. Only files
+    // that look different are hashed again, and files that really changed are left alone and logged.
+    void handleGroup(const DuplicateGroup& group);
+
+    // Identical folders are kept or removed whole, like the files of a group. Each folder, the one kept included, is
+    // listed again first and must still hold exactly the entries and file fingerprints recorded when it was found.
+    void handleDirectoryGroup(const DirectoryGroup& group);
 
-void interactiveRemoval(const std::map<std::string, std::vector<fs::path>>& duplicateGroups);
+    // Review mode picks groups from the stored results instead; number is the group's place in them. Folders are
+    // checked against the contents stored with them, and folders stored without any are left alone.
+    void reviewGroup(const DuplicateGroup& group, size_t number);
+    void reviewGroup(const DirectoryGroup& group, size_t number);
+    // With removable, only the flagged entries may go, and the entry kept is chosen by selectEntryToKeep
+    void removeKeepingBest(const DuplicateGroup& group, const std::vector<bool>* removable = nullptr);
+    void removeKeepingBest(const DirectoryGroup& group, const std::vector<bool>* removable = nullptr);
 
-void automaticRemoval(const std::map<std::string, std::vector<fs::path>>& duplicateGroups);
+    // Writes the deletion log once every group has been handled
+    void finish();
+
+private:
+    // group is null for folders, which are checked against folders instead; without either nothing is removed
+    void handleEntries(const std::vector<fs::path>& entries, uintmax_t entrySize, const DuplicateGroup* group, const DirectoryGroup* folders);
+    void removeInteractively(const std::vector<fs::path>& entries, uintmax_t entrySize, const DuplicateGroup* group, const DirectoryGroup* folders);
+    void removeAutomatically(const std::vector<fs::path>& entries, uintmax_t entrySize, const DuplicateGroup* group, const DirectoryGroup* folders,
+        const std::vector<bool>* removable = nullptr);
+
+    // Per file of the group: does it still hold the contents it was hashed with
+    std::vector<bool> confirmUnchanged(const DuplicateGroup& group);
+    // Per folder: does it still hold exactly what it held when the group was found
+    std::vector<bool> confirmUnchanged(const std::vector<fs::path>& directories, const DirectoryGroup* folders);
+    std::vector<bool> confirmUnchanged(const std::vector<fs::path>& entries, const DuplicateGroup* group, const DirectoryGroup* folders);
+
+    RemovalMode mode;
+    size_t groupNumber = 1;
+    size_t totalDeleted = 0;
+    uintmax_t totalSizeDeleted = 0;
+    std::vector<fs::path> deletedFiles;
+    std::vector<fs::path> keptFiles;
+    std::vector<fs::path> changedFiles;   // changed since hashing, not removed
+    std::vector<fs::path> recheckedFiles; // looked different but were hashed again and still match
+};
 
 fs::path selectBestFileToKeep(const std::vector<fs::path>& files);
 
+// The shortest path among the entries not flagged in removable, or the shortest of all if every entry is flagged or
+// removable is null
+size_t selectEntryToKeep(const std::vector<fs::path>& entries, const std::vector<bool>* removable);
+
 bool safeDeleteFile(const fs::path& filePath, bool useRecycleBin = true);
\ No newline at end of file
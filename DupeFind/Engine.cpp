@@ -0,0 +1,118 @@
+#include "Engine.h"
+#include "Async.h"
+
+#include <atomic>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <optional>
+
+EngineResult findDuplicates(const EngineOptions& options, const EngineCallbacks& callbacks, std::stop_token stopToken)
+{
+    // The caller's token and the limits both end the run through this source
+    std::stop_source stop;
+    std::stop_callback forwardStop(stopToken, [&] { stop.request_stop(); });
+    std::atomic<bool> limitReached{ false };
+
+    // Never empty, so the stages do not fall back to the console
+    const MessageHandler onMessage = callbacks.onMessage ? callbacks.onMessage : [](const std::wstring&) {};
+
+    std::unique_ptr<IoExecutor> executor;
+    if (options.engine == ExecutionEngine::Coroutines)
+    {
+        executor = std::make_unique<IoExecutor>(options.limits.threads);
+    }
+
+    std::vector<fs::path> paths;
+    std::vector<ScanNode> nodes;
+    for (size_t root = 0; root < options.roots.size() && !stop.stop_requested(); ++root)
+    {
+        if (options.limits.maxEntries > 0 && paths.size() >= options.limits.maxEntries)
+        {
+            limitReached = true;
+            stop.request_stop();
+            break;
+        }
+
+        ScanControl control;
+        control.stopToken = stop.get_token();
+        control.maxEntries = options.limits.maxEntries > 0 ? options.limits.maxEntries - paths.size() : 0;
+        control.onMessage = onMessage;
+
+        std::vector<ScanNode> rootNodes;
+        std::vector<fs::path> rootPaths = getAllFilesAndDirectories(options.roots[root], options.journal, options.filter, executor.get(), &rootNodes, &control);
+
+        // Parents index into this root's results; shift them past the roots before it
+        const uint32_t offset = static_cast<uint32_t>(paths.size());
+        for (size_t i = 0; i < rootPaths.size(); ++i)
+        {
+            if (rootNodes[i].parent != NO_PARENT) rootNodes[i].parent += offset;
+            if (callbacks.onEntry) callbacks.onEntry(rootPaths[i], rootNodes[i]);
+        }
+        paths.insert(paths.end(), std::make_move_iterator(rootPaths.begin()), std::make_move_iterator(rootPaths.end()));
+        nodes.insert(nodes.end(), rootNodes.begin(), rootNodes.end());
+
+        if (callbacks.onProgress) callbacks.onProgress({ EngineStage::Scanning, root + 1, options.roots.size(), 0 });
+
+        if (control.limitReached)
+        {
+            limitReached = true;
+            stop.request_stop();
+        }
+    }
+
+    if (!stop.stop_requested())
+    {
+        HashOptions hashOptions = options.hashOptions;
+        hashOptions.executor = executor.get();
+        hashOptions.stopToken = stop.get_token();
+        hashOptions.onMessage = onMessage;
+        hashOptions.scheduling.onMessage = onMessage;
+        hashOptions.onProgress = [&](size_t finished, size_t total, uint64_t bytesRead)
+        {
+            if (options.limits.maxBytesRead > 0 && bytesRead >= options.limits.maxBytesRead && !limitReached.exchange(true))
+            {
+                stop.request_stop();
+            }
+            if (callbacks.onProgress) callbacks.onProgress({ EngineStage::Hashing, finished, total, bytesRead });
+        };
+
+        if (callbacks.onDirectoryGroup)
+        {
+            std::vector<DuplicateGroup> fileGroups;
+            std::vector<std::optional<Sha256Digest>> fileDigests;
+            std::mutex fileGroupsMutex;
+            streamFilesByHash(paths, nodes, options.journal, hashOptions, [&](DuplicateGroup&& group)
+            {
+                std::lock_guard<std::mutex> lock(fileGroupsMutex);
+                fileGroups.push_back(std::move(group));
+            }, &fileDigests);
+
+            // A stopped pass leaves digests missing, and no group should rest on a partial one
+            if (!stop.stop_requested())
+            {
+                DirectoryDuplicates directories = findDuplicateDirectories(paths, nodes, fileDigests);
+                for (auto& group : directories.groups)
+                {
+                    callbacks.onDirectoryGroup(std::move(group));
+                }
+
+                removeCoveredFiles(fileGroups, paths, directories.covered);
+                for (auto& group : fileGroups)
+                {
+                    if (callbacks.onGroup) callbacks.onGroup(std::move(group));
+                }
+            }
+        }
+        else
+        {
+            streamFilesByHash(paths, nodes, options.journal, hashOptions, [&](DuplicateGroup&& group)
+            {
+                if (callbacks.onGroup) callbacks.onGroup(std::move(group));
+            });
+        }
+    }
+
+    if (limitReached) return EngineResult::LimitReached;
+    return stopToken.stop_requested() ? EngineResult::Cancelled : EngineResult::Completed;
+}
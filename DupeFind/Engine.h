@@ -0,0 +1,88 @@
+#pragma once
+
+#include "HashCalculator.h"
+#include "FileScanner.h"
+#include "DirectoryDigest.h"
+
+#include <filesystem>
+#include <functional>
+#include <stop_token>
+#include <vector>
+#include <cstdint>
+
+namespace fs = std::filesystem;
+
+class ScanJournal;
+class FileFilter;
+
+// The scan, hash and grouping stages as one call, for programs that link libdupefind instead of running the console
+// tool and parsing its logs. Results are handed out through callbacks as each stage produces them.
+
+// How the scan and hash stages run: blocking loops on per-device reader pools, or coroutines on an I/O completion port
+enum class ExecutionEngine
+{
+    Threads,
+    Coroutines
+};
+
+struct EngineLimits
+{
+    size_t maxEntries = 0;     // files and folders found before the scan stops, 0 for no limit
+    uint64_t maxBytesRead = 0; // bytes read before hashing stops, 0 for no limit
+    unsigned threads = 0;      // coroutine engine threads, 0 for one per logical processor
+};
+
+struct EngineOptions
+{
+    std::vector<fs::path> roots;
+    ExecutionEngine engine = ExecutionEngine::Threads;
+
+    // Reader counts, read order and files in flight are set here. showProgress and onMessage are ignored; progress and
+    // messages go to the callbacks.
+    HashOptions hashOptions;
+    EngineLimits limits;
+
+    const FileFilter* filter = nullptr; // the built-in skip rules if not given
+    ScanJournal* journal = nullptr;     // opened by the caller, if the run should be resumable
+};
+
+enum class EngineStage
+{
+    Scanning,
+    Hashing
+};
+
+struct EngineProgress
+{
+    EngineStage stage = EngineStage::Scanning;
+    size_t done = 0;  // roots scanned, or files hashed
+    size_t total = 0;
+    uint64_t bytesRead = 0;
+};
+
+// Every callback may be left empty. onEntry and the scanning progress run on the calling thread once a root is
+// scanned; onGroup and the hashing progress run on reader threads, like a DuplicateGroupHandler.
+// onMessage gets the status and error lines the console tool would print, from any thread; left empty, they are
+// dropped. The journal, the filter and a ThrottleMonitor are made by the caller and report to the handler they were
+// given, so to keep the console quiet, give each of them one as well.
+// Setting onDirectoryGroup groups whole folders as well. A folder's digest needs every file under it, so then all
+// groups come on the calling thread after hashing: identical folders first, then the file groups outside them.
+struct EngineCallbacks
+{
+    std::function<void(const fs::path& path, const ScanNode& node)> onEntry;
+    DuplicateGroupHandler onGroup;
+    std::function<void(DirectoryGroup&& group)> onDirectoryGroup;
+    std::function<void(const EngineProgress& progress)> onProgress;
+    MessageHandler onMessage;
+};
+
+enum class EngineResult
+{
+    Completed,
+    Cancelled,    // stop was requested through the token
+    LimitReached  // a limit ended the run early; the groups reported so far are still correct
+};
+
+// Blocks until the run is finished or stopped. Stopping is cooperative: the scan stops before its next directory
+// and hashing before its next file, and no group with a file left unread is reported.
+EngineResult findDuplicates(const EngineOptions& options, const EngineCallbacks& callbacks, std::stop_token stopToken = {});
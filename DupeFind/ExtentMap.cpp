@@ -0,0 +1,248 @@
+#include "ExtentMap.h"
+
+#include <vector>
+#include <algorithm>
+
+#define WIN32_LEAN_AND_MEAN
+#include <Windows.h>
+#include <winioctl.h>
+
+#ifndef FILE_SUPPORTS_BLOCK_REFCOUNTING
+#define FILE_SUPPORTS_BLOCK_REFCOUNTING 0x08000000
+#endif
+
+void queryAllocatedRanges(void* fileHandle, uint64_t fileSize, std::vector<AllocatedRange>& ranges)
+{
+    ranges.clear();
+    auto wholeFile = [&]()
+    {
+        ranges.clear();
+        ranges.push_back({ 0, fileSize });
+    };
+
+    BY_HANDLE_FILE_INFORMATION fileInfo;
+    if (!GetFileInformationByHandle(fileHandle, &fileInfo) || !(fileInfo.dwFileAttributes & FILE_ATTRIBUTE_SPARSE_FILE))
+    {
+        wholeFile();
+        return;
+    }
+
+    FILE_ALLOCATED_RANGE_BUFFER query;
+    query.FileOffset.QuadPart = 0;
+    query.Length.QuadPart = static_cast<LONGLONG>(fileSize);
+
+    FILE_ALLOCATED_RANGE_BUFFER results[64];
+    while (true)
+    {
+        DWORD bytesReturned = 0;
+        BOOL ok = DeviceIoControl(fileHandle, FSCTL_QUERY_ALLOCATED_RANGES, &query, sizeof(query), results, sizeof(results), &bytesReturned, nullptr);
+        DWORD error = ok ? ERROR_SUCCESS : GetLastError();
+
+        if (!ok && error != ERROR_MORE_DATA)
+        {
+            wholeFile();
+            return;
+        }
+
+        DWORD count = bytesReturned / sizeof(FILE_ALLOCATED_RANGE_BUFFER);
+        for (DWORD i = 0; i < count; ++i)
+        {
+            ranges.push_back({ static_cast<uint64_t>(results[i].FileOffset.QuadPart), static_cast<uint64_t>(results[i].Length.QuadPart) });
+        }
+
+        if (ok || count == 0) break;
+
+        // Continue after the last range we received
+        const auto& last = results[count - 1];
+        query.FileOffset.QuadPart = last.FileOffset.QuadPart + last.Length.QuadPart;
+        query.Length.QuadPart = static_cast<LONGLONG>(fileSize) - query.FileOffset.QuadPart;
+    }
+
+}
+
+FileExtentMap queryPhysicalExtents(const fs::path& filePath, uint64_t clusterSize)
+{
+    FileExtentMap extentMap;
+
+    HANDLE hFile = CreateFileW(filePath.c_str(), FILE_READ_ATTRIBUTES, FILE_SHARE_READ | FILE_SHARE_WRITE, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (hFile == INVALID_HANDLE_VALUE) return extentMap;
+
+    BY_HANDLE_FILE_INFORMATION fileInfo;
+    if (!GetFileInformationByHandle(hFile, &fileInfo))
+    {
+        CloseHandle(hFile);
+        return extentMap;
+    }
+    extentMap.volumeSerial = fileInfo.dwVolumeSerialNumber;
+
+    STARTING_VCN_INPUT_BUFFER query;
+    query.StartingVcn.QuadPart = 0;
+
+    const DWORD BUFFER_SIZE = 16 * 1024;
+    std::vector<BYTE> buffer(BUFFER_SIZE);
+    bool complete = false;
+
+    while (true)
+    {
+        DWORD bytesReturned = 0;
+        BOOL ok = DeviceIoControl(hFile, FSCTL_GET_RETRIEVAL_POINTERS, &query, sizeof(query), buffer.data(), BUFFER_SIZE, &bytesReturned, nullptr);
+        DWORD error = ok ? ERROR_SUCCESS : GetLastError();
+
+        if (!ok && error != ERROR_MORE_DATA) break; // Resident (tiny) files and unsupported filesystems end up here
+
+        const auto* pointers = reinterpret_cast<const RETRIEVAL_POINTERS_BUFFER*>(buffer.data());
+        LONGLONG fileCluster = pointers->StartingVcn.QuadPart;
+
+        for (DWORD i = 0; i < pointers->ExtentCount; ++i)
+        {
+            LONGLONG nextCluster = pointers->Extents[i].NextVcn.QuadPart;
+            LONGLONG volumeCluster = pointers->Extents[i].Lcn.QuadPart;
+
+            if (volumeCluster != -1) // -1 marks a sparse hole
+            {
+                extentMap.extents.push_back({ static_cast<uint64_t>(fileCluster), static_cast<uint64_t>(volumeCluster), static_cast<uint64_t>(nextCluster - fileCluster) });
+            }
+            fileCluster = nextCluster;
+        }
+
+        if (ok)
+        {
+            complete = true;
+            break;
+        }
+        if (pointers->ExtentCount == 0) break;
+
+        query.StartingVcn.QuadPart = fileCluster;
+    }
+
+    CloseHandle(hFile);
+
+    if (complete)
+    {
+        extentMap.clusterSize = clusterSize > 0 ? clusterSize : volumeClusterSize(filePath);
+        extentMap.valid = extentMap.clusterSize > 0;
+    }
+
+    return extentMap;
+}
+
+PhysicalLocation queryPhysicalLocation(const fs::path& filePath)
+{
+    PhysicalLocation location;
+
+    HANDLE hFile = CreateFileW(filePath.c_str(), FILE_READ_ATTRIBUTES, FILE_SHARE_READ | FILE_SHARE_WRITE, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (hFile == INVALID_HANDLE_VALUE) return location;
+
+    BY_HANDLE_FILE_INFORMATION fileInfo;
+    if (GetFileInformationByHandle(hFile, &fileInfo))
+    {
+        location.fileIndex = (static_cast<uint64_t>(fileInfo.nFileIndexHigh) << 32) | fileInfo.nFileIndexLow;
+    }
+
+    STARTING_VCN_INPUT_BUFFER query;
+    query.StartingVcn.QuadPart = 0;
+
+    // Room for a handful of extents; ERROR_MORE_DATA just means the file has more than that
+    BYTE buffer[sizeof(RETRIEVAL_POINTERS_BUFFER) + 7 * 2 * sizeof(LARGE_INTEGER)];
+    DWORD bytesReturned = 0;
+    BOOL ok = DeviceIoControl(hFile, FSCTL_GET_RETRIEVAL_POINTERS, &query, sizeof(query), buffer, sizeof(buffer), &bytesReturned, nullptr);
+
+    if (ok || GetLastError() == ERROR_MORE_DATA)
+    {
+        const auto* pointers = reinterpret_cast<const RETRIEVAL_POINTERS_BUFFER*>(buffer);
+        LONGLONG fileCluster = pointers->StartingVcn.QuadPart;
+
+        for (DWORD i = 0; i < pointers->ExtentCount && bytesReturned >= sizeof(RETRIEVAL_POINTERS_BUFFER) + i * 2 * sizeof(LARGE_INTEGER); ++i)
+        {
+            LONGLONG nextCluster = pointers->Extents[i].NextVcn.QuadPart;
+            if (pointers->Extents[i].Lcn.QuadPart != -1) // the file may start with a sparse hole
+            {
+                location.hasCluster = true;
+                location.volumeCluster = static_cast<uint64_t>(pointers->Extents[i].Lcn.QuadPart);
+                location.clusterCount = static_cast<uint64_t>(nextCluster - fileCluster);
+                break;
+            }
+            fileCluster = nextCluster;
+        }
+    }
+
+    CloseHandle(hFile);
+    return location;
+}
+
+namespace
+{
+    uint64_t clusterSizeOfVolume(const std::wstring& volumePath)
+    {
+        DWORD sectorsPerCluster = 0, bytesPerSector = 0, freeClusters = 0, totalClusters = 0;
+        if (!GetDiskFreeSpaceW(volumePath.c_str(), &sectorsPerCluster, &bytesPerSector, &freeClusters, &totalClusters)) return 0;
+
+        return static_cast<uint64_t>(sectorsPerCluster) * bytesPerSector;
+    }
+}
+
+uint64_t volumeClusterSize(const fs::path& filePath)
+{
+    std::wstring volumePath = volumePathOf(filePath);
+    return volumePath.empty() ? 0 : clusterSizeOfVolume(volumePath);
+}
+
+std::wstring volumePathOf(const fs::path& filePath)
+{
+    wchar_t volumePath[MAX_PATH] = {};
+    if (!GetVolumePathNameW(filePath.c_str(), volumePath, MAX_PATH)) return {};
+    return volumePath;
+}
+
+VolumeBlockInfo queryVolumeBlockInfo(const std::wstring& volumePath)
+{
+    VolumeBlockInfo info;
+    if (volumePath.empty()) return info;
+
+    DWORD flags = 0;
+    if (GetVolumeInformationW(volumePath.c_str(), nullptr, 0, nullptr, nullptr, &flags, nullptr, 0))
+    {
+        info.sharesBlocks = (flags & FILE_SUPPORTS_BLOCK_REFCOUNTING) != 0;
+    }
+    info.clusterSize = clusterSizeOfVolume(volumePath);
+    return info;
+}
+
+uint64_t sharedPhysicalBytes(const FileExtentMap& first, const FileExtentMap& second)
+{
+    if (!first.valid || !second.valid || first.volumeSerial != second.volumeSerial) return 0;
+
+    auto byVolumeCluster = [](const PhysicalExtent& a, const PhysicalExtent& b) { return a.volumeCluster < b.volumeCluster; };
+
+    std::vector<PhysicalExtent> a = first.extents;
+    std::vector<PhysicalExtent> b = second.extents;
+    std::sort(a.begin(), a.end(), byVolumeCluster);
+    std::sort(b.begin(), b.end(), byVolumeCluster);
+
+    // Intersect the two sorted cluster run lists
+    uint64_t sharedClusters = 0;
+    size_t i = 0, j = 0;
+    while (i < a.size() && j < b.size())
+    {
+        uint64_t aEnd = a[i].volumeCluster + a[i].clusterCount;
+        uint64_t bEnd = b[j].volumeCluster + b[j].clusterCount;
+        uint64_t start = std::max<uint64_t>(a[i].volumeCluster, b[j].volumeCluster);
+        uint64_t end = std::min<uint64_t>(aEnd, bEnd);
+
+        if (end > start) sharedClusters += end - start;
+
+        if (aEnd < bEnd) ++i; else ++j;
+    }
+
+    return sharedClusters * first.clusterSize;
+}
+
+uint64_t allocatedPhysicalBytes(const FileExtentMap& extentMap)
+{
+    uint64_t clusters = 0;
+    for (const auto& extent : extentMap.extents)
+    {
+        clusters += extent.clusterCount;
+    }
+    return clusters * extentMap.clusterSize;
+}
@@ -0,0 +1,68 @@
+﻿#pragma once
+
+#include <filesystem>
+#include <string>
+#include <vector>
+#include <cstdint>
+
+namespace fs = std::filesystem;
+
+// A byte range of a file that is backed by storage. Everything outside these ranges is a hole that reads as zeros.
+struct AllocatedRange
+{
+    uint64_t offset = 0;
+    uint64_t length = 0;
+};
+
+// A run of clusters on the volume, in the order the file uses them
+struct PhysicalExtent
+{
+    uint64_t fileCluster = 0;
+    uint64_t volumeCluster = 0;
+    uint64_t clusterCount = 0;
+};
+
+// Where a file starts on its volume, the sort key for reading files in one sweep across the disk
+struct PhysicalLocation
+{
+    bool hasCluster = false;     // false for files stored inside the MFT and filesystems without retrieval pointers
+    uint64_t volumeCluster = 0;  // first allocated cluster
+    uint64_t clusterCount = 0;   // length of the first extent
+    uint64_t fileIndex = 0;      // MFT record number, the fallback key when there is no cluster
+};
+
+struct FileExtentMap
+{
+    bool valid = false;
+    uint32_t volumeSerial = 0;
+    uint64_t clusterSize = 0;
+    std::vector<PhysicalExtent> extents;
+};
+
+// Allocated ranges of an open file. Gives a single range covering the file if it is not sparse or the query fails.
+// ranges is cleared first, so a caller can pass the same vector for every file and keep its capacity.
+void queryAllocatedRanges(void* fileHandle, uint64_t fileSize, std::vector<AllocatedRange>& ranges);
+
+// Physical extents of a file on its volume. Holes are not included. clusterSize, if known, saves looking it up.
+FileExtentMap queryPhysicalExtents(const fs::path& filePath, uint64_t clusterSize = 0);
+
+// Number of bytes two files have in common on disk (e.g. after block cloning on ReFS).
+uint64_t sharedPhysicalBytes(const FileExtentMap& first, const FileExtentMap& second);
+
+// First extent and file index of a file. Cheaper than queryPhysicalExtents as only one extent is requested.
+PhysicalLocation queryPhysicalLocation(const fs::path& filePath);
+
+uint64_t volumeClusterSize(const fs::path& filePath);
+
+// Root of the volume holding a path, e.g. C:\ or a mount point folder; empty if it cannot be found
+std::wstring volumePathOf(const fs::path& filePath);
+
+struct VolumeBlockInfo
+{
+    bool sharesBlocks = false; // the filesystem can block-clone (ReFS); copies anywhere else never share clusters
+    uint64_t clusterSize = 0;
+};
+
+VolumeBlockInfo queryVolumeBlockInfo(const std::wstring& volumePath);
+
+uint64_t allocatedPhysicalBytes(const FileExtentMap& extentMap);
@@ -0,0 +1,540 @@
+#include "FileFilter.h"
+#include "FileScanner.h"
+#include "Utilities.h"
+
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <cwctype>
+
+#define WIN32_LEAN_AND_MEAN
+#include <Windows.h>
+
+namespace
+{
+    const size_t MAX_GLOB_TOKENS = 63; // one bit per token plus the start state must fit in 64 bits
+
+    wchar_t foldCase(wchar_t c)
+    {
+        if (c < 128)
+        {
+            return (c >= L'A' && c <= L'Z') ? static_cast<wchar_t>(c + (L'a' - L'A')) : c;
+        }
+        return static_cast<wchar_t>(std::towlower(c));
+    }
+
+    bool isSeparator(wchar_t c)
+    {
+        return c == L'\\' || c == L'/';
+    }
+
+    std::wstring_view fileNameOf(std::wstring_view path)
+    {
+        size_t pos = path.find_last_of(L"\\/");
+        return pos == std::wstring_view::npos ? path : path.substr(pos + 1);
+    }
+
+    // Same rule as fs::path::extension(): a leading dot (".gitignore") is not an extension
+    std::wstring_view extensionOf(std::wstring_view name)
+    {
+        size_t pos = name.find_last_of(L'.');
+        if (pos == std::wstring_view::npos || pos == 0 || name == L"..") return {};
+        return name.substr(pos);
+    }
+
+    bool equalsFolded(std::wstring_view a, std::wstring_view b)
+    {
+        if (a.size() != b.size()) return false;
+        for (size_t i = 0; i < a.size(); ++i)
+        {
+            if (foldCase(a[i]) != foldCase(b[i])) return false;
+        }
+        return true;
+    }
+
+    // Whether path is prefix itself or lies below it. prefix is stored folded and without a trailing separator.
+    bool isUnder(std::wstring_view path, std::wstring_view prefix)
+    {
+        if (path.size() < prefix.size()) return false;
+        for (size_t i = 0; i < prefix.size(); ++i)
+        {
+            wchar_t c = foldCase(path[i]);
+            if (c == L'/') c = L'\\';
+            if (c != prefix[i]) return false;
+        }
+        return path.size() == prefix.size() || isSeparator(path[prefix.size()]);
+    }
+
+    // Folded, backslash separated and without trailing separators, the form isUnder() expects for prefixes
+    std::wstring normalizedPrefix(std::wstring_view path)
+    {
+        std::wstring prefix(path);
+        for (auto& c : prefix)
+        {
+            c = (c == L'/') ? L'\\' : foldCase(c);
+        }
+        while (!prefix.empty() && prefix.back() == L'\\') prefix.pop_back();
+        return prefix;
+    }
+
+    uint32_t hashFolded(std::wstring_view text, uint32_t seed)
+    {
+        uint32_t hash = 2166136261u ^ seed; // FNV-1a
+        for (wchar_t c : text)
+        {
+            hash ^= static_cast<uint32_t>(foldCase(c));
+            hash *= 16777619u;
+        }
+        return hash ^ (hash >> 15);
+    }
+
+    std::wstring_view trim(std::wstring_view text)
+    {
+        size_t start = text.find_first_not_of(L" \t\r\n");
+        if (start == std::wstring_view::npos) return {};
+        size_t end = text.find_last_not_of(L" \t\r\n");
+        return text.substr(start, end - start + 1);
+    }
+
+    // Splits off the first whitespace separated word
+    std::wstring_view takeWord(std::wstring_view& text)
+    {
+        text = trim(text);
+        size_t end = text.find_first_of(L" \t");
+        std::wstring_view word = text.substr(0, end);
+        text = end == std::wstring_view::npos ? std::wstring_view() : trim(text.substr(end));
+        return word;
+    }
+
+    std::wstring foldedCopy(std::wstring_view text)
+    {
+        std::wstring result(text);
+        std::transform(result.begin(), result.end(), result.begin(), foldCase);
+        return result;
+    }
+
+    bool parseSize(std::wstring_view text, uintmax_t& size)
+    {
+        std::wstring value = foldedCopy(trim(text));
+        size_t unitStart = value.find_first_not_of(L"0123456789.");
+        std::wstring unit = unitStart == std::wstring::npos ? L"" : std::wstring(trim(std::wstring_view(value).substr(unitStart)));
+
+        double number = 0;
+        try
+        {
+            number = std::stod(value.substr(0, unitStart));
+        }
+        catch (const std::exception&)
+        {
+            return false;
+        }
+
+        const std::wstring units[] = { L"b", L"kb", L"mb", L"gb", L"tb" };
+        double multiplier = 1;
+        bool knownUnit = unit.empty();
+        for (const auto& candidate : units)
+        {
+            if (unit == candidate)
+            {
+                knownUnit = true;
+                break;
+            }
+            multiplier *= 1024;
+        }
+        if (!knownUnit) return false;
+        if (unit.empty()) multiplier = 1;
+
+        size = static_cast<uintmax_t>(number * multiplier);
+        return true;
+    }
+}
+
+void FileFilter::ExtensionTable::build(std::vector<std::wstring> extensions)
+{
+    for (auto& extension : extensions)
+    {
+        extension = foldedCopy(extension);
+    }
+    std::sort(extensions.begin(), extensions.end());
+    extensions.erase(std::unique(extensions.begin(), extensions.end()), extensions.end());
+
+    slots.clear();
+    if (extensions.empty()) return;
+
+    // Search for a seed that maps every extension to its own slot, growing the table if none is found quickly
+    size_t tableSize = 8;
+    while (tableSize < extensions.size() * 2) tableSize *= 2;
+
+    while (true)
+    {
+        for (uint32_t candidate = 1; candidate <= 1000; ++candidate)
+        {
+            std::vector<std::wstring> table(tableSize);
+            bool collision = false;
+
+            for (const auto& extension : extensions)
+            {
+                auto& slot = table[hashFolded(extension, candidate) & (tableSize - 1)];
+                if (!slot.empty())
+                {
+                    collision = true;
+                    break;
+                }
+                slot = extension;
+            }
+
+            if (!collision)
+            {
+                seed = candidate;
+                slots = std::move(table);
+                return;
+            }
+        }
+        tableSize *= 2;
+    }
+}
+
+bool FileFilter::ExtensionTable::contains(std::wstring_view extension) const
+{
+    if (slots.empty() || extension.empty()) return false;
+
+    const std::wstring& slot = slots[hashFolded(extension, seed) & (slots.size() - 1)];
+    return equalsFolded(slot, extension);
+}
+
+bool FileFilter::GlobMatcher::compile(std::wstring_view pattern, GlobMatcher& matcher)
+{
+    matcher = GlobMatcher();
+    size_t tokenCount = 0;
+
+    for (size_t i = 0; i < pattern.size(); ++i)
+    {
+        wchar_t c = pattern[i];
+
+        if (c == L'*')
+        {
+            matcher.selfLoopMask |= 1ull << tokenCount;
+            continue;
+        }
+
+        if (++tokenCount > MAX_GLOB_TOKENS) return false;
+        const uint64_t bit = 1ull << tokenCount;
+
+        if (c == L'?')
+        {
+            for (auto& mask : matcher.asciiMasks) mask |= bit;
+            matcher.anyCharMask |= bit;
+            continue;
+        }
+
+        size_t classEnd = c == L'[' ? pattern.find(L']', i + 2) : std::wstring_view::npos;
+        if (classEnd == std::wstring_view::npos)
+        {
+            wchar_t folded = foldCase(c);
+            if (folded < 128) matcher.asciiMasks[folded] |= bit;
+            else matcher.wideLiterals.push_back({ folded, bit });
+            continue;
+        }
+
+        // Character class: [abc], [a-z], [!abc]
+        std::wstring_view members = pattern.substr(i + 1, classEnd - i - 1);
+        bool negated = !members.empty() && (members[0] == L'!' || members[0] == L'^');
+        if (negated) members.remove_prefix(1);
+
+        bool asciiMembers[128] = {};
+        for (size_t m = 0; m < members.size(); ++m)
+        {
+            wchar_t low = foldCase(members[m]);
+            wchar_t high = low;
+            if (m + 2 < members.size() && members[m + 1] == L'-')
+            {
+                high = foldCase(members[m + 2]);
+                m += 2;
+            }
+
+            for (wchar_t member = low; member <= high && member < 128; ++member)
+            {
+                asciiMembers[member] = true;
+            }
+            if (!negated && high >= 128)
+            {
+                for (wchar_t member = std::max<wchar_t>(low, 128); member <= high && member != 0; ++member)
+                {
+                    matcher.wideLiterals.push_back({ member, bit });
+                }
+            }
+        }
+
+        for (size_t ascii = 0; ascii < 128; ++ascii)
+        {
+            if (asciiMembers[ascii] != negated) matcher.asciiMasks[ascii] |= bit;
+        }
+        if (negated) matcher.anyCharMask |= bit; // non-ASCII characters are never in a negated ASCII class
+
+        i = classEnd;
+    }
+
+    matcher.acceptMask = 1ull << tokenCount;
+    return true;
+}
+
+bool FileFilter::GlobMatcher::matches(std::wstring_view name) const
+{
+    uint64_t state = 1; // start state: nothing matched yet
+
+    for (wchar_t c : name)
+    {
+        wchar_t folded = foldCase(c);
+        uint64_t mask;
+
+        if (folded < 128)
+        {
+            mask = asciiMasks[folded];
+        }
+        else
+        {
+            mask = anyCharMask;
+            for (const auto& [literal, bit] : wideLiterals)
+            {
+                if (literal == folded) mask |= bit;
+            }
+        }
+
+        state = ((state << 1) & mask) | (state & selfLoopMask);
+        if (state == 0) return false;
+    }
+
+    return (state & acceptMask) != 0;
+}
+
+FileFilter::FileFilter() = default;
+
+const std::wstring& FileFilter::defaultRules()
+{
+    static const std::wstring rules =
+        L"# Default DupeFind filter rules\n"
+        L"exclude ext .sys .log .tmp .bak .swp .dll\n"
+        L"# Used by Windows to store folder view settings\n"
+        L"exclude glob desktop.ini\n";
+    return rules;
+}
+
+FileFilter FileFilter::compile(const std::wstring& rulesText, const MessageHandler* onMessage)
+{
+    FileFilter filter;
+    std::vector<std::wstring> excluded;
+    std::vector<std::wstring> included;
+
+    std::wstring_view remaining(rulesText);
+    size_t lineNumber = 0;
+    while (!remaining.empty())
+    {
+        size_t lineEnd = remaining.find(L'\n');
+        std::wstring_view line = trim(remaining.substr(0, lineEnd));
+        remaining = lineEnd == std::wstring_view::npos ? std::wstring_view() : remaining.substr(lineEnd + 1);
+        ++lineNumber;
+
+        if (line.empty() || line[0] == L'#') continue;
+
+        // Extensions are collected first and compiled into their hash tables at the end
+        std::wstring_view rest = line;
+        std::wstring_view action = takeWord(rest);
+        std::wstring_view kind = takeWord(rest);
+        if (equalsFolded(kind, L"ext") && (equalsFolded(action, L"exclude") || equalsFolded(action, L"include")))
+        {
+            auto& target = equalsFolded(action, L"exclude") ? excluded : included;
+            while (!rest.empty())
+            {
+                std::wstring_view extension = takeWord(rest);
+                target.push_back(extension[0] == L'.' ? std::wstring(extension) : L"." + std::wstring(extension));
+            }
+            continue;
+        }
+
+        if (!filter.parseLine(line))
+        {
+            printMessage(onMessage, L"Warning: Ignoring invalid filter rule on line ", std::to_wstring(lineNumber), L": ", std::wstring(line));
+        }
+    }
+
+    filter.excludedExtensions.build(std::move(excluded));
+    filter.includedExtensions.build(std::move(included));
+    return filter;
+}
+
+bool FileFilter::parseLine(std::wstring_view line)
+{
+    std::wstring_view rest = line;
+    std::wstring_view action = takeWord(rest);
+    std::wstring_view kind = takeWord(rest);
+
+    bool exclude = equalsFolded(action, L"exclude");
+    if ((!exclude && !equalsFolded(action, L"include")) || rest.empty()) return false;
+
+    if (equalsFolded(kind, L"glob"))
+    {
+        GlobMatcher matcher;
+        if (!GlobMatcher::compile(rest, matcher)) return false;
+        (exclude ? excludedGlobs : includedGlobs).push_back(matcher);
+        return true;
+    }
+
+    if (equalsFolded(kind, L"path"))
+    {
+        std::wstring prefix = normalizedPrefix(rest);
+        if (prefix.empty()) return false;
+
+        (exclude ? excludedPaths : includedPaths).push_back(prefix);
+        return true;
+    }
+
+    if (equalsFolded(kind, L"size"))
+    {
+        SizeRange range;
+        size_t dash = rest.find(L'-');
+
+        if (dash == std::wstring_view::npos)
+        {
+            if (!parseSize(rest, range.minSize)) return false;
+            range.maxSize = range.minSize + 1; // a single value means exactly this size
+        }
+        else
+        {
+            std::wstring_view low = trim(rest.substr(0, dash));
+            std::wstring_view high = trim(rest.substr(dash + 1));
+            if (!low.empty() && !parseSize(low, range.minSize)) return false;
+            if (!high.empty() && !parseSize(high, range.maxSize)) return false;
+        }
+
+        (exclude ? excludedSizes : includedSizes).push_back(range);
+        return true;
+    }
+
+    return false;
+}
+
+bool FileFilter::shouldPruneDirectory(std::wstring_view directoryPath) const
+{
+    std::wstring_view name = fileNameOf(directoryPath);
+
+    // The Recycle Bin and System Volume Information are never scanned
+    if (equalsFolded(name, L"$recycle.bin") || equalsFolded(name, L"system volume information")) return true;
+
+    for (const auto& prefix : excludedPaths)
+    {
+        if (isUnder(directoryPath, prefix)) return true;
+    }
+
+    if (!includedPaths.empty())
+    {
+        // Keep directories inside an included subtree and the ones on the way down to it
+        bool onIncludedPath = false;
+        for (const auto& prefix : includedPaths)
+        {
+            if (isUnder(directoryPath, prefix) || isUnder(prefix, normalizedPrefix(directoryPath)))
+            {
+                onIncludedPath = true;
+                break;
+            }
+        }
+        if (!onIncludedPath) return true;
+    }
+
+    for (const auto& glob : excludedGlobs)
+    {
+        if (glob.matches(name)) return true;
+    }
+
+    // Hidden, system and encrypted attributes are checked file by file, so a hidden folder such as AppData is still
+    // scanned and only its hidden or system files are skipped. A folder is left out by its attributes only if it is
+    // a junction or another reparse point.
+    return isReparsePoint(fs::path(directoryPath));
+}
+
+bool FileFilter::shouldSkipFile(std::wstring_view filePath, uintmax_t fileSize) const
+{
+    std::wstring_view name = fileNameOf(filePath);
+    std::wstring_view extension = extensionOf(name);
+
+    if (excludedExtensions.contains(extension)) return true;
+    if (!includedExtensions.empty() && !includedExtensions.contains(extension)) return true;
+
+    for (const auto& range : excludedSizes)
+    {
+        if (fileSize >= range.minSize && fileSize < range.maxSize) return true;
+    }
+    if (!includedSizes.empty() && std::none_of(includedSizes.begin(), includedSizes.end(),
+        [fileSize](const SizeRange& range) { return fileSize >= range.minSize && fileSize < range.maxSize; }))
+    {
+        return true;
+    }
+
+    for (const auto& glob : excludedGlobs)
+    {
+        if (glob.matches(name)) return true;
+    }
+    if (!includedGlobs.empty() && std::none_of(includedGlobs.begin(), includedGlobs.end(),
+        [name](const GlobMatcher& glob) { return glob.matches(name); }))
+    {
+        return true;
+    }
+
+    for (const auto& prefix : excludedPaths)
+    {
+        if (isUnder(filePath, prefix)) return true;
+    }
+    if (!includedPaths.empty() && std::none_of(includedPaths.begin(), includedPaths.end(),
+        [filePath](const std::wstring& prefix) { return isUnder(filePath, prefix); }))
+    {
+        return true;
+    }
+
+    // Only now pay for a filesystem call
+    return isSystemOrEncryptedFile(fs::path(filePath));
+}
+
+FileFilter loadFileFilter(const fs::path& rulesFile, const MessageHandler* onMessage)
+{
+    std::error_code ec;
+    if (!fs::exists(rulesFile, ec))
+    {
+        return FileFilter::compile(FileFilter::defaultRules());
+    }
+
+    HANDLE hFile = CreateFileW(rulesFile.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (hFile == INVALID_HANDLE_VALUE)
+    {
+        printMessage(onMessage, L"Warning: Could not read filter rules from ", rulesFile.wstring(), L", using the default rules.");
+        return FileFilter::compile(FileFilter::defaultRules());
+    }
+
+    std::string bytes;
+    char buffer[4096];
+    DWORD bytesRead = 0;
+    while (ReadFile(hFile, buffer, sizeof(buffer), &bytesRead, NULL) && bytesRead > 0)
+    {
+        bytes.append(buffer, bytesRead);
+    }
+    CloseHandle(hFile);
+
+    // Accept UTF-16 (as written by Notepad or our own log functions) and UTF-8 with or without BOM
+    std::wstring rulesText;
+    if (bytes.size() >= 2 && static_cast<unsigned char>(bytes[0]) == 0xFF && static_cast<unsigned char>(bytes[1]) == 0xFE)
+    {
+        rulesText.assign(reinterpret_cast<const wchar_t*>(bytes.data() + 2), (bytes.size() - 2) / sizeof(wchar_t));
+    }
+    else
+    {
+        if (bytes.size() >= 3 && bytes.compare(0, 3, "\xEF\xBB\xBF") == 0) bytes.erase(0, 3);
+        rulesText = utf8ToWstring(bytes);
+    }
+
+    printMessage(onMessage, L"Using filter rules from: ", rulesFile.wstring());
+    return FileFilter::compile(rulesText, onMessage);
+}
+
+const FileFilter& defaultFileFilter()
+{
+    static const FileFilter filter = FileFilter::compile(FileFilter::defaultRules());
+    return filter;
+}
@@ -0,0 +1,89 @@
+#pragma once
+
+#include <filesystem>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <cstdint>
+
+#include "Utilities.h"
+
+namespace fs = std::filesystem;
+
+// Include/exclude rules compiled once into a matcher the scanner can run on every entry without allocating.
+//
+// Rule file syntax, one rule per line ('#' starts a comment):
+//   exclude ext .log .tmp        extensions, case-insensitive
+//   include ext .jpg .png        if present, only files with these extensions are scanned
+//   exclude glob desktop.ini     globs (*, ?, [abc]) on the file or directory name
+//   include glob IMG_*           if present, only files whose name matches are scanned
+//   exclude path C:\Windows      prunes everything below this path
+//   include path D:\Photos       if present, only these subtrees are scanned
+//   exclude size 0-4KB           sizes in B/KB/MB/GB/TB, either bound may be left out (e.g. 2GB-)
+//   include size 1MB-            if present, only files inside one of these ranges are scanned
+class FileFilter
+{
+public:
+    FileFilter();
+
+    // Compiles rule text. Invalid lines are reported and ignored.
+    static FileFilter compile(const std::wstring& rulesText, const MessageHandler* onMessage = nullptr);
+
+    // Rules DupeFind uses when no rule file is given
+    static const std::wstring& defaultRules();
+
+    // Whether a directory and everything below it can be skipped without listing it
+    bool shouldPruneDirectory(std::wstring_view directoryPath) const;
+
+    // Whether a file is skipped. The cheap rules run first, file attributes are only read if they all pass.
+    bool shouldSkipFile(std::wstring_view filePath, uintmax_t fileSize) const;
+
+    bool hasSizeRules() const { return !excludedSizes.empty() || !includedSizes.empty(); }
+
+private:
+    struct ExtensionTable
+    {
+        uint32_t seed = 0;
+        std::vector<std::wstring> slots; // power-of-two sized, at most one extension per slot
+
+        void build(std::vector<std::wstring> extensions);
+        bool contains(std::wstring_view extension) const;
+        bool empty() const { return slots.empty(); }
+    };
+
+    struct GlobMatcher
+    {
+        // Bit-parallel NFA: bit j is "the first j tokens matched"
+        uint64_t asciiMasks[128] = {};
+        uint64_t anyCharMask = 0;                                        // '?' tokens and negated classes
+        std::vector<std::pair<wchar_t, uint64_t>> wideLiterals;          // literal tokens outside ASCII
+        uint64_t selfLoopMask = 0;                                       // states followed by '*'
+        uint64_t acceptMask = 0;
+
+        static bool compile(std::wstring_view pattern, GlobMatcher& matcher);
+        bool matches(std::wstring_view name) const;
+    };
+
+    struct SizeRange
+    {
+        uintmax_t minSize = 0;
+        uintmax_t maxSize = UINTMAX_MAX;
+    };
+
+    bool parseLine(std::wstring_view line);
+
+    ExtensionTable excludedExtensions;
+    ExtensionTable includedExtensions;
+    std::vector<GlobMatcher> excludedGlobs;
+    std::vector<GlobMatcher> includedGlobs;
+    std::vector<std::wstring> excludedPaths;
+    std::vector<std::wstring> includedPaths;
+    std::vector<SizeRange> excludedSizes;
+    std::vector<SizeRange> includedSizes;
+};
+
+// Loads rules from a file, or returns the default rules if the file does not exist. Which rules are used and any
+// invalid lines are reported to onMessage, or the console without one.
+FileFilter loadFileFilter(const fs::path& rulesFile, const MessageHandler* onMessage = nullptr);
+
+const FileFilter& defaultFileFilter();
@@ -0,0 +1,45 @@
+#include "FileFingerprint.h"
+#include "Throttle.h"
+
+#define WIN32_LEAN_AND_MEAN
+#include <Windows.h>
+
+bool queryFileFingerprint(void* handle, FileFingerprint& fingerprint)
+{
+    BY_HANDLE_FILE_INFORMATION info;
+    FILE_BASIC_INFO basic;
+    if (!GetFileInformationByHandle(handle, &info) || !GetFileInformationByHandleEx(handle, FileBasicInfo, &basic, sizeof(basic)))
+    {
+        return false;
+    }
+
+    fingerprint.size = static_cast<uint64_t>(info.nFileSizeHigh) << 32 | info.nFileSizeLow;
+    fingerprint.writeTime = basic.LastWriteTime.QuadPart;
+    fingerprint.changeTime = basic.ChangeTime.QuadPart;
+    fingerprint.volumeSerial = info.dwVolumeSerialNumber;
+    fingerprint.fileIndex = static_cast<uint64_t>(info.nFileIndexHigh) << 32 | info.nFileIndexLow;
+    return true;
+}
+
+bool queryFileFingerprint(const fs::path& filePath, FileFingerprint& fingerprint)
+{
+    ioThrottle().beforeMetadata();
+    HANDLE hFile = CreateFileW(filePath.c_str(), FILE_READ_ATTRIBUTES, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, nullptr, OPEN_EXISTING,
+        FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (hFile == INVALID_HANDLE_VALUE) return false;
+
+    bool ok = queryFileFingerprint(hFile, fingerprint);
+    CloseHandle(hFile);
+    return ok;
+}
+
+bool fingerprintsMatch(const FileFingerprint& recorded, const FileFingerprint& current)
+{
+    auto same = [](auto a, auto b) { return a == 0 || a == b; };
+
+    return recorded.size == current.size
+        && same(recorded.writeTime, current.writeTime)
+        && same(recorded.changeTime, current.changeTime)
+        && same(recorded.volumeSerial, current.volumeSerial)
+        && same(recorded.fileIndex, current.fileIndex);
+}
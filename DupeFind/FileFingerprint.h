@@ -0,0 +1,30 @@
+#pragma once
+
+#include <filesystem>
+#include <cstdint>
+
+namespace fs = std::filesystem;
+
+// What a file looked like when its contents were read for hashing. If it still looks the same when it is about to
+// be removed, its digest is trusted; if not, the file has to be read again. The change time also moves on renames,
+// attribute and permission changes, so a mismatch means "look again", not "different contents".
+//
+// Times are FILETIME ticks, the unit of fs::file_time_type on Windows. Zero means not recorded (groups formed from
+// a scan listing or a snapshot only know size and write time), and is not compared.
+struct FileFingerprint
+{
+    uint64_t size = 0;
+    int64_t writeTime = 0;
+    int64_t changeTime = 0;
+    uint64_t volumeSerial = 0;
+    uint64_t fileIndex = 0;  // identity on the volume, changes when the file is replaced by another one
+};
+
+// From an open handle, so the fingerprint belongs to exactly the file that is read through it
+bool queryFileFingerprint(void* handle, FileFingerprint& fingerprint);
+
+// Opens the file for its attributes only, without read access or a sharing conflict
+bool queryFileFingerprint(const fs::path& filePath, FileFingerprint& fingerprint);
+
+// Compares the fields recorded in both; size always counts
+bool fingerprintsMatch(const FileFingerprint& recorded, const FileFingerprint& current);
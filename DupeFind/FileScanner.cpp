@@ -1,17 +1,22 @@
 ﻿#include "FileScanner.h"
 #include "Utilities.h" 
+#include "ScanJournal.h"
+#include "FileFilter.h"
+#include "Async.h"
+#include "Throttle.h"
 
 #include <filesystem>
 #include <vector>
 #include <string>
 #include <algorithm>
-#include <unordered_set>
+#include <atomic>
+#include <iterator>
 
 #define WIN32_LEAN_AND_MEAN
 #include <Windows.h>
 
 
-fs::path convertToPath(const std::wstring& input)
+fs::path convertToPath(const std::wstring& input, const MessageHandler* onMessage)
 {
     try
     {
@@ -19,12 +24,12 @@ fs::path convertToPath(const std::wstring& input)
 
         if (!fs::exists(pathObj))
         {
-            printUnicodeMulti(true, L"Error: Path does not exist: ", pathObj.wstring());
+            printMessage(onMessage, L"Error: Path does not exist: ", pathObj.wstring());
             return {};
         }
         if (!fs::is_directory(pathObj))
         {
-            printUnicodeMulti(true, L"Error: Path is not a directory: ", pathObj.wstring());
+            printMessage(onMessage, L"Error: Path is not a directory: ", pathObj.wstring());
             return {};
         }
 
@@ -34,72 +39,309 @@ fs::path convertToPath(const std::wstring& input)
 
     catch (const fs::filesystem_error& exception)
     {
-        printUnicodeMulti(true,
-            L"Filesystem error: ",
-            utf8ToWstring(exception.what()),
-            L"\nFailed on path: ",
-            exception.path1().wstring());
+        printMessage(onMessage, L"Filesystem error: ", errorMessage(exception));
 
 		return {};
     }
     catch (const std::exception& exception)
     {
-        printUnicodeMulti(true, L"Error: ", utf8ToWstring(exception.what()));
+        printMessage(onMessage, L"Error: ", errorMessage(exception));
         return {};
     }
 }
 
-std::vector<fs::path> getAllFilesAndDirectories(const fs::path& folderPath)
+namespace
 {
-    std::vector<fs::path> results;
+    // Lists one directory and records it in the journal once the listing is complete. Directories already
+    // in the journal are not listed again. Skipped entries are only reported while quiet is not set.
+    // whole is cleared if anything in the directory was left out: filtered, skipped over an error or lost to a
+    // failed listing.
+    std::vector<JournalEntry> listDirectory(const fs::path& directory, const FileFilter& filter, ScanJournal* journal, bool quiet,
+        const MessageHandler* onMessage, bool& whole)
+    {
+        std::vector<JournalEntry> entries;
+        const std::vector<JournalEntry>* recorded = journal ? journal->findDirectory(directory) : nullptr;
 
-    try {
-        for (auto it = fs::recursive_directory_iterator(folderPath, fs::directory_options::skip_permission_denied); it != fs::recursive_directory_iterator(); ++it)
+        // Only whole listings are recorded, so a recorded one needs no flag of its own
+        whole = true;
+        if (recorded)
         {
-            try
-            {
-                std::wstring dirName = it->path().filename().wstring();
-                std::transform(dirName.begin(), dirName.end(), dirName.begin(), ::tolower);
+            return *recorded;
+        }
 
-                if (dirName == L"$recycle.bin" || dirName == L"system volume information")
-                {
-                    it.disable_recursion_pending(); // Skip the Recycle Bin directory and System Volume Information
-                    continue;
-                }
+        bool listingComplete = true;
 
-                if (shouldSkipFile(it->path()))
+        // One operation per listing: the entries arrive in batches with their sizes and times, not one call each
+        ioThrottle().beforeMetadata();
+
+        try
+        {
+            for (const auto& entry : fs::directory_iterator(directory, fs::directory_options::skip_permission_denied))
+            {
+                try
                 {
-                    // Reduces console spam
-                    if (results.size() < 1000)
+                    bool isDirectory = entry.is_directory() && !entry.is_symlink();
+                    const std::wstring fullPath = entry.path().wstring();
+
+                    // The size comes with the directory listing, so keeping it costs no extra call
+                    std::error_code sizeError;
+                    uint64_t size = isDirectory ? 0 : entry.file_size(sizeError);
+                    if (sizeError) size = 0;
+
+                    // Links to folders, broken links and devices have no contents to compare, and neither has a file
+                    // whose size could not be read. Leaving them out here lets the hash stage take every listed file
+                    // at its listed size without asking again.
+                    std::error_code typeError;
+                    if (!isDirectory && (sizeError || !entry.is_regular_file(typeError)))
                     {
-                        printUnicodeMulti(true, L"Skipping system file: ", it->path().filename().wstring());
+                        whole = false;
+                        if (!quiet)
+                        {
+                            printMessage(onMessage, L"Skipping file: ", entry.path().filename().wstring());
+                        }
+                        continue;
                     }
+
+                    // So is the write time, which lets a saved scan tell changed files apart later
+                    std::error_code timeError;
+                    int64_t writeTime = isDirectory ? 0 : entry.last_write_time(timeError).time_since_epoch().count();
+                    if (timeError) writeTime = 0;
+
+                    // Pruned directories are never listed, so nothing below them costs anything
+                    bool skip = isDirectory
+                        ? filter.shouldPruneDirectory(fullPath)
+                        : filter.shouldSkipFile(fullPath, size);
+
+                    if (skip)
+                    {
+                        whole = false;
+
+                        // Reduces console spam
+                        if (!quiet)
+                        {
+                            printMessage(onMessage, isDirectory ? L"Skipping directory: " : L"Skipping file: ", entry.path().filename().wstring());
+                        }
+                        continue;
+                    }
+
+                    entries.push_back({ entry.path().filename().wstring(), isDirectory, size, writeTime });
+                }
+                catch (const std::system_error& ex)
+                {
+                    printMessage(onMessage, L"Failed to process: ", entry.path().wstring());
+                    printMessage(onMessage, L"Error processing entry: ", errorMessage(ex));
+                    whole = false;
+
                     continue;
                 }
+            }
+        }
+        catch (const fs::filesystem_error& ex)
+        {
+            printMessage(onMessage, L"Error accessing directory: ", errorMessage(ex));
+            listingComplete = false;
+            whole = false;
+        }
+
+        // An incomplete listing is not checkpointed, so a resumed run lists the directory again. Neither is one with
+        // entries left out, whose folder must not look whole when the run resumes.
+        if (journal && listingComplete && whole)
+        {
+            journal->recordDirectory(directory, entries);
+        }
+
+        return entries;
+    }
+
+    // Checked before each directory is listed and, in the blocking scan, before each entry is added
+    bool scanShouldStop(ScanControl* control, size_t found)
+    {
+        if (!control) return false;
+
+        if (control->maxEntries > 0 && found >= control->maxEntries)
+        {
+            control->limitReached = true;
+            control->stopped = true;
+        }
+        else if (control->stopToken.stop_requested())
+        {
+            control->stopped = true;
+        }
+        return control->stopped;
+    }
+
+    ScanNode nodeFor(const JournalEntry& entry, uint32_t parent, uint32_t depth)
+    {
+        ScanNode node;
+        node.size = entry.size;
+        node.writeTime = entry.writeTime;
+        node.parent = parent;
+        node.depth = depth;
+        node.isDirectory = entry.isDirectory;
+        return node;
+    }
+
+    // Lists a directory, then descends into its subdirectories. parent is the directory's own index in the
+    // results and depth the depth of its entries.
+    void scanDirectory(const fs::path& directory, std::vector<fs::path>& results, std::vector<ScanNode>* nodes,
+        uint32_t parent, uint32_t depth, const FileFilter& filter, ScanJournal* journal, ScanControl* control)
+    {
+        // A directory the scan stops in has not been seen whole
+        const bool hasNode = nodes && parent != NO_PARENT;
+        if (scanShouldStop(control, results.size()))
+        {
+            if (hasNode) (*nodes)[parent].complete = false;
+            return;
+        }
+
+        bool whole = true;
+        std::vector<JournalEntry> entries = listDirectory(directory, filter, journal, results.size() >= 1000, control ? &control->onMessage : nullptr, whole);
+        if (hasNode) (*nodes)[parent].complete = whole;
+
+        for (const auto& entry : entries)
+        {
+            if (scanShouldStop(control, results.size()))
+            {
+                if (hasNode) (*nodes)[parent].complete = false;
+                return;
+            }
+
+            fs::path entryPath = directory / entry.name;
+            uint32_t index = static_cast<uint32_t>(results.size());
+            results.push_back(entryPath);
+            if (nodes) nodes->push_back(nodeFor(entry, parent, depth));
+
+            if (entry.isDirectory)
+            {
+                scanDirectory(entryPath, results, nodes, index, depth + 1, filter, journal, control);
+            }
+        }
+    }
+
+    struct ScannedTree
+    {
+        std::vector<fs::path> paths;
+        std::vector<ScanNode> nodes; // parents index into this subtree, NO_PARENT for the directory's own entries
+        bool complete = false;       // for the directory's own node: listed with nothing left out
+    };
 
-                results.push_back(it->path());
+    // The same traversal as a coroutine: every subdirectory is listed concurrently on the executor's threads,
+    // and the results are stitched together in the order scanDirectory would have produced them
+    Task<ScannedTree> scanDirectoryAsync(IoExecutor& executor, fs::path directory, uint32_t depth, const FileFilter& filter, ScanJournal* journal,
+        std::atomic<size_t>& found, ScanControl* control)
+    {
+        co_await executor.schedule();
+
+        if (scanShouldStop(control, found.load(std::memory_order_relaxed))) co_return ScannedTree();
+
+        ScannedTree tree;
+        std::vector<JournalEntry> entries = listDirectory(directory, filter, journal, found.load(std::memory_order_relaxed) >= 1000,
+            control ? &control->onMessage : nullptr, tree.complete);
+        found += entries.size();
+
+        std::vector<Task<ScannedTree>> subdirectories;
+        for (const auto& entry : entries)
+        {
+            if (entry.isDirectory)
+            {
+                subdirectories.push_back(scanDirectoryAsync(executor, directory / entry.name, depth + 1, filter, journal, found, control));
             }
-            catch (const std::system_error& ex) 
+        }
+        std::vector<ScannedTree> below = co_await whenAll(executor, std::move(subdirectories));
+
+        size_t next = 0;
+        for (const auto& entry : entries)
+        {
+            uint32_t index = static_cast<uint32_t>(tree.paths.size());
+            tree.paths.push_back(directory / entry.name);
+            tree.nodes.push_back(nodeFor(entry, NO_PARENT, depth));
+
+            if (entry.isDirectory)
             {
-                printUnicodeMulti(true, L"Failed to process: ", it->path().wstring());
-                printUnicodeMulti(true, L"Error processing entry: ", utf8ToWstring(ex.what()));
+                // The subtree's indexes were relative to itself; its top entries belong to this directory
+                ScannedTree& subtree = below[next++];
+                tree.nodes.back().complete = subtree.complete;
+                uint32_t offset = static_cast<uint32_t>(tree.paths.size());
+                for (ScanNode& node : subtree.nodes)
+                {
+                    node.parent = node.parent == NO_PARENT ? index : node.parent + offset;
+                }
 
-                continue;
+                tree.paths.insert(tree.paths.end(), std::make_move_iterator(subtree.paths.begin()), std::make_move_iterator(subtree.paths.end()));
+                tree.nodes.insert(tree.nodes.end(), subtree.nodes.begin(), subtree.nodes.end());
             }
         }
+        co_return tree;
     }
-    catch (const fs::filesystem_error& ex) 
+}
+
+std::vector<fs::path> getAllFilesAndDirectories(const fs::path& folderPath, ScanJournal* journal, const FileFilter* filter, IoExecutor* executor, std::vector<ScanNode>* nodes,
+    ScanControl* control)
+{
+    std::vector<fs::path> results;
+    const FileFilter& activeFilter = filter ? *filter : defaultFileFilter();
+
+    if (nodes) nodes->clear();
+
+    if (executor)
     {
-        printUnicodeMulti(true, L"Error accessing directory: ", utf8ToWstring(ex.what()));
+        std::atomic<size_t> found{ 0 };
+        ScannedTree tree = runBlocking(*executor, scanDirectoryAsync(*executor, folderPath, 1, activeFilter, journal, found, control));
+        results = std::move(tree.paths);
+        if (nodes) *nodes = std::move(tree.nodes);
+
+        // Directories listed concurrently can overshoot the limit. Parents come before their entries, so cutting the
+        // depth-first order short leaves every kept parent index valid.
+        if (control && control->maxEntries > 0 && results.size() > control->maxEntries)
+        {
+            // The folders the cut runs through lose entries, and they are the ones holding the first entry cut off
+            if (nodes)
+            {
+                for (uint32_t parent = (*nodes)[control->maxEntries].parent; parent != NO_PARENT; parent = (*nodes)[parent].parent)
+                {
+                    (*nodes)[parent].complete = false;
+                }
+            }
+            results.resize(control->maxEntries);
+            if (nodes) nodes->resize(control->maxEntries);
+            control->limitReached = true;
+            control->stopped = true;
+        }
+    }
+    else
+    {
+        scanDirectory(folderPath, results, nodes, NO_PARENT, 1, activeFilter, journal, control);
+    }
+
+    if (journal)
+    {
+        journal->checkpoint();
     }
 
     return results;
 }
 
+bool anySizeShared(const std::vector<ScanNode>& nodes)
+{
+    std::vector<uint64_t> sizes;
+    for (const auto& node : nodes)
+    {
+        if (!node.isDirectory) sizes.push_back(node.size);
+    }
+    std::sort(sizes.begin(), sizes.end());
+    return std::adjacent_find(sizes.begin(), sizes.end()) != sizes.end();
+}
+
+bool isReparsePoint(const fs::path& path)
+{
+    DWORD attributes = GetFileAttributesW(path.c_str());
+    return attributes != INVALID_FILE_ATTRIBUTES && (attributes & FILE_ATTRIBUTE_REPARSE_POINT) != 0;
+}
+
 bool isSystemOrEncryptedFile(const fs::path& filePath)
 {
 
-    DWORD attributes = GetFileAttributesW(filePath.wstring().c_str());
+    DWORD attributes = GetFileAttributesW(filePath.c_str());
 
     if (attributes == INVALID_FILE_ATTRIBUTES)
     {
@@ -116,25 +358,10 @@ bool isSystemOrEncryptedFile(const fs::path& filePath)
 
 bool shouldSkipFile(const fs::path& filePath)
 {
-    std::wstring fileName = filePath.filename().wstring();
-    std::transform(fileName.begin(), fileName.end(), fileName.begin(), ::tolower);
+    const FileFilter& filter = defaultFileFilter();
 
-    std::wstring ext = filePath.extension().wstring();
-    std::transform(ext.begin(), ext.end(), ext.begin(), ::towlower);
+    std::error_code ec;
+    uintmax_t fileSize = filter.hasSizeRules() ? fs::file_size(filePath, ec) : 0;
 
-    static const std::unordered_set<std::wstring> skippedExtensions = 
-    {
-        L".sys", L".log", L".tmp", L".bak", L".swp", L".dll"
-    };
-
-	if (skippedExtensions.count(ext)) return true; // Skip files with these extensions
-    if (isSystemOrEncryptedFile(filePath)) return true;
-
-    // Skip desktop.ini files, which are used by Windows to store folder view settings
-    if (fileName == L"desktop.ini")
-    {
-        return true;
-    }
-
-    return false;
+    return filter.shouldSkipFile(filePath.wstring(), fileSize);
 }
@@ -3,14 +3,59 @@
 #include <filesystem>
 #include <vector>
 #include <string>
+#include <cstdint>
+#include <atomic>
+#include <stop_token>
+
+#include "Utilities.h"
 
 
 namespace fs = std::filesystem;
 
-fs::path convertToPath(const std::wstring& input);
+class ScanJournal;
+class FileFilter;
+class IoExecutor;
+
+fs::path convertToPath(const std::wstring& input, const MessageHandler* onMessage = nullptr);
+
+const uint32_t NO_PARENT = UINT32_MAX;
+
+// What the scanner saw of one returned path, so later stages need not ask the filesystem again
+struct ScanNode
+{
+    uint64_t size = 0;              // files only, as listed
+    int64_t writeTime = 0;          // files only, last write time as listed (file_time_type ticks)
+    uint32_t parent = NO_PARENT;    // index of the containing directory in the results, NO_PARENT directly under the scanned folder
+    uint32_t depth = 1;             // 1 directly under the scanned folder
+    bool isDirectory = false;
+    bool complete = true;           // folders only: listed with nothing inside filtered, skipped or left unlisted
+};
+
+// Lets a caller end a scan early, on request or once maxEntries files and folders are found. Directories are not
+// listed once it stops, so the result is a depth-first prefix of the full one; stopped tells the caller it is partial.
+struct ScanControl
+{
+    std::stop_token stopToken;
+    size_t maxEntries = 0; // 0 for no limit
 
-std::vector<fs::path> getAllFilesAndDirectories(const fs::path& folderPath);
+    // Gets the skipped-entry and listing error lines instead of the console, from the executor's threads too
+    MessageHandler onMessage;
+
+    std::atomic<bool> stopped{ false };
+    std::atomic<bool> limitReached{ false };
+};
+
+// Paths come out depth-first, each directory followed by its contents. With an executor, directories are listed
+// by coroutines on its threads; the result is in the same order either way. nodes, if given, gets one entry per path.
+std::vector<fs::path> getAllFilesAndDirectories(const fs::path& folderPath, ScanJournal* journal = nullptr, const FileFilter* filter = nullptr,
+    IoExecutor* executor = nullptr, std::vector<ScanNode>* nodes = nullptr, ScanControl* control = nullptr);
 
 bool shouldSkipFile(const fs::path& filePath);
 
-bool isSystemOrEncryptedFile(const fs::path& filePath);
\ No newline at end of file
+// True if at least two scanned files share a size; otherwise there cannot be any duplicates
+bool anySizeShared(const std::vector<ScanNode>& nodes);
+
+bool isSystemOrEncryptedFile(const fs::path& filePath);
+
+// Junctions, mount points and links: a folder that is one is never walked into, so a scan cannot loop or leave its tree
+bool isReparsePoint(const fs::path& path);
\ No newline at end of file
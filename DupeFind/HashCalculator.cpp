@@ -1,166 +1,1137 @@
 ﻿#include "HashCalculator.h"
 #include "Utilities.h"
+#include "ScanJournal.h"
+#include "ExtentMap.h"
+#include "SortGrouping.h"
+#include "DigestIndex.h"
+#include "Throttle.h"
+#include "FileScanner.h"
 
 #include <iostream>
 #include <fstream>
-#include <sstream>
-#include <iomanip>
 #include <vector>
+#include <algorithm>
+#include <chrono>
+#include <atomic>
+#include <unordered_map>
+#include <memory>
+#include <mutex>
+#include <cstring>
 
 #define WIN32_LEAN_AND_MEAN
 #include <Windows.h>
-#include <wincrypt.h>
+#include <bcrypt.h>
 
-std::string calculateSHA256(const fs::path& filePath)  
-{  
-    if (!fs::exists(filePath)) return "empty_file";  
+// Linked from here so programs using the library need no extra linker input
+#pragma comment(lib, "bcrypt.lib")
 
-	printUnicodeMulti(true, L"Calculating hash for file: ", filePath.wstring());
+namespace
+{
+    std::atomic<uint64_t> hashContexts{ 0 };
+
+    // Opened on first use and kept for the life of the process. CNG lets threads share an algorithm handle,
+    // and the reusable flag lets a hash object start over after each finish instead of being recreated.
+    BCRYPT_ALG_HANDLE sha256Algorithm()
+    {
+        static BCRYPT_ALG_HANDLE algorithm = []
+        {
+            BCRYPT_ALG_HANDLE handle = nullptr;
+            // A failure shows up as a hasher that cannot begin, which the caller reports where its lines go
+            if (!BCRYPT_SUCCESS(BCryptOpenAlgorithmProvider(&handle, BCRYPT_SHA256_ALGORITHM, nullptr, BCRYPT_HASH_REUSABLE_FLAG)))
+            {
+                handle = nullptr;
+            }
+            return handle;
+        }();
+        return algorithm;
+    }
+}
+
+Sha256Hasher::Sha256Hasher()
+{
+    BCRYPT_ALG_HANDLE algorithm = sha256Algorithm();
+    if (!algorithm) return;
+
+    DWORD objectLength = 0;
+    ULONG written = 0;
+    bool fits = BCRYPT_SUCCESS(BCryptGetProperty(algorithm, BCRYPT_OBJECT_LENGTH, reinterpret_cast<PUCHAR>(&objectLength), sizeof(objectLength), &written, 0))
+        && objectLength <= sizeof(hashObject);
+
+    BCRYPT_HASH_HANDLE handle = nullptr;
+    if (BCRYPT_SUCCESS(BCryptCreateHash(algorithm, &handle, fits ? hashObject : nullptr, fits ? objectLength : 0, nullptr, 0, BCRYPT_HASH_REUSABLE_FLAG)))
+    {
+        hash = handle;
+        hashContexts.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+Sha256Hasher::~Sha256Hasher()
+{
+    if (hash) BCryptDestroyHash(hash);
+}
+
+bool Sha256Hasher::begin()
+{
+    if (!hash) return false;
+
+    // A digest abandoned halfway is finished into scratch, which resets the reusable object
+    if (pending)
+    {
+        Sha256Digest scratch;
+        finish(scratch);
+    }
+    return true;
+}
+
+bool Sha256Hasher::update(const void* data, size_t length)
+{
+    PUCHAR bytes = static_cast<PUCHAR>(const_cast<void*>(data));
+    pending = true;
 
-    HANDLE hFile = CreateFileW(  
-        filePath.wstring().c_str(),
-        GENERIC_READ,  
-        FILE_SHARE_READ,  
-        NULL,  
-        OPEN_EXISTING,  
-        FILE_ATTRIBUTE_NORMAL || FILE_FLAG_SEQUENTIAL_SCAN,
-        NULL);  
+    while (length > 0)
+    {
+        ULONG count = static_cast<ULONG>(std::min<size_t>(length, 1u << 30));
+        if (!hash || !BCRYPT_SUCCESS(BCryptHashData(hash, bytes, count, 0)))
+        {
+            return false;
+        }
+        bytes += count;
+        length -= count;
+    }
+
+    return true;
+}
+
+bool Sha256Hasher::finish(Sha256Digest& digest)
+{
+    pending = false;
+    return hash && BCRYPT_SUCCESS(BCryptFinishHash(hash, digest.data(), static_cast<ULONG>(digest.size()), 0));
+}
+
+uint64_t Sha256Hasher::contextCount()
+{
+    return hashContexts.load(std::memory_order_relaxed);
+}
+
+bool calculateSHA256(const fs::path& filePath, Sha256Digest& digest, ReadPolicy policy, ReadStats* stats, FileFingerprint* fingerprint,
+    const MessageHandler* onMessage)
+{
+    HANDLE hFile = openForRead(filePath, policy);
 
     if (hFile == INVALID_HANDLE_VALUE)  
     {  
 		DWORD error = GetLastError();
 		std::wstring wsError = std::to_wstring(error);
 
-		printUnicodeMulti(true, L"Error opening file: ", filePath.wstring(), L" (Error code: ", wsError, L")");
-        return {};  
+		printMessage(onMessage, L"Error opening file: ", filePath.wstring(), L" (Error code: ", wsError, L")");
+        return false;
     }  
 
     LARGE_INTEGER fileSizeLI;
     if (!GetFileSizeEx(hFile, &fileSizeLI))
     {
-		printUnicodeMulti(true, L"Error getting file size: ", filePath.wstring());
+		printMessage(onMessage, L"Error getting file size: ", filePath.wstring());
         CloseHandle(hFile);
-        return {};
+        return false;
     }
 
-    // Check if the file is empty  
-    if (fileSizeLI.QuadPart == 0)  
-    {  
-        CloseHandle(hFile);  
-        return "empty_file";  
-    }  
+    if (fingerprint)
+    {
+        queryFileFingerprint(hFile, *fingerprint);
+    }
 
-    if (fileSizeLI.QuadPart > 2LL * 1024 * 1024 * 1024) // 2GB limit hack  
-    {  
-		printUnicodeMulti(true, L"Skipping large file (>2GB): ", filePath.wstring());
-        CloseHandle(hFile);  
-        return {};  
-    }  
+    // Kept per reader thread, so only a thread's first file pays for them
+    const size_t BUFFER_SIZE = 65536; // 64 KB buffer  
+    thread_local Sha256Hasher hasher;
+    thread_local ReadBuffer buffer(BUFFER_SIZE);
+    thread_local std::vector<AllocatedRange> ranges;
+    static const std::vector<BYTE> zeroRun(BUFFER_SIZE, 0);
+    DWORD bytesRead = 0;  
 
-    HCRYPTPROV hProv = NULL; // Cryptographic provider handle  
-    HCRYPTHASH hHash = NULL; // Hash handle  
-    const DWORD HASH_LENGTH = 32; // 256 bits = 32 bytes  
-    BYTE rgbHash[HASH_LENGTH];  
-    DWORD cbHash = HASH_LENGTH;  
+    if (!hasher.begin())
+    {
+        printMessage(onMessage, L"Error: Could not create a SHA-256 hash object.");
+        CloseHandle(hFile);
+        return false;
+    }
 
-    // Acquire a cryptographic provider context  
-    if (!CryptAcquireContext(&hProv, NULL, NULL, PROV_RSA_AES, CRYPT_VERIFYCONTEXT))  
-    {  
-        std::wcerr << L"Error: CryptAcquireContext failed." << std::endl;  
-        CloseHandle(hFile);  
-        return {};  
-    }  
+    // Unbuffered reads must start and end on sector boundaries; the extra bytes are read but not hashed
+    const uint64_t alignment = readAlignment(hFile, policy);
+    ScopedReadCachePriority cachePriority(policy);
 
-    // Create a hash object for SHA-256  
-    if (!CryptCreateHash(hProv, CALG_SHA_256, 0, 0, &hHash))  
-    {  
-        std::wcerr << L"Error: CryptCreateHash failed." << std::endl;  
-        CryptReleaseContext(hProv, 0);  
-        CloseHandle(hFile);  
-        return {};  
-    }  
+    const uint64_t fileSize = static_cast<uint64_t>(fileSizeLI.QuadPart);
+    uint64_t position = 0;
+    bool hashFailed = false;
+    bool readFailed = false;
 
-    const size_t BUFFER_SIZE = 65536; // 64 KB buffer  
-    std::vector<BYTE> buffer(BUFFER_SIZE);  
-    DWORD bytesRead = 0;  
+    // Holes in sparse files read as zeros, so they are hashed from a zero buffer instead of being read from disk.
+    // The digest is the same as for a fully allocated copy of the file.
+    auto hashZeros = [&](uint64_t endOffset)
+    {
+        while (!hashFailed && position < endOffset)
+        {
+            DWORD count = static_cast<DWORD>(std::min<uint64_t>(BUFFER_SIZE, endOffset - position));
+            hashFailed = !hasher.update(zeroRun.data(), count);
+            position += count;
+        }
+    };
 
-    while (ReadFile(hFile, buffer.data(), BUFFER_SIZE, &bytesRead, NULL) && bytesRead > 0)  
-    {  
-        if (!CryptHashData(hHash, buffer.data(), bytesRead, 0))  
-        {  
-            std::wcerr << L"Error: CryptHashData failed." << std::endl;  
-            CryptDestroyHash(hHash);  
-            CryptReleaseContext(hProv, 0);  
-            CloseHandle(hFile);  
-            return {};  
-        }  
-    }  
+    queryAllocatedRanges(hFile, fileSize, ranges);
+    for (const auto& range : ranges)
+    {
+        uint64_t rangeEnd = std::min<uint64_t>(range.offset + range.length, fileSize);
+        if (range.offset >= rangeEnd) continue;
 
-    if (!CryptGetHashParam(hHash, HP_HASHVAL, rgbHash, &cbHash, 0))  
-    {  
-        std::wcerr << L"Error: CryptGetHashParam failed." << std::endl;  
-        CryptDestroyHash(hHash);  
-        CryptReleaseContext(hProv, 0);  
-        CloseHandle(hFile);  
-        return {};  
-    }  
+        hashZeros(range.offset);
 
-    CryptDestroyHash(hHash);  
-    CryptReleaseContext(hProv, 0);  
-    CloseHandle(hFile);  
+        LARGE_INTEGER seekTo;
+        seekTo.QuadPart = static_cast<LONGLONG>(range.offset - range.offset % alignment);
+        uint64_t skipBytes = range.offset % alignment;
+        if (!hashFailed && !SetFilePointerEx(hFile, seekTo, nullptr, FILE_BEGIN))
+        {
+            readFailed = true;
+        }
 
-    std::ostringstream oss;  
-    for (DWORD i = 0; i < cbHash; ++i)
-    {  
-        oss << std::hex << std::setw(2) << std::setfill('0') << static_cast<int>(rgbHash[i]);  
-    }  
+        while (!hashFailed && !readFailed && position < rangeEnd)
+        {
+            uint64_t wanted = std::min<uint64_t>(BUFFER_SIZE - skipBytes, rangeEnd - position);
+            uint64_t alignedLength = (skipBytes + wanted + alignment - 1) / alignment * alignment;
+            DWORD toRead = static_cast<DWORD>(std::min<uint64_t>(BUFFER_SIZE, alignedLength));
+
+            ioThrottle().beforeRead(toRead);
+            if (!ReadFile(hFile, buffer.data(), toRead, &bytesRead, NULL) || bytesRead <= skipBytes)
+            {
+                readFailed = true; // the file shrank or became unreadable while hashing
+                break;
+            }
+
+            DWORD usable = static_cast<DWORD>(std::min<uint64_t>(bytesRead - skipBytes, wanted));
+            hashFailed = !hasher.update(buffer.data() + skipBytes, usable);
+            position += usable;
+            skipBytes = 0;
 
-    return oss.str();  
+            if (stats) stats->bytesRead += bytesRead;
+        }
+
+        if (hashFailed || readFailed) break;
+    }
+
+    hashZeros(fileSize);
+    CloseHandle(hFile);
+
+    if (hashFailed || readFailed)
+    {
+        if (hashFailed)
+        {
+            printMessage(onMessage, L"Error: BCryptHashData failed.");
+        }
+        else
+        {
+            printMessage(onMessage, L"Error reading file: ", filePath.wstring());
+        }
+        return false;
+    }
+
+    if (!hasher.finish(digest))
+    {
+        printMessage(onMessage, L"Error: BCryptFinishHash failed.");
+        return false;
+    }
+
+    if (stats) stats->filesRead++;
+    return true;
 }
 
-std::map<std::string, std::vector<fs::path>> groupFilesByHash(const std::vector<fs::path>& files)
+namespace
 {
-    std::map<std::string, std::vector<fs::path>> hashGroups;
-    size_t processedFiles = 0;
-    size_t totalFiles = 0;
+    // A head rounded up to whole sectors, as large as the blocking reads, which also assume no sector is larger
+    const size_t HEAD_READ_BUFFER_SIZE = 65536;
+
+    // Shared by the blocking and the overlapped head reads, so a pass allocates one per file in flight, not per file
+    ReadBufferPool headReadBuffers(HEAD_READ_BUFFER_SIZE);
+}
+
+bool calculateHeadDigest(const fs::path& filePath, uint64_t& headDigest, ReadPolicy policy, ReadStats* stats)
+{
+    HANDLE hFile = openForRead(filePath, policy);
+    if (hFile == INVALID_HANDLE_VALUE) return false;
+
+    // Unbuffered reads need whole sectors; a short file just returns fewer bytes
+    const size_t alignment = readAlignment(hFile, policy);
+    const size_t readLength = std::min<size_t>((HEAD_DIGEST_BYTES + alignment - 1) / alignment * alignment, HEAD_READ_BUFFER_SIZE);
+    ReadBufferPool::Lease buffer = headReadBuffers.acquire();
+
+    DWORD bytesRead = 0;
+    ioThrottle().beforeRead(readLength);
+    bool ok = ReadFile(hFile, buffer.data(), static_cast<DWORD>(readLength), &bytesRead, NULL) != FALSE;
+    CloseHandle(hFile);
+    if (!ok) return false;
+
+    if (stats) stats->bytesRead += bytesRead;
+
+    thread_local Sha256Hasher hasher; // one provider per reader thread instead of one per file
+    Sha256Digest digest;
+    if (!hasher.begin() || !hasher.update(buffer.data(), std::min<size_t>(bytesRead, HEAD_DIGEST_BYTES)) || !hasher.finish(digest)) return false;
+
+    headDigest = 0;
+    for (size_t i = 0; i < sizeof(headDigest); ++i)
+    {
+        headDigest = (headDigest << 8) | digest[i];
+    }
+    return true;
+}
+
+namespace
+{
+    // Larger than the blocking reads: with hundreds of files in flight, fewer and bigger requests keep the number
+    // of completions down
+    const uint32_t ASYNC_READ_SIZE = 256 * 1024;
+
+    // Coroutines move between threads, so their read buffers come from a shared pool instead of a thread_local
+    ReadBufferPool asyncReadBuffers(ASYNC_READ_SIZE);
+
+    // The same goes for hashers, whose state lives across the awaits of one file: a pass creates one hash object per
+    // file in flight, not one per file
+    class HasherPool
+    {
+    public:
+        class Lease
+        {
+        public:
+            explicit Lease(HasherPool& pool) : pool(pool), hasher(pool.take()) {}
+            ~Lease() { pool.give(std::move(hasher)); }
+
+            Lease(const Lease&) = delete;
+            Lease& operator=(const Lease&) = delete;
+
+            Sha256Hasher* operator->() const { return hasher.get(); }
+
+        private:
+            HasherPool& pool;
+            std::unique_ptr<Sha256Hasher> hasher;
+        };
+
+    private:
+        std::unique_ptr<Sha256Hasher> take()
+        {
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                if (!idle.empty())
+                {
+                    std::unique_ptr<Sha256Hasher> hasher = std::move(idle.back());
+                    idle.pop_back();
+                    return hasher;
+                }
+            }
+            return std::make_unique<Sha256Hasher>();
+        }
+
+        void give(std::unique_ptr<Sha256Hasher> hasher)
+        {
+            if (!hasher->isValid()) return;
+            std::lock_guard<std::mutex> lock(mutex);
+            idle.push_back(std::move(hasher));
+        }
+
+        std::mutex mutex;
+        std::vector<std::unique_ptr<Sha256Hasher>> idle;
+    };
+
+    HasherPool asyncHashers;
+}
+
+Task<std::optional<Sha256Digest>> calculateSHA256Async(IoExecutor& executor, fs::path filePath, ReadPolicy policy, ReadStats* stats, FileFingerprint* fingerprint,
+    const MessageHandler* onMessage)
+{
+    HANDLE hFile = openForRead(filePath, policy, true);
+    if (hFile == INVALID_HANDLE_VALUE)
+    {
+        DWORD error = GetLastError();
+        printMessage(onMessage, L"Error opening file: ", filePath.wstring(), L" (Error code: ", std::to_wstring(error), L")");
+        co_return std::nullopt;
+    }
+
+    LARGE_INTEGER fileSizeLI;
+    if (!GetFileSizeEx(hFile, &fileSizeLI))
+    {
+        printMessage(onMessage, L"Error getting file size: ", filePath.wstring());
+        CloseHandle(hFile);
+        co_return std::nullopt;
+    }
+
+    if (fingerprint)
+    {
+        queryFileFingerprint(hFile, *fingerprint);
+    }
+
+    HasherPool::Lease hasher(asyncHashers);
+    if (!executor.associate(hFile) || !hasher->begin())
+    {
+        CloseHandle(hFile);
+        co_return std::nullopt;
+    }
+
+    // Every read starts at a multiple of the buffer size, which is a multiple of any sector size, so this also works
+    // unbuffered. Holes in sparse files are read as zeros rather than skipped: asking for the allocated ranges would
+    // take its own overlapped request, and the digest is the same either way.
+    const uint64_t fileSize = static_cast<uint64_t>(fileSizeLI.QuadPart);
+    ReadBufferPool::Lease buffer = asyncReadBuffers.acquire();
+    uint64_t position = 0;
+    bool failed = false;
+
+    while (!failed && position < fileSize)
+    {
+        ioThrottle().beforeRead(std::min<uint64_t>(ASYNC_READ_SIZE, fileSize - position));
+        IoResult result = co_await executor.read(hFile, position, buffer.data(), ASYNC_READ_SIZE);
+        if (result.error != 0 || result.bytesTransferred == 0)
+        {
+            failed = true; // the file shrank or became unreadable while hashing
+            break;
+        }
+
+        size_t usable = static_cast<size_t>(std::min<uint64_t>(result.bytesTransferred, fileSize - position));
+        failed = !hasher->update(buffer.data(), usable);
+        position += usable;
+
+        if (stats) stats->bytesRead += result.bytesTransferred;
+    }
+
+    CloseHandle(hFile);
+
+    Sha256Digest digest;
+    if (failed || !hasher->finish(digest))
+    {
+        printMessage(onMessage, L"Error reading file: ", filePath.wstring());
+        co_return std::nullopt;
+    }
+
+    if (stats) stats->filesRead++;
+    co_return digest;
+}
+
+Task<std::optional<uint64_t>> calculateHeadDigestAsync(IoExecutor& executor, fs::path filePath, ReadPolicy policy, ReadStats* stats)
+{
+    HANDLE hFile = openForRead(filePath, policy, true);
+    if (hFile == INVALID_HANDLE_VALUE) co_return std::nullopt;
+
+    if (!executor.associate(hFile))
+    {
+        CloseHandle(hFile);
+        co_return std::nullopt;
+    }
+
+    const size_t alignment = readAlignment(hFile, policy);
+    const size_t readLength = std::min<size_t>((HEAD_DIGEST_BYTES + alignment - 1) / alignment * alignment, HEAD_READ_BUFFER_SIZE);
+    ReadBufferPool::Lease buffer = headReadBuffers.acquire();
+
+    ioThrottle().beforeRead(readLength);
+    IoResult result = co_await executor.read(hFile, 0, buffer.data(), static_cast<uint32_t>(readLength));
+    CloseHandle(hFile);
+    if (result.error != 0) co_return std::nullopt;
+
+    if (stats) stats->bytesRead += result.bytesTransferred;
+
+    thread_local Sha256Hasher hasher; // nothing is awaited while it is in use, so coroutines on this thread can share it
+    Sha256Digest digest;
+    if (!hasher.begin() || !hasher.update(buffer.data(), std::min<size_t>(result.bytesTransferred, HEAD_DIGEST_BYTES)) || !hasher.finish(digest)) co_return std::nullopt;
+
+    uint64_t headDigest = 0;
+    for (size_t i = 0; i < sizeof(headDigest); ++i)
+    {
+        headDigest = (headDigest << 8) | digest[i];
+    }
+    co_return headDigest;
+}
+
+namespace
+{
+    // Formats into a buffer each thread keeps, so a progress line costs no allocation once the longest path has been shown
+    void printProgressLine(const MessageHandler* onMessage, size_t finished, size_t total, const fs::path& file)
+    {
+        thread_local std::wstring line;
+        wchar_t counts[64];
+        swprintf(counts, sizeof(counts) / sizeof(counts[0]), L"Progress: %zu/%zu - ", finished, total);
+        line.assign(counts);
+        line.append(file.native());
+        if (*onMessage) (*onMessage)(line);
+        else printUnicode(line, true);
+    }
+
+    // Small-file batches are closed once their slab reaches this, so one reader does not hold too many runs
+    const uint64_t SMALL_BATCH_BYTES = 1024 * 1024;
+
+    // SHA-256 of no input, which every zero-byte file has without being read
+    const Sha256Digest EMPTY_SHA256 = {
+        0xe3, 0xb0, 0xc4, 0x42, 0x98, 0xfc, 0x1c, 0x14, 0x9a, 0xfb, 0xf4, 0xc8, 0x99, 0x6f, 0xb9, 0x24,
+        0x27, 0xae, 0x41, 0xe4, 0x64, 0x9b, 0x93, 0x4c, 0xa4, 0x95, 0x99, 0x1b, 0x78, 0x52, 0xb8, 0x55 };
+
+    // Unbuffered reads need whole sectors, so with Direct every slot starts and ends on a multiple of any sector size in use
+    const size_t DIRECT_SLOT_ALIGNMENT = 4096;
+
+    // Sizes with more files than this take the digest path instead, so one slab stays a modest allocation
+    const size_t SMALL_RUN_SLAB_LIMIT = 64 * 1024 * 1024;
+
+    // Slab bytes all of a pass's coroutines may hold at once. Without it every size run in flight could hold a full slab.
+    const size_t SMALL_SLAB_BUDGET = 256 * 1024 * 1024;
+
+    // Bytes a small file takes in a slab. One more than the file, so a read that fills the slot shows it grew since it was listed.
+    size_t smallFileSlot(uint64_t size, ReadPolicy policy)
+    {
+        size_t slot = static_cast<size_t>(size) + 1;
+        if (policy == ReadPolicy::Direct) slot = (slot + DIRECT_SLOT_ALIGNMENT - 1) / DIRECT_SLOT_ALIGNMENT * DIRECT_SLOT_ALIGNMENT;
+        return slot;
+    }
+
+    bool readsWhole(uint64_t size, size_t fileCount, ReadPolicy policy)
+    {
+        return size > 0 && size <= SMALL_FILE_LIMIT && fileCount * smallFileSlot(size, policy) <= SMALL_RUN_SLAB_LIMIT;
+    }
+
+    // Reads a small file into its slot with a single call. False if it cannot be read or no longer has the listed size.
+    bool readSmallFile(const fs::path& filePath, uint64_t size, ReadPolicy policy, unsigned char* slot, size_t slotLength, ReadStats& stats,
+        FileFingerprint& fingerprint)
+    {
+        HANDLE hFile = openForRead(filePath, policy);
+        if (hFile == INVALID_HANDLE_VALUE) return false;
+
+        queryFileFingerprint(hFile, fingerprint);
+
+        DWORD bytesRead = 0;
+        ioThrottle().beforeRead(slotLength);
+        bool ok = ReadFile(hFile, slot, static_cast<DWORD>(slotLength), &bytesRead, NULL) != FALSE;
+        CloseHandle(hFile);
+        if (!ok) return false;
+
+        stats.bytesRead += bytesRead;
+        stats.filesRead++;
+        return bytesRead == size;
+    }
+
+    // Sorts the files of one size by their contents. Each set of equal contents gets the SHA-256 of those contents,
+    // computed once, so the group carries the same hash the digest path would give it. Unique contents get no hash.
+    void digestEqualContents(std::vector<std::pair<uint32_t, const unsigned char*>>& contents, size_t size, std::vector<std::optional<Sha256Digest>>& digests)
+    {
+        std::sort(contents.begin(), contents.end(), [size](const auto& a, const auto& b)
+        {
+            return std::memcmp(a.second, b.second, size) < 0;
+        });
+
+        thread_local Sha256Hasher hasher; // nothing is awaited while it is in use, so coroutines can share it too
+        for (size_t begin = 0, end = 0; begin < contents.size(); begin = end)
+        {
+            end = begin + 1;
+            while (end < contents.size() && std::memcmp(contents[begin].second, contents[end].second, size) == 0) ++end;
+            if (end - begin < 2) continue;
+
+            Sha256Digest digest;
+            if (!hasher.begin() || !hasher.update(contents[begin].second, size) || !hasher.finish(digest)) continue;
+
+            for (size_t i = begin; i < end; ++i)
+            {
+                digests[contents[i].first] = digest;
+            }
+        }
+    }
 
-    // Count regular files first
-    for (const auto& file : files)
+    // Reuses the digest from an interrupted run if the journal has one for the listed size and write time and the
+    // file still has them. Only a hit opens the file: the fingerprint taken to check is also the one removal compares.
+    bool digestFromJournal(const ScanJournal& journal, const fs::path& file, uint64_t size, int64_t writeTime, Sha256Digest& digest,
+        FileFingerprint& fingerprint)
     {
-        if (fs::is_regular_file(file)) totalFiles++;
+        if (!journal.findHash(file, size, writeTime, digest)) return false;
+        if (queryFileFingerprint(file, fingerprint) && fingerprint.size == size && fingerprint.writeTime == writeTime) return true;
+
+        fingerprint = {}; // read again below, which takes it afresh
+        return false;
     }
 
-    std::wcout << L"Processing " << totalFiles << L" files for duplicate detection..." << std::endl;
+    // State shared by the coroutines of one hashing pass
+    struct AsyncHashPass
+    {
+        AsyncHashPass(IoExecutor& executor, const HashOptions& options)
+            : executor(executor), options(options), filesInFlight(executor, options.filesInFlight), slabBytes(executor, SMALL_SLAB_BUDGET) {}
+
+        IoExecutor& executor;
+        const HashOptions& options;
+        AsyncLimiter filesInFlight;
+        AsyncLimiter slabBytes;
+
+        const std::vector<fs::path>* files = nullptr;
+        const std::vector<ScanNode>* nodes = nullptr;
+        const std::vector<GroupRecord>* candidates = nullptr;
+        const std::vector<RecordRun>* sizeRuns = nullptr;
+        std::vector<std::optional<Sha256Digest>>* digests = nullptr;
+        std::vector<FileFingerprint>* fingerprints = nullptr;
+        ScanJournal* journal = nullptr;
+        ReadStats* readStats = nullptr;
+        std::function<void(size_t)> resolveRun;
 
-    for (const auto& file : files)
+        size_t totalFiles = 0;
+        std::atomic<size_t> finishedFiles{ 0 };
+        std::atomic<size_t> nextRun{ 0 };
+        std::atomic<size_t> ruledOutByHead{ 0 };
+    };
+
+    void reportAsyncProgress(AsyncHashPass& pass, const fs::path& file)
     {
-        if (!fs::is_regular_file(file)) continue; // Skip directories and non-regular files
+        size_t finished = ++pass.finishedFiles;
+        if (pass.options.onProgress)
+        {
+            pass.options.onProgress(finished, pass.totalFiles, pass.readStats->bytesRead);
+        }
+        else if (pass.options.showProgress && (pass.totalFiles <= 100 || finished % 100 == 0)) // Show progress every 100 files
+        {
+            printProgressLine(&pass.options.onMessage, finished, pass.totalFiles, file);
+        }
+    }
+
+    Task<std::optional<uint64_t>> headOfCandidate(AsyncHashPass& pass, uint32_t entryIndex)
+    {
+        co_await pass.filesInFlight.acquire();
+        if (pass.options.stopToken.stop_requested())
+        {
+            pass.filesInFlight.release();
+            co_return std::nullopt;
+        }
+        std::optional<uint64_t> head = co_await calculateHeadDigestAsync(pass.executor, (*pass.files)[entryIndex], pass.options.readPolicy, pass.readStats);
+        pass.filesInFlight.release();
+        co_return head;
+    }
+
+    Task<std::optional<Sha256Digest>> digestOfCandidate(AsyncHashPass& pass, uint32_t entryIndex, uint64_t size)
+    {
+        const fs::path& file = (*pass.files)[entryIndex];
+
+        co_await pass.filesInFlight.acquire();
+        reportAsyncProgress(pass, file);
+
+        std::optional<Sha256Digest> digest;
+        if (pass.options.stopToken.stop_requested())
+        {
+            pass.filesInFlight.release();
+            co_return digest;
+        }
 
         try
         {
-            processedFiles++;
+            digest = co_await calculateSHA256Async(pass.executor, file, pass.options.readPolicy, pass.readStats, &(*pass.fingerprints)[entryIndex],
+                &pass.options.onMessage);
+        }
+        catch (const std::exception& e)
+        {
+            printMessage(&pass.options.onMessage, L"Error processing file ", file.wstring(), L": ", errorMessage(e));
+        }
+        pass.filesInFlight.release();
+
+        if (digest && pass.journal)
+        {
+            pass.journal->recordHash(file, size, (*pass.nodes)[entryIndex].writeTime, *digest);
+        }
+        co_return digest;
+    }
 
-            if (totalFiles <= 100 || processedFiles % 100 == 0) // Show progress every 100 files
+    Task<bool> readSmallCandidate(AsyncHashPass& pass, uint32_t entryIndex, uint64_t size, unsigned char* slot, size_t slotLength)
+    {
+        const fs::path& file = (*pass.files)[entryIndex];
+
+        co_await pass.filesInFlight.acquire();
+        reportAsyncProgress(pass, file);
+
+        bool ok = false;
+        HANDLE hFile = pass.options.stopToken.stop_requested() ? INVALID_HANDLE_VALUE : openForRead(file, pass.options.readPolicy, true);
+        if (hFile != INVALID_HANDLE_VALUE)
+        {
+            queryFileFingerprint(hFile, (*pass.fingerprints)[entryIndex]);
+            if (pass.executor.associate(hFile))
             {
-                std::wstring wsProcessed = std::to_wstring(processedFiles);
-                std::wstring wsTotal = std::to_wstring(totalFiles);
+                ioThrottle().beforeRead(slotLength);
+                IoResult result = co_await pass.executor.read(hFile, 0, slot, static_cast<uint32_t>(slotLength));
+                ok = result.error == 0 && result.bytesTransferred == size;
+                pass.readStats->bytesRead += result.bytesTransferred;
+                pass.readStats->filesRead++;
+            }
+            CloseHandle(hFile);
+        }
+        pass.filesInFlight.release();
+        co_return ok;
+    }
+
+    // Small-file path for one size: every file is read whole into the run's slab at once, then compared by content
+    Task<void> compareSmallSizeRun(AsyncHashPass& pass, size_t run)
+    {
+        const RecordRun& range = (*pass.sizeRuns)[run];
+        const uint64_t size = (*pass.candidates)[range.begin].size;
+        const size_t slot = smallFileSlot(size, pass.options.readPolicy);
+        const size_t slabLength = (range.end - range.begin) * slot;
+
+        // Taken before the slab is allocated, so a pass never holds more than the budget however many runs are in flight
+        co_await pass.slabBytes.acquire(slabLength);
+        {
+            ReadBuffer slab(slabLength);
+
+            std::vector<Task<bool>> readTasks;
+            for (size_t i = range.begin; i < range.end; ++i)
+            {
+                readTasks.push_back(readSmallCandidate(pass, (*pass.candidates)[i].entryIndex, size, slab.data() + (i - range.begin) * slot, slot));
+            }
+            std::vector<bool> readable = co_await whenAll(pass.executor, std::move(readTasks));
 
-				// CHECK: This might or might not work, maybe test more
-                printUnicodeMulti(true, L"Progress: ", wsProcessed, L"/", wsTotal, L" - ", file.wstring());
+            std::vector<std::pair<uint32_t, const unsigned char*>> contents;
+            for (size_t i = range.begin; i < range.end; ++i)
+            {
+                if (readable[i - range.begin]) contents.push_back({ (*pass.candidates)[i].entryIndex, slab.data() + (i - range.begin) * slot });
             }
+            digestEqualContents(contents, static_cast<size_t>(size), *pass.digests);
+        }
+        pass.slabBytes.release(slabLength);
+    }
 
-            std::string hash = calculateSHA256(file);
+    // Metadata, partial-hash and full-hash stages for every candidate of one size. Each await is where the
+    // thread goes off to run other sizes' files until this one's reads are back.
+    Task<void> hashSizeRun(AsyncHashPass& pass, size_t run)
+    {
+        const RecordRun& range = (*pass.sizeRuns)[run];
+        const uint64_t size = (*pass.candidates)[range.begin].size;
 
-            if (hash.empty()) continue; // Skip files that failed to hash
+        if (size == 0) co_return; // grouped before the pass started
 
-            hashGroups[hash].push_back(file);
+        if (readsWhole(size, range.end - range.begin, pass.options.readPolicy))
+        {
+            co_await compareSmallSizeRun(pass, run);
+            pass.resolveRun(run);
+            co_return;
         }
-        catch (const std::exception& e)
+
+        // Metadata stage: reuse the digest from an interrupted run if the file is unchanged since then
+        std::vector<uint32_t> unhashed;
+        bool anyFromJournal = false;
+
+        for (size_t i = range.begin; i < range.end; ++i)
         {
-            std::wstring wsExceptionMsg = utf8ToWstring(e.what());
-            printUnicodeMulti(true, L"Error processing file ", file.wstring(), wsExceptionMsg);
+            uint32_t entryIndex = (*pass.candidates)[i].entryIndex;
+
+            Sha256Digest digest;
+            if (pass.journal && digestFromJournal(*pass.journal, (*pass.files)[entryIndex], size, (*pass.nodes)[entryIndex].writeTime, digest,
+                (*pass.fingerprints)[entryIndex]))
+            {
+                (*pass.digests)[entryIndex] = digest;
+                anyFromJournal = true;
+                ++pass.finishedFiles;
+                continue;
+            }
+
+            unhashed.push_back(entryIndex);
         }
+
+        // Partial-hash stage: a file whose first block matches no other file of its size cannot be a duplicate.
+        // Not worth it for files that fit in the head, and a digest from the journal has no head to compare with.
+        std::vector<bool> needsDigest(unhashed.size(), true);
+        if (!anyFromJournal && size > HEAD_DIGEST_BYTES && unhashed.size() > 1)
+        {
+            std::vector<Task<std::optional<uint64_t>>> headTasks;
+            for (uint32_t entryIndex : unhashed)
+            {
+                headTasks.push_back(headOfCandidate(pass, entryIndex));
+            }
+            std::vector<std::optional<uint64_t>> heads = co_await whenAll(pass.executor, std::move(headTasks));
+
+            std::unordered_map<uint64_t, size_t> headCounts;
+            for (const auto& head : heads)
+            {
+                if (head) ++headCounts[*head];
+            }
+
+            for (size_t i = 0; i < heads.size(); ++i)
+            {
+                needsDigest[i] = heads[i] && headCounts[*heads[i]] > 1; // an unreadable head would not hash either
+                if (!needsDigest[i])
+                {
+                    ++pass.ruledOutByHead;
+                    ++pass.finishedFiles;
+                }
+            }
+        }
+
+        // Full-hash stage
+        std::vector<Task<std::optional<Sha256Digest>>> digestTasks;
+        std::vector<uint32_t> digestEntries;
+        for (size_t i = 0; i < unhashed.size(); ++i)
+        {
+            if (!needsDigest[i]) continue;
+
+            digestTasks.push_back(digestOfCandidate(pass, unhashed[i], size));
+            digestEntries.push_back(unhashed[i]);
+        }
+
+        std::vector<std::optional<Sha256Digest>> digests = co_await whenAll(pass.executor, std::move(digestTasks));
+        for (size_t i = 0; i < digests.size(); ++i)
+        {
+            (*pass.digests)[digestEntries[i]] = digests[i];
+        }
+
+        pass.resolveRun(run);
+    }
+
+    // A fixed number of these take sizes one after another, so only that many runs have coroutine frames at once
+    Task<void> hashSizeRunsInTurn(AsyncHashPass& pass)
+    {
+        for (size_t run; (run = pass.nextRun++) < pass.sizeRuns->size() && !pass.options.stopToken.stop_requested();)
+        {
+            co_await hashSizeRun(pass, run);
+        }
+    }
+
+    Task<void> hashAllSizeRuns(AsyncHashPass& pass)
+    {
+        std::vector<Task<void>> workers;
+        size_t workerCount = std::min<size_t>(pass.sizeRuns->size(), pass.options.filesInFlight);
+        for (size_t i = 0; i < workerCount; ++i)
+        {
+            workers.push_back(hashSizeRunsInTurn(pass));
+        }
+        co_await whenAll(pass.executor, std::move(workers));
     }
-    std::wcout << L"Finished processing files." << std::endl;
-    return hashGroups;
-}
\ No newline at end of file
+}
+
+void streamFilesByHash(const std::vector<fs::path>& files, const std::vector<ScanNode>& nodes, ScanJournal* journal, const HashOptions& options,
+    const DuplicateGroupHandler& onGroup, std::vector<std::optional<Sha256Digest>>* digestsOut)
+{
+    size_t processedFiles = 0;
+    size_t regularFiles = 0;
+
+    // Size stage: a file whose size is unique cannot have a duplicate, so it is never hashed. The sizes are the ones
+    // the scan listed, and the scanner only lists regular files besides folders, so no file is asked again here.
+    std::vector<GroupRecord> records;
+    for (size_t i = 0; i < files.size(); ++i)
+    {
+        if (nodes[i].isDirectory) continue;
+
+        regularFiles++;
+        records.push_back({ nodes[i].size, 0, static_cast<uint32_t>(i) });
+    }
+
+    // Every run of equal sizes resolves on its own: once its last candidate is hashed, its groups are final
+    std::vector<RecordRun> sizeRuns = findEqualKeyRuns(records);
+    std::vector<GroupRecord> candidates;
+    std::vector<uint32_t> runOfCandidate;
+    std::vector<std::atomic<uint32_t>> pendingInRun(sizeRuns.size());
+    for (size_t run = 0; run < sizeRuns.size(); ++run)
+    {
+        size_t runLength = sizeRuns[run].end - sizeRuns[run].begin;
+        candidates.insert(candidates.end(), records.begin() + sizeRuns[run].begin, records.begin() + sizeRuns[run].end);
+        runOfCandidate.resize(candidates.size(), static_cast<uint32_t>(run));
+        pendingInRun[run] = static_cast<uint32_t>(runLength);
+        sizeRuns[run] = { candidates.size() - runLength, candidates.size() }; // from here on, indexes into candidates
+    }
+    const size_t totalFiles = candidates.size();
+
+    printMessage(&options.onMessage, L"Processing ", std::to_wstring(totalFiles), L" files for duplicate detection (",
+        std::to_wstring(regularFiles - totalFiles), L" files skipped because their size is unique)...");
+
+    ReadStats readStats;
+    const uint64_t cacheBefore = systemCacheBytes();
+    const auto startTime = std::chrono::steady_clock::now();
+    const uint64_t buffersBefore = ReadBuffer::allocationCount();
+    const uint64_t contextsBefore = Sha256Hasher::contextCount();
+
+    // Fixed-size binary digests: no allocation per file, and hex is only produced for the groups that are reported
+    std::vector<std::optional<Sha256Digest>> digests(files.size());
+    std::vector<FileFingerprint> fingerprints(files.size()); // filled by whichever thread reads the file, like digests
+
+    // Digest stage for one size run: group its candidates by (size, digest prefix), let the full digest
+    // decide, and hand the groups on
+    auto resolveRun = [&](size_t run)
+    {
+        if (options.stopToken.stop_requested()) return; // its files may not all have been read
+
+        std::vector<GroupRecord> hashedRecords;
+        for (size_t i = sizeRuns[run].begin; i < sizeRuns[run].end; ++i)
+        {
+            const std::optional<Sha256Digest>& digest = digests[candidates[i].entryIndex];
+            if (!digest) continue;
+
+            hashedRecords.push_back({ candidates[i].size, digestPrefixOf(*digest), candidates[i].entryIndex });
+        }
+
+        for (const auto& prefixRun : findEqualKeyRuns(hashedRecords, 2, 1))
+        {
+            std::map<Sha256Digest, DuplicateGroup> groups;
+            for (size_t i = prefixRun.begin; i < prefixRun.end; ++i)
+            {
+                uint32_t entryIndex = hashedRecords[i].entryIndex;
+                DuplicateGroup& group = groups[*digests[entryIndex]];
+                group.fileSize = hashedRecords[i].size;
+                group.files.push_back(files[entryIndex]);
+                group.fingerprints.push_back(fingerprints[entryIndex]);
+            }
+
+            for (auto& [digest, group] : groups)
+            {
+                if (group.files.size() < 2) continue;
+                group.hash = digestToHex(digest);
+                onGroup(std::move(group));
+            }
+        }
+    };
+
+    // The thread that finishes the last candidate of a run resolves it; the atomic decrement makes every
+    // other candidate's digest visible to it
+    auto finishCandidate = [&](size_t candidate)
+    {
+        size_t run = runOfCandidate[candidate];
+        if (pendingInRun[run].fetch_sub(1, std::memory_order_acq_rel) == 1) resolveRun(run);
+    };
+
+    // Zero-byte files are all equal, so they form one group without being opened
+    for (size_t run = 0; run < sizeRuns.size(); ++run)
+    {
+        if (candidates[sizeRuns[run].begin].size != 0) continue;
+
+        DuplicateGroup emptyFiles{ "empty_file", {}, 0 };
+        for (size_t i = sizeRuns[run].begin; i < sizeRuns[run].end; ++i)
+        {
+            emptyFiles.files.push_back(files[candidates[i].entryIndex]);
+            emptyFiles.fingerprints.push_back({}); // only the size is known, and it is all that needs checking
+            digests[candidates[i].entryIndex] = EMPTY_SHA256; // so folders holding them can still be matched
+        }
+        processedFiles += emptyFiles.files.size();
+        pendingInRun[run] = 0;
+        onGroup(std::move(emptyFiles));
+    }
+
+    if (options.executor)
+    {
+        AsyncHashPass pass(*options.executor, options);
+        pass.files = &files;
+        pass.nodes = &nodes;
+        pass.candidates = &candidates;
+        pass.sizeRuns = &sizeRuns;
+        pass.digests = &digests;
+        pass.fingerprints = &fingerprints;
+        pass.journal = journal;
+        pass.readStats = &readStats;
+        pass.resolveRun = resolveRun;
+        pass.totalFiles = totalFiles;
+        pass.finishedFiles = processedFiles;
+
+        const uint64_t resumptionsBefore = options.executor->resumptionCount();
+        runBlocking(*options.executor, hashAllSizeRuns(pass));
+
+        // Thread count and switches, to set against the reader pools' "I/O:" lines
+        uint64_t resumptions = options.executor->resumptionCount() - resumptionsBefore;
+        printMessage(&options.onMessage, L"Coroutines: ", std::to_wstring(options.executor->threadCount()), L" threads, ",
+            std::to_wstring(resumptions), L" resumptions (", std::to_wstring(totalFiles > 0 ? resumptions / totalFiles : 0), L" per file), peak ",
+            std::to_wstring(options.executor->peakReadsInFlight()), L" reads in flight, ", std::to_wstring(pass.ruledOutByHead.load()),
+            L" files ruled out by their first ", std::to_wstring(HEAD_DIGEST_BYTES), L" bytes");
+    }
+    else
+    {
+        std::vector<ReadJob> jobs;
+        std::vector<uint32_t> jobCandidates;
+
+        // Small files go out in batches of whole size runs, one job per batch, so a reader handles many of them
+        // per call and every run of a batch shares its slab
+        std::vector<std::vector<uint32_t>> smallBatches;
+        std::vector<bool> smallRun(sizeRuns.size(), false);
+        uint64_t batchBytes = 0;
+        for (size_t run = 0; run < sizeRuns.size(); ++run)
+        {
+            size_t runLength = sizeRuns[run].end - sizeRuns[run].begin;
+            uint64_t size = candidates[sizeRuns[run].begin].size;
+            if (!readsWhole(size, runLength, options.readPolicy)) continue;
+
+            if (smallBatches.empty() || batchBytes >= SMALL_BATCH_BYTES)
+            {
+                smallBatches.emplace_back();
+                batchBytes = 0;
+            }
+            smallBatches.back().push_back(static_cast<uint32_t>(run));
+            batchBytes += runLength * smallFileSlot(size, options.readPolicy);
+            smallRun[run] = true;
+        }
+
+        for (size_t candidate = 0; candidate < candidates.size(); ++candidate)
+        {
+            if (candidates[candidate].size == 0 || smallRun[runOfCandidate[candidate]]) continue;
+
+            const uint32_t entryIndex = candidates[candidate].entryIndex;
+            const fs::path& file = files[entryIndex];
+
+            Sha256Digest digest;
+            if (journal && digestFromJournal(*journal, file, candidates[candidate].size, nodes[entryIndex].writeTime, digest, fingerprints[entryIndex]))
+            {
+                digests[entryIndex] = digest;
+                processedFiles++;
+                finishCandidate(candidate);
+                continue;
+            }
+
+            // One batch per size run, so the physical read order finishes a run before moving on and its group is confirmed early
+            jobs.push_back({ file, candidates[candidate].size, runOfCandidate[candidate] });
+            jobCandidates.push_back(static_cast<uint32_t>(candidate));
+        }
+
+        const size_t hashJobCount = jobs.size();
+        for (const auto& batch : smallBatches)
+        {
+            const RecordRun& firstRun = sizeRuns[batch.front()];
+            uint64_t slabBytes = 0;
+            for (uint32_t run : batch)
+            {
+                slabBytes += (sizeRuns[run].end - sizeRuns[run].begin) * smallFileSlot(candidates[sizeRuns[run].begin].size, options.readPolicy);
+            }
+            jobs.push_back({ files[candidates[firstRun.begin].entryIndex], slabBytes, sizeRuns.size() + jobs.size() });
+        }
+
+        std::atomic<size_t> finishedFiles{ processedFiles };
+
+        auto reportProgress = [&](const fs::path& file)
+        {
+            size_t finished = ++finishedFiles;
+
+            if (options.onProgress)
+            {
+                options.onProgress(finished, totalFiles, readStats.bytesRead);
+            }
+            else if (options.showProgress && (totalFiles <= 100 || finished % 100 == 0)) // Show progress every 100 files
+            {
+                printProgressLine(&options.onMessage, finished, totalFiles, file);
+            }
+        };
+
+        // Reads every file of the batch's runs into one slab, then compares each run by content
+        auto compareSmallBatch = [&](const std::vector<uint32_t>& batch) -> uint64_t
+        {
+            if (options.stopToken.stop_requested())
+            {
+                for (uint32_t run : batch)
+                {
+                    for (size_t candidate = sizeRuns[run].begin; candidate < sizeRuns[run].end; ++candidate) finishCandidate(candidate);
+                }
+                return 0;
+            }
+
+            ScopedReadCachePriority cachePriority(options.readPolicy);
+            ReadStats batchStats;
+
+            size_t slabBytes = 0;
+            for (uint32_t run : batch)
+            {
+                slabBytes += (sizeRuns[run].end - sizeRuns[run].begin) * smallFileSlot(candidates[sizeRuns[run].begin].size, options.readPolicy);
+            }
+            ReadBuffer slab(slabBytes);
+            unsigned char* slot = slab.data();
+
+            std::vector<std::pair<uint32_t, const unsigned char*>> contents;
+            for (uint32_t run : batch)
+            {
+                const uint64_t size = candidates[sizeRuns[run].begin].size;
+                const size_t slotLength = smallFileSlot(size, options.readPolicy);
+
+                contents.clear();
+                for (size_t candidate = sizeRuns[run].begin; candidate < sizeRuns[run].end; ++candidate, slot += slotLength)
+                {
+                    uint32_t entryIndex = candidates[candidate].entryIndex;
+                    reportProgress(files[entryIndex]);
+
+                    if (readSmallFile(files[entryIndex], size, options.readPolicy, slot, slotLength, batchStats, fingerprints[entryIndex]))
+                    {
+                        contents.push_back({ entryIndex, slot });
+                    }
+                }
+                digestEqualContents(contents, static_cast<size_t>(size), digests);
+
+                for (size_t candidate = sizeRuns[run].begin; candidate < sizeRuns[run].end; ++candidate)
+                {
+                    finishCandidate(candidate);
+                }
+            }
+
+            readStats.bytesRead += batchStats.bytesRead;
+            readStats.filesRead += batchStats.filesRead;
+            return batchStats.bytesRead;
+        };
+
+        // The schedulers' "I/O:" lines go wherever the pass's own lines go
+        IoSchedulerOptions scheduling = options.scheduling;
+        if (!scheduling.onMessage) scheduling.onMessage = options.onMessage;
+
+        runScheduledReads(jobs, [&](size_t job) -> uint64_t
+        {
+            if (job >= hashJobCount) return compareSmallBatch(smallBatches[job - hashJobCount]);
+
+            if (options.stopToken.stop_requested())
+            {
+                finishCandidate(jobCandidates[job]);
+                return 0;
+            }
+
+            const fs::path& file = jobs[job].path;
+            reportProgress(file);
+
+            uint64_t bytesRead = 0;
+            try
+            {
+                ReadStats jobStats;
+                Sha256Digest digest;
+                uint32_t entryIndex = candidates[jobCandidates[job]].entryIndex;
+                bool hashed = calculateSHA256(file, digest, options.readPolicy, &jobStats, &fingerprints[entryIndex], &options.onMessage);
+                readStats.bytesRead += jobStats.bytesRead;
+                readStats.filesRead += jobStats.filesRead;
+                bytesRead = jobStats.bytesRead;
+
+                if (hashed) // Files that failed to hash are left out of their group
+                {
+                    if (journal)
+                    {
+                        journal->recordHash(file, jobs[job].size, nodes[entryIndex].writeTime, digest);
+                    }
+
+                    // Each job owns its slot, so no lock is needed
+                    digests[entryIndex] = digest;
+                }
+            }
+            catch (const std::exception& e)
+            {
+                std::wstring wsExceptionMsg = errorMessage(e);
+                printMessage(&options.onMessage, L"Error processing file ", file.wstring(), L": ", wsExceptionMsg);
+            }
+
+            finishCandidate(jobCandidates[job]);
+            return bytesRead;
+        }, scheduling);
+    }
+
+    if (journal)
+    {
+        journal->checkpoint();
+    }
+
+    // Throughput and cache growth make the read policies comparable
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+    uint64_t bytesRead = readStats.bytesRead;
+    uint64_t cacheAfter = systemCacheBytes();
+    std::string readStr = formatFileSize(bytesRead);
+    std::string speedStr = formatFileSize(seconds > 0 ? static_cast<uintmax_t>(bytesRead / seconds) : 0);
+    std::string cacheBeforeStr = formatFileSize(cacheBefore);
+    std::string cacheAfterStr = formatFileSize(cacheAfter);
+    printMessage(&options.onMessage, L"Read policy: ", readPolicyName(options.readPolicy),
+        L", read ", utf8ToWstring(readStr), L" in ", std::to_wstring(static_cast<long long>(seconds)), L" s (", utf8ToWstring(speedStr), L"/s)",
+        L", system file cache ", utf8ToWstring(cacheBeforeStr), L" -> ", utf8ToWstring(cacheAfterStr));
+
+    // Read buffers and hash contexts are reused per reader thread, so these stay near the thread count instead of
+    // growing with the file count (before that, hashing a file took one of each). Only these two are counted, not
+    // every allocation the pass makes.
+    uint64_t buffers = ReadBuffer::allocationCount() - buffersBefore;
+    uint64_t contexts = Sha256Hasher::contextCount() - contextsBefore;
+    uint64_t filesRead = readStats.filesRead;
+    printMessage(&options.onMessage, L"Buffers created: ", std::to_wstring(buffers), L" read buffers and ", std::to_wstring(contexts), L" hash contexts for ",
+        std::to_wstring(filesRead), L" files read (", std::to_wstring(filesRead > 0 ? static_cast<double>(buffers + contexts) / filesRead : 0.0), L" per file)");
+
+    if (digestsOut)
+    {
+        *digestsOut = std::move(digests);
+    }
+
+    printMessage(&options.onMessage, L"Finished processing files.");
+}
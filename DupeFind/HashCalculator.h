@@ -1,13 +1,120 @@
-#pragma once
+﻿#pragma once
 
 #include <string>
 #include <vector>
 #include <map>
 #include <filesystem>
+#include <array>
+#include <functional>
+#include <optional>
+#include <stop_token>
+#include <cstdint>
+
+#include "ReadPolicy.h"
+#include "Utilities.h"
+#include "IoScheduler.h"
+#include "Async.h"
+#include "FileFingerprint.h"
 
 
 namespace fs = std::filesystem;
 
-std::string calculateSHA256(const fs::path& filePath);
+class ScanJournal;
+
+using Sha256Digest = std::array<unsigned char, 32>;
+
+// Incremental SHA-256 on a reusable CNG hash object. The algorithm provider is opened once per process and the
+// hash object lives inside the hasher, so every digest after construction runs without setup or allocation.
+class Sha256Hasher
+{
+public:
+    Sha256Hasher();
+    ~Sha256Hasher();
+
+    Sha256Hasher(const Sha256Hasher&) = delete;
+    Sha256Hasher& operator=(const Sha256Hasher&) = delete;
+
+    bool isValid() const { return hash != nullptr; }
+
+    bool begin();
+    bool update(const void* data, size_t length);
+    bool finish(Sha256Digest& digest);
+
+    // Hash objects created so far in this process, to show how many a pass needed per file
+    static uint64_t contextCount();
+
+private:
+    // Large enough for the SHA-256 object of every CNG version so far; a larger one is left to CNG to allocate
+    alignas(8) unsigned char hashObject[512];
+    void* hash = nullptr;
+    bool pending = false; // data was hashed since the last finish
+};
+
+// Files the coroutine engine keeps open at once, each with a read outstanding
+const size_t DEFAULT_FILES_IN_FLIGHT = 256;
+
+struct HashOptions
+{
+    ReadPolicy readPolicy = ReadPolicy::Sequential;
+    IoSchedulerOptions scheduling;
+    bool showProgress = true;
+
+    // With an executor, files are hashed by coroutines with overlapped reads instead of by the per-device reader pools
+    IoExecutor* executor = nullptr;
+    size_t filesInFlight = DEFAULT_FILES_IN_FLIGHT;
+
+    // Checked before each file is read. Once a stop is requested the remaining files are skipped and no more groups are reported.
+    std::stop_token stopToken;
+
+    // Replaces the progress lines: called with the files finished, the total and the bytes read so far, from whichever thread finished one
+    std::function<void(size_t finished, size_t total, uint64_t bytesRead)> onProgress;
+
+    // Replaces every other line the pass prints, per-file errors and the read summaries included, from whichever thread
+    // has one. Also used for the "I/O:" lines unless scheduling sets its own.
+    MessageHandler onMessage;
+};
+
+struct DuplicateGroup
+{
+    std::string hash;
+    std::vector<fs::path> files;
+    uint64_t fileSize = 0; // of each file, as listed by the size stage
+
+    // One per file, taken when it was read for hashing, so removal can tell which files changed since
+    std::vector<FileFingerprint> fingerprints;
+};
+
+// Called from whichever thread hashed the last file of a group's size, so it must be thread-safe.
+// Blocking in it holds that reader back, which is how a slow consumer slows hashing down.
+using DuplicateGroupHandler = std::function<void(DuplicateGroup&&)>;
+
+// SHA-256 of the file's contents. Each thread keeps its hasher, read buffer and range list, so after its first file
+// a thread hashes without allocating. Returns false if the file cannot be read.
+// fingerprint, if given, is taken from the handle before the first read. Errors go to onMessage, or the console without one.
+bool calculateSHA256(const fs::path& filePath, Sha256Digest& digest, ReadPolicy policy = ReadPolicy::Sequential, ReadStats* stats = nullptr,
+    FileFingerprint* fingerprint = nullptr, const MessageHandler* onMessage = nullptr);
+
+// Files are first compared by a digest of this many leading bytes, which is enough to tell most different files apart
+const size_t HEAD_DIGEST_BYTES = 4096;
+
+// First 8 bytes of the SHA-256 of the file's first HEAD_DIGEST_BYTES (or of the whole file if it is shorter)
+bool calculateHeadDigest(const fs::path& filePath, uint64_t& headDigest, ReadPolicy policy = ReadPolicy::Sequential, ReadStats* stats = nullptr);
+
+// Files up to this size skip the digest: each is read whole with one call into a slab shared with the other files
+// of its size, and files with the same contents are found by comparing the bytes. Only a group that turns out to
+// have duplicates has its contents hashed, once, to name it. Zero-byte files are grouped by size without being opened.
+const uint64_t SMALL_FILE_LIMIT = 16 * 1024;
+
+// Overlapped versions of the above for coroutines on an IoExecutor. They give the same digests.
+Task<std::optional<Sha256Digest>> calculateSHA256Async(IoExecutor& executor, fs::path filePath, ReadPolicy policy = ReadPolicy::Sequential, ReadStats* stats = nullptr,
+    FileFingerprint* fingerprint = nullptr, const MessageHandler* onMessage = nullptr);
+Task<std::optional<uint64_t>> calculateHeadDigestAsync(IoExecutor& executor, fs::path filePath, ReadPolicy policy = ReadPolicy::Sequential, ReadStats* stats = nullptr);
+
+struct ScanNode;
 
-std::map<std::string, std::vector<fs::path>> groupFilesByHash(const std::vector<fs::path>& files);
\ No newline at end of file
+// Hashes every file whose size is shared and hands each duplicate group to onGroup as soon as all files of
+// that size are hashed, rather than after the last file of the scan. nodes are the scanner's, one per path, and
+// give the sizes files are grouped by and the write times the journal is checked against. digestsOut, if given, receives each file's digest by its
+// index in files; a file left without one has no duplicate (or could not be read).
+void streamFilesByHash(const std::vector<fs::path>& files, const std::vector<ScanNode>& nodes, ScanJournal* journal, const HashOptions& options,
+    const DuplicateGroupHandler& onGroup, std::vector<std::optional<Sha256Digest>>* digestsOut = nullptr);
\ No newline at end of file
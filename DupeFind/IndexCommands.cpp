@@ -0,0 +1,268 @@
+#include "IndexCommands.h"
+#include "DigestIndex.h"
+#include "IndexServer.h"
+#include "FileScanner.h"
+#include "FileFilter.h"
+#include "Utilities.h"
+
+#include <string>
+#include <vector>
+
+namespace
+{
+    // Files named on the command line, with folders expanded through the usual skip rules
+    std::vector<fs::path> collectFiles(const std::vector<std::wstring>& arguments, const FileFilter& filter)
+    {
+        std::vector<fs::path> files;
+        for (const auto& argument : arguments)
+        {
+            // Canonical paths, so a file is stored and looked up under one name however it was typed
+            std::error_code ec;
+            fs::path path = fs::canonical(argument, ec);
+
+            if (ec)
+            {
+                printUnicodeMulti(true, L"Skipping ", argument, L": ", utf8ToWstring(ec.message()));
+            }
+            else if (fs::is_directory(path, ec))
+            {
+                for (auto& found : getAllFilesAndDirectories(path, nullptr, &filter))
+                {
+                    if (fs::is_regular_file(found, ec)) files.push_back(std::move(found));
+                }
+            }
+            else if (fs::is_regular_file(path, ec))
+            {
+                files.push_back(path);
+            }
+            else
+            {
+                printUnicodeMulti(true, L"Skipping ", argument, L": not a file or folder");
+            }
+        }
+        return files;
+    }
+
+    // Unlike the duplicate search every file is considered, since a file that is unique now may be matched later
+    std::vector<IndexedFile> sizedFiles(const std::vector<fs::path>& paths)
+    {
+        std::vector<IndexedFile> files;
+        for (const auto& path : paths)
+        {
+            std::error_code ec;
+            uintmax_t size = fs::file_size(path, ec);
+            if (ec || size == 0) continue; // empty files are all the same and not worth indexing
+
+            IndexedFile file;
+            file.size = size;
+            file.path = path.wstring();
+            files.push_back(std::move(file));
+        }
+        return files;
+    }
+
+    // Fills in the head digest and/or the full digest of every file and drops the ones that could not be read
+    void hashFiles(std::vector<IndexedFile>& files, bool headDigest, bool fullDigest, const HashOptions& options, ReadStats& readStats)
+    {
+        std::vector<ReadJob> jobs;
+        for (const auto& file : files)
+        {
+            jobs.push_back({ file.path, file.size });
+        }
+
+        std::vector<char> valid(files.size(), 0);
+
+        runScheduledReads(jobs, [&](size_t job) -> uint64_t
+        {
+            ReadStats stats;
+            bool ok = !headDigest || calculateHeadDigest(jobs[job].path, files[job].headDigest, options.readPolicy, &stats);
+            if (ok && fullDigest)
+            {
+                ok = calculateSHA256(jobs[job].path, files[job].digest, options.readPolicy, &stats);
+            }
+
+            valid[job] = ok;
+            readStats.bytesRead += stats.bytesRead;
+            readStats.filesRead += ok ? 1 : 0;
+            return stats.bytesRead;
+        }, options.scheduling);
+
+        size_t kept = 0;
+        for (size_t i = 0; i < files.size(); ++i)
+        {
+            if (valid[i]) files[kept++] = std::move(files[i]);
+        }
+        files.resize(kept);
+    }
+
+    int addToIndex(DigestIndex& index, const ProgramOptions& options)
+    {
+        std::vector<std::wstring> folders(options.command.begin() + 2, options.command.end());
+        if (folders.empty())
+        {
+            printUnicode(L"index add needs at least one folder.", true);
+            return 1;
+        }
+
+        FileFilter filter = loadFileFilter(L"dupefind_filters.txt");
+        std::vector<IndexedFile> files = sizedFiles(collectFiles(folders, filter));
+        ReadStats readStats;
+        hashFiles(files, true, true, options.hashOptions, readStats);
+
+        if (!index.insert(files, options.prefilterFalsePositiveRate)) return 1;
+
+        DigestIndexStats stats = index.stats();
+        printUnicodeMulti(true, L"Indexed ", std::to_wstring(files.size()), L" files, the index now holds ",
+            std::to_wstring(stats.entries), L" entries.");
+        printUnicodeMulti(true, L"Prefilter: ", utf8ToWstring(formatFileSize(stats.prefilterBytes)), L", ", std::to_wstring(stats.prefilterHashes),
+            L" hashes per key, expected false-positive rate ", std::to_wstring(stats.expectedFalsePositiveRate));
+        return 0;
+    }
+
+    int queryIndex(const DigestIndex& index, const ProgramOptions& options)
+    {
+        std::vector<std::wstring> paths(options.command.begin() + 2, options.command.end());
+        if (paths.empty())
+        {
+            printUnicode(L"index query needs at least one file or folder.", true);
+            return 1;
+        }
+
+        DigestIndexClient client;
+        if (options.useIndexServer && !client.connect())
+        {
+            printUnicodeMulti(true, L"Error: No index server is listening on ", DEFAULT_INDEX_PIPE);
+            return 1;
+        }
+
+        FileFilter filter = loadFileFilter(L"dupefind_filters.txt");
+        std::vector<IndexedFile> files = sizedFiles(collectFiles(paths, filter));
+        const size_t queried = files.size();
+
+        // First pass: only the head of each file is read, and the prefilter turns most new files away
+        ReadStats headStats;
+        hashFiles(files, true, false, options.hashOptions, headStats);
+
+        std::vector<IndexedFile> candidates;
+        size_t rejected = 0;
+        for (auto& file : files)
+        {
+            bool maybe = true;
+            if (options.useIndexServer)
+            {
+                if (!client.mightContain(file.size, file.headDigest, maybe))
+                {
+                    printUnicode(L"Error: Lost the connection to the index server.", true);
+                    return 1;
+                }
+            }
+            else
+            {
+                maybe = index.mightContain(file.size, file.headDigest);
+            }
+
+            if (maybe)
+            {
+                candidates.push_back(std::move(file));
+            }
+            else
+            {
+                rejected++;
+                printOutputLine(L"NEW\t" + file.path);
+            }
+        }
+
+        // Second pass: full digests and table lookups for the files the filter could not rule out
+        ReadStats fullStats;
+        hashFiles(candidates, false, true, options.hashOptions, fullStats);
+
+        size_t known = 0;
+        size_t falsePositives = 0;
+        for (const auto& file : candidates)
+        {
+            std::vector<std::wstring> matches;
+            if (options.useIndexServer)
+            {
+                if (!client.lookup(file.size, file.digest, matches))
+                {
+                    printUnicode(L"Error: Lost the connection to the index server.", true);
+                    return 1;
+                }
+            }
+            else
+            {
+                matches = index.lookup(file.size, file.digest);
+            }
+
+            if (matches.empty())
+            {
+                falsePositives++;
+                printOutputLine(L"NEW\t" + file.path);
+                continue;
+            }
+
+            // A file that was indexed itself is not a duplicate of anything
+            std::erase(matches, file.path);
+
+            if (matches.empty())
+            {
+                printOutputLine(L"INDEXED\t" + file.path);
+            }
+            else
+            {
+                known++;
+                printOutputLine(L"DUPLICATE\t" + file.path + L"\t" + matches.front());
+            }
+        }
+
+        printUnicodeMulti(true, std::to_wstring(known), L" of ", std::to_wstring(queried), L" files are duplicates of indexed files.");
+
+        // The measured rate counts filter passes among the files that turned out not to be indexed
+        size_t notIndexed = rejected + falsePositives;
+        double measuredRate = notIndexed ? static_cast<double>(falsePositives) / notIndexed : 0;
+        printUnicodeMulti(true, L"Prefilter: rejected ", std::to_wstring(rejected), L" files after reading ",
+            utf8ToWstring(formatFileSize(headStats.bytesRead)), L" of file heads; ", std::to_wstring(candidates.size()),
+            L" needed a full hash (", utf8ToWstring(formatFileSize(fullStats.bytesRead)), L"), ", std::to_wstring(falsePositives),
+            L" of them false positives (measured rate ", std::to_wstring(measuredRate), L")");
+        return 0;
+    }
+
+    int showStats(const DigestIndex& index, const ProgramOptions& options)
+    {
+        DigestIndexStats stats = index.stats();
+        double load = stats.slots ? static_cast<double>(stats.entries) / stats.slots : 0;
+
+        printUnicodeMulti(true, L"Index: ", options.indexPath.wstring());
+        printUnicodeMulti(true, L"Entries: ", std::to_wstring(stats.entries), L" in ", std::to_wstring(stats.slots), L" slots (load ",
+            std::to_wstring(static_cast<int>(load * 100)), L"%)");
+        printUnicodeMulti(true, L"Average probe length: ", std::to_wstring(stats.averageProbe));
+        printUnicodeMulti(true, L"File size: ", utf8ToWstring(formatFileSize(stats.fileBytes)));
+        if (stats.prefilterBytes > 0)
+        {
+            printUnicodeMulti(true, L"Prefilter: ", utf8ToWstring(formatFileSize(stats.prefilterBytes)), L", ", std::to_wstring(stats.prefilterHashes),
+                L" hashes per key, target false-positive rate ", std::to_wstring(stats.targetFalsePositiveRate),
+                L", expected ", std::to_wstring(stats.expectedFalsePositiveRate));
+        }
+        return 0;
+    }
+}
+
+int runIndexCommand(const ProgramOptions& options)
+{
+    const std::wstring subcommand = options.command.size() > 1 ? options.command[1] : L"";
+
+    DigestIndex index;
+    if (!(subcommand == L"query" && options.useIndexServer) && !index.open(options.indexPath))
+    {
+        printUnicodeMulti(true, L"Error: Could not open the digest index ", options.indexPath.wstring());
+        return 1;
+    }
+
+    if (subcommand == L"add") return addToIndex(index, options);
+    if (subcommand == L"query") return queryIndex(index, options);
+    if (subcommand == L"stats") return showStats(index, options);
+    if (subcommand == L"serve") return serveDigestIndex(index) ? 0 : 1;
+
+    printUnicodeMulti(true, L"Unknown index command: ", subcommand, L" (expected add, query, serve or stats)");
+    return 1;
+}
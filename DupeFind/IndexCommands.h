@@ -0,0 +1,6 @@
+#pragma once
+
+#include "Options.h"
+
+// Runs "DupeFind index ..." and returns the process exit code
+int runIndexCommand(const ProgramOptions& options);
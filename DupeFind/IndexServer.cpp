@@ -0,0 +1,195 @@
+#include "IndexServer.h"
+#include "Utilities.h"
+
+#include <string>
+#include <vector>
+#include <thread>
+#include <cstdlib>
+#include <cstdio>
+
+#define WIN32_LEAN_AND_MEAN
+#include <Windows.h>
+
+const wchar_t* const DEFAULT_INDEX_PIPE = L"\\\\.\\pipe\\dupefind-index";
+
+namespace
+{
+    const DWORD PIPE_BUFFER_SIZE = 64 * 1024;
+    const size_t MAX_REQUEST_LINE = 4096;
+
+    bool writeAll(HANDLE hPipe, const std::string& data)
+    {
+        DWORD written = 0;
+        return WriteFile(hPipe, data.data(), static_cast<DWORD>(data.size()), &written, nullptr) && written == data.size();
+    }
+
+    std::string answerHeadRequest(const DigestIndex& index, const std::string& arguments)
+    {
+        char* end = nullptr;
+        uint64_t size = std::strtoull(arguments.c_str(), &end, 10);
+        if (*end != ' ') return "ERROR\n";
+
+        char* digestEnd = nullptr;
+        uint64_t headDigest = std::strtoull(end + 1, &digestEnd, 16);
+        if (digestEnd == end + 1 || *digestEnd != '\0') return "ERROR\n";
+
+        return index.mightContain(size, headDigest) ? "MAYBE\n" : "MISS\n";
+    }
+
+    std::string answerRequest(const DigestIndex& index, const std::string& line)
+    {
+        if (line.rfind("HEAD ", 0) == 0) return answerHeadRequest(index, line.substr(5));
+
+        size_t space = line.find(' ');
+        if (space == std::string::npos) return "ERROR\n";
+
+        char* end = nullptr;
+        uint64_t size = std::strtoull(line.c_str(), &end, 10);
+        Sha256Digest digest;
+        if (end != line.c_str() + space || !parseDigestHex(line.substr(space + 1), digest)) return "ERROR\n";
+
+        std::vector<std::wstring> paths = index.lookup(size, digest);
+        if (paths.empty()) return "MISS\n";
+
+        std::string reply = "HIT";
+        for (const auto& path : paths)
+        {
+            reply += '\t';
+            reply += wstringToUtf8(path); // file names cannot contain tabs or newlines
+        }
+        reply += '\n';
+        return reply;
+    }
+
+    void serveClient(const DigestIndex& index, HANDLE hPipe)
+    {
+        // The index is read-only while served, so clients never wait for each other
+        std::string buffered;
+        char chunk[4096];
+        DWORD bytesRead = 0;
+
+        while (ReadFile(hPipe, chunk, sizeof(chunk), &bytesRead, nullptr) && bytesRead > 0)
+        {
+            buffered.append(chunk, bytesRead);
+
+            std::string replies;
+            size_t lineStart = 0;
+            for (size_t newline; (newline = buffered.find('\n', lineStart)) != std::string::npos; lineStart = newline + 1)
+            {
+                std::string line = buffered.substr(lineStart, newline - lineStart);
+                if (!line.empty() && line.back() == '\r') line.pop_back();
+                replies += answerRequest(index, line);
+            }
+            buffered.erase(0, lineStart);
+
+            if (buffered.size() > MAX_REQUEST_LINE || (!replies.empty() && !writeAll(hPipe, replies))) break;
+        }
+
+        FlushFileBuffers(hPipe);
+        DisconnectNamedPipe(hPipe);
+        CloseHandle(hPipe);
+    }
+}
+
+bool serveDigestIndex(const DigestIndex& index, const std::wstring& pipeName)
+{
+    printUnicodeMulti(true, L"Serving ", std::to_wstring(index.entryCount()), L" index entries on ", pipeName, L" (Ctrl+C to stop)");
+
+    while (true)
+    {
+        HANDLE hPipe = CreateNamedPipeW(pipeName.c_str(), PIPE_ACCESS_DUPLEX, PIPE_TYPE_BYTE | PIPE_READMODE_BYTE | PIPE_WAIT | PIPE_REJECT_REMOTE_CLIENTS,
+            PIPE_UNLIMITED_INSTANCES, PIPE_BUFFER_SIZE, PIPE_BUFFER_SIZE, 0, nullptr);
+
+        if (hPipe == INVALID_HANDLE_VALUE)
+        {
+            DWORD error = GetLastError();
+            printUnicodeMulti(true, L"Error: Could not create pipe ", pipeName, L" (Error code: ", std::to_wstring(error), L")");
+            return false;
+        }
+
+        // A client may connect between CreateNamedPipe and ConnectNamedPipe, which is reported as ERROR_PIPE_CONNECTED
+        if (ConnectNamedPipe(hPipe, nullptr) || GetLastError() == ERROR_PIPE_CONNECTED)
+        {
+            std::thread(serveClient, std::cref(index), hPipe).detach();
+        }
+        else
+        {
+            CloseHandle(hPipe);
+        }
+    }
+}
+
+DigestIndexClient::~DigestIndexClient()
+{
+    if (pipeHandle) CloseHandle(pipeHandle);
+}
+
+bool DigestIndexClient::connect(const std::wstring& pipeName)
+{
+    while (true)
+    {
+        HANDLE hPipe = CreateFileW(pipeName.c_str(), GENERIC_READ | GENERIC_WRITE, 0, nullptr, OPEN_EXISTING, 0, nullptr);
+        if (hPipe != INVALID_HANDLE_VALUE)
+        {
+            pipeHandle = hPipe;
+            return true;
+        }
+
+        // Every instance is busy between a connect and the server creating the next one; wait for it
+        if (GetLastError() != ERROR_PIPE_BUSY || !WaitNamedPipeW(pipeName.c_str(), 5000)) return false;
+    }
+}
+
+bool DigestIndexClient::lookup(uint64_t size, const Sha256Digest& digest, std::vector<std::wstring>& paths)
+{
+    paths.clear();
+    if (!pipeHandle) return false;
+
+    std::string request = std::to_string(size) + " " + digestToHex(digest) + "\n";
+    std::string reply;
+    if (!writeAll(pipeHandle, request) || !readLine(reply) || reply == "ERROR") return false;
+
+    if (reply.rfind("HIT", 0) == 0)
+    {
+        size_t start = 3;
+        while (start < reply.size() && reply[start] == '\t')
+        {
+            size_t end = reply.find('\t', start + 1);
+            paths.push_back(utf8ToWstring(reply.substr(start + 1, end == std::string::npos ? std::string::npos : end - start - 1)));
+            start = end == std::string::npos ? reply.size() : end;
+        }
+    }
+
+    return true;
+}
+
+bool DigestIndexClient::mightContain(uint64_t size, uint64_t headDigest, bool& maybe)
+{
+    if (!pipeHandle) return false;
+
+    char request[64];
+    snprintf(request, sizeof(request), "HEAD %llu %016llx\n", static_cast<unsigned long long>(size), static_cast<unsigned long long>(headDigest));
+
+    std::string reply;
+    if (!writeAll(pipeHandle, request) || !readLine(reply) || (reply != "MAYBE" && reply != "MISS")) return false;
+
+    maybe = reply == "MAYBE";
+    return true;
+}
+
+bool DigestIndexClient::readLine(std::string& line)
+{
+    char chunk[4096];
+    DWORD bytesRead = 0;
+
+    while (pending.find('\n') == std::string::npos)
+    {
+        if (!ReadFile(pipeHandle, chunk, sizeof(chunk), &bytesRead, nullptr) || bytesRead == 0) return false;
+        pending.append(chunk, bytesRead);
+    }
+
+    size_t newline = pending.find('\n');
+    line = pending.substr(0, newline);
+    pending.erase(0, newline + 1);
+    return true;
+}
@@ -0,0 +1,41 @@
+#pragma once
+
+#include "DigestIndex.h"
+
+#include <string>
+#include <vector>
+#include <cstdint>
+
+// Local pipe the index is served on unless another name is given
+extern const wchar_t* const DEFAULT_INDEX_PIPE;
+
+// Serves lookups from an open index over a named pipe, one thread per connected client. Each request is a
+// line "<size> <hex digest>"; the reply is "HIT\t<path>\t<path>..." or "MISS", or "ERROR" for a malformed line.
+// "HEAD <size> <16 hex digits>" asks the prefilter about a head digest and is answered "MAYBE" or "MISS".
+// Runs until the process is stopped. Returns false if the pipe could not be created.
+bool serveDigestIndex(const DigestIndex& index, const std::wstring& pipeName = DEFAULT_INDEX_PIPE);
+
+// Client side of the protocol, one connection reused for any number of queries
+class DigestIndexClient
+{
+public:
+    DigestIndexClient() = default;
+    ~DigestIndexClient();
+
+    DigestIndexClient(const DigestIndexClient&) = delete;
+    DigestIndexClient& operator=(const DigestIndexClient&) = delete;
+
+    bool connect(const std::wstring& pipeName = DEFAULT_INDEX_PIPE);
+
+    // Returns false if the server could not be reached; paths is empty for a miss
+    bool lookup(uint64_t size, const Sha256Digest& digest, std::vector<std::wstring>& paths);
+
+    // Asks the server's prefilter; maybe is false only if the file cannot be in the index
+    bool mightContain(uint64_t size, uint64_t headDigest, bool& maybe);
+
+private:
+    bool readLine(std::string& line);
+
+    void* pipeHandle = nullptr;
+    std::string pending;
+};
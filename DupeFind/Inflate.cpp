@@ -0,0 +1,408 @@
+#include "Inflate.h"
+
+#include <array>
+#include <vector>
+#include <cstring>
+
+namespace
+{
+    const unsigned MAX_CODE_BITS = 15;
+    const unsigned FAST_BITS = 9; // codes up to this long are decoded with one table lookup
+    const size_t WINDOW_SIZE = 32 * 1024;
+    const size_t INPUT_BUFFER_SIZE = 64 * 1024;
+    const size_t LITERAL_CODES = 288;
+    const size_t DISTANCE_CODES = 30;
+
+    const uint16_t LENGTH_BASE[29] = { 3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258 };
+    const uint8_t LENGTH_EXTRA[29] = { 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0 };
+    const uint16_t DISTANCE_BASE[30] = { 1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193, 257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097,
+        6145, 8193, 12289, 16385, 24577 };
+    const uint8_t DISTANCE_EXTRA[30] = { 0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13 };
+    const uint8_t CODE_LENGTH_ORDER[19] = { 16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15 };
+
+    // Canonical Huffman code: symbols sorted by code length, plus a lookup table for the short codes. Deflate sends
+    // codes most significant bit first into a stream read least significant bit first, so the table is indexed by
+    // the bit-reversed code.
+    struct HuffmanCode
+    {
+        std::array<uint16_t, MAX_CODE_BITS + 1> counts{};
+        std::array<uint16_t, LITERAL_CODES> symbols{};
+        std::array<uint16_t, 1 << FAST_BITS> fast{}; // symbol << 4 | length, 0 for codes longer than FAST_BITS
+
+        // False if the lengths describe more codes than fit; incomplete codes are allowed, as deflate uses them
+        bool build(const uint8_t* lengths, size_t count)
+        {
+            counts.fill(0);
+            for (size_t symbol = 0; symbol < count; ++symbol) counts[lengths[symbol]]++;
+            counts[0] = 0;
+
+            int left = 1;
+            for (unsigned length = 1; length <= MAX_CODE_BITS; ++length)
+            {
+                left = (left << 1) - counts[length];
+                if (left < 0) return false;
+            }
+
+            std::array<uint16_t, MAX_CODE_BITS + 2> offsets{};
+            for (unsigned length = 1; length <= MAX_CODE_BITS; ++length) offsets[length + 1] = offsets[length] + counts[length];
+            for (size_t symbol = 0; symbol < count; ++symbol)
+            {
+                if (lengths[symbol] != 0) symbols[offsets[lengths[symbol]]++] = static_cast<uint16_t>(symbol);
+            }
+
+            fast.fill(0);
+            unsigned code = 0;
+            size_t index = 0;
+            for (unsigned length = 1; length <= FAST_BITS; ++length)
+            {
+                for (unsigned i = 0; i < counts[length]; ++i, ++code)
+                {
+                    unsigned reversed = 0;
+                    for (unsigned bit = 0; bit < length; ++bit) reversed |= ((code >> bit) & 1) << (length - 1 - bit);
+
+                    uint16_t entry = static_cast<uint16_t>(symbols[index++] << 4 | length);
+                    for (unsigned slot = reversed; slot < fast.size(); slot += 1u << length) fast[slot] = entry;
+                }
+                code <<= 1;
+            }
+            return true;
+        }
+    };
+
+    class Decoder
+    {
+    public:
+        Decoder(const InflateInput& input, const InflateOutput& output)
+            : input(input), output(output), inputBuffer(INPUT_BUFFER_SIZE), window(WINDOW_SIZE)
+        {
+        }
+
+        InflateResult run()
+        {
+            bool lastBlock = false;
+            while (!lastBlock)
+            {
+                if (!need(3)) return failure;
+                lastBlock = take(1) != 0;
+                uint32_t type = take(2);
+
+                bool ok = false;
+                if (type == 0) ok = storedBlock();
+                else if (type == 1) ok = fixedBlock();
+                else if (type == 2) ok = dynamicBlock();
+                else failure = InflateResult::Corrupt;
+                if (!ok) return failure;
+            }
+
+            if (windowPosition > 0 && !output(window.data(), windowPosition)) return InflateResult::Stopped;
+            return InflateResult::Done;
+        }
+
+    private:
+        bool refill()
+        {
+            if (inputEnded) return false;
+            inputEnd = input(inputBuffer.data(), inputBuffer.size());
+            inputPosition = 0;
+            if (inputEnd == 0) inputEnded = true;
+            return inputEnd > 0;
+        }
+
+        // Makes sure count bits are buffered; false, with failure set, if the input ends first
+        bool need(unsigned count)
+        {
+            while (bitCount < count)
+            {
+                if (inputPosition == inputEnd && !refill())
+                {
+                    failure = InflateResult::Truncated;
+                    return false;
+                }
+                bitBuffer |= static_cast<uint64_t>(inputBuffer[inputPosition++]) << bitCount;
+                bitCount += 8;
+            }
+            return true;
+        }
+
+        uint32_t take(unsigned count)
+        {
+            uint32_t value = static_cast<uint32_t>(bitBuffer & ((1ull << count) - 1));
+            bitBuffer >>= count;
+            bitCount -= count;
+            return value;
+        }
+
+        // -1 with failure set if no symbol matches
+        int decode(const HuffmanCode& code)
+        {
+            // Buffers as many bits as the longest code without failing, since the last code of a stream may be short
+            while (bitCount < MAX_CODE_BITS && (inputPosition < inputEnd || refill()))
+            {
+                bitBuffer |= static_cast<uint64_t>(inputBuffer[inputPosition++]) << bitCount;
+                bitCount += 8;
+            }
+
+            uint16_t entry = code.fast[bitBuffer & ((1u << FAST_BITS) - 1)];
+            unsigned length = entry & 15;
+            if (length != 0 && length <= bitCount)
+            {
+                take(length);
+                return entry >> 4;
+            }
+
+            // Longer codes bit by bit: within each length the codes are consecutive, starting at first
+            int value = 0;
+            int first = 0;
+            int index = 0;
+            for (length = 1; length <= MAX_CODE_BITS; ++length)
+            {
+                if (length > bitCount)
+                {
+                    failure = InflateResult::Truncated;
+                    return -1;
+                }
+                value |= static_cast<int>((bitBuffer >> (length - 1)) & 1);
+                int count = code.counts[length];
+                if (value - count < first)
+                {
+                    take(length);
+                    return code.symbols[index + (value - first)];
+                }
+                index += count;
+                first = (first + count) << 1;
+                value <<= 1;
+            }
+
+            failure = InflateResult::Corrupt;
+            return -1;
+        }
+
+        bool emit(unsigned char byte)
+        {
+            window[windowPosition++] = byte;
+            totalOutput++;
+            if (windowPosition == WINDOW_SIZE)
+            {
+                windowPosition = 0;
+                if (!output(window.data(), WINDOW_SIZE))
+                {
+                    failure = InflateResult::Stopped;
+                    return false;
+                }
+            }
+            return true;
+        }
+
+        bool storedBlock()
+        {
+            take(bitCount % 8);
+            if (!need(32)) return false;
+            uint32_t length = take(16);
+            uint32_t complement = take(16);
+            if ((length ^ 0xFFFF) != complement)
+            {
+                failure = InflateResult::Corrupt;
+                return false;
+            }
+
+            for (uint32_t i = 0; i < length; ++i)
+            {
+                if (!need(8) || !emit(static_cast<unsigned char>(take(8)))) return false;
+            }
+            return true;
+        }
+
+        bool fixedBlock()
+        {
+            if (!fixedBuilt)
+            {
+                uint8_t lengths[LITERAL_CODES + DISTANCE_CODES];
+                size_t symbol = 0;
+                for (; symbol < 144; ++symbol) lengths[symbol] = 8;
+                for (; symbol < 256; ++symbol) lengths[symbol] = 9;
+                for (; symbol < 280; ++symbol) lengths[symbol] = 7;
+                for (; symbol < LITERAL_CODES; ++symbol) lengths[symbol] = 8;
+                for (; symbol < LITERAL_CODES + DISTANCE_CODES; ++symbol) lengths[symbol] = 5;
+
+                fixedLiterals.build(lengths, LITERAL_CODES);
+                fixedDistances.build(lengths + LITERAL_CODES, DISTANCE_CODES);
+                fixedBuilt = true;
+            }
+            return codes(fixedLiterals, fixedDistances);
+        }
+
+        bool dynamicBlock()
+        {
+            if (!need(14)) return false;
+            size_t literalCount = take(5) + 257;
+            size_t distanceCount = take(5) + 1;
+            size_t lengthCodeCount = take(4) + 4;
+            if (literalCount > 286 || distanceCount > DISTANCE_CODES)
+            {
+                failure = InflateResult::Corrupt;
+                return false;
+            }
+
+            uint8_t lengths[LITERAL_CODES + DISTANCE_CODES] = {};
+            for (size_t i = 0; i < lengthCodeCount; ++i)
+            {
+                if (!need(3)) return false;
+                lengths[CODE_LENGTH_ORDER[i]] = static_cast<uint8_t>(take(3));
+            }
+
+            HuffmanCode lengthCode;
+            if (!lengthCode.build(lengths, 19))
+            {
+                failure = InflateResult::Corrupt;
+                return false;
+            }
+
+            size_t index = 0;
+            while (index < literalCount + distanceCount)
+            {
+                int symbol = decode(lengthCode);
+                if (symbol < 0) return false;
+
+                if (symbol < 16)
+                {
+                    lengths[index++] = static_cast<uint8_t>(symbol);
+                    continue;
+                }
+
+                uint8_t repeated = 0;
+                size_t repeat = 0;
+                if (symbol == 16)
+                {
+                    if (index == 0)
+                    {
+                        failure = InflateResult::Corrupt;
+                        return false;
+                    }
+                    if (!need(2)) return false;
+                    repeated = lengths[index - 1];
+                    repeat = 3 + take(2);
+                }
+                else if (symbol == 17)
+                {
+                    if (!need(3)) return false;
+                    repeat = 3 + take(3);
+                }
+                else
+                {
+                    if (!need(7)) return false;
+                    repeat = 11 + take(7);
+                }
+
+                if (index + repeat > literalCount + distanceCount)
+                {
+                    failure = InflateResult::Corrupt;
+                    return false;
+                }
+                while (repeat-- > 0) lengths[index++] = repeated;
+            }
+
+            // Without an end-of-block code the block could never finish
+            if (lengths[256] == 0 || !literals.build(lengths, literalCount) || !distances.build(lengths + literalCount, distanceCount))
+            {
+                failure = InflateResult::Corrupt;
+                return false;
+            }
+            return codes(literals, distances);
+        }
+
+        bool codes(const HuffmanCode& literalCode, const HuffmanCode& distanceCode)
+        {
+            while (true)
+            {
+                int symbol = decode(literalCode);
+                if (symbol < 0) return false;
+                if (symbol < 256)
+                {
+                    if (!emit(static_cast<unsigned char>(symbol))) return false;
+                    continue;
+                }
+                if (symbol == 256) return true;
+
+                symbol -= 257;
+                if (symbol >= 29)
+                {
+                    failure = InflateResult::Corrupt;
+                    return false;
+                }
+                if (!need(LENGTH_EXTRA[symbol])) return false;
+                size_t length = LENGTH_BASE[symbol] + take(LENGTH_EXTRA[symbol]);
+
+                int distanceSymbol = decode(distanceCode);
+                if (distanceSymbol < 0) return false;
+                if (distanceSymbol >= static_cast<int>(DISTANCE_CODES))
+                {
+                    failure = InflateResult::Corrupt;
+                    return false;
+                }
+                if (!need(DISTANCE_EXTRA[distanceSymbol])) return false;
+                size_t distance = DISTANCE_BASE[distanceSymbol] + take(DISTANCE_EXTRA[distanceSymbol]);
+                if (distance > totalOutput)
+                {
+                    failure = InflateResult::Corrupt;
+                    return false;
+                }
+
+                // The window is a ring, and a match may overlap the bytes it is producing
+                size_t from = (windowPosition + WINDOW_SIZE - distance) % WINDOW_SIZE;
+                while (length-- > 0)
+                {
+                    if (!emit(window[from])) return false;
+                    from = (from + 1) % WINDOW_SIZE;
+                }
+            }
+        }
+
+        const InflateInput& input;
+        const InflateOutput& output;
+        InflateResult failure = InflateResult::Corrupt;
+
+        std::vector<unsigned char> inputBuffer;
+        size_t inputPosition = 0;
+        size_t inputEnd = 0;
+        bool inputEnded = false;
+        uint64_t bitBuffer = 0;
+        unsigned bitCount = 0;
+
+        std::vector<unsigned char> window;
+        size_t windowPosition = 0;
+        uint64_t totalOutput = 0;
+
+        HuffmanCode literals;
+        HuffmanCode distances;
+        HuffmanCode fixedLiterals;
+        HuffmanCode fixedDistances;
+        bool fixedBuilt = false;
+    };
+
+    std::array<uint32_t, 256> makeCrcTable()
+    {
+        std::array<uint32_t, 256> table{};
+        for (uint32_t i = 0; i < 256; ++i)
+        {
+            uint32_t value = i;
+            for (int bit = 0; bit < 8; ++bit) value = value & 1 ? 0xEDB88320u ^ (value >> 1) : value >> 1;
+            table[i] = value;
+        }
+        return table;
+    }
+}
+
+InflateResult inflateRaw(const InflateInput& input, const InflateOutput& output)
+{
+    Decoder decoder(input, output);
+    return decoder.run();
+}
+
+uint32_t crc32Update(uint32_t crc, const unsigned char* data, size_t length)
+{
+    static const std::array<uint32_t, 256> table = makeCrcTable();
+
+    crc = ~crc;
+    for (size_t i = 0; i < length; ++i) crc = table[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+    return ~crc;
+}
@@ -0,0 +1,28 @@
+#pragma once
+
+#include <functional>
+#include <cstdint>
+#include <cstddef>
+
+// Streaming decoder for raw deflate data (RFC 1951), the compression of almost every zip member. It holds the 32 KB
+// window and a 64 KB input buffer and nothing else, however large the member, and hands the output on in pieces
+// of up to the window size.
+
+// Fills the buffer with the next compressed bytes and returns how many; 0 once the input is used up
+using InflateInput = std::function<size_t(unsigned char* buffer, size_t capacity)>;
+
+// Receives the decompressed bytes in order; returning false stops decoding
+using InflateOutput = std::function<bool(const unsigned char* data, size_t length)>;
+
+enum class InflateResult
+{
+    Done,
+    Corrupt,   // not valid deflate data
+    Truncated, // the input ended before the last block did
+    Stopped    // the output asked to stop
+};
+
+InflateResult inflateRaw(const InflateInput& input, const InflateOutput& output);
+
+// CRC-32 as stored in zip headers; start from 0 and feed the data in any number of pieces
+uint32_t crc32Update(uint32_t crc, const unsigned char* data, size_t length);
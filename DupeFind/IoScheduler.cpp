@@ -0,0 +1,425 @@
+#include "IoScheduler.h"
+#include "Utilities.h"
+#include "ExtentMap.h"
+
+#include <string>
+#include <vector>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <chrono>
+#include <sstream>
+#include <iomanip>
+#include <algorithm>
+#include <numeric>
+#include <cwctype>
+
+#define WIN32_LEAN_AND_MEAN
+#include <Windows.h>
+#include <winioctl.h>
+
+namespace
+{
+    const uint64_t WINDOW_MS = 500;          // shortest measurement window
+    const double SIGNIFICANT_CHANGE = 0.05;  // throughput must move by 5% to count as better or worse
+    const double LATENCY_CLIMB = 1.5;        // latency growth that counts as queueing without benefit
+
+    struct ReaderLimits
+    {
+        unsigned lower;
+        unsigned upper;
+        unsigned initial;
+    };
+
+    ReaderLimits limitsFor(DeviceKind kind)
+    {
+        switch (kind)
+        {
+        case DeviceKind::Rotational: return { 1, 4, 1 };
+        case DeviceKind::SolidState: return { 2, 32, 4 };
+        case DeviceKind::Remote: return { 2, 16, 4 };
+        case DeviceKind::Unknown: break;
+        }
+        return { 1, 8, 2 };
+    }
+
+    const wchar_t* busTypeName(STORAGE_BUS_TYPE busType)
+    {
+        switch (busType)
+        {
+        case BusTypeUsb: return L"USB";
+        case BusTypeNvme: return L"NVMe";
+        case BusTypeSata: return L"SATA";
+        case BusTypeAta: return L"ATA";
+        case BusTypeSas: return L"SAS";
+        case BusTypeScsi: return L"SCSI";
+        case BusTypeRAID: return L"RAID";
+        case BusTypeiScsi: return L"iSCSI";
+        case BusTypeSd: return L"SD";
+        case BusTypeVirtual:
+        case BusTypeFileBackedVirtual: return L"virtual";
+        case BusTypeSpaces: return L"Storage Spaces";
+        default: return L"";
+        }
+    }
+
+    DeviceInfo detectVolumeDevice(const std::wstring& volumePath)
+    {
+        DeviceInfo info;
+        info.key = volumePath;
+        if (volumePath.empty()) return info;
+
+        if (GetDriveTypeW(volumePath.c_str()) == DRIVE_REMOTE)
+        {
+            info.kind = DeviceKind::Remote;
+            return info;
+        }
+
+        // "\\?\Volume{...}\" names the volume; without the trailing slash it opens the volume device itself
+        wchar_t volumeName[MAX_PATH] = {};
+        if (!GetVolumeNameForVolumeMountPointW(volumePath.c_str(), volumeName, MAX_PATH)) return info;
+
+        std::wstring devicePath = volumeName;
+        if (!devicePath.empty() && devicePath.back() == L'\\') devicePath.pop_back();
+
+        // No access rights are needed for property queries, so this works without elevation
+        HANDLE hVolume = CreateFileW(devicePath.c_str(), 0, FILE_SHARE_READ | FILE_SHARE_WRITE, NULL, OPEN_EXISTING, 0, NULL);
+        if (hVolume == INVALID_HANDLE_VALUE) return info;
+
+        STORAGE_PROPERTY_QUERY query = {};
+        query.PropertyId = StorageDeviceSeekPenaltyProperty;
+        query.QueryType = PropertyStandardQuery;
+
+        DEVICE_SEEK_PENALTY_DESCRIPTOR seekPenalty = {};
+        DWORD bytesReturned = 0;
+        if (DeviceIoControl(hVolume, IOCTL_STORAGE_QUERY_PROPERTY, &query, sizeof(query), &seekPenalty, sizeof(seekPenalty), &bytesReturned, NULL)
+            && bytesReturned >= sizeof(seekPenalty))
+        {
+            info.kind = seekPenalty.IncursSeekPenalty ? DeviceKind::Rotational : DeviceKind::SolidState;
+        }
+
+        query.PropertyId = StorageDeviceProperty;
+        STORAGE_DEVICE_DESCRIPTOR descriptor = {};
+        if (DeviceIoControl(hVolume, IOCTL_STORAGE_QUERY_PROPERTY, &query, sizeof(query), &descriptor, sizeof(descriptor), &bytesReturned, NULL)
+            && bytesReturned >= offsetof(STORAGE_DEVICE_DESCRIPTOR, RawPropertiesLength))
+        {
+            info.busName = busTypeName(descriptor.BusType);
+        }
+
+        CloseHandle(hVolume);
+        return info;
+    }
+
+    std::wstring describeDevice(const DeviceInfo& device)
+    {
+        std::wstring text = device.key.empty() ? std::wstring(L"(unknown volume)") : device.key;
+        text += L" (";
+        text += deviceKindName(device.kind);
+        if (!device.busName.empty())
+        {
+            text += L", ";
+            text += device.busName;
+        }
+        text += L")";
+        return text;
+    }
+
+    std::wstring describeWindow(const ConcurrencyController& controller)
+    {
+        std::wostringstream text;
+        text << std::fixed << std::setprecision(1)
+             << utf8ToWstring(formatFileSize(static_cast<uintmax_t>(controller.lastThroughput()))) << L"/s, "
+             << controller.lastLatency() * 1000.0 << L" ms per file";
+        return text.str();
+    }
+
+    struct DevicePool
+    {
+        DevicePool(const DeviceInfo& info, unsigned fixedReaders, const MessageHandler* onMessage)
+            : device(info), onMessage(onMessage), controller(info.kind, fixedReaders) {}
+
+        DeviceInfo device;
+        const MessageHandler* onMessage; // the caller's, for the "I/O:" lines
+        std::vector<size_t> jobs;
+        size_t nextJob = 0;
+
+        std::mutex mutex;
+        std::condition_variable wake;
+        ConcurrencyController controller;
+        unsigned lowestLimit = 0;
+        unsigned highestLimit = 0;
+    };
+
+    struct SweepCost
+    {
+        uint64_t seeks = 0;
+        uint64_t travelClusters = 0;
+    };
+
+    // Estimated head movement for reading the files in this order, from the first extent of each file
+    SweepCost estimateSweepCost(const std::vector<PhysicalLocation>& locations, const std::vector<size_t>& order)
+    {
+        SweepCost cost;
+        bool started = false;
+        uint64_t headPosition = 0;
+
+        for (size_t index : order)
+        {
+            const PhysicalLocation& location = locations[index];
+            if (!location.hasCluster) continue;
+
+            if (!started || location.volumeCluster != headPosition)
+            {
+                cost.seeks++;
+                if (started)
+                {
+                    cost.travelClusters += location.volumeCluster > headPosition ? location.volumeCluster - headPosition : headPosition - location.volumeCluster;
+                }
+            }
+
+            started = true;
+            headPosition = location.volumeCluster + location.clusterCount;
+        }
+
+        return cost;
+    }
+
+    void orderByPhysicalLocation(DevicePool& pool, const std::vector<ReadJob>& jobs)
+    {
+        std::vector<PhysicalLocation> locations(pool.jobs.size());
+        for (size_t i = 0; i < pool.jobs.size(); ++i)
+        {
+            locations[i] = queryPhysicalLocation(jobs[pool.jobs[i]].path);
+        }
+
+        std::vector<size_t> order(pool.jobs.size());
+        std::iota(order.begin(), order.end(), 0);
+        SweepCost before = estimateSweepCost(locations, order);
+
+        // Each job's batch is known by where its run of equal batches starts, so batches keep the given order
+        std::vector<size_t> batchStart(pool.jobs.size(), 0);
+        for (size_t i = 1; i < pool.jobs.size(); ++i)
+        {
+            batchStart[i] = jobs[pool.jobs[i]].batch == jobs[pool.jobs[i - 1]].batch ? batchStart[i - 1] : i;
+        }
+
+        // Files without clusters live in the MFT near the start of the volume, so they go first, by record number
+        std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b)
+        {
+            if (batchStart[a] != batchStart[b]) return batchStart[a] < batchStart[b];
+            const PhysicalLocation& x = locations[a];
+            const PhysicalLocation& y = locations[b];
+            if (x.hasCluster != y.hasCluster) return !x.hasCluster;
+            return x.hasCluster ? x.volumeCluster < y.volumeCluster : x.fileIndex < y.fileIndex;
+        });
+        SweepCost after = estimateSweepCost(locations, order);
+
+        std::vector<size_t> sortedJobs(pool.jobs.size());
+        for (size_t i = 0; i < order.size(); ++i)
+        {
+            sortedJobs[i] = pool.jobs[order[i]];
+        }
+        pool.jobs.swap(sortedJobs);
+
+        uint64_t clusterSize = jobs.empty() ? 0 : volumeClusterSize(jobs[pool.jobs.front()].path);
+        printMessage(pool.onMessage, L"I/O: ", pool.device.key, L" reads ", std::to_wstring(pool.jobs.size()), L" files in physical order, estimated seeks ",
+            std::to_wstring(before.seeks), L" -> ", std::to_wstring(after.seeks), L", head travel ",
+            utf8ToWstring(formatFileSize(before.travelClusters * clusterSize)), L" -> ", utf8ToWstring(formatFileSize(after.travelClusters * clusterSize)));
+    }
+
+    void runReader(DevicePool& pool, unsigned readerIndex, const std::function<uint64_t(size_t)>& readJob)
+    {
+        std::unique_lock<std::mutex> lock(pool.mutex);
+
+        while (true)
+        {
+            // Readers above the current limit park here until the controller raises it or the work runs out
+            pool.wake.wait(lock, [&] { return pool.nextJob >= pool.jobs.size() || readerIndex < pool.controller.limit(); });
+            if (pool.nextJob >= pool.jobs.size()) break;
+
+            size_t job = pool.jobs[pool.nextJob++];
+            if (pool.nextJob >= pool.jobs.size()) pool.wake.notify_all();
+
+            lock.unlock();
+            auto start = std::chrono::steady_clock::now();
+            uint64_t bytes = readJob(job);
+            double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            lock.lock();
+
+            unsigned oldLimit = pool.controller.limit();
+            if (pool.controller.recordCompletion(bytes, seconds))
+            {
+                unsigned newLimit = pool.controller.limit();
+                pool.lowestLimit = std::min<unsigned>(pool.lowestLimit, newLimit);
+                pool.highestLimit = std::max<unsigned>(pool.highestLimit, newLimit);
+
+                printMessage(pool.onMessage, L"I/O: ", pool.device.key, L" ", std::to_wstring(oldLimit), L" -> ", std::to_wstring(newLimit),
+                    L" readers (", describeWindow(pool.controller), L")");
+                pool.wake.notify_all();
+            }
+        }
+    }
+}
+
+bool parseReadOrder(const std::wstring& name, ReadOrder& order)
+{
+    std::wstring lower = name;
+    std::transform(lower.begin(), lower.end(), lower.begin(), ::towlower);
+
+    if (lower == L"auto") order = ReadOrder::Auto;
+    else if (lower == L"physical") order = ReadOrder::Physical;
+    else if (lower == L"given") order = ReadOrder::Given;
+    else return false;
+
+    return true;
+}
+
+DeviceInfo detectDevice(const fs::path& filePath)
+{
+    return detectVolumeDevice(volumePathOf(filePath));
+}
+
+const wchar_t* deviceKindName(DeviceKind kind)
+{
+    switch (kind)
+    {
+    case DeviceKind::Rotational: return L"rotational";
+    case DeviceKind::SolidState: return L"solid state";
+    case DeviceKind::Remote: return L"network";
+    case DeviceKind::Unknown: break;
+    }
+    return L"unknown";
+}
+
+ConcurrencyController::ConcurrencyController(DeviceKind kind, unsigned fixedLimit)
+{
+    if (fixedLimit > 0)
+    {
+        lowerLimit = upperLimit = currentLimit = fixedLimit;
+        adaptive = false;
+    }
+    else
+    {
+        ReaderLimits limits = limitsFor(kind);
+        lowerLimit = limits.lower;
+        upperLimit = limits.upper;
+        currentLimit = limits.initial;
+    }
+
+    windowStartTick = GetTickCount64();
+}
+
+bool ConcurrencyController::recordCompletion(uint64_t bytes, double seconds)
+{
+    windowBytes += bytes;
+    windowLatencySum += seconds;
+    windowCompletions++;
+
+    // A window needs enough time and at least one completion per reader to say anything about this limit
+    if (GetTickCount64() - windowStartTick < WINDOW_MS || windowCompletions < currentLimit) return false;
+
+    unsigned oldLimit = currentLimit;
+    closeWindow();
+    return currentLimit != oldLimit;
+}
+
+void ConcurrencyController::closeWindow()
+{
+    uint64_t now = GetTickCount64();
+    double elapsed = std::max<double>(0.001, (now - windowStartTick) / 1000.0);
+    windowThroughput = windowBytes / elapsed;
+    windowLatency = windowLatencySum / windowCompletions;
+
+    if (adaptive && previousThroughput > 0)
+    {
+        if (windowThroughput < previousThroughput * (1.0 - SIGNIFICANT_CHANGE))
+        {
+            direction = -direction; // the last step hurt, undo it
+        }
+        else if (windowThroughput <= previousThroughput * (1.0 + SIGNIFICANT_CHANGE) && windowLatency > previousLatency * LATENCY_CLIMB)
+        {
+            direction = -1; // the same throughput at a higher latency means the extra readers only queue
+        }
+    }
+
+    if (adaptive)
+    {
+        // Steps scale with the limit so deep queues on fast devices are reached in a few windows
+        int step = std::max<int>(1, currentLimit / 4);
+        int next = static_cast<int>(currentLimit) + direction * step;
+        currentLimit = static_cast<unsigned>(std::clamp<int>(next, lowerLimit, upperLimit));
+
+        if (currentLimit == upperLimit) direction = -1;
+        else if (currentLimit == lowerLimit) direction = 1;
+    }
+
+    previousThroughput = windowThroughput;
+    previousLatency = windowLatency;
+    windowStartTick = now;
+    windowBytes = 0;
+    windowLatencySum = 0;
+    windowCompletions = 0;
+}
+
+void runScheduledReads(const std::vector<ReadJob>& jobs, const std::function<uint64_t(size_t)>& readJob, const IoSchedulerOptions& options)
+{
+    // Devices are detected once per volume; files of one directory are always on the same volume
+    std::map<std::wstring, std::wstring> volumeOfDirectory;
+    std::map<std::wstring, std::unique_ptr<DevicePool>> pools;
+
+    for (size_t i = 0; i < jobs.size(); ++i)
+    {
+        std::wstring directory = jobs[i].path.parent_path().wstring();
+        auto known = volumeOfDirectory.find(directory);
+        if (known == volumeOfDirectory.end())
+        {
+            known = volumeOfDirectory.emplace(directory, volumePathOf(jobs[i].path)).first;
+        }
+
+        auto& pool = pools[known->second];
+        if (!pool)
+        {
+            pool = std::make_unique<DevicePool>(detectVolumeDevice(known->second), options.fixedReaders, &options.onMessage);
+            pool->lowestLimit = pool->highestLimit = pool->controller.limit();
+
+            printMessage(&options.onMessage, L"I/O: ", describeDevice(pool->device), L" starts with ", std::to_wstring(pool->controller.limit()),
+                L" of up to ", std::to_wstring(pool->controller.maxLimit()), L" readers");
+        }
+        pool->jobs.push_back(i);
+    }
+
+    for (auto& [volume, pool] : pools)
+    {
+        bool sortPhysically = options.order == ReadOrder::Physical
+            || (options.order == ReadOrder::Auto && pool->device.kind == DeviceKind::Rotational);
+
+        if (sortPhysically && pool->jobs.size() > 1)
+        {
+            orderByPhysicalLocation(*pool, jobs);
+        }
+    }
+
+    // Every device runs its own readers, so a slow USB disk does not hold back an NVMe drive
+    std::vector<std::thread> readers;
+    for (auto& [volume, pool] : pools)
+    {
+        unsigned readerCount = static_cast<unsigned>(std::min<size_t>(pool->controller.maxLimit(), pool->jobs.size()));
+        for (unsigned r = 0; r < readerCount; ++r)
+        {
+            readers.emplace_back(runReader, std::ref(*pool), r, std::cref(readJob));
+        }
+    }
+
+    for (auto& reader : readers)
+    {
+        reader.join();
+    }
+
+    for (const auto& [volume, pool] : pools)
+    {
+        printMessage(&options.onMessage, L"I/O: ", describeDevice(pool->device), L" read ", std::to_wstring(pool->jobs.size()), L" files with ",
+            std::to_wstring(pool->lowestLimit), L"-", std::to_wstring(pool->highestLimit), L" readers, finished at ", std::to_wstring(pool->controller.limit()));
+    }
+}
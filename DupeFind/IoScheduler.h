@@ -0,0 +1,99 @@
+#pragma once
+
+#include <filesystem>
+#include <functional>
+#include <string>
+#include <vector>
+#include <cstdint>
+
+#include "Utilities.h"
+
+namespace fs = std::filesystem;
+
+enum class DeviceKind
+{
+    Unknown,
+    Rotational,  // incurs a seek penalty, every extra reader costs head movement
+    SolidState,  // SATA/NVMe flash, wants a deep queue
+    Remote       // network share, latency bound
+};
+
+struct DeviceInfo
+{
+    std::wstring key;      // volume the file lives on, e.g. "C:\"
+    DeviceKind kind = DeviceKind::Unknown;
+    std::wstring busName;  // "NVMe", "USB", ... if the storage stack reports it
+};
+
+// Finds the volume a file lives on and asks the storage stack whether it has a seek penalty
+DeviceInfo detectDevice(const fs::path& filePath);
+
+const wchar_t* deviceKindName(DeviceKind kind);
+
+// Feedback controller for the number of concurrent readers on one device. Completed reads are collected
+// into measurement windows; after each window the limit takes a step in the direction that last improved
+// throughput, and backs off when throughput drops or latency climbs without a throughput gain.
+class ConcurrencyController
+{
+public:
+    explicit ConcurrencyController(DeviceKind kind, unsigned fixedLimit = 0);
+
+    // Records one completed read. Returns true if the limit changed at the end of a window.
+    bool recordCompletion(uint64_t bytes, double seconds);
+
+    unsigned limit() const { return currentLimit; }
+    unsigned maxLimit() const { return upperLimit; }
+
+    double lastThroughput() const { return windowThroughput; }
+    double lastLatency() const { return windowLatency; }
+
+private:
+    void closeWindow();
+
+    unsigned lowerLimit = 1;
+    unsigned upperLimit = 1;
+    unsigned currentLimit = 1;
+    bool adaptive = true;
+    int direction = 1;
+
+    uint64_t windowStartTick = 0;
+    uint64_t windowBytes = 0;
+    double windowLatencySum = 0;
+    unsigned windowCompletions = 0;
+
+    double windowThroughput = 0;
+    double windowLatency = 0;
+    double previousThroughput = 0;
+    double previousLatency = 0;
+};
+
+enum class ReadOrder
+{
+    Auto,      // physical order on rotational devices, the given order everywhere else
+    Physical,  // always sort by physical location
+    Given      // keep the order the caller passed
+};
+
+bool parseReadOrder(const std::wstring& name, ReadOrder& order);
+
+struct IoSchedulerOptions
+{
+    unsigned fixedReaders = 0; // 0 lets the controller tune each device
+    ReadOrder order = ReadOrder::Auto;
+    MessageHandler onMessage;  // gets the "I/O:" lines instead of the console, from the reader threads too
+};
+
+struct ReadJob
+{
+    fs::path path;
+    uint64_t size = 0;
+    uint64_t batch = 0; // consecutive jobs with the same batch are sorted physically among themselves only
+};
+
+// Runs readJob(index) for every job. Jobs are split by device and each device gets its own pool of readers,
+// sized by its controller while the pass runs. readJob returns the number of bytes it read, is called from
+// several threads at once and must not throw. Jobs of one device are started in the order given, unless the
+// read order sorts them by their first cluster on disk (MFT record number for files without one) so the
+// heads sweep across the platter once instead of seeking back and forth. That sort stays within each batch, so
+// work the caller wants finished early, like a whole size run of candidates, is not spread over the whole sweep.
+void runScheduledReads(const std::vector<ReadJob>& jobs, const std::function<uint64_t(size_t)>& readJob, const IoSchedulerOptions& options = {});
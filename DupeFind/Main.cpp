@@ -5,56 +5,299 @@
 #include "InputHandler.h"
 #include "ReportGenerator.h"
 #include "Utilities.h"
+#include "ScanJournal.h"
+#include "ChunkAnalyzer.h"
+#include "FileFilter.h"
+#include "Options.h"
+#include "IndexCommands.h"
+#include "ShardScan.h"
+#include "BoundedQueue.h"
+#include "DirectoryDigest.h"
+#include "ScanSnapshot.h"
+#include "SnapshotCommands.h"
+#include "Throttle.h"
+#include "ArchiveScan.h"
+#include "ResultStore.h"
+#include "ReviewSession.h"
+#include "BenchCommands.h"
+#include "TestCommands.h"
 
 #include <iostream>
 #include <filesystem>
 #include <string>
 #include <vector>
 #include <map>
+#include <thread>
+#include <mutex>
+#include <memory>
+#include <optional>
+#include <cstdint>
 
 #include <io.h>
 #include <fcntl.h>
 
 namespace fs = std::filesystem;
 
-int main()
+// Confirmed groups waiting for the report and removal stages; hashing blocks once this many are queued
+const size_t DUPLICATE_GROUP_QUEUE_CAPACITY = 64;
+
+int wmain(int argc, wchar_t* argv[])
 {
 	(void)_setmode(_fileno(stdin), _O_U16TEXT);
 	(void)_setmode(_fileno(stdout), _O_U16TEXT);
 	(void)_setmode(_fileno(stderr), _O_U16TEXT);
 
+	ProgramOptions options;
+	if (!parseCommandLine(argc, argv, options) || options.showHelp)
+	{
+		printUsage();
+		return options.showHelp ? 0 : 1;
+	}
+
+	// Set before any command runs, so index and shard scans on a shared machine keep to the same budget
+	ioThrottle().setLimits(options.throttleLimits);
+	if (options.backgroundPriority && !enterBackgroundMode())
+	{
+		printUnicode(L"Warning: Could not switch to background priority, running at normal priority.", true);
+	}
+
+	std::unique_ptr<ThrottleMonitor> throttleMonitor;
+	if (!options.throttleControlFile.empty() || options.pauseAbovePercent > 0)
+	{
+		throttleMonitor = std::make_unique<ThrottleMonitor>(options.throttleControlFile, options.pauseAbovePercent, options.throttleLimits);
+	}
+
+	if (!options.command.empty())
+	{
+		if (options.command.front() == L"shard") return runShardCommand(options);
+		if (options.command.front() == L"snapshot") return runSnapshotCommand(options);
+		if (options.command.front() == L"review") return runReviewCommand(options);
+		if (options.command.front() == L"bench") return runBenchCommand(options);
+		if (options.command.front() == L"test") return runTestCommand(options);
+		return runIndexCommand(options);
+	}
+
 	resetLogFiles();
 
 	std::wcout << L"DupeFind is ready!" << std::endl;
 	fs::path folderPath;
-	while (true) 
+	std::vector<ScanNode> scanNodes;
+	std::vector<fs::path> foundPaths;
+	std::vector<std::optional<Sha256Digest>> fileDigests;
+
+	ScanJournal journal(L"dupefind_journal.dat");
+	std::unique_ptr<IoExecutor> executor;
+	const bool fromSnapshot = !options.loadSnapshotPath.empty();
+
+	if (fromSnapshot)
 	{
-        std::wstring input = getUserInput(L"Enter folder path to scan: ");
-		printUnicodeMulti(true, L"DEBUG Input Path: ", input); // TODO: Remove this line after debugging
-		folderPath = convertToPath(input);
-		if (folderPath.empty()) 
+		// The saved scan and digests replace the scan and hash stages, so nothing on disk is read until removal
+		ScanSnapshot snapshot;
+		if (!snapshot.open(options.loadSnapshotPath) || !snapshot.load(foundPaths, scanNodes, fileDigests))
 		{
-			std::wcout << L"Please enter a valid folder path: " << std::endl;
-			continue;
+			printUnicodeMulti(true, L"Error: Could not load the snapshot ", options.loadSnapshotPath.wstring());
+			return 1;
 		}
-		break;
+		folderPath = snapshot.root();
+
+		std::wcout << L"\nLoaded " << foundPaths.size() << L" files and directories in: " << folderPath.wstring()
+			<< L" from the snapshot saved " << formatSnapshotTime(snapshot.createdTime()) << L"." << std::endl;
+		std::wcout << L"Changes made since then are not seen; rescan if the folder was modified." << std::endl;
 	}
+	else
+	{
+		while (true) 
+		{
+	        std::wstring input = getUserInput(L"Enter folder path to scan: ");
+			printUnicodeMulti(true, L"DEBUG Input Path: ", input); // TODO: Remove this line after debugging
+			folderPath = convertToPath(input);
+			if (folderPath.empty()) 
+			{
+				std::wcout << L"Please enter a valid folder path: " << std::endl;
+				continue;
+			}
+			break;
+		}
 
 
-    std::vector<fs::path> foundPaths = getAllFilesAndDirectories(folderPath);
-    std::wcout << L"\nScan completed. Found " << foundPaths.size() << L" files and directories in: " << folderPath.wstring() << std::endl;
+		// Progress is checkpointed so an interrupted run can pick up where it stopped
+		bool resume = false;
+		if (journal.load(folderPath))
+		{
+			std::wcout << L"\nFound a checkpoint from an interrupted scan of this folder ("
+				<< journal.completedDirectoryCount() << L" directories listed, "
+				<< journal.knownHashCount() << L" files hashed)." << std::endl;
+			resume = getUserConfirmation(L"Resume from the checkpoint? (Y/n): ");
+		}
+		journal.open(folderPath, resume);
 
-	writeScanLog(foundPaths, folderPath, 1000);
+		// Skip rules come from dupefind_filters.txt if it exists, otherwise the built-in defaults are used
+		FileFilter filter = loadFileFilter(L"dupefind_filters.txt");
+
+		// The coroutine engine shares one executor between the scan and hash stages
+		if (options.engine == ExecutionEngine::Coroutines)
+		{
+			executor = std::make_unique<IoExecutor>();
+		}
+
+	    foundPaths = getAllFilesAndDirectories(folderPath, &journal, &filter, executor.get(), &scanNodes);
+	    std::wcout << L"\nScan completed. Found " << foundPaths.size() << L" files and directories in: " << folderPath.wstring() << std::endl;
+	}
+
+	writeScanLog(foundPaths, scanNodes, folderPath, options.fullScanLog ? SIZE_MAX : 1000);
     
 	std::wcout << L"You can read about the found files in the log!" << std::endl;
 
+	// Asked up front so each duplicate group can be acted on the moment it is confirmed. Without two files of the same
+	// size there is nothing to remove, so there is nothing to ask either.
+	RemovalMode removalMode = RemovalMode::KeepAll;
+	if (anySizeShared(scanNodes))
+	{
+		removalMode = chooseRemovalMode();
+	}
+	else
+	{
+		std::wcout << L"\nNo two files have the same size, so there are no duplicates to remove." << std::endl;
+	}
+
+	// Automatic and review mode write the groups to disk as they come, so however many there are, none of them stays in memory
+	ResultStoreWriter resultWriter;
+	const bool storeResults = removalMode == RemovalMode::Automatic || removalMode == RemovalMode::Review;
+	if (storeResults && !resultWriter.create(DEFAULT_RESULTS_FILE))
+	{
+		std::wcout << L"Keeping all files, since the groups cannot be stored until hashing is done." << std::endl;
+		removalMode = RemovalMode::KeepAll;
+	}
+	const bool storeForRemoval = removalMode == RemovalMode::Automatic || removalMode == RemovalMode::Review;
+
+	HashOptions hashOptions = options.hashOptions;
+	// progress lines would run through the prompts, unless those only come once hashing is done
+	hashOptions.showProgress = removalMode != RemovalMode::Interactive || options.groupDirectories;
+	hashOptions.executor = executor.get();
+
     std::wcout << L"\nChecking for duplicate files..." << std::endl;
-    std::map<std::string, std::vector<fs::path>> duplicateGroups = groupFilesByHash(foundPaths);
-    size_t duplicateGroupCount = processDuplicateGroups(duplicateGroups);
-    if (duplicateGroupCount > 0)
-    {
-        handleDuplicateRemoval(duplicateGroups);
-    }
+
+	DuplicateReport report(options.topGroups, folderPath);
+	DuplicateRemover remover(removalMode);
+
+	if (fromSnapshot || options.groupDirectories)
+	{
+		// A folder's digest needs every file under it, so the groups wait for the whole pass (a snapshot has them all
+		// already). Identical folders are handled first; the file groups then leave out whatever those folders contain.
+		std::vector<DuplicateGroup> fileGroups;
+		if (fromSnapshot)
+		{
+			fileGroups = groupByDigest(foundPaths, scanNodes, fileDigests);
+		}
+		else
+		{
+			std::mutex fileGroupsMutex; // groups arrive from the reader threads
+			streamFilesByHash(foundPaths, scanNodes, &journal, hashOptions, [&](DuplicateGroup&& group)
+			{
+				std::lock_guard<std::mutex> lock(fileGroupsMutex);
+				fileGroups.push_back(std::move(group));
+			}, &fileDigests);
+		}
+
+		// Saved before removal, so the snapshot can be run again with another removal mode
+		if (!options.saveSnapshotPath.empty() && writeScanSnapshot(options.saveSnapshotPath, folderPath, foundPaths, scanNodes, fileDigests))
+		{
+			printUnicodeMulti(true, L"Saved the scan to ", options.saveSnapshotPath.wstring());
+		}
+
+		if (options.groupDirectories)
+		{
+			DirectoryDuplicates directories = findDuplicateDirectories(foundPaths, scanNodes, fileDigests);
+			for (const auto& directoryGroup : directories.groups)
+			{
+				report.addDirectoryGroup(directoryGroup.hash, directoryGroup.directories, directoryGroup.bytes, directoryGroup.files);
+				remover.handleDirectoryGroup(directoryGroup);
+				if (storeForRemoval) resultWriter.addDirectoryGroup(directoryGroup);
+			}
+			removeCoveredFiles(fileGroups, foundPaths, directories.covered);
+		}
+
+		for (const auto& group : fileGroups)
+		{
+			report.addGroup(group.hash, group.files, group.fileSize);
+			remover.handleGroup(group);
+			if (storeForRemoval) resultWriter.addGroup(group);
+		}
+	}
+	else
+	{
+		// Hashing runs on its own thread and hands confirmed groups to the report and removal stages here. The queue is
+		// bounded, so while removal waits for the user, hashing waits for removal instead of piling up groups.
+		const bool saveSnapshot = !options.saveSnapshotPath.empty();
+		const bool keepDigests = saveSnapshot || options.scanArchives;
+		BoundedQueue<DuplicateGroup> confirmedGroups(DUPLICATE_GROUP_QUEUE_CAPACITY);
+		std::thread hashingStage([&]
+		{
+			streamFilesByHash(foundPaths, scanNodes, &journal, hashOptions, [&](DuplicateGroup&& group) { confirmedGroups.push(std::move(group)); },
+				keepDigests ? &fileDigests : nullptr);
+			confirmedGroups.close();
+		});
+
+		DuplicateGroup group;
+		while (confirmedGroups.pop(group))
+		{
+			report.addGroup(group.hash, group.files, group.fileSize);
+			remover.handleGroup(group);
+			if (storeForRemoval) resultWriter.addGroup(group);
+		}
+		hashingStage.join();
+
+		// The files removed while hashing are still in it, as the snapshot records the folder as it was scanned
+		if (saveSnapshot && writeScanSnapshot(options.saveSnapshotPath, folderPath, foundPaths, scanNodes, fileDigests))
+		{
+			printUnicodeMulti(true, L"Saved the scan to ", options.saveSnapshotPath.wstring());
+		}
+	}
+
+	// Archive members only come after every loose file is hashed, since their digests are compared with those. They are
+	// reported but never removed; the loose copies in these groups were already offered for removal in their own groups.
+	if (options.scanArchives)
+	{
+		ArchiveDuplicates archiveDuplicates = findArchiveDuplicates(foundPaths, scanNodes, fileDigests, hashOptions);
+		printUnicodeMulti(true, L"Looked inside ", std::to_wstring(archiveDuplicates.archives), L" archives: ", std::to_wstring(archiveDuplicates.members),
+			L" members, ", std::to_wstring(archiveDuplicates.membersHashed), L" read, ", std::to_wstring(archiveDuplicates.membersSkippedByCrc),
+			L" ruled out by their CRC");
+		for (const auto& group : archiveDuplicates.groups)
+		{
+			report.addArchiveGroup(group.hash, group.files, group.members, group.size);
+		}
+	}
+
+	report.finish();
+
+	// The report comes first, so removal starts from its summary of where the wasted space is
+	if (storeForRemoval && resultWriter.finish())
+	{
+		printUnicodeMulti(true, L"Saved ", std::to_wstring(resultWriter.groupCount()), L" groups to ", DEFAULT_RESULTS_FILE);
+		if (removalMode == RemovalMode::Review)
+		{
+			reviewResults(DEFAULT_RESULTS_FILE, remover);
+		}
+		else
+		{
+			removeResultsAutomatically(DEFAULT_RESULTS_FILE, remover);
+		}
+	}
+	remover.finish();
+
+	// The run is complete, so there is nothing left to resume (a run from a snapshot never opened the journal)
+	if (!fromSnapshot)
+	{
+		journal.discard();
+	}
+
+	// Whole-file hashing misses files that share most but not all of their bytes
+	if (getUserConfirmation(L"\nRun block-level (partial) duplicate analysis? (y/N): ", false))
+	{
+		ChunkingOptions chunkingOptions;
+		chunkingOptions.readPolicy = options.hashOptions.readPolicy;
+		analyzeChunkDuplication(foundPaths, chunkingOptions);
+	}
 	
 	std::wcout << L"\nPress enter to exit...";
 	std::wstring quitInput;
@@ -0,0 +1,274 @@
+﻿#include "Options.h"
+#include "Utilities.h"
+
+#include <string>
+#include <cwchar>
+
+namespace
+{
+    // Splits "--name=value" or takes the value from the next argument
+    bool takeValue(int argc, wchar_t* argv[], int& index, const std::wstring& argument, std::wstring& name, std::wstring& value)
+    {
+        size_t equals = argument.find(L'=');
+        if (equals != std::wstring::npos)
+        {
+            name = argument.substr(0, equals);
+            value = argument.substr(equals + 1);
+            return true;
+        }
+
+        name = argument;
+        if (index + 1 >= argc) return false;
+        value = argv[++index];
+        return true;
+    }
+}
+
+bool parseCommandLine(int argc, wchar_t* argv[], ProgramOptions& options)
+{
+    for (int i = 1; i < argc; ++i)
+    {
+        std::wstring argument = argv[i];
+
+        if (argument == L"--help" || argument == L"-h" || argument == L"/?")
+        {
+            options.showHelp = true;
+            continue;
+        }
+
+        if (argument == L"--server")
+        {
+            options.useIndexServer = true;
+            continue;
+        }
+
+        if (argument == L"--full-scan-log")
+        {
+            options.fullScanLog = true;
+            continue;
+        }
+
+        if (argument == L"--directories")
+        {
+            options.groupDirectories = true;
+            continue;
+        }
+
+        if (argument == L"--archives")
+        {
+            options.scanArchives = true;
+            continue;
+        }
+
+        if (argument == L"--background")
+        {
+            options.backgroundPriority = true;
+            continue;
+        }
+
+        if (argument.rfind(L"--", 0) != 0)
+        {
+            options.command.push_back(argument);
+            continue;
+        }
+
+        std::wstring name;
+        std::wstring value;
+        if (!takeValue(argc, argv, i, argument, name, value))
+        {
+            printUnicodeMulti(true, L"Invalid argument: ", argument);
+            return false;
+        }
+
+        if (name == L"--read-policy")
+        {
+            if (!parseReadPolicy(value, options.hashOptions.readPolicy))
+            {
+                printUnicodeMulti(true, L"Unknown read policy: ", value, L" (expected buffered, sequential, lowcache or direct)");
+                return false;
+            }
+        }
+        else if (name == L"--read-order")
+        {
+            if (!parseReadOrder(value, options.hashOptions.scheduling.order))
+            {
+                printUnicodeMulti(true, L"Unknown read order: ", value, L" (expected auto, physical or given)");
+                return false;
+            }
+        }
+        else if (name == L"--readers")
+        {
+            wchar_t* end = nullptr;
+            unsigned long readers = std::wcstoul(value.c_str(), &end, 10);
+            if (value.empty() || *end != L'\0' || readers > 256)
+            {
+                printUnicodeMulti(true, L"Invalid reader count: ", value, L" (expected 0 for automatic, or 1 to 256)");
+                return false;
+            }
+            options.hashOptions.scheduling.fixedReaders = static_cast<unsigned>(readers);
+        }
+        else if (name == L"--engine")
+        {
+            if (value == L"threads") options.engine = ExecutionEngine::Threads;
+            else if (value == L"coroutines") options.engine = ExecutionEngine::Coroutines;
+            else
+            {
+                printUnicodeMulti(true, L"Unknown engine: ", value, L" (expected threads or coroutines)");
+                return false;
+            }
+        }
+        else if (name == L"--in-flight")
+        {
+            wchar_t* end = nullptr;
+            unsigned long files = std::wcstoul(value.c_str(), &end, 10);
+            if (value.empty() || *end != L'\0' || files == 0 || files > 65536)
+            {
+                printUnicodeMulti(true, L"Invalid in-flight count: ", value, L" (expected 1 to 65536)");
+                return false;
+            }
+            options.hashOptions.filesInFlight = files;
+        }
+        else if (name == L"--top")
+        {
+            wchar_t* end = nullptr;
+            unsigned long count = std::wcstoul(value.c_str(), &end, 10);
+            if (value.empty() || *end != L'\0' || count > 10000)
+            {
+                printUnicodeMulti(true, L"Invalid top count: ", value, L" (expected 0 to 10000)");
+                return false;
+            }
+            options.topGroups = count;
+        }
+        else if (name == L"--filter-fpr")
+        {
+            wchar_t* end = nullptr;
+            double rate = std::wcstod(value.c_str(), &end);
+            if (value.empty() || *end != L'\0' || !(rate > 0 && rate < 1))
+            {
+                printUnicodeMulti(true, L"Invalid false-positive rate: ", value, L" (expected a value between 0 and 1, e.g. 0.01)");
+                return false;
+            }
+            options.prefilterFalsePositiveRate = rate;
+        }
+        else if (name == L"--shard")
+        {
+            // "k/N": this is worker k of N, counting from 0
+            wchar_t* slash = nullptr;
+            wchar_t* end = nullptr;
+            unsigned long index = std::wcstoul(value.c_str(), &slash, 10);
+            unsigned long count = *slash == L'/' ? std::wcstoul(slash + 1, &end, 10) : 0;
+            if (slash == value.c_str() || !end || end == slash + 1 || *end != L'\0' || count == 0 || count > 65536 || index >= count)
+            {
+                printUnicodeMulti(true, L"Invalid shard: ", value, L" (expected k/N with 0 <= k < N, e.g. 0/4)");
+                return false;
+            }
+            options.shardIndex = static_cast<unsigned>(index);
+            options.shardCount = static_cast<unsigned>(count);
+        }
+        else if (name == L"--max-read-rate" || name == L"--max-open-rate" || name == L"--max-metadata-rate")
+        {
+            uint64_t& rate = name == L"--max-read-rate" ? options.throttleLimits.bytesPerSecond
+                : name == L"--max-open-rate" ? options.throttleLimits.filesPerSecond
+                : options.throttleLimits.metadataPerSecond;
+            if (!parseRate(value, rate))
+            {
+                printUnicodeMulti(true, L"Invalid rate: ", value, L" (expected a count per second, e.g. 200 or 50MB, 0 for no limit)");
+                return false;
+            }
+        }
+        else if (name == L"--throttle-file")
+        {
+            options.throttleControlFile = value;
+        }
+        else if (name == L"--pause-above")
+        {
+            wchar_t* end = nullptr;
+            unsigned long percent = std::wcstoul(value.c_str(), &end, 10);
+            if (value.empty() || *end != L'\0' || percent == 0 || percent > 100)
+            {
+                printUnicodeMulti(true, L"Invalid load threshold: ", value, L" (expected a percentage from 1 to 100)");
+                return false;
+            }
+            options.pauseAbovePercent = static_cast<unsigned>(percent);
+        }
+        else if (name == L"--output")
+        {
+            options.outputPath = value;
+        }
+        else if (name == L"--index")
+        {
+            options.indexPath = value;
+        }
+        else if (name == L"--save-snapshot")
+        {
+            options.saveSnapshotPath = value;
+        }
+        else if (name == L"--from-snapshot")
+        {
+            options.loadSnapshotPath = value;
+        }
+        else
+        {
+            printUnicodeMulti(true, L"Unknown option: ", name);
+            return false;
+        }
+    }
+
+    if (!options.command.empty() && options.command.front() != L"index" && options.command.front() != L"shard" && options.command.front() != L"snapshot"
+        && options.command.front() != L"review" && options.command.front() != L"bench" && options.command.front() != L"test")
+    {
+        printUnicodeMulti(true, L"Unknown command: ", options.command.front());
+        return false;
+    }
+
+    return true;
+}
+
+void printUsage()
+{
+    printUnicode(L"Usage: DupeFind [options]", true);
+    printUnicode(L"       DupeFind [options] index add <folder>...     hash the folders and add them to the digest index (stop index serve first)", true);
+    printUnicode(L"       DupeFind [options] index query <path>...     report which files are already in the index", true);
+    printUnicode(L"       DupeFind [options] index serve               answer lookups on a local named pipe", true);
+    printUnicode(L"       DupeFind [options] index stats               show the size and load of the index", true);
+    printUnicode(L"       DupeFind [options] shard scan <folder>...    scan one shard and write a partial result (see --shard)", true);
+    printUnicode(L"       DupeFind [options] shard merge <file>...     combine partial results into duplicate groups (needs read access to every shard's paths)", true);
+    printUnicode(L"       DupeFind [options] snapshot save <folder>    scan and hash the folder and save the result (see --output)", true);
+    printUnicode(L"       DupeFind [options] snapshot diff <old> <new> list new, removed and changed files and new duplicate groups", true);
+    printUnicode(L"       DupeFind [options] snapshot info <file>      show what a snapshot holds", true);
+    printUnicode(L"       DupeFind [options] review [<file>]           go on reviewing the groups a run left (default dupefind_results.dfr)", true);
+    printUnicode(L"       DupeFind bench grouping [<count>...]         time radix sort grouping against std::map (default 1M and 10M records)", true);
+    printUnicode(L"       DupeFind test archives                       check the zip, tar and deflate readers against stored test archives", true);
+    printUnicode(L"       DupeFind test filters                        check that a folder filter matches whole folders only", true);
+    printUnicode(L"", true);
+    printUnicode(L"Options:", true);
+    printUnicode(L"  --read-policy <policy>   How files are read while hashing:", true);
+    printUnicode(L"                             buffered    plain cached reads", true);
+    printUnicode(L"                             sequential  cached reads with read-ahead hint (default)", true);
+    printUnicode(L"                             lowcache    read-ahead, cached at lowest priority to spare the file cache", true);
+    printUnicode(L"                             direct      unbuffered reads that bypass the file cache", true);
+    printUnicode(L"  --readers <count>        Concurrent readers per device while hashing (default 0: tuned per device)", true);
+    printUnicode(L"  --read-order <order>     auto (default: by disk position on rotational disks), physical or given", true);
+    printUnicode(L"  --engine <engine>        threads (default: blocking reader pools) or coroutines (overlapped reads on a few threads)", true);
+    printUnicode(L"  --in-flight <count>      coroutines: files open and being read at once (default 256)", true);
+    printUnicode(L"  --full-scan-log          Write every scanned entry to scan_results.txt instead of the first 1000", true);
+    printUnicode(L"  --directories            Report identical folders as one group and remove them whole (groups are shown after hashing)", true);
+    printUnicode(L"  --archives               Also compare the files inside zip and tar archives, without extracting them (reported only)", true);
+    printUnicode(L"  --top <count>            Largest groups, folders and extensions listed in the wasted space analysis (default 20)", true);
+    printUnicode(L"  --save-snapshot <file>   Save the scan and its digests once hashing is done", true);
+    printUnicode(L"  --from-snapshot <file>   Group, report and remove from a saved scan instead of scanning and hashing", true);
+    printUnicode(L"  --max-read-rate <rate>   Bytes read per second while hashing, e.g. 50MB (default 0: no limit)", true);
+    printUnicode(L"  --max-open-rate <rate>   Files opened per second while hashing (default 0: no limit)", true);
+    printUnicode(L"  --max-metadata-rate <rate>", true);
+    printUnicode(L"                           Folder listings and size or attribute lookups per second (default 0: no limit)", true);
+    printUnicode(L"  --throttle-file <file>   Control file checked every second: bytes=, files=, metadata= and pause=yes|no", true);
+    printUnicode(L"  --pause-above <percent>  Pause while other processes keep the CPUs busier than this", true);
+    printUnicode(L"  --background             Run at background priority: idle CPU, very low I/O and low memory priority", true);
+    printUnicode(L"  --index <file>           Digest index file (default dupefind_index.dat)", true);
+    printUnicode(L"  --filter-fpr <rate>      False-positive rate of the index prefilter built by index add (default 0.01)", true);
+    printUnicode(L"  --server                 index query asks a running index server instead of opening the file", true);
+    printUnicode(L"  --shard <k/N>            shard scan: scan the k-th of N directory partitions (default 0/1)", true);
+    printUnicode(L"  --output <file>          shard scan: partial result file (default shard_<k>_of_<N>.dfp)", true);
+    printUnicode(L"                           snapshot save: snapshot file (default dupefind_snapshot.dfs)", true);
+    printUnicode(L"  --help                   Show this help", true);
+}
@@ -0,0 +1,49 @@
+﻿#pragma once
+
+#include "HashCalculator.h"
+#include "DigestIndex.h"
+#include "Engine.h"
+#include "Throttle.h"
+#include "WasteAnalytics.h"
+
+#include <string>
+#include <vector>
+#include <filesystem>
+
+// Settings given on the command line. Anything not given keeps its default and the interactive prompts still run.
+struct ProgramOptions
+{
+    HashOptions hashOptions;
+    ExecutionEngine engine = ExecutionEngine::Threads;
+    bool fullScanLog = false;
+    bool groupDirectories = false; // --directories: whole identical folders before single files
+    bool scanArchives = false;     // --archives: also compare the members of zip and tar files
+    size_t topGroups = DEFAULT_TOP_GROUPS; // largest groups, folders and extensions listed in the wasted space analysis
+
+    // Budgets for shared machines; they apply to every command
+    ThrottleLimits throttleLimits;
+    std::filesystem::path throttleControlFile;
+    unsigned pauseAbovePercent = 0;
+    bool backgroundPriority = false;
+
+    // Interactive mode: save the scan and digests after hashing, or run from a saved scan instead of scanning
+    std::filesystem::path saveSnapshotPath;
+    std::filesystem::path loadSnapshotPath;
+    bool showHelp = false;
+
+    // Subcommand and its arguments, e.g. "index" "add" "D:\Photos". Empty for the interactive mode.
+    std::vector<std::wstring> command;
+    std::filesystem::path indexPath = L"dupefind_index.dat";
+    bool useIndexServer = false;
+    double prefilterFalsePositiveRate = DEFAULT_PREFILTER_FALSE_POSITIVE_RATE;
+
+    // shard scan: this worker's share of the directories, and where its partial result goes
+    unsigned shardIndex = 0;
+    unsigned shardCount = 1;
+    std::filesystem::path outputPath;
+};
+
+// Parses "--name value" and "--name=value" flags. Prints what is wrong and returns false on invalid input.
+bool parseCommandLine(int argc, wchar_t* argv[], ProgramOptions& options);
+
+void printUsage();
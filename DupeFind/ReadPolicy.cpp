@@ -0,0 +1,157 @@
+#include "ReadPolicy.h"
+#include "Throttle.h"
+
+#include <string>
+#include <algorithm>
+#include <new>
+#include <cwctype>
+
+#define WIN32_LEAN_AND_MEAN
+#include <Windows.h>
+#include <Psapi.h>
+
+namespace
+{
+    const size_t DEFAULT_SECTOR_SIZE = 4096;
+}
+
+bool parseReadPolicy(const std::wstring& name, ReadPolicy& policy)
+{
+    std::wstring lower = name;
+    std::transform(lower.begin(), lower.end(), lower.begin(), ::towlower);
+
+    if (lower == L"buffered") policy = ReadPolicy::Buffered;
+    else if (lower == L"sequential") policy = ReadPolicy::Sequential;
+    else if (lower == L"lowcache") policy = ReadPolicy::LowCachePriority;
+    else if (lower == L"direct") policy = ReadPolicy::Direct;
+    else return false;
+
+    return true;
+}
+
+const wchar_t* readPolicyName(ReadPolicy policy)
+{
+    switch (policy)
+    {
+    case ReadPolicy::Buffered: return L"buffered";
+    case ReadPolicy::Sequential: return L"sequential";
+    case ReadPolicy::LowCachePriority: return L"lowcache";
+    case ReadPolicy::Direct: return L"direct";
+    }
+    return L"unknown";
+}
+
+void* openForRead(const fs::path& filePath, ReadPolicy policy, bool overlapped)
+{
+    DWORD flags = overlapped ? FILE_ATTRIBUTE_NORMAL | FILE_FLAG_OVERLAPPED : FILE_ATTRIBUTE_NORMAL;
+    switch (policy)
+    {
+    case ReadPolicy::Buffered:
+        break;
+    case ReadPolicy::Sequential:
+    case ReadPolicy::LowCachePriority:
+        flags |= FILE_FLAG_SEQUENTIAL_SCAN;
+        break;
+    case ReadPolicy::Direct:
+        flags |= FILE_FLAG_NO_BUFFERING;
+        break;
+    }
+
+    // Every file hashed is opened here, so this is where the files-per-second budget is spent
+    ioThrottle().beforeOpen();
+    return CreateFileW(filePath.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, flags, NULL);
+}
+
+size_t readAlignment(void* fileHandle, ReadPolicy policy)
+{
+    if (policy != ReadPolicy::Direct) return 1;
+
+    FILE_STORAGE_INFO storageInfo = {};
+    if (GetFileInformationByHandleEx(fileHandle, FileStorageInfo, &storageInfo, sizeof(storageInfo)))
+    {
+        size_t sectorSize = std::max<size_t>(storageInfo.LogicalBytesPerSector, storageInfo.PhysicalBytesPerSectorForPerformance);
+        if (sectorSize > 0 && (sectorSize & (sectorSize - 1)) == 0) return sectorSize;
+    }
+
+    return DEFAULT_SECTOR_SIZE;
+}
+
+namespace
+{
+    std::atomic<uint64_t> readBufferAllocations{ 0 };
+}
+
+ReadBuffer::ReadBuffer(size_t size)
+    : length(size)
+{
+    // VirtualAlloc returns page-aligned memory, which satisfies every sector size up to the page size
+    bytes = static_cast<unsigned char*>(VirtualAlloc(NULL, size, MEM_COMMIT | MEM_RESERVE, PAGE_READWRITE));
+    if (!bytes) throw std::bad_alloc();
+    readBufferAllocations.fetch_add(1, std::memory_order_relaxed);
+}
+
+ReadBuffer::~ReadBuffer()
+{
+    if (bytes) VirtualFree(bytes, 0, MEM_RELEASE);
+}
+
+uint64_t ReadBuffer::allocationCount()
+{
+    return readBufferAllocations.load(std::memory_order_relaxed);
+}
+
+ReadBufferPool::Lease ReadBufferPool::acquire()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (!idle.empty())
+        {
+            std::unique_ptr<ReadBuffer> buffer = std::move(idle.back());
+            idle.pop_back();
+            return Lease(*this, std::move(buffer));
+        }
+    }
+    return Lease(*this, std::make_unique<ReadBuffer>(bufferSize));
+}
+
+void ReadBufferPool::release(std::unique_ptr<ReadBuffer> buffer)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    idle.push_back(std::move(buffer));
+}
+
+ScopedReadCachePriority::ScopedReadCachePriority(ReadPolicy policy)
+{
+    if (policy != ReadPolicy::LowCachePriority) return;
+
+    // Pages a very-low-priority thread reads go to the lowest standby list, so they are the first to be
+    // reused and the cache of other processes survives the pass
+    MEMORY_PRIORITY_INFORMATION priority = {};
+    if (!GetThreadInformation(GetCurrentThread(), ThreadMemoryPriority, &priority, sizeof(priority)))
+    {
+        priority.MemoryPriority = MEMORY_PRIORITY_NORMAL;
+    }
+    previousPriority = priority.MemoryPriority;
+    if (previousPriority <= MEMORY_PRIORITY_VERY_LOW) return; // already as low as it goes
+
+    priority.MemoryPriority = MEMORY_PRIORITY_VERY_LOW;
+    lowered = SetThreadInformation(GetCurrentThread(), ThreadMemoryPriority, &priority, sizeof(priority)) != FALSE;
+}
+
+ScopedReadCachePriority::~ScopedReadCachePriority()
+{
+    if (!lowered) return;
+
+    MEMORY_PRIORITY_INFORMATION priority = {};
+    priority.MemoryPriority = previousPriority;
+    SetThreadInformation(GetCurrentThread(), ThreadMemoryPriority, &priority, sizeof(priority));
+}
+
+uint64_t systemCacheBytes()
+{
+    PERFORMANCE_INFORMATION performance = {};
+    performance.cb = sizeof(performance);
+    if (!GetPerformanceInfo(&performance, sizeof(performance))) return 0;
+
+    return static_cast<uint64_t>(performance.SystemCache) * performance.PageSize;
+}
@@ -0,0 +1,119 @@
+﻿#pragma once
+
+#include <filesystem>
+#include <string>
+#include <atomic>
+#include <mutex>
+#include <memory>
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+namespace fs = std::filesystem;
+
+// How the hasher reads files, and how much it leaves behind in the system file cache
+enum class ReadPolicy
+{
+    Buffered,         // plain cached reads, no hints
+    Sequential,       // cached reads with a sequential read-ahead hint (default)
+    LowCachePriority, // sequential, and pages are cached at the lowest priority so they are repurposed first
+    Direct            // unbuffered reads into sector-aligned buffers, bypassing the cache entirely
+};
+
+bool parseReadPolicy(const std::wstring& name, ReadPolicy& policy);
+const wchar_t* readPolicyName(ReadPolicy policy);
+
+// Opens a file for hashing with the flags the policy asks for. Returns INVALID_HANDLE_VALUE on failure.
+// An overlapped handle is read through an IoExecutor instead of with blocking reads.
+void* openForRead(const fs::path& filePath, ReadPolicy policy, bool overlapped = false);
+
+// Offsets and lengths of reads on this handle must be multiples of this (1 unless the policy is Direct)
+size_t readAlignment(void* fileHandle, ReadPolicy policy);
+
+// Page-aligned read buffer, as unbuffered reads require
+class ReadBuffer
+{
+public:
+    explicit ReadBuffer(size_t size);
+    ~ReadBuffer();
+
+    ReadBuffer(const ReadBuffer&) = delete;
+    ReadBuffer& operator=(const ReadBuffer&) = delete;
+
+    unsigned char* data() const { return bytes; }
+    size_t size() const { return length; }
+
+    // Buffers allocated so far in this process, to show how many a pass needed per file
+    static uint64_t allocationCount();
+
+private:
+    unsigned char* bytes = nullptr;
+    size_t length = 0;
+};
+
+// Read buffers of one size kept for whoever reads next. For readers that cannot keep a buffer per thread,
+// such as coroutines that move between threads. Safe to share between threads.
+class ReadBufferPool
+{
+public:
+    explicit ReadBufferPool(size_t bufferSize) : bufferSize(bufferSize) {}
+
+    ReadBufferPool(const ReadBufferPool&) = delete;
+    ReadBufferPool& operator=(const ReadBufferPool&) = delete;
+
+    // A buffer taken from the pool, given back when the lease ends
+    class Lease
+    {
+    public:
+        Lease(ReadBufferPool& pool, std::unique_ptr<ReadBuffer> buffer) : pool(&pool), buffer(std::move(buffer)) {}
+        Lease(Lease&& other) noexcept : pool(other.pool), buffer(std::move(other.buffer)) {}
+        ~Lease()
+        {
+            if (buffer) pool->release(std::move(buffer));
+        }
+
+        Lease(const Lease&) = delete;
+        Lease& operator=(const Lease&) = delete;
+        Lease& operator=(Lease&&) = delete;
+
+        unsigned char* data() const { return buffer->data(); }
+        size_t size() const { return buffer->size(); }
+
+    private:
+        ReadBufferPool* pool;
+        std::unique_ptr<ReadBuffer> buffer;
+    };
+
+    Lease acquire();
+
+private:
+    void release(std::unique_ptr<ReadBuffer> buffer);
+
+    size_t bufferSize;
+    std::mutex mutex;
+    std::vector<std::unique_ptr<ReadBuffer>> idle;
+};
+
+// Lowers the memory priority of the calling thread for the policies that ask for it, and restores it afterwards
+class ScopedReadCachePriority
+{
+public:
+    explicit ScopedReadCachePriority(ReadPolicy policy);
+    ~ScopedReadCachePriority();
+
+    ScopedReadCachePriority(const ScopedReadCachePriority&) = delete;
+    ScopedReadCachePriority& operator=(const ScopedReadCachePriority&) = delete;
+
+private:
+    bool lowered = false;
+    unsigned long previousPriority = 0; // restored on exit, so a thread already lowered by --background stays lowered
+};
+
+struct ReadStats
+{
+    std::atomic<uint64_t> bytesRead{ 0 };
+    std::atomic<uint64_t> filesRead{ 0 };
+};
+
+// Current size of the system file cache, used to show how much a pass pushed into it
+uint64_t systemCacheBytes();
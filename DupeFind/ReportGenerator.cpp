@@ -1,5 +1,8 @@
 ﻿#include "ReportGenerator.h"
 #include "Utilities.h"
+#include "ExtentMap.h"
+#include "FileScanner.h"
+#include "HashCalculator.h"
 
 #include <iostream>
 #include <fstream>
@@ -9,57 +12,199 @@
 #include <filesystem>
 #include <sstream>
 #include <iomanip>
+#include <algorithm>
+#include <iterator>
+#include <cstdint>
 
 
+namespace
+{
+    // Rows of the size histogram, matching WasteAnalytics::bucketLowerBound
+    const wchar_t* const SIZE_BUCKET_LABELS[] = { L"under 4 KB", L"4 KB - 64 KB", L"64 KB - 1 MB", L"1 MB - 16 MB", L"16 MB - 256 MB",
+        L"256 MB - 4 GB", L"4 GB and over" };
+    static_assert(std::size(SIZE_BUCKET_LABELS) == WasteAnalytics::SIZE_BUCKETS, "one label per size bucket");
+
+    // Lines of the largest groups repeated on the console; the rest of the analysis is only in the log
+    const size_t CONSOLE_TOP_GROUPS = 5;
+
+    std::wstring sizeText(uint64_t bytes)
+    {
+        return utf8ToWstring(formatFileSize(bytes));
+    }
 
-size_t processDuplicateGroups(const std::map<std::string, std::vector<fs::path>>& duplicateGroups)
+    std::wstring describeWastedGroup(const WastedGroup& group)
+    {
+        std::wstringstream line;
+        line << sizeText(group.wastedBytes) << L" in group #" << group.number << L": " << group.copies
+            << (group.isDirectory ? L" folders of " : L" files of ") << sizeText(group.size) << L", e.g. " << group.firstCopy.wstring();
+        return line.str();
+    }
+}
+
+DuplicateReport::DuplicateReport(size_t topGroups, const fs::path& scanRoot)
+    : topGroups(topGroups), analytics(topGroups, DEFAULT_ROLLUP_KEYS, scanRoot)
 {
-    const std::wstring logFileName = L"duplicate_log.txt";
+    writeUnicodeToFile(L"=== DUPLICATE FILES ANALYSIS ===\n\n", logFileName, false, false); // overwrite the previous run's log
+}
 
-    // Build the complete log content in memory first
-    std::wstringstream logContent;
-    size_t groupCount = 0;
-    size_t totalDuplicateFiles = 0;
-    uintmax_t totalDuplicateSize = 0;
+void DuplicateReport::addGroup(const std::string& hash, const std::vector<fs::path>& files, uintmax_t fileSize)
+{
+    if (files.size() <= 1) return; // Skip unique files
+
+    ++groupCount;
+    totalDuplicateFiles += files.size() - 1;
+
+    std::string fileSizeStr = formatFileSize(fileSize);
+    std::wstring fileSizeWStr = utf8ToWstring(fileSizeStr);
+    std::wstring hashWStr = utf8ToWstring(hash);
 
-    // Process groups and collect statistics
     std::wstringstream groupsBuffer;
-    for (const auto& [hash, files] : duplicateGroups)
+    groupsBuffer << L"Duplicate group #" << groupCount << L" (" << files.size() << L" files, " << fileSizeWStr << L" each)" << std::endl;
+    groupsBuffer << L"SHA-256: " << hashWStr << std::endl;
+
+    // Copies that already share their blocks on disk (e.g. block-cloned on ReFS) free nothing when removed,
+    // so only the bytes a copy does not share with an earlier one in the group count as wasted. Extents are only
+    // asked for where sharing is possible: two or more copies of at least a cluster on one volume that can clone.
+    std::vector<FileExtentMap> extentMaps(files.size());
+    if (fileSize > 0)
     {
-        if (files.size() <= 1) continue; // Skip unique files
-
-        ++groupCount;
-        totalDuplicateFiles += files.size() - 1;
-        uintmax_t fileSize = 0;
+        std::vector<const VolumeBlockInfo*> fileVolumes;
+        fileVolumes.reserve(files.size());
+        for (const auto& file : files)
+        {
+            const VolumeBlockInfo& volume = volumeOf(file);
+            fileVolumes.push_back(volume.sharesBlocks && fileSize >= volume.clusterSize ? &volume : nullptr);
+        }
 
-        try
+        for (size_t i = 0; i < files.size(); ++i)
         {
-            fileSize = fs::file_size(files[0]);
-            totalDuplicateSize += fileSize * (files.size() - 1);
+            if (fileVolumes[i] && std::count(fileVolumes.begin(), fileVolumes.end(), fileVolumes[i]) > 1)
+            {
+                extentMaps[i] = queryPhysicalExtents(files[i], fileVolumes[i]->clusterSize);
+            }
         }
-        catch (const fs::filesystem_error& e)
+    }
+
+    uint64_t groupWasted = 0;
+    for (size_t i = 0; i < files.size(); ++i)
+    {
+        groupsBuffer << L"  " << files[i].wstring();
+
+        if (i > 0)
         {
-            std::wstring errorMsg = L"Error getting file size for " + files[0].wstring() + L": " + utf8ToWstring(e.what());
-            printUnicode(errorMsg, true);
-            continue;
+            uint64_t sharedBytes = 0;
+            size_t sharedWith = 0;
+            for (size_t j = 0; j < i; ++j)
+            {
+                uint64_t shared = sharedPhysicalBytes(extentMaps[i], extentMaps[j]);
+                if (shared > sharedBytes)
+                {
+                    sharedBytes = shared;
+                    sharedWith = j;
+                }
+            }
+            sharedBytes = std::min<uint64_t>(sharedBytes, fileSize);
+
+            if (sharedBytes > 0)
+            {
+                std::string sharedStr = formatFileSize(sharedBytes);
+                groupsBuffer << L" [already shares " << utf8ToWstring(sharedStr) << L" on disk with #" << (sharedWith + 1) << L"]";
+            }
+
+            groupWasted += fileSize - sharedBytes;
+            totalSharedSize += sharedBytes;
         }
 
-        std::string fileSizeStr = formatFileSize(fileSize);
-        std::wstring fileSizeWStr(fileSizeStr.begin(), fileSizeStr.end());
-        std::wstring hashWStr = std::wstring(hash.begin(), hash.end());
+        groupsBuffer << std::endl;
+    }
+    groupsBuffer << std::endl;
+    totalDuplicateSize += groupWasted;
+    analytics.addGroup(hash, files, fileSize, groupWasted);
+
+    // Each group goes to the log as soon as it is known, so a long run can be read while it is still going
+    writeUnicodeToFile(groupsBuffer.str(), logFileName, false, true);
 
-        groupsBuffer << L"Duplicate group #" << groupCount << L" (" << files.size() << L" files, " << fileSizeWStr << L" each)" << std::endl;
-        groupsBuffer << L"SHA-256: " << hashWStr << std::endl;
+    printUnicodeMulti(true, L"Duplicate group #", std::to_wstring(groupCount), L": ", std::to_wstring(files.size()), L" files, ", fileSizeWStr, L" each");
+}
 
-        for (const auto& file : files)
+const VolumeBlockInfo& DuplicateReport::volumeOf(const fs::path& file)
+{
+    std::wstring directory = file.parent_path().wstring();
+    auto known = volumeOfDirectory.find(directory);
+    if (known == volumeOfDirectory.end())
+    {
+        std::wstring volumePath = volumePathOf(file);
+        auto volume = volumes.find(volumePath);
+        if (volume == volumes.end())
         {
-            groupsBuffer << L"  " << file.wstring() << std::endl;
+            volume = volumes.emplace(volumePath, queryVolumeBlockInfo(volumePath)).first;
         }
-        groupsBuffer << std::endl;
+        known = volumeOfDirectory.emplace(directory, &volume->second).first;
+    }
+    return *known->second;
+}
+
+void DuplicateReport::addDirectoryGroup(const std::string& hash, const std::vector<fs::path>& directories, uintmax_t bytes, size_t files)
+{
+    if (directories.size() <= 1) return;
+
+    ++groupCount;
+    ++directoryGroupCount;
+    totalDuplicateFiles += files * (directories.size() - 1);
+    totalDuplicateSize += bytes * (directories.size() - 1); // block sharing is only looked up for single files
+    analytics.addDirectoryGroup(hash, directories, bytes);
+
+    std::wstring sizeWStr = utf8ToWstring(formatFileSize(bytes));
+
+    std::wstringstream groupsBuffer;
+    groupsBuffer << L"Duplicate folder group #" << groupCount << L" (" << directories.size() << L" folders, " << files << L" files and "
+        << sizeWStr << L" each)" << std::endl;
+    groupsBuffer << L"Tree SHA-256: " << utf8ToWstring(hash) << std::endl;
+    for (const auto& directory : directories)
+    {
+        groupsBuffer << L"  " << directory.wstring() << L"\\" << std::endl;
+    }
+    groupsBuffer << std::endl;
+
+    writeUnicodeToFile(groupsBuffer.str(), logFileName, false, true);
+
+    printUnicodeMulti(true, L"Duplicate folder group #", std::to_wstring(groupCount), L": ", std::to_wstring(directories.size()), L" folders, ",
+        std::to_wstring(files), L" files and ", sizeWStr, L" each");
+}
+
+void DuplicateReport::addArchiveGroup(const std::string& hash, const std::vector<fs::path>& files, const std::vector<fs::path>& members, uintmax_t size)
+{
+    size_t copies = files.size() + members.size();
+    if (copies <= 1 || members.empty()) return;
+
+    ++groupCount;
+    ++archiveGroupCount;
+    archivedDuplicateSize += size * (copies - 1);
+
+    std::wstring sizeWStr = utf8ToWstring(formatFileSize(size));
+
+    std::wstringstream groupsBuffer;
+    groupsBuffer << L"Duplicate group #" << groupCount << L" with archive members (" << copies << L" copies, " << sizeWStr << L" each)" << std::endl;
+    groupsBuffer << L"SHA-256: " << utf8ToWstring(hash) << std::endl;
+    for (const auto& file : files)
+    {
+        groupsBuffer << L"  " << file.wstring() << std::endl;
     }
+    for (const auto& member : members)
+    {
+        groupsBuffer << L"  " << member.wstring() << L" [in archive]" << std::endl;
+    }
+    groupsBuffer << std::endl;
+
+    writeUnicodeToFile(groupsBuffer.str(), logFileName, false, true);
 
-    // Build the complete log content
-    logContent << L"=== DUPLICATE FILES ANALYSIS ===" << std::endl;
+    printUnicodeMulti(true, L"Duplicate group #", std::to_wstring(groupCount), L": ", std::to_wstring(copies), L" copies, ",
+        std::to_wstring(members.size()), L" in archives, ", sizeWStr, L" each");
+}
+
+size_t DuplicateReport::finish()
+{
+    std::wstringstream logContent;
 
     if (groupCount == 0)
     {
@@ -69,153 +214,242 @@ size_t processDuplicateGroups(const std::map<std::string, std::vector<fs::path>>
     else
     {
         std::string totalSizeStr = formatFileSize(totalDuplicateSize);
-        std::wstring totalSizeWStr(totalSizeStr.begin(), totalSizeStr.end());
+        std::wstring totalSizeWStr = utf8ToWstring(totalSizeStr);
 
-        // Write summary to log content
+        // Write summary to log content; it follows the groups since those were written as they were found
         logContent << L"=== SUMMARY ===" << std::endl;
         logContent << L"Total duplicate groups found: " << groupCount << std::endl;
+        if (directoryGroupCount > 0)
+        {
+            logContent << L"Of which duplicate folder groups: " << directoryGroupCount << std::endl;
+        }
+        if (archiveGroupCount > 0)
+        {
+            logContent << L"Of which groups with archive members: " << archiveGroupCount << L" (" << utf8ToWstring(formatFileSize(archivedDuplicateSize))
+                << L" of extra copies, not counted below)" << std::endl;
+        }
         logContent << L"Total duplicate files: " << totalDuplicateFiles << std::endl;
-        logContent << L"Total wasted space: " << totalSizeWStr << std::endl << std::endl;
+        logContent << L"Total wasted space: " << totalSizeWStr << std::endl;
+        if (totalSharedSize > 0)
+        {
+            std::string sharedSizeStr = formatFileSize(totalSharedSize);
+            logContent << L"Already shared on disk (not reclaimable): " << utf8ToWstring(sharedSizeStr) << std::endl;
+        }
+        logContent << std::endl;
 
         // Print summary to console
         printUnicode(L"\n=== SUMMARY ===", true);
         printUnicode(L"Total duplicate groups found: " + std::to_wstring(groupCount), true);
+        if (directoryGroupCount > 0)
+        {
+            printUnicode(L"Of which duplicate folder groups: " + std::to_wstring(directoryGroupCount), true);
+        }
+        if (archiveGroupCount > 0)
+        {
+            printUnicode(L"Of which groups with archive members: " + std::to_wstring(archiveGroupCount) + L" (" + utf8ToWstring(formatFileSize(archivedDuplicateSize))
+                + L" of extra copies, not counted below)", true);
+        }
         printUnicode(L"Total duplicate files: " + std::to_wstring(totalDuplicateFiles), true);
         printUnicode(L"Total wasted space: " + totalSizeWStr, true);
+        if (totalSharedSize > 0)
+        {
+            std::string sharedSizeStr = formatFileSize(totalSharedSize);
+            printUnicode(L"Already shared on disk (not reclaimable): " + utf8ToWstring(sharedSizeStr), true);
+        }
     }
 
-    // Append the buffered group details
-    logContent << groupsBuffer.str();
+    writeUnicodeToFile(logContent.str(), logFileName, false, true);
 
-    // Write everything to file using your Unicode function
-    writeUnicodeToFile(logContent.str(), logFileName, false, false); // newline=false since content already has newlines, append=false to overwrite
+    if (analytics.groupCount() > 0)
+    {
+        writeWasteAnalysis();
+    }
 
     printUnicode(L"Duplicate analysis written to: " + logFileName, true);
 
     return groupCount;
 }
 
-void writeScanLog(const std::vector<fs::path>& paths, const fs::path& basePath, size_t maxEntries)
+// Everything here was collected as the groups came in, so this only formats it
+void DuplicateReport::writeWasteAnalysis()
 {
-    const std::wstring logFileName = L"scan_results.txt";
+    const uint64_t wasted = analytics.totalWasted();
+    auto percentOf = [wasted](uint64_t bytes) { return wasted == 0 ? 0.0 : 100.0 * static_cast<double>(bytes) / static_cast<double>(wasted); };
+
+    std::vector<WastedGroup> largest = analytics.topGroups();
+    uint64_t largestWasted = 0;
+    for (const auto& group : largest)
+    {
+        largestWasted += group.wastedBytes;
+    }
+
+    std::wstringstream share;
+    share << std::fixed << std::setprecision(1) << L"The largest " << largest.size() << L" of " << analytics.groupCount() << L" groups hold "
+        << percentOf(largestWasted) << L"% of the wasted space";
+
     std::wstringstream logContent;
+    logContent << L"=== WHERE THE WASTED SPACE IS ===" << std::endl;
+    logContent << share.str() << L":" << std::endl;
+    for (size_t i = 0; i < largest.size(); ++i)
+    {
+        logContent << std::setw(5) << (i + 1) << L". " << describeWastedGroup(largest[i]) << std::endl;
+    }
+    logContent << std::endl;
+
+    // Counted for every copy, since any of them could be the one removed, and for every folder above it up to the scan root
+    const HeavyHitters& folders = analytics.folders();
+    logContent << L"Folders holding the most duplicated data, with their subfolders:" << std::endl;
+    for (const auto& folder : folders.top(topGroups))
+    {
+        logContent << L"  " << (folder.overcount > 0 ? L"~" : L"") << sizeText(folder.weight) << L" in " << folder.count << L" duplicated entries: "
+            << folder.key << std::endl;
+    }
+    if (folders.evicted())
+    {
+        logContent << L"  (only the heaviest " << DEFAULT_ROLLUP_KEYS << L" folders are tracked; ~ marks a total that may include bytes of folders dropped along the way)" << std::endl;
+    }
+    logContent << std::endl;
+
+    const HeavyHitters& extensions = analytics.extensions();
+    logContent << L"Wasted space by extension:" << std::endl;
+    for (const auto& extension : extensions.top(topGroups))
+    {
+        logContent << L"  " << (extension.overcount > 0 ? L"~" : L"") << sizeText(extension.weight) << L" in " << extension.count << L" groups: "
+            << extension.key << std::endl;
+    }
+    logContent << std::endl;
+
+    logContent << L"Wasted space by file size:" << std::endl;
+    logContent << std::left << std::setw(18) << L"  size" << std::right << std::setw(10) << L"groups" << std::setw(12) << L"files"
+        << std::setw(14) << L"wasted" << std::endl;
+    const auto& histogram = analytics.sizeHistogram();
+    for (size_t bucket = 0; bucket < histogram.size(); ++bucket)
+    {
+        if (histogram[bucket].groups == 0) continue;
+        logContent << std::left << std::setw(18) << (std::wstring(L"  ") + SIZE_BUCKET_LABELS[bucket]) << std::right << std::setw(10) << histogram[bucket].groups
+            << std::setw(12) << histogram[bucket].files << std::setw(14) << sizeText(histogram[bucket].wastedBytes) << std::endl;
+    }
+    logContent << std::endl;
+
+    writeUnicodeToFile(logContent.str(), logFileName, false, true);
+
+    printUnicode(L"\n" + share.str() + L":", true);
+    for (size_t i = 0; i < largest.size() && i < CONSOLE_TOP_GROUPS; ++i)
+    {
+        printUnicode(L"  " + describeWastedGroup(largest[i]), true);
+    }
+}
+
+size_t processDuplicateGroups(const std::vector<DuplicateGroup>& duplicateGroups, size_t topGroups)
+{
+    DuplicateReport report(topGroups);
+    for (const auto& group : duplicateGroups)
+    {
+        report.addGroup(group.hash, group.files, group.fileSize);
+    }
+    return report.finish();
+}
 
+void writeScanLog(const std::vector<fs::path>& paths, const std::vector<ScanNode>& nodes, const fs::path& basePath, size_t maxEntries)
+{
+    const std::wstring logFileName = L"scan_results.txt";
+    const size_t FLUSH_THRESHOLD = 512 * 1024; // characters buffered before they are appended to the log
+
+    std::wstringstream logContent;
     logContent << L"=== DUPEFIND SCAN RESULTS ===" << std::endl;
     logContent << L"Scan Date: " << getCurrentTimestamp() << std::endl;
     logContent << L"Base Directory: " << basePath.wstring() << std::endl;
     logContent << L"Total Files/Directories Found: " << paths.size() << std::endl;
     logContent << std::endl;
 
+    if (maxEntries == SIZE_MAX)
+    {
+        logContent << L"\n=== FILE TREE ===" << std::endl;
+    }
+    else
+    {
+        logContent << L"\n=== FILE TREE (limited to " << maxEntries << L" entries) ===" << std::endl;
+    }
+
+    writeUnicodeToFile(logContent.str(), logFileName, false, false);
+
+    // One pass over what the scanner recorded: the tree is written from it and the totals are counted along the
+    // way, so the log needs no filesystem calls of its own
     size_t fileCount = 0;
     size_t dirCount = 0;
     uintmax_t totalSize = 0;
+    std::wstring buffer;
 
-    // Precompute counts & sizes before writing file tree for accurate summary
-    for (const auto& path : paths)
+    for (size_t i = 0; i < paths.size() && i < nodes.size(); ++i)
     {
-        try
+        const ScanNode& node = nodes[i];
+        if (node.isDirectory)
         {
-            if (fs::is_regular_file(path))
-            {
-                fileCount++;
-                totalSize += fs::file_size(path);
-            }
-            else if (fs::is_directory(path))
-            {
-                dirCount++;
-            }
+            dirCount++;
         }
-        catch (const fs::filesystem_error&)
+        else
         {
-            // Ignore size errors
+            fileCount++;
+            totalSize += node.size;
         }
-    }
 
-    // Write summary statistics first
-    logContent << L"\n=== SUMMARY STATISTICS ===" << std::endl;
-    logContent << L"Directories: " << dirCount << std::endl;
-    logContent << L"Files: " << fileCount << std::endl;
-    if (totalSize > 0)
-    {
-        std::string totalSizeStr = formatFileSize(totalSize);
-        std::wstring totalSizeWStr(totalSizeStr.begin(), totalSizeStr.end());
-        logContent << L"Total Size: " << totalSizeWStr << std::endl;
-    }
-    logContent << std::endl;
-
-    // Write the file tree header
-    logContent << L"\n=== FILE TREE (limited to " << maxEntries << L" entries) ===" << std::endl;
-
-	writeUnicodeToFile(logContent.str(), logFileName);
-
-
-    size_t entriesWritten = 0;
-    for (const auto& path : paths)
-    {
-        if (entriesWritten >= maxEntries)
+        if (i >= maxEntries)
         {
-            size_t remaining = paths.size() - entriesWritten;
-			std::wstringstream truncatedMessage;
-            truncatedMessage << L"... (file tree truncated, " << remaining << L" more entries not shown)";
-			writeUnicodeToFile(truncatedMessage.str(), logFileName);
-            break;
+            continue; // still counted for the summary
         }
 
-        try
+        buffer.append((node.depth - 1) * 2, L' ');
+        buffer += paths[i].filename().native();
+        if (node.isDirectory)
         {
-            std::wstringstream entryContent;
-
-            // Calculate relative path and indentation
-            fs::path relativePath = fs::relative(path, basePath);
-            auto depth = std::distance(relativePath.begin(), relativePath.end());
-            std::wstring indent = (depth > 1) ? std::wstring((depth - 1) * 2, L' ') : L"";
-
-            // Write the entry
-            entryContent << indent << path.filename().wstring();
-
-            // Add file info if regular file
-            if (fs::is_regular_file(path))
-            {
-                try
-                {
-                    uintmax_t fileSize = fs::file_size(path);
-                    std::string fileSizeStr = formatFileSize(fileSize);
-                    std::wstring fileSizeWStr(fileSizeStr.begin(), fileSizeStr.end());
-                    entryContent << L" (" << fileSizeWStr << L")";
-                }
-                catch (const fs::filesystem_error&)
-                {
-                    entryContent << L" (size unknown)";
-                }
-            }
-            else if (fs::is_directory(path))
-            {
-                entryContent << L"/";  // trailing slash for directories
-            }
-
-			writeUnicodeToFile(entryContent.str(), logFileName);
+            buffer += L'/'; // trailing slash for directories
         }
-        catch (const fs::filesystem_error& e)
+        else
         {
-            std::wstring message = L"Error processing: " + path.wstring() + L" - " + utf8ToWstring(e.what());
-            printUnicodeMulti(true, message);
+            buffer += L" (";
+            buffer += utf8ToWstring(formatFileSize(node.size));
+            buffer += L')';
+        }
+        buffer += L'\n';
 
-            writeUnicodeToFile(message, logFileName);
+        if (buffer.size() >= FLUSH_THRESHOLD)
+        {
+            writeUnicodeToFile(buffer, logFileName, false, true);
+            buffer.clear();
         }
+    }
 
-        entriesWritten++;
+    if (paths.size() > maxEntries)
+    {
+        buffer += L"... (file tree truncated, " + std::to_wstring(paths.size() - maxEntries) + L" more entries not shown)\n";
     }
 
+    // The totals are only known once the tree is written, so the summary follows it
+    std::wstringstream summary;
+    summary << L"\n=== SUMMARY STATISTICS ===" << std::endl;
+    summary << L"Directories: " << dirCount << std::endl;
+    summary << L"Files: " << fileCount << std::endl;
+    if (totalSize > 0)
+    {
+        std::string totalSizeStr = formatFileSize(totalSize);
+        std::wstring totalSizeWStr = utf8ToWstring(totalSizeStr);
+        summary << L"Total Size: " << totalSizeWStr << std::endl;
+    }
+    buffer += summary.str();
+
+    writeUnicodeToFile(buffer, logFileName, false, true);
+
     printUnicode(L"Scan results written to: " + logFileName, true);
 }
 
-void writeDeletionLog(const std::vector<fs::path>& deletedFiles, const std::vector<fs::path>& keptFiles, const std::string& removalType, size_t successCount, uintmax_t totalSizeDeleted)
+void writeDeletionLog(const std::vector<fs::path>& deletedFiles, const std::vector<fs::path>& keptFiles, const std::string& removalType, size_t successCount, uintmax_t totalSizeDeleted,
+    const std::vector<fs::path>& changedFiles, const std::vector<fs::path>& recheckedFiles)
 {
 	const std::wstring logFileName = L"deletion_log.txt";
     std::wstringstream logContent;
 
 
-    logContent << L"=== " << std::wstring(removalType.begin(), removalType.end()) << L" REMOVAL ===" << std::endl;
+    logContent << L"=== " << utf8ToWstring(removalType) << L" REMOVAL ===" << std::endl;
     logContent << L"Timestamp: " << getCurrentTimestamp() << std::endl;
     logContent << L"Total files processed: " << deletedFiles.size() << std::endl;
     logContent << L"Successfully deleted: " << successCount << std::endl;
@@ -223,7 +457,7 @@ void writeDeletionLog(const std::vector<fs::path>& deletedFiles, const std::vect
     if (totalSizeDeleted > 0)
     {
         std::string spaceFreedStr = formatFileSize(totalSizeDeleted);
-        logContent << L"Total space freed: " << std::wstring(spaceFreedStr.begin(), spaceFreedStr.end()) << std::endl;
+        logContent << L"Total space freed: " << utf8ToWstring(spaceFreedStr) << std::endl;
     }
 
     logContent << std::endl;
@@ -247,13 +481,37 @@ void writeDeletionLog(const std::vector<fs::path>& deletedFiles, const std::vect
     }
 	writeUnicodeToFile(L"", logFileName);
 
+    // Files whose fingerprint no longer matched the one taken while hashing
+    if (!changedFiles.empty())
+    {
+        writeUnicodeToFile(L"Files changed since they were hashed (not removed):", logFileName);
+        for (const auto& file : changedFiles)
+        {
+            writeUnicodeToFile(L"  CHANGED: " + file.wstring(), logFileName);
+        }
+        writeUnicodeToFile(L"", logFileName);
+    }
+    if (!recheckedFiles.empty())
+    {
+        writeUnicodeToFile(L"Files touched since they were hashed, hashed again and unchanged:", logFileName);
+        for (const auto& file : recheckedFiles)
+        {
+            writeUnicodeToFile(L"  RECHECKED: " + file.wstring(), logFileName);
+        }
+        writeUnicodeToFile(L"", logFileName);
+    }
+
     // Also write summary to console
     printUnicode(L"\n=== REMOVAL SUMMARY ===", true);
     printUnicode(L"Total files moved to Recycle Bin: " + std::to_wstring(successCount), true);
+    if (!changedFiles.empty())
+    {
+        printUnicode(L"Changed since hashing and left alone: " + std::to_wstring(changedFiles.size()), true);
+    }
     if (totalSizeDeleted > 0)
     {
         std::string spaceFreedStr = formatFileSize(totalSizeDeleted);
-        printUnicode(L"Total space freed: " + std::wstring(spaceFreedStr.begin(), spaceFreedStr.end()), true);
+        printUnicode(L"Total space freed: " + utf8ToWstring(spaceFreedStr), true);
     }
 }
 
@@ -276,7 +534,8 @@ void resetLogFiles()
     const std::vector<std::wstring> logFiles = {
         L"scan_results.txt",
         L"duplicate_log.txt",
-        L"deletion_log.txt"
+        L"deletion_log.txt",
+        L"chunk_log.txt"
     };
 
     for (const auto& logFile : logFiles)
@@ -291,7 +550,7 @@ void resetLogFiles()
             catch (const fs::filesystem_error& e)
             {
                 // Non-critical error, just notify
-                printUnicode(L"Warning: Could not delete old log file: " + logFile + L" - " + utf8ToWstring(e.what()), true);
+                printUnicode(L"Warning: Could not delete old log file: " + logFile + L" - " + errorMessage(e), true);
             }
         }
     }
@@ -1,17 +1,71 @@
 ﻿#pragma once
 
+#include "WasteAnalytics.h"
+#include "ExtentMap.h"
+
 #include <string>
 #include <vector>
 #include <map>
 #include <filesystem>
+#include <cstdint>
 
 namespace fs = std::filesystem;
 
-size_t processDuplicateGroups(const std::map<std::string, std::vector<fs::path>>& duplicateGroups);
+// Writes duplicate_log.txt one group at a time, so groups from a streaming run reach the log and the console
+// as soon as they are confirmed. The summary is appended by finish, once every group is known, followed by where the
+// wasted space is: the largest groups, the folders and extensions holding the most, and a size histogram.
+class DuplicateReport
+{
+public:
+    // scanRoot is where the folder totals of the waste analysis stop rolling up
+    explicit DuplicateReport(size_t topGroups = DEFAULT_TOP_GROUPS, const fs::path& scanRoot = {});
+
+    // fileSize is the listed size of each file. Block sharing is only looked up for copies of a cluster or more that
+    // sit together on a volume that can block-clone, so most groups are reported without a filesystem call.
+    void addGroup(const std::string& hash, const std::vector<fs::path>& files, uintmax_t fileSize);
+
+    // Identical folders, listed once for the whole subtree; bytes and files are those of one copy
+    void addDirectoryGroup(const std::string& hash, const std::vector<fs::path>& directories, uintmax_t bytes, size_t files);
+
+    // Copies inside zip or tar files, with any loose copies. Reported only: nothing inside an archive is removed, so
+    // these groups are kept out of the wasted space totals.
+    void addArchiveGroup(const std::string& hash, const std::vector<fs::path>& files, const std::vector<fs::path>& members, uintmax_t size);
+
+    // Returns the number of duplicate groups reported, folder groups included
+    size_t finish();
+
+private:
+    void writeWasteAnalysis();
+    const VolumeBlockInfo& volumeOf(const fs::path& file);
+
+    const std::wstring logFileName = L"duplicate_log.txt";
+    size_t topGroups;
+    WasteAnalytics analytics;
+    size_t groupCount = 0;
+    size_t directoryGroupCount = 0;
+    size_t archiveGroupCount = 0;
+    uintmax_t archivedDuplicateSize = 0;
+    size_t totalDuplicateFiles = 0;
+    uintmax_t totalDuplicateSize = 0;
+    uintmax_t totalSharedSize = 0;
+
+    // Volumes are looked up once each; files of one directory are always on the same volume
+    std::map<std::wstring, VolumeBlockInfo> volumes;
+    std::map<std::wstring, const VolumeBlockInfo*> volumeOfDirectory;
+};
+
+struct DuplicateGroup;
+
+size_t processDuplicateGroups(const std::vector<DuplicateGroup>& duplicateGroups, size_t topGroups = DEFAULT_TOP_GROUPS);
+
+struct ScanNode;
 
-void writeScanLog(const std::vector<fs::path>& paths, const fs::path& basePath, size_t maxEntries = 1000);
+// Writes scan_results.txt from the scanner's own record of the tree. SIZE_MAX writes every entry.
+void writeScanLog(const std::vector<fs::path>& paths, const std::vector<ScanNode>& nodes, const fs::path& basePath, size_t maxEntries = 1000);
 
-void writeDeletionLog(const std::vector<fs::path>& deletedFiles, const std::vector<fs::path>& keptFiles, const std::string& removalType, size_t successCount, uintmax_t totalSizeDeleted);
+// changedFiles changed after they were hashed and were not removed; recheckedFiles looked changed but still matched
+void writeDeletionLog(const std::vector<fs::path>& deletedFiles, const std::vector<fs::path>& keptFiles, const std::string& removalType, size_t successCount, uintmax_t totalSizeDeleted,
+    const std::vector<fs::path>& changedFiles = {}, const std::vector<fs::path>& recheckedFiles = {});
 
 std::wstring getCurrentTimestamp();
 
@@ -0,0 +1,562 @@
+#include "ResultStore.h"
+#include "Utilities.h"
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <chrono>
+#include <cstring>
+#include <algorithm>
+
+#define WIN32_LEAN_AND_MEAN
+#include <Windows.h>
+
+struct ResultIndexRecord
+{
+    uint64_t wastedBytes;
+    uint64_t size;
+    uint64_t groupOffset; // of its GroupHeader
+    uint32_t count;
+    uint32_t flags;
+};
+
+namespace
+{
+    const char STORE_MAGIC[4] = { 'D', 'F', 'R', '1' };
+    const uint32_t STORE_VERSION = 1;
+
+    const uint32_t RECORD_DIRECTORY = 1;
+    const uint32_t RECORD_HANDLED = 2;
+
+    const uint32_t GROUP_FINGERPRINTS = 1;
+    const uint32_t GROUP_FOLDER_CONTENTS = 2;
+
+    // Written to the file in pieces of this size while groups come in
+    const size_t WRITE_CHUNK = 1 << 20;
+
+    struct StoreHeader
+    {
+        char magic[4];
+        uint32_t version;
+        uint64_t groupCount;
+        uint64_t indexOffset;  // groups run from the header to here
+        uint64_t totalWasted;
+        int64_t createdTime;
+    };
+
+    // Followed by the hash, then one EntryHeader and path per entry, each padded to a multiple of 8
+    struct GroupHeader
+    {
+        uint32_t hashLength;
+        uint32_t flags;
+    };
+
+    struct EntryHeader
+    {
+        FileFingerprint fingerprint; // only meaningful with GROUP_FINGERPRINTS
+        uint32_t pathLength;         // UTF-8
+        uint32_t reserved;
+    };
+
+    // With GROUP_FOLDER_CONTENTS the entries are followed by this, one FolderEntryHeader and relative path per entry
+    // inside the folders, padded like the paths, and then for each folder in turn one fingerprint per entry
+    struct FolderContentsHeader
+    {
+        uint32_t entryCount;
+        uint32_t reserved;
+    };
+
+    struct FolderEntryHeader
+    {
+        uint32_t pathLength;         // UTF-8
+        uint32_t isDirectory;
+    };
+
+    uint64_t padded(uint64_t length)
+    {
+        return (length + sizeof(uint64_t) - 1) / sizeof(uint64_t) * sizeof(uint64_t);
+    }
+
+    // Paths match however their letters and separators were typed
+    char looseChar(char c)
+    {
+        if (c == '/') return '\\';
+        if (c >= 'A' && c <= 'Z') return static_cast<char>(c - 'A' + 'a');
+        return c;
+    }
+
+    // The folder itself or anything below it: "D:\Photos" takes in "D:\Photos\a.jpg" but not "D:\Photos Old\a.jpg"
+    bool underFolderLoose(std::string_view path, std::string_view folder)
+    {
+        if (path.size() < folder.size()) return false;
+        for (size_t i = 0; i < folder.size(); ++i)
+        {
+            if (looseChar(path[i]) != looseChar(folder[i])) return false;
+        }
+        return folder.empty() || path.size() == folder.size() || looseChar(folder.back()) == '\\' || looseChar(path[folder.size()]) == '\\';
+    }
+
+    bool writeAll(HANDLE hFile, const void* data, uint64_t length)
+    {
+        const char* bytes = static_cast<const char*>(data);
+        while (length > 0)
+        {
+            DWORD chunk = static_cast<DWORD>(std::min<uint64_t>(length, 1u << 30));
+            DWORD written = 0;
+            if (!WriteFile(hFile, bytes, chunk, &written, nullptr) || written != chunk) return false;
+            bytes += chunk;
+            length -= chunk;
+        }
+        return true;
+    }
+}
+
+bool pathUnderPrefix(const fs::path& path, const std::wstring& prefix)
+{
+    return underFolderLoose(wstringToUtf8(path.native()), wstringToUtf8(prefix));
+}
+
+static_assert(sizeof(StoreHeader) == 40, "result store header layout changed");
+static_assert(sizeof(ResultIndexRecord) == 32, "result store index layout changed");
+static_assert(sizeof(EntryHeader) == 48, "result store entry layout changed");
+static_assert(sizeof(FolderEntryHeader) == 8 && sizeof(FileFingerprint) % 8 == 0, "result store folder layout changed");
+
+ResultStore::~ResultStore()
+{
+    close();
+}
+
+bool ResultStore::open(const fs::path& storePath)
+{
+    close();
+
+    HANDLE hFile = CreateFileW(storePath.c_str(), GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_RANDOM_ACCESS, nullptr);
+    if (hFile == INVALID_HANDLE_VALUE)
+    {
+        printMessage(&onMessage, L"Error: Could not open the results ", storePath.wstring());
+        return false;
+    }
+
+    LARGE_INTEGER fileSize;
+    HANDLE hMapping = nullptr;
+    unsigned char* mapped = nullptr;
+    if (GetFileSizeEx(hFile, &fileSize) && fileSize.QuadPart >= static_cast<LONGLONG>(sizeof(StoreHeader)))
+    {
+        hMapping = CreateFileMappingW(hFile, nullptr, PAGE_READWRITE, 0, 0, nullptr);
+        mapped = hMapping ? static_cast<unsigned char*>(MapViewOfFile(hMapping, FILE_MAP_WRITE, 0, 0, 0)) : nullptr;
+    }
+
+    fileHandle = hFile;
+    mappingHandle = hMapping;
+    view = mapped;
+    viewSize = mapped ? static_cast<uint64_t>(fileSize.QuadPart) : 0;
+
+    StoreHeader header = {};
+    bool valid = view != nullptr;
+    if (valid)
+    {
+        std::memcpy(&header, view, sizeof(header));
+        valid = std::memcmp(header.magic, STORE_MAGIC, sizeof(STORE_MAGIC)) == 0
+            && header.version == STORE_VERSION
+            && header.indexOffset >= sizeof(header)
+            && header.indexOffset % sizeof(uint64_t) == 0
+            && header.indexOffset <= viewSize
+            && header.groupCount <= (viewSize - header.indexOffset) / sizeof(ResultIndexRecord)
+            && header.indexOffset + header.groupCount * sizeof(ResultIndexRecord) == viewSize;
+    }
+
+    if (!valid)
+    {
+        printMessage(&onMessage, L"Error: ", storePath.wstring(), L" is not a valid results file.");
+        close();
+        return false;
+    }
+    return true;
+}
+
+void ResultStore::close()
+{
+    if (view)
+    {
+        FlushViewOfFile(view, 0); // the handled flags
+        UnmapViewOfFile(view);
+    }
+    if (mappingHandle) CloseHandle(mappingHandle);
+    if (fileHandle) CloseHandle(fileHandle);
+
+    view = nullptr;
+    mappingHandle = nullptr;
+    fileHandle = nullptr;
+    viewSize = 0;
+}
+
+size_t ResultStore::groupCount() const
+{
+    if (!view) return 0;
+    return static_cast<size_t>(reinterpret_cast<const StoreHeader*>(view)->groupCount);
+}
+
+uint64_t ResultStore::totalWasted() const
+{
+    return view ? reinterpret_cast<const StoreHeader*>(view)->totalWasted : 0;
+}
+
+int64_t ResultStore::createdTime() const
+{
+    return view ? reinterpret_cast<const StoreHeader*>(view)->createdTime : 0;
+}
+
+StoredGroupInfo ResultStore::info(size_t rank) const
+{
+    StoredGroupInfo info;
+    if (rank >= groupCount()) return info;
+
+    const ResultIndexRecord* record = reinterpret_cast<const ResultIndexRecord*>(view + reinterpret_cast<const StoreHeader*>(view)->indexOffset) + rank;
+    info.wastedBytes = record->wastedBytes;
+    info.size = record->size;
+    info.count = record->count;
+    info.isDirectory = (record->flags & RECORD_DIRECTORY) != 0;
+    info.handled = (record->flags & RECORD_HANDLED) != 0;
+    return info;
+}
+
+template <typename Visit>
+bool ResultStore::visitFiles(size_t rank, std::string* hash, Visit&& visit, uint64_t* contentsOffset) const
+{
+    if (contentsOffset) *contentsOffset = 0;
+    if (rank >= groupCount()) return false;
+
+    const uint64_t groupsEnd = reinterpret_cast<const StoreHeader*>(view)->indexOffset;
+    const ResultIndexRecord* record = reinterpret_cast<const ResultIndexRecord*>(view + groupsEnd) + rank;
+
+    uint64_t position = record->groupOffset;
+    if (position < sizeof(StoreHeader) || position > groupsEnd || groupsEnd - position < sizeof(GroupHeader)) return false;
+
+    GroupHeader group;
+    std::memcpy(&group, view + position, sizeof(group));
+    position += sizeof(group);
+    if (group.hashLength > groupsEnd - position) return false;
+    if (hash) hash->assign(reinterpret_cast<const char*>(view + position), group.hashLength);
+    position += padded(group.hashLength);
+
+    const bool hasFingerprints = (group.flags & GROUP_FINGERPRINTS) != 0;
+    for (uint32_t i = 0; i < record->count; ++i)
+    {
+        if (position > groupsEnd || groupsEnd - position < sizeof(EntryHeader)) return false;
+        EntryHeader entry;
+        std::memcpy(&entry, view + position, sizeof(entry));
+        position += sizeof(entry);
+        if (entry.pathLength > groupsEnd - position) return false;
+
+        std::string_view path(reinterpret_cast<const char*>(view + position), entry.pathLength);
+        position += padded(entry.pathLength);
+        if (!visit(path, hasFingerprints ? &entry.fingerprint : nullptr)) return true;
+    }
+
+    if (contentsOffset && (group.flags & GROUP_FOLDER_CONTENTS) != 0) *contentsOffset = position;
+    return true;
+}
+
+fs::path ResultStore::firstPath(size_t rank) const
+{
+    fs::path first;
+    visitFiles(rank, nullptr, [&](std::string_view path, const FileFingerprint*)
+    {
+        first = utf8ToWstring(path);
+        return false;
+    });
+    return first;
+}
+
+bool ResultStore::load(size_t rank, DuplicateGroup& group) const
+{
+    group = DuplicateGroup();
+    group.fileSize = info(rank).size;
+
+    bool allFingerprints = true;
+    bool loaded = visitFiles(rank, &group.hash, [&](std::string_view path, const FileFingerprint* fingerprint)
+    {
+        group.files.push_back(utf8ToWstring(path));
+        if (fingerprint) group.fingerprints.push_back(*fingerprint);
+        else allFingerprints = false;
+        return true;
+    });
+
+    if (!allFingerprints) group.fingerprints.clear();
+    return loaded && group.files.size() == info(rank).count;
+}
+
+bool ResultStore::load(size_t rank, DirectoryGroup& group) const
+{
+    group = DirectoryGroup();
+    const StoredGroupInfo stored = info(rank);
+    group.bytes = stored.size;
+
+    uint64_t position = 0;
+    bool loaded = visitFiles(rank, &group.hash, [&](std::string_view path, const FileFingerprint*)
+    {
+        group.directories.push_back(utf8ToWstring(path));
+        return true;
+    }, &position);
+    if (!loaded || group.directories.size() != stored.count) return false;
+    if (position == 0) return true;
+
+    const uint64_t groupsEnd = reinterpret_cast<const StoreHeader*>(view)->indexOffset;
+    if (position > groupsEnd || groupsEnd - position < sizeof(FolderContentsHeader)) return false;
+    FolderContentsHeader contents;
+    std::memcpy(&contents, view + position, sizeof(contents));
+    position += sizeof(contents);
+
+    for (uint32_t i = 0; i < contents.entryCount; ++i)
+    {
+        if (position > groupsEnd || groupsEnd - position < sizeof(FolderEntryHeader)) return false;
+        FolderEntryHeader entry;
+        std::memcpy(&entry, view + position, sizeof(entry));
+        position += sizeof(entry);
+        if (entry.pathLength > groupsEnd - position) return false;
+
+        std::string_view path(reinterpret_cast<const char*>(view + position), entry.pathLength);
+        group.entries.push_back({ utf8ToWstring(path), entry.isDirectory != 0 });
+        if (!entry.isDirectory) group.files++;
+        position += padded(entry.pathLength);
+    }
+
+    const uint64_t fingerprintCount = static_cast<uint64_t>(stored.count) * contents.entryCount;
+    if (position > groupsEnd || fingerprintCount > (groupsEnd - position) / sizeof(FileFingerprint)) return false;
+    group.fingerprints.assign(stored.count, std::vector<FileFingerprint>(contents.entryCount));
+    for (auto& fingerprints : group.fingerprints)
+    {
+        std::memcpy(fingerprints.data(), view + position, fingerprints.size() * sizeof(FileFingerprint));
+        position += fingerprints.size() * sizeof(FileFingerprint);
+    }
+    return true;
+}
+
+bool ResultStore::matches(size_t rank, const ResultFilter& filter, std::string_view prefix) const
+{
+    StoredGroupInfo group = info(rank);
+    if (group.count == 0) return false;
+    if (group.handled && !filter.includeHandled) return false;
+    if (group.size < filter.minSize || group.size > filter.maxSize) return false;
+    if (prefix.empty()) return true;
+
+    bool found = false;
+    visitFiles(rank, nullptr, [&](std::string_view path, const FileFingerprint*)
+    {
+        found = underFolderLoose(path, prefix);
+        return !found;
+    });
+    return found;
+}
+
+bool ResultStore::matches(size_t rank, const ResultFilter& filter) const
+{
+    return matches(rank, filter, wstringToUtf8(filter.pathPrefix));
+}
+
+size_t ResultStore::nextMatch(size_t rank, const ResultFilter& filter) const
+{
+    const std::string prefix = wstringToUtf8(filter.pathPrefix);
+    for (; rank < groupCount(); ++rank)
+    {
+        if (matches(rank, filter, prefix)) return rank;
+    }
+    return groupCount();
+}
+
+size_t ResultStore::previousMatch(size_t rank, const ResultFilter& filter) const
+{
+    const std::string prefix = wstringToUtf8(filter.pathPrefix);
+    for (rank = std::min<size_t>(rank, groupCount()); rank > 0; --rank)
+    {
+        if (matches(rank - 1, filter, prefix)) return rank - 1;
+    }
+    return groupCount();
+}
+
+void ResultStore::markHandled(size_t rank)
+{
+    if (rank >= groupCount()) return;
+    ResultIndexRecord* record = reinterpret_cast<ResultIndexRecord*>(view + reinterpret_cast<const StoreHeader*>(view)->indexOffset) + rank;
+    record->flags |= RECORD_HANDLED;
+}
+
+ResultStoreWriter::ResultStoreWriter(MessageHandler onMessage)
+    : onMessage(std::move(onMessage))
+{
+}
+
+ResultStoreWriter::~ResultStoreWriter()
+{
+    discard();
+}
+
+bool ResultStoreWriter::create(const fs::path& storePath)
+{
+    discard();
+
+    finalPath = storePath;
+    tempPath = storePath;
+    tempPath += L".tmp";
+
+    HANDLE hFile = CreateFileW(tempPath.c_str(), GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (hFile == INVALID_HANDLE_VALUE)
+    {
+        printMessage(&onMessage, L"Error: Could not create ", tempPath.wstring());
+        return false;
+    }
+    fileHandle = hFile;
+
+    // Room for the header, which is only known once every group is in
+    StoreHeader header = {};
+    append(&header, sizeof(header));
+    return true;
+}
+
+size_t ResultStoreWriter::groupCount() const
+{
+    return index.size();
+}
+
+void ResultStoreWriter::addGroup(const DuplicateGroup& group)
+{
+    const bool hasFingerprints = group.fingerprints.size() == group.files.size();
+    addEntries(group.hash, group.files, group.fileSize, hasFingerprints ? group.fingerprints.data() : nullptr, nullptr, 0);
+}
+
+void ResultStoreWriter::addDirectoryGroup(const DirectoryGroup& group)
+{
+    addEntries(group.hash, group.directories, group.bytes, nullptr, &group, RECORD_DIRECTORY);
+}
+
+void ResultStoreWriter::addEntries(const std::string& hash, const std::vector<fs::path>& entries, uint64_t size, const FileFingerprint* fingerprints,
+    const DirectoryGroup* contents, uint32_t flags)
+{
+    if (!fileHandle || failed || entries.size() < 2) return;
+
+    const uint64_t wastedBytes = size * (entries.size() - 1);
+    index.push_back({ wastedBytes, size, offset, static_cast<uint32_t>(entries.size()), flags });
+    wastedTotal += wastedBytes;
+
+    // Folders are only stored with their contents if every one of them has a fingerprint for every entry
+    const bool hasContents = contents && contents->fingerprints.size() == entries.size()
+        && std::all_of(contents->fingerprints.begin(), contents->fingerprints.end(), [&](const std::vector<FileFingerprint>& folder)
+        {
+            return folder.size() == contents->entries.size();
+        });
+
+    static const char zeros[sizeof(uint64_t)] = {};
+    GroupHeader header = { static_cast<uint32_t>(hash.size()), (fingerprints ? GROUP_FINGERPRINTS : 0) | (hasContents ? GROUP_FOLDER_CONTENTS : 0) };
+    append(&header, sizeof(header));
+    append(hash.data(), hash.size());
+    append(zeros, padded(hash.size()) - hash.size());
+
+    for (size_t i = 0; i < entries.size(); ++i)
+    {
+        std::string path = wstringToUtf8(entries[i].native());
+        EntryHeader entry = {};
+        if (fingerprints) entry.fingerprint = fingerprints[i];
+        entry.pathLength = static_cast<uint32_t>(path.size());
+        append(&entry, sizeof(entry));
+        append(path.data(), path.size());
+        append(zeros, padded(path.size()) - path.size());
+    }
+
+    if (hasContents)
+    {
+        FolderContentsHeader contentsHeader = { static_cast<uint32_t>(contents->entries.size()), 0 };
+        append(&contentsHeader, sizeof(contentsHeader));
+        for (const auto& folderEntry : contents->entries)
+        {
+            std::string path = wstringToUtf8(folderEntry.relativePath.native());
+            FolderEntryHeader entry = { static_cast<uint32_t>(path.size()), folderEntry.isDirectory ? 1u : 0u };
+            append(&entry, sizeof(entry));
+            append(path.data(), path.size());
+            append(zeros, padded(path.size()) - path.size());
+        }
+        for (const auto& folder : contents->fingerprints)
+        {
+            append(folder.data(), folder.size() * sizeof(FileFingerprint));
+        }
+    }
+
+    if (pending.size() >= WRITE_CHUNK) flush();
+}
+
+void ResultStoreWriter::append(const void* data, size_t length)
+{
+    pending.append(static_cast<const char*>(data), length);
+    offset += length;
+}
+
+bool ResultStoreWriter::flush()
+{
+    if (failed) return false;
+    if (!writeAll(fileHandle, pending.data(), pending.size()))
+    {
+        printMessage(&onMessage, L"Error: Could not write ", tempPath.wstring());
+        failed = true;
+        return false;
+    }
+    pending.clear();
+    return true;
+}
+
+bool ResultStoreWriter::finish()
+{
+    if (!fileHandle) return false;
+
+    // Largest reclaimable space first; groups that reclaim the same keep the order they were found in
+    std::sort(index.begin(), index.end(), [](const ResultIndexRecord& a, const ResultIndexRecord& b)
+    {
+        return a.wastedBytes != b.wastedBytes ? a.wastedBytes > b.wastedBytes : a.groupOffset < b.groupOffset;
+    });
+
+    StoreHeader header = {};
+    std::memcpy(header.magic, STORE_MAGIC, sizeof(STORE_MAGIC));
+    header.version = STORE_VERSION;
+    header.groupCount = index.size();
+    header.indexOffset = offset;
+    header.totalWasted = wastedTotal;
+    header.createdTime = std::chrono::system_clock::now().time_since_epoch().count();
+
+    LARGE_INTEGER start = {};
+    bool written = flush()
+        && writeAll(fileHandle, index.data(), index.size() * sizeof(ResultIndexRecord))
+        && SetFilePointerEx(fileHandle, start, nullptr, FILE_BEGIN)
+        && writeAll(fileHandle, &header, sizeof(header))
+        && FlushFileBuffers(fileHandle);
+    CloseHandle(fileHandle);
+    fileHandle = nullptr;
+
+    if (!written)
+    {
+        printMessage(&onMessage, L"Error: Could not write ", tempPath.wstring());
+        DeleteFileW(tempPath.c_str());
+        return false;
+    }
+
+    if (!MoveFileExW(tempPath.c_str(), finalPath.c_str(), MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH))
+    {
+        DWORD error = GetLastError();
+        printMessage(&onMessage, L"Error: Could not replace ", finalPath.wstring(), L" (Error code: ", std::to_wstring(error), L")");
+        DeleteFileW(tempPath.c_str());
+        return false;
+    }
+    return true;
+}
+
+void ResultStoreWriter::discard()
+{
+    if (fileHandle)
+    {
+        CloseHandle(fileHandle);
+        DeleteFileW(tempPath.c_str());
+        fileHandle = nullptr;
+    }
+    pending.clear();
+    index.clear();
+    offset = 0;
+    wastedTotal = 0;
+    failed = false;
+}
@@ -0,0 +1,129 @@
+#pragma once
+
+#include "HashCalculator.h"
+#include "DirectoryDigest.h"
+
+#include <filesystem>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <cstdint>
+
+namespace fs = std::filesystem;
+
+struct ResultIndexRecord; // one per group, in the file layout
+
+// Duplicate groups kept on disk for review, ordered by the space removing their extra copies would reclaim, so a
+// run with hundreds of thousands of groups neither holds them in memory nor shows them in the order they were found.
+//
+// One file: a header, the groups in the order they were written, each with its hash, paths and fingerprints (folder
+// groups with what each folder held instead), and then an index of fixed 32-byte records sorted by reclaimable bytes. Review maps the file and reads only the groups
+// it shows. Each index record also has a handled flag, written back to the file, so a review can stop and go on later.
+
+struct ResultFilter
+{
+    std::wstring pathPrefix;        // at least one copy in this folder or below it; ASCII letters and slashes compare loosely
+    uint64_t minSize = 0;           // of one copy
+    uint64_t maxSize = UINT64_MAX;
+    bool includeHandled = false;
+};
+
+// Whether path is a filter's pathPrefix folder or below it, compared the same loose way; a sibling such as
+// "<folder> Old" does not count
+bool pathUnderPrefix(const fs::path& path, const std::wstring& prefix);
+
+struct StoredGroupInfo
+{
+    uint64_t wastedBytes = 0;       // every copy but one
+    uint64_t size = 0;              // of one copy
+    uint32_t count = 0;
+    bool isDirectory = false;
+    bool handled = false;
+};
+
+class ResultStore
+{
+public:
+    // Errors go to onMessage, or the console without one
+    explicit ResultStore(MessageHandler onMessage = {}) : onMessage(std::move(onMessage)) {}
+    ~ResultStore();
+
+    ResultStore(const ResultStore&) = delete;
+    ResultStore& operator=(const ResultStore&) = delete;
+
+    // Opened for writing too, for the handled flags. Fails on a missing, damaged or newer-version file.
+    bool open(const fs::path& storePath);
+    void close();
+
+    size_t groupCount() const;
+    uint64_t totalWasted() const;
+    int64_t createdTime() const; // system_clock ticks when the store was written
+
+    // Groups are addressed by rank, 0 being the one that reclaims the most
+    StoredGroupInfo info(size_t rank) const;
+    fs::path firstPath(size_t rank) const;
+
+    bool load(size_t rank, DuplicateGroup& group) const;
+    // Folder groups come back with the entries and fingerprints recorded when they were found. Those stored before
+    // folder contents were recorded come back without, and removal leaves their folders alone.
+    bool load(size_t rank, DirectoryGroup& group) const;
+
+    bool matches(size_t rank, const ResultFilter& filter) const;
+
+    // The first match at or after rank, or the last one before it; groupCount() if there is none
+    size_t nextMatch(size_t rank, const ResultFilter& filter) const;
+    size_t previousMatch(size_t rank, const ResultFilter& filter) const;
+
+    void markHandled(size_t rank);
+
+private:
+    // Calls visit(path, fingerprint) for each file of the group until it returns false; false if the group is damaged.
+    // contentsOffset, if given, is set to where a folder group's recorded contents start, or 0 if it has none.
+    template <typename Visit>
+    bool visitFiles(size_t rank, std::string* hash, Visit&& visit, uint64_t* contentsOffset = nullptr) const;
+    // With the filter's prefix already in UTF-8, so paging converts it once and not once per group
+    bool matches(size_t rank, const ResultFilter& filter, std::string_view prefix) const;
+
+    MessageHandler onMessage;
+    void* fileHandle = nullptr;
+    void* mappingHandle = nullptr;
+    unsigned char* view = nullptr;
+    uint64_t viewSize = 0;
+};
+
+// Appends groups as they are confirmed and sorts only the index at the end, so writing needs 32 bytes per group
+class ResultStoreWriter
+{
+public:
+    explicit ResultStoreWriter(MessageHandler onMessage = {});
+    ~ResultStoreWriter(); // an unfinished store is deleted
+
+    ResultStoreWriter(const ResultStoreWriter&) = delete;
+    ResultStoreWriter& operator=(const ResultStoreWriter&) = delete;
+
+    // Writes to a temporary file next to storePath, which finish swaps in
+    bool create(const fs::path& storePath);
+
+    void addGroup(const DuplicateGroup& group);
+    void addDirectoryGroup(const DirectoryGroup& group);
+
+    bool finish();
+    size_t groupCount() const;
+
+private:
+    void addEntries(const std::string& hash, const std::vector<fs::path>& entries, uint64_t size, const FileFingerprint* fingerprints,
+        const DirectoryGroup* contents, uint32_t flags);
+    void append(const void* data, size_t length);
+    bool flush();
+    void discard();
+
+    MessageHandler onMessage;
+    void* fileHandle = nullptr;
+    fs::path finalPath;
+    fs::path tempPath;
+    std::string pending;     // written out in pieces of about a megabyte
+    uint64_t offset = 0;     // bytes appended so far, pending included
+    uint64_t wastedTotal = 0;
+    bool failed = false;
+    std::vector<ResultIndexRecord> index;
+};
@@ -0,0 +1,391 @@
+#include "ReviewSession.h"
+#include "ResultStore.h"
+#include "SnapshotCommands.h"
+#include "InputHandler.h"
+#include "Throttle.h"
+#include "Utilities.h"
+
+#include <iostream>
+#include <string>
+#include <vector>
+
+namespace
+{
+    // Groups "remove all" shows in full before asking
+    const size_t BULK_SAMPLE_GROUPS = 3;
+
+    std::wstring sizeText(uint64_t bytes)
+    {
+        return utf8ToWstring(formatFileSize(bytes));
+    }
+
+    std::wstring describeFilter(const ResultFilter& filter)
+    {
+        std::wstring text;
+        if (!filter.pathPrefix.empty()) text += L" under \"" + filter.pathPrefix + L"\"";
+        if (filter.minSize > 0) text += L" from " + sizeText(filter.minSize);
+        if (filter.maxSize != UINT64_MAX) text += L" up to " + sizeText(filter.maxSize);
+        return text;
+    }
+
+    void printPage(const ResultStore& store, const std::vector<size_t>& page, const ResultFilter& filter)
+    {
+        std::wcout << L"\n--- Groups by reclaimable space" << describeFilter(filter) << L" ---" << std::endl;
+        for (size_t rank : page)
+        {
+            StoredGroupInfo group = store.info(rank);
+            printUnicodeMulti(true, L"  #", std::to_wstring(rank + 1), L"  ", sizeText(group.wastedBytes), L" reclaimable, ",
+                std::to_wstring(group.count), group.isDirectory ? L" folders of " : L" copies of ", sizeText(group.size), L"  ",
+                store.firstPath(rank).wstring());
+        }
+    }
+
+    // Loads the group at rank, as folders with their recorded contents or as files, and hands it to act. False if the
+    // group is damaged in the file.
+    template <typename Act>
+    bool withGroup(const ResultStore& store, size_t rank, Act&& act)
+    {
+        if (store.info(rank).isDirectory)
+        {
+            DirectoryGroup folders;
+            if (!store.load(rank, folders)) return false;
+            act(folders);
+            return true;
+        }
+
+        DuplicateGroup group;
+        if (!store.load(rank, group)) return false;
+        act(group);
+        return true;
+    }
+
+    const std::vector<fs::path>& entriesOf(const DuplicateGroup& group) { return group.files; }
+    const std::vector<fs::path>& entriesOf(const DirectoryGroup& group) { return group.directories; }
+
+    // With a folder filter, remove all takes only the copies under the folder, so a group keeps a copy outside it
+    // whenever it has one. Empty without a folder filter, when any copy may go.
+    std::vector<bool> removableUnder(const std::vector<fs::path>& entries, const std::wstring& prefix)
+    {
+        std::vector<bool> removable;
+        if (prefix.empty()) return removable;
+
+        for (const auto& entry : entries)
+        {
+            removable.push_back(pathUnderPrefix(entry, prefix));
+        }
+        return removable;
+    }
+
+    // What remove all would do to the first few matching groups, path by path
+    void printRemovalSample(const ResultStore& store, const ResultFilter& filter, size_t groups)
+    {
+        DuplicateGroup group;
+        size_t shown = 0;
+        for (size_t rank = store.nextMatch(0, filter); rank < store.groupCount() && shown < BULK_SAMPLE_GROUPS; rank = store.nextMatch(rank + 1, filter))
+        {
+            if (!store.load(rank, group)) continue;
+            shown++;
+
+            std::vector<bool> removable = removableUnder(group.files, filter.pathPrefix);
+            size_t keep = selectEntryToKeep(group.files, removable.empty() ? nullptr : &removable);
+            printUnicodeMulti(true, L"  Group #", std::to_wstring(rank + 1), L" (", sizeText(group.fileSize), L" each)");
+            for (size_t i = 0; i < group.files.size(); ++i)
+            {
+                bool removed = i != keep && (removable.empty() || removable[i]);
+                printUnicodeMulti(true, removed ? L"    DELETE: " : L"    KEEP:   ", group.files[i].wstring());
+            }
+        }
+        if (groups > shown) std::wcout << L"  ... and " << (groups - shown) << L" more groups." << std::endl;
+    }
+
+    void printCommands()
+    {
+        std::wcout << L"\nCommands:" << std::endl;
+        std::wcout << L"  <number>       open that group and choose what to keep" << std::endl;
+        std::wcout << L"  n / p          next / previous page" << std::endl;
+        std::wcout << L"  f <folder>     only groups with a copy under the folder (f alone clears it)" << std::endl;
+        std::wcout << L"  min <size>     only groups of files at least this large, e.g. 10MB (min 0 clears it)" << std::endl;
+        std::wcout << L"  max <size>     only groups of files at most this large (max alone clears it)" << std::endl;
+        std::wcout << L"  remove all     in every group that matches, keep the shortest path and remove the rest;" << std::endl;
+        std::wcout << L"                 with f, only the copies under the folder go and a copy outside it is kept" << std::endl;
+        std::wcout << L"  keep all       keep every group that matches and take it off the list" << std::endl;
+        std::wcout << L"  q              stop; the groups not handled yet are still there for \"DupeFind review\"" << std::endl;
+    }
+
+    // Bulk actions go over the file twice, once to show what they would touch and once to do it, one group at a time
+    void applyToMatches(ResultStore& store, const ResultFilter& filter, DuplicateRemover& remover, bool removeDuplicates)
+    {
+        size_t groups = 0;
+        uint64_t wastedBytes = 0;
+        DuplicateGroup group;
+        for (size_t rank = store.nextMatch(0, filter); rank < store.groupCount(); rank = store.nextMatch(rank + 1, filter))
+        {
+            groups++;
+            if (!removeDuplicates || filter.pathPrefix.empty())
+            {
+                wastedBytes += store.info(rank).wastedBytes;
+                continue;
+            }
+
+            // Only the copies under the folder count
+            if (!store.load(rank, group)) continue;
+            std::vector<bool> removable = removableUnder(group.files, filter.pathPrefix);
+            size_t keep = selectEntryToKeep(group.files, &removable);
+            for (size_t i = 0; i < group.files.size(); ++i)
+            {
+                if (i != keep && removable[i]) wastedBytes += group.fileSize;
+            }
+        }
+
+        if (groups == 0)
+        {
+            std::wcout << L"No groups match." << std::endl;
+            return;
+        }
+
+        std::wcout << groups << L" groups match" << describeFilter(filter) << L", with " << sizeText(wastedBytes) << L" reclaimable." << std::endl;
+        if (removeDuplicates && filter.pathPrefix.empty())
+        {
+            std::wcout << L"The shortest path in each group is kept and the other copies are moved to the Recycle Bin." << std::endl;
+        }
+        else if (removeDuplicates)
+        {
+            printUnicodeMulti(true, L"Only copies under \"", filter.pathPrefix, L"\" are moved to the Recycle Bin; copies outside it are not touched. ",
+                L"A group with every copy under the folder keeps its shortest path.");
+        }
+        if (removeDuplicates) printRemovalSample(store, filter, groups);
+        if (!getUserConfirmation(removeDuplicates ? L"Remove them? (y/N): " : L"Keep them all? (y/N): ", false))
+        {
+            std::wcout << L"Nothing changed." << std::endl;
+            return;
+        }
+
+        for (size_t rank = store.nextMatch(0, filter); rank < store.groupCount(); rank = store.nextMatch(rank + 1, filter))
+        {
+            bool loaded = !removeDuplicates || withGroup(store, rank, [&](const auto& group)
+            {
+                std::vector<bool> removable = removableUnder(entriesOf(group), filter.pathPrefix);
+                remover.removeKeepingBest(group, removable.empty() ? nullptr : &removable);
+            });
+            if (!loaded)
+            {
+                printUnicodeMulti(true, L"Group #", std::to_wstring(rank + 1), L" is damaged in the results file, skipped.");
+                continue;
+            }
+            store.markHandled(rank);
+        }
+    }
+
+    void openGroup(ResultStore& store, size_t rank, DuplicateRemover& remover)
+    {
+        bool opened = withGroup(store, rank, [&](const auto& group)
+        {
+            std::wcout << std::endl;
+            remover.reviewGroup(group, rank + 1);
+        });
+        if (!opened)
+        {
+            printUnicodeMulti(true, L"Group #", std::to_wstring(rank + 1), L" is damaged in the results file.");
+            return;
+        }
+        store.markHandled(rank);
+    }
+
+    void runSession(ResultStore& store, DuplicateRemover& remover)
+    {
+        const size_t groupCount = store.groupCount();
+        std::wcout << L"\n=== REVIEW DUPLICATE GROUPS ===" << std::endl;
+        std::wcout << groupCount << L" groups with " << sizeText(store.totalWasted()) << L" reclaimable, largest first." << std::endl;
+        std::wcout << L"Files are moved to the Recycle Bin, and files changed since they were hashed are left alone." << std::endl;
+        printCommands();
+
+        ResultFilter filter;
+        size_t pageStart = 0;
+        while (std::wcin)
+        {
+            // Groups handled since the page was shown drop off it
+            pageStart = store.nextMatch(pageStart, filter);
+
+            std::vector<size_t> page;
+            for (size_t rank = pageStart; rank < groupCount && page.size() < REVIEW_PAGE_SIZE; rank = store.nextMatch(rank + 1, filter))
+            {
+                page.push_back(rank);
+            }
+
+            if (page.empty())
+            {
+                bool earlierGroups = store.previousMatch(pageStart, filter) < groupCount;
+                std::wcout << (earlierGroups ? L"\nNo more groups after this page (p goes back)" : L"\nNo groups left to review") << describeFilter(filter) << L"." << std::endl;
+            }
+            else
+            {
+                printPage(store, page, filter);
+            }
+
+            std::wstring input = getUserInput(L"\nCommand (h for help): ");
+            size_t space = input.find(L' ');
+            std::wstring command = input.substr(0, space);
+            std::wstring argument = space == std::wstring::npos ? L"" : input.substr(input.find_first_not_of(L' ', space));
+
+            if (command == L"q")
+            {
+                break;
+            }
+            else if (command == L"h")
+            {
+                printCommands();
+            }
+            else if (command == L"n")
+            {
+                size_t next = page.empty() ? groupCount : store.nextMatch(page.back() + 1, filter);
+                if (next < groupCount) pageStart = next;
+                else std::wcout << L"This is the last page." << std::endl;
+            }
+            else if (command == L"p")
+            {
+                for (size_t i = 0; i < REVIEW_PAGE_SIZE; ++i)
+                {
+                    size_t previous = store.previousMatch(pageStart, filter);
+                    if (previous >= groupCount) break;
+                    pageStart = previous;
+                }
+            }
+            else if (command == L"f")
+            {
+                filter.pathPrefix = argument;
+                pageStart = 0;
+            }
+            else if (command == L"min" || command == L"max")
+            {
+                uint64_t size = 0;
+                if (!argument.empty() && !parseRate(argument, size))
+                {
+                    printUnicodeMulti(true, L"Not a size: ", argument);
+                    continue;
+                }
+                if (command == L"min") filter.minSize = size;
+                else filter.maxSize = argument.empty() ? UINT64_MAX : size;
+                pageStart = 0;
+            }
+            else if ((command == L"remove" || command == L"keep") && argument == L"all")
+            {
+                applyToMatches(store, filter, remover, command == L"remove");
+            }
+            else if (!command.empty() && command.find_first_not_of(L"0123456789") == std::wstring::npos)
+            {
+                size_t number = 0;
+                try
+                {
+                    number = static_cast<size_t>(std::stoull(command));
+                }
+                catch (const std::exception&)
+                {
+                }
+
+                if (number >= 1 && number <= groupCount) openGroup(store, number - 1, remover);
+                else std::wcout << L"There is no group #" << command << L"." << std::endl;
+            }
+            else if (!command.empty())
+            {
+                printUnicodeMulti(true, L"Unknown command: ", input);
+            }
+        }
+    }
+}
+
+bool removeResultsAutomatically(const std::filesystem::path& resultsPath, DuplicateRemover& remover)
+{
+    ResultStore store;
+    if (!store.open(resultsPath)) return false;
+
+    const size_t groupCount = store.groupCount();
+    if (groupCount == 0)
+    {
+        std::wcout << L"No files to delete." << std::endl;
+        return true;
+    }
+
+    std::wcout << L"\n=== AUTOMATIC DUPLICATE REMOVAL ===" << std::endl;
+
+    DuplicateGroup group;
+    const size_t previewCount = std::min<size_t>(groupCount, REVIEW_PAGE_SIZE);
+    for (size_t rank = 0; rank < previewCount; ++rank)
+    {
+        if (!store.load(rank, group)) continue;
+
+        fs::path keep = selectBestFileToKeep(group.files);
+        printUnicodeMulti(true, L"\nGroup #", std::to_wstring(rank + 1), L" (", sizeText(group.fileSize), L" each)");
+        printUnicodeMulti(true, L"  KEEP: ", keep.wstring());
+        for (const auto& file : group.files)
+        {
+            if (file != keep) printUnicodeMulti(true, L"  DELETE: ", file.wstring());
+        }
+    }
+
+    uint64_t filesToDelete = 0;
+    for (size_t rank = 0; rank < groupCount; ++rank)
+    {
+        filesToDelete += store.info(rank).count - 1;
+    }
+    if (groupCount > previewCount)
+    {
+        std::wcout << L"\n... and " << (groupCount - previewCount) << L" smaller groups." << std::endl;
+    }
+    std::wcout << L"\nIn all " << groupCount << L" groups, " << filesToDelete << L" files or folders (" << sizeText(store.totalWasted())
+        << L") will be moved to the Recycle Bin." << std::endl;
+
+    if (!getUserConfirmation(L"Are you sure you want to continue? (y/N): ", false))
+    {
+        std::wcout << L"Automatic removal cancelled. The groups are still there for \"DupeFind review\"." << std::endl;
+        return true;
+    }
+
+    for (size_t rank = 0; rank < groupCount; ++rank)
+    {
+        if (!withGroup(store, rank, [&](const auto& group) { remover.removeKeepingBest(group); }))
+        {
+            printUnicodeMulti(true, L"Group #", std::to_wstring(rank + 1), L" is damaged in the results file, skipped.");
+            continue;
+        }
+        store.markHandled(rank);
+    }
+    return true;
+}
+
+bool reviewResults(const std::filesystem::path& resultsPath, DuplicateRemover& remover)
+{
+    ResultStore store;
+    if (!store.open(resultsPath)) return false;
+
+    if (store.groupCount() == 0)
+    {
+        std::wcout << L"No duplicate groups to review." << std::endl;
+        return true;
+    }
+
+    runSession(store, remover);
+    return true;
+}
+
+int runReviewCommand(const ProgramOptions& options)
+{
+    if (options.command.size() > 2)
+    {
+        printUnicode(L"review takes at most one results file.", true);
+        return 1;
+    }
+
+    std::filesystem::path resultsPath = options.command.size() == 2 ? std::filesystem::path(options.command[1]) : std::filesystem::path(DEFAULT_RESULTS_FILE);
+
+    // Checked up front, so a missing file does not start an empty removal log
+    {
+        ResultStore store;
+        if (!store.open(resultsPath)) return 1;
+        printUnicodeMulti(true, L"Results saved ", formatSnapshotTime(store.createdTime()), L"; groups already handled are left out.");
+    }
+
+    DuplicateRemover remover(RemovalMode::Review);
+    bool reviewed = reviewResults(resultsPath, remover);
+    remover.finish();
+    return reviewed ? 0 : 1;
+}
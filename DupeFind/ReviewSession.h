@@ -0,0 +1,24 @@
+#pragma once
+
+#include "Options.h"
+#include "DuplicateManager.h"
+
+#include <filesystem>
+
+// Where review mode keeps the duplicate groups, and where "DupeFind review" looks for them by default
+const wchar_t* const DEFAULT_RESULTS_FILE = L"dupefind_results.dfr";
+
+// Groups listed at a time
+const size_t REVIEW_PAGE_SIZE = 20;
+
+// Pages through the stored groups, largest reclaimable space first. Only the page on screen is read from the file,
+// whatever the number of groups. Files are removed through remover, which checks and logs them as usual.
+// False if the results could not be opened.
+bool reviewResults(const std::filesystem::path& resultsPath, DuplicateRemover& remover);
+
+// Automatic removal: previews what would be kept and removed in the largest groups, with the totals for all of
+// them, and once confirmed keeps the shortest path in every group. False if the results could not be opened.
+bool removeResultsAutomatically(const std::filesystem::path& resultsPath, DuplicateRemover& remover);
+
+// Runs "DupeFind review [<file>]", going on with the groups an earlier run left, and returns the process exit code
+int runReviewCommand(const ProgramOptions& options);
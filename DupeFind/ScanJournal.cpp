@@ -0,0 +1,345 @@
+#include "ScanJournal.h"
+#include "Utilities.h"
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <cstring>
+#include <algorithm>
+
+#define WIN32_LEAN_AND_MEAN
+#include <Windows.h>
+
+namespace
+{
+    const char JOURNAL_MAGIC[4] = { 'D', 'F', 'J', '4' }; // 2: directory entries carry their size, 3: digests are binary, 4: and write times
+    const char RECORD_DIRECTORY = 'D';
+    const char RECORD_HASH = 'H';
+
+    const size_t FLUSH_THRESHOLD = 1024 * 1024;  // write out once 1 MB of records is buffered
+    const uint64_t CHECKPOINT_INTERVAL_MS = 5000; // and at least every 5 seconds
+
+    void putU8(std::string& out, uint8_t value) { out.push_back(static_cast<char>(value)); }
+
+    void putU32(std::string& out, uint32_t value)
+    {
+        out.append(reinterpret_cast<const char*>(&value), sizeof(value));
+    }
+
+    void putU64(std::string& out, uint64_t value)
+    {
+        out.append(reinterpret_cast<const char*>(&value), sizeof(value));
+    }
+
+    void putString(std::string& out, const std::string& value)
+    {
+        putU32(out, static_cast<uint32_t>(value.size()));
+        out.append(value);
+    }
+
+    // Bounds-checked reader over the replayed journal; any read past the end marks the record as torn
+    struct RecordReader
+    {
+        const std::vector<char>& data;
+        size_t offset;
+        bool ok = true;
+
+        bool take(void* target, size_t count)
+        {
+            if (!ok || data.size() - offset < count)
+            {
+                ok = false;
+                return false;
+            }
+            std::memcpy(target, data.data() + offset, count);
+            offset += count;
+            return true;
+        }
+
+        uint8_t u8() { uint8_t v = 0; take(&v, sizeof(v)); return v; }
+        uint32_t u32() { uint32_t v = 0; take(&v, sizeof(v)); return v; }
+        uint64_t u64() { uint64_t v = 0; take(&v, sizeof(v)); return v; }
+
+        // Views into the journal buffer; only valid while it lives
+        std::string_view str()
+        {
+            uint32_t length = u32();
+            if (!ok || data.size() - offset < length)
+            {
+                ok = false;
+                return {};
+            }
+            std::string_view value(data.data() + offset, length);
+            offset += length;
+            return value;
+        }
+    };
+
+    std::vector<char> readWholeFile(const fs::path& filePath)
+    {
+        std::vector<char> data;
+
+        HANDLE hFile = CreateFileW(filePath.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+        if (hFile == INVALID_HANDLE_VALUE) return data;
+
+        LARGE_INTEGER fileSize;
+        if (GetFileSizeEx(hFile, &fileSize) && fileSize.QuadPart > 0)
+        {
+            data.resize(static_cast<size_t>(fileSize.QuadPart));
+            size_t total = 0;
+            DWORD bytesRead = 0;
+            while (total < data.size() && ReadFile(hFile, data.data() + total, static_cast<DWORD>(std::min<size_t>(data.size() - total, 1 << 20)), &bytesRead, nullptr) && bytesRead > 0)
+            {
+                total += bytesRead;
+            }
+            data.resize(total);
+        }
+
+        CloseHandle(hFile);
+        return data;
+    }
+}
+
+ScanJournal::ScanJournal(const fs::path& journalPath, MessageHandler onMessage)
+    : journalPath(journalPath), onMessage(std::move(onMessage))
+{
+}
+
+ScanJournal::~ScanJournal()
+{
+    checkpoint();
+    if (fileHandle) CloseHandle(fileHandle);
+}
+
+bool ScanJournal::load(const fs::path& basePath)
+{
+    directories.clear();
+    hashes.clear();
+    validLength = 0;
+
+    std::vector<char> data = readWholeFile(journalPath);
+    if (data.size() < sizeof(JOURNAL_MAGIC) || std::memcmp(data.data(), JOURNAL_MAGIC, sizeof(JOURNAL_MAGIC)) != 0)
+    {
+        return false;
+    }
+
+    RecordReader reader{ data, sizeof(JOURNAL_MAGIC) };
+    std::wstring journalBase = utf8ToWstring(reader.str());
+    if (!reader.ok || journalBase != basePath.wstring())
+    {
+        return false;
+    }
+    validLength = reader.offset;
+
+    // Replay until the end or the first torn record (a crash in the middle of a write)
+    while (reader.offset < data.size())
+    {
+        char type = static_cast<char>(reader.u8());
+
+        if (type == RECORD_DIRECTORY)
+        {
+            std::wstring directory = utf8ToWstring(reader.str());
+            uint32_t count = reader.u32();
+
+            std::vector<JournalEntry> entries;
+            for (uint32_t i = 0; i < count && reader.ok; ++i)
+            {
+                JournalEntry entry;
+                entry.isDirectory = reader.u8() != 0;
+                entry.size = reader.u64();
+                entry.writeTime = static_cast<int64_t>(reader.u64());
+                entry.name = utf8ToWstring(reader.str());
+                entries.push_back(std::move(entry));
+            }
+
+            if (!reader.ok) break;
+            directories[directory] = std::move(entries);
+        }
+        else if (type == RECORD_HASH)
+        {
+            std::wstring file = utf8ToWstring(reader.str());
+            HashRecord record;
+            record.fileSize = reader.u64();
+            record.writeTime = static_cast<int64_t>(reader.u64());
+            reader.take(record.digest.data(), record.digest.size());
+
+            if (!reader.ok) break;
+            hashes[file] = std::move(record);
+        }
+        else
+        {
+            break;
+        }
+
+        validLength = reader.offset;
+    }
+
+    return true;
+}
+
+bool ScanJournal::open(const fs::path& basePath, bool keepExisting)
+{
+    if (validLength == 0) keepExisting = false; // nothing was replayed, so there is nothing to keep
+
+    if (!keepExisting)
+    {
+        directories.clear();
+        hashes.clear();
+        validLength = 0;
+    }
+
+    fileHandle = CreateFileW(
+        journalPath.c_str(),
+        GENERIC_WRITE,
+        FILE_SHARE_READ,
+        nullptr,
+        keepExisting ? OPEN_ALWAYS : CREATE_ALWAYS,
+        FILE_ATTRIBUTE_NORMAL,
+        nullptr);
+
+    if (fileHandle == INVALID_HANDLE_VALUE)
+    {
+        fileHandle = nullptr;
+        printMessage(&onMessage, L"Warning: Could not open checkpoint journal: ", journalPath.wstring(), L" (progress will not be saved)");
+        return false;
+    }
+    writable = true;
+
+    if (keepExisting)
+    {
+        // Drop a torn trailing record so new records follow the last complete one
+        LARGE_INTEGER position;
+        position.QuadPart = static_cast<LONGLONG>(validLength);
+        SetFilePointerEx(fileHandle, position, nullptr, FILE_BEGIN);
+        SetEndOfFile(fileHandle);
+    }
+    else
+    {
+        std::string header(JOURNAL_MAGIC, sizeof(JOURNAL_MAGIC));
+        putString(header, wstringToUtf8(basePath.native()));
+        appendRecord(header);
+        checkpoint();
+    }
+
+    lastCheckpointTick = GetTickCount64();
+    return true;
+}
+
+const std::vector<JournalEntry>* ScanJournal::findDirectory(const fs::path& directory) const
+{
+    if (directories.empty()) return nullptr; // not resuming
+    auto it = directories.find(directory.wstring());
+    return it != directories.end() ? &it->second : nullptr;
+}
+
+void ScanJournal::recordDirectory(const fs::path& directory, const std::vector<JournalEntry>& entries)
+{
+    std::string record;
+    putU8(record, RECORD_DIRECTORY);
+    putString(record, wstringToUtf8(directory.native()));
+    putU32(record, static_cast<uint32_t>(entries.size()));
+    for (const auto& entry : entries)
+    {
+        putU8(record, entry.isDirectory ? 1 : 0);
+        putU64(record, entry.size);
+        putU64(record, static_cast<uint64_t>(entry.writeTime));
+        putString(record, wstringToUtf8(entry.name));
+    }
+
+    appendRecord(record);
+}
+
+bool ScanJournal::findHash(const fs::path& file, uintmax_t fileSize, int64_t writeTime, Sha256Digest& digest) const
+{
+    if (hashes.empty()) return false; // not resuming
+    auto it = hashes.find(file.wstring());
+    if (it == hashes.end()) return false;
+
+    // A digest is only reused if the file looks unchanged since it was recorded
+    if (it->second.fileSize != fileSize || it->second.writeTime != writeTime) return false;
+
+    digest = it->second.digest;
+    return true;
+}
+
+void ScanJournal::recordHash(const fs::path& file, uintmax_t fileSize, int64_t writeTime, const Sha256Digest& digest)
+{
+    std::string record;
+    putU8(record, RECORD_HASH);
+    putString(record, wstringToUtf8(file.native()));
+    putU64(record, fileSize);
+    putU64(record, static_cast<uint64_t>(writeTime));
+    record.append(reinterpret_cast<const char*>(digest.data()), digest.size());
+
+    appendRecord(record);
+}
+
+void ScanJournal::appendRecord(const std::string& record)
+{
+    {
+        std::lock_guard<std::mutex> lock(recordMutex);
+        if (!writable) return;
+
+        pendingRecords += record;
+        if (!checkpointDue()) return;
+    }
+
+    // Written and flushed without recordMutex, so hashing threads keep recording while the disk catches up
+    writePending(false);
+}
+
+bool ScanJournal::checkpointDue() const
+{
+    return pendingRecords.size() >= FLUSH_THRESHOLD || GetTickCount64() - lastCheckpointTick >= CHECKPOINT_INTERVAL_MS;
+}
+
+void ScanJournal::checkpoint()
+{
+    writePending(true);
+}
+
+void ScanJournal::writePending(bool force)
+{
+    std::lock_guard<std::mutex> writeLock(writeMutex);
+
+    std::string records;
+    {
+        std::lock_guard<std::mutex> lock(recordMutex);
+        // Another thread may have written them out while this one waited
+        if (!writable || pendingRecords.empty() || (!force && !checkpointDue())) return;
+
+        records.swap(pendingRecords);
+        lastCheckpointTick = GetTickCount64();
+    }
+
+    DWORD written = 0;
+    if (!WriteFile(fileHandle, records.data(), static_cast<DWORD>(records.size()), &written, nullptr) || written != records.size())
+    {
+        printMessage(&onMessage, L"Warning: Could not write checkpoint journal, progress will not be saved.");
+        CloseHandle(fileHandle);
+        fileHandle = nullptr;
+
+        std::lock_guard<std::mutex> lock(recordMutex);
+        writable = false;
+        pendingRecords.clear();
+        return;
+    }
+
+    FlushFileBuffers(fileHandle);
+}
+
+void ScanJournal::discard()
+{
+    std::lock_guard<std::mutex> writeLock(writeMutex);
+    std::lock_guard<std::mutex> lock(recordMutex);
+    writable = false;
+    pendingRecords.clear();
+    if (fileHandle)
+    {
+        CloseHandle(fileHandle);
+        fileHandle = nullptr;
+    }
+
+    std::error_code ec;
+    fs::remove(journalPath, ec);
+}
@@ -0,0 +1,85 @@
+﻿#pragma once
+
+#include <filesystem>
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <mutex>
+#include <cstdint>
+
+#include "HashCalculator.h"
+
+namespace fs = std::filesystem;
+
+struct JournalEntry
+{
+    std::wstring name;
+    bool isDirectory = false;
+    uint64_t size = 0; // files only, as listed
+    int64_t writeTime = 0;
+};
+
+// Append-only checkpoint file for long scans. The scan stage records each directory once its
+// listing is complete, the hash stage records every digest it computes. Records are buffered
+// and written out periodically, so an interrupted run loses at most the last few seconds of work.
+// Lookups and records may come from several hashing threads at once. Lookups only answer from a replayed
+// journal, which is never changed afterwards; a fresh run only appends.
+class ScanJournal
+{
+public:
+    // Warnings go to onMessage, or the console without one
+    explicit ScanJournal(const fs::path& journalPath, MessageHandler onMessage = {});
+    ~ScanJournal();
+
+    ScanJournal(const ScanJournal&) = delete;
+    ScanJournal& operator=(const ScanJournal&) = delete;
+
+    // Replays an existing journal. Returns true if one exists and was written for basePath.
+    bool load(const fs::path& basePath);
+
+    // Opens the journal for appending. Keeps replayed records if keepExisting is set, otherwise starts a new journal.
+    bool open(const fs::path& basePath, bool keepExisting);
+
+    const std::vector<JournalEntry>* findDirectory(const fs::path& directory) const;
+    void recordDirectory(const fs::path& directory, const std::vector<JournalEntry>& entries);
+
+    bool findHash(const fs::path& file, uintmax_t fileSize, int64_t writeTime, Sha256Digest& digest) const;
+    void recordHash(const fs::path& file, uintmax_t fileSize, int64_t writeTime, const Sha256Digest& digest);
+
+    size_t completedDirectoryCount() const { return directories.size(); }
+    size_t knownHashCount() const { return hashes.size(); }
+
+    // Writes buffered records to disk and forces them out of the OS cache.
+    void checkpoint();
+
+    // Closes and deletes the journal file, used once a run has finished.
+    void discard();
+
+private:
+    struct HashRecord
+    {
+        uintmax_t fileSize = 0;
+        int64_t writeTime = 0;
+        Sha256Digest digest{};
+    };
+
+    void appendRecord(const std::string& record);
+    bool checkpointDue() const;
+    void writePending(bool force);
+
+    // recordMutex guards the buffer and is never held while writing; writeMutex keeps the writes of the buffers
+    // taken from it in order. Taken in that order: writeMutex first.
+    std::mutex recordMutex;
+    std::mutex writeMutex;
+
+    fs::path journalPath;
+    MessageHandler onMessage;
+    void* fileHandle = nullptr; // under writeMutex
+    bool writable = false;      // under recordMutex
+    std::string pendingRecords;
+    uint64_t lastCheckpointTick = 0;
+    uint64_t validLength = 0;
+
+    std::unordered_map<std::wstring, std::vector<JournalEntry>> directories;
+    std::unordered_map<std::wstring, HashRecord> hashes;
+};
@@ -0,0 +1,336 @@
+#include "ScanSnapshot.h"
+#include "DigestIndex.h"
+#include "Utilities.h"
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <map>
+#include <chrono>
+#include <cstring>
+#include <algorithm>
+
+#define WIN32_LEAN_AND_MEAN
+#include <Windows.h>
+
+namespace
+{
+    const char SNAPSHOT_MAGIC[4] = { 'D', 'F', 'S', '1' };
+    const uint32_t SNAPSHOT_VERSION = 1;
+
+    const uint32_t RECORD_DIRECTORY = 1;
+    const uint32_t RECORD_HAS_DIGEST = 2;
+    const uint32_t RECORD_COMPLETE = 4;   // a folder listed with nothing left out; older snapshots never set it
+
+    struct SnapshotHeader
+    {
+        char magic[4];
+        uint32_t version;
+        uint64_t entryCount;
+        uint64_t stringBytes;     // padded to a multiple of 8
+        uint64_t rootOffset;      // into the string table
+        uint32_t rootLength;
+        uint32_t reserved;
+        int64_t createdTime;
+        uint64_t digestCount;
+    };
+
+    // Followed by the digest, which is only meaningful with RECORD_HAS_DIGEST
+    struct SnapshotRecord
+    {
+        uint64_t size;
+        int64_t writeTime;
+        uint64_t nameOffset; // into the string table
+        uint32_t nameLength;
+        uint32_t parent;
+        uint32_t depth;
+        uint32_t flags;
+        unsigned char digest[32];
+    };
+
+    const SnapshotRecord* recordAt(const unsigned char* view, uint64_t index)
+    {
+        return reinterpret_cast<const SnapshotRecord*>(view + sizeof(SnapshotHeader)) + index;
+    }
+
+    bool writeAll(HANDLE hFile, const void* data, uint64_t length)
+    {
+        const char* bytes = static_cast<const char*>(data);
+        while (length > 0)
+        {
+            DWORD chunk = static_cast<DWORD>(std::min<uint64_t>(length, 1u << 30));
+            DWORD written = 0;
+            if (!WriteFile(hFile, bytes, chunk, &written, nullptr) || written != chunk) return false;
+            bytes += chunk;
+            length -= chunk;
+        }
+        return true;
+    }
+}
+
+static_assert(sizeof(SnapshotHeader) == 56, "snapshot header layout changed");
+static_assert(sizeof(SnapshotRecord) == 72, "snapshot record layout changed");
+
+ScanSnapshot::~ScanSnapshot()
+{
+    close();
+}
+
+bool ScanSnapshot::open(const fs::path& snapshotPath)
+{
+    close();
+
+    HANDLE hFile = CreateFileW(snapshotPath.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_DELETE, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if (hFile == INVALID_HANDLE_VALUE)
+    {
+        printMessage(&onMessage, L"Error: Could not open the snapshot ", snapshotPath.wstring());
+        return false;
+    }
+
+    LARGE_INTEGER fileSize;
+    HANDLE hMapping = nullptr;
+    const unsigned char* mapped = nullptr;
+    if (GetFileSizeEx(hFile, &fileSize) && fileSize.QuadPart >= static_cast<LONGLONG>(sizeof(SnapshotHeader)))
+    {
+        hMapping = CreateFileMappingW(hFile, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        mapped = hMapping ? static_cast<const unsigned char*>(MapViewOfFile(hMapping, FILE_MAP_READ, 0, 0, 0)) : nullptr;
+    }
+
+    fileHandle = hFile;
+    mappingHandle = hMapping;
+    view = mapped;
+    viewSize = mapped ? static_cast<uint64_t>(fileSize.QuadPart) : 0;
+
+    SnapshotHeader header = {};
+    bool valid = view != nullptr;
+    if (valid)
+    {
+        std::memcpy(&header, view, sizeof(header));
+        valid = std::memcmp(header.magic, SNAPSHOT_MAGIC, sizeof(SNAPSHOT_MAGIC)) == 0
+            && header.version == SNAPSHOT_VERSION
+            && header.entryCount <= (viewSize - sizeof(header)) / sizeof(SnapshotRecord)
+            && header.stringBytes % sizeof(uint64_t) == 0
+            && sizeof(header) + header.entryCount * sizeof(SnapshotRecord) + header.stringBytes == viewSize
+            && header.rootOffset + header.rootLength <= header.stringBytes;
+    }
+
+    if (!valid)
+    {
+        printMessage(&onMessage, L"Error: ", snapshotPath.wstring(), L" is not a valid scan snapshot.");
+        close();
+        return false;
+    }
+    return true;
+}
+
+void ScanSnapshot::close()
+{
+    if (view) UnmapViewOfFile(view);
+    if (mappingHandle) CloseHandle(mappingHandle);
+    if (fileHandle) CloseHandle(fileHandle);
+
+    view = nullptr;
+    mappingHandle = nullptr;
+    fileHandle = nullptr;
+    viewSize = 0;
+}
+
+std::string_view ScanSnapshot::stringAt(uint64_t offset, uint32_t length) const
+{
+    uint64_t tableStart = sizeof(SnapshotHeader) + entryCount() * sizeof(SnapshotRecord);
+    if (offset > viewSize - tableStart || length > viewSize - tableStart - offset) return {};
+    return std::string_view(reinterpret_cast<const char*>(view + tableStart + offset), length);
+}
+
+fs::path ScanSnapshot::root() const
+{
+    if (!view) return {};
+
+    SnapshotHeader header;
+    std::memcpy(&header, view, sizeof(header));
+    return fs::path(utf8ToWstring(stringAt(header.rootOffset, header.rootLength)));
+}
+
+int64_t ScanSnapshot::createdTime() const
+{
+    if (!view) return 0;
+
+    SnapshotHeader header;
+    std::memcpy(&header, view, sizeof(header));
+    return header.createdTime;
+}
+
+size_t ScanSnapshot::entryCount() const
+{
+    if (!view) return 0;
+
+    SnapshotHeader header;
+    std::memcpy(&header, view, sizeof(header));
+    return static_cast<size_t>(header.entryCount);
+}
+
+size_t ScanSnapshot::digestCount() const
+{
+    if (!view) return 0;
+
+    SnapshotHeader header;
+    std::memcpy(&header, view, sizeof(header));
+    return static_cast<size_t>(header.digestCount);
+}
+
+bool ScanSnapshot::load(std::vector<fs::path>& paths, std::vector<ScanNode>& nodes, std::vector<std::optional<Sha256Digest>>& digests) const
+{
+    const size_t count = entryCount();
+    const fs::path rootPath = root();
+
+    paths.clear();
+    nodes.clear();
+    digests.clear();
+    paths.reserve(count);
+    nodes.reserve(count);
+    digests.reserve(count);
+
+    for (size_t i = 0; i < count; ++i)
+    {
+        const SnapshotRecord* record = recordAt(view, i);
+
+        // Parents come before their entries in the depth-first order, anything else means the file is damaged
+        if (record->parent != NO_PARENT && record->parent >= i) return false;
+
+        ScanNode node;
+        node.size = record->size;
+        node.writeTime = record->writeTime;
+        node.parent = record->parent;
+        node.depth = record->depth;
+        node.isDirectory = (record->flags & RECORD_DIRECTORY) != 0;
+        node.complete = !node.isDirectory || (record->flags & RECORD_COMPLETE) != 0;
+
+        const fs::path& parentPath = record->parent == NO_PARENT ? rootPath : paths[record->parent];
+        paths.push_back(parentPath / utf8ToWstring(stringAt(record->nameOffset, record->nameLength)));
+        nodes.push_back(node);
+
+        if (record->flags & RECORD_HAS_DIGEST)
+        {
+            Sha256Digest digest;
+            std::memcpy(digest.data(), record->digest, digest.size());
+            digests.push_back(digest);
+        }
+        else
+        {
+            digests.push_back(std::nullopt);
+        }
+    }
+    return true;
+}
+
+bool writeScanSnapshot(const fs::path& snapshotPath, const fs::path& root, const std::vector<fs::path>& paths, const std::vector<ScanNode>& nodes,
+    const std::vector<std::optional<Sha256Digest>>& digests, const MessageHandler* onMessage)
+{
+    const size_t count = std::min<size_t>(paths.size(), nodes.size());
+
+    std::vector<SnapshotRecord> records(count);
+    std::memset(records.data(), 0, records.size() * sizeof(SnapshotRecord));
+    std::string strings;
+    uint64_t digestCount = 0;
+
+    auto addString = [&](const std::string& value)
+    {
+        uint64_t offset = strings.size();
+        strings.append(value);
+        return offset;
+    };
+
+    std::string rootName = wstringToUtf8(root.native());
+    uint64_t rootOffset = addString(rootName);
+
+    for (size_t i = 0; i < count; ++i)
+    {
+        SnapshotRecord& record = records[i];
+        std::string name = wstringToUtf8(paths[i].filename().native());
+
+        record.size = nodes[i].size;
+        record.writeTime = nodes[i].writeTime;
+        record.nameOffset = addString(name);
+        record.nameLength = static_cast<uint32_t>(name.size());
+        record.parent = nodes[i].parent;
+        record.depth = nodes[i].depth;
+        record.flags = nodes[i].isDirectory ? RECORD_DIRECTORY : 0;
+        if (nodes[i].isDirectory && nodes[i].complete) record.flags |= RECORD_COMPLETE;
+
+        if (i < digests.size() && digests[i])
+        {
+            record.flags |= RECORD_HAS_DIGEST;
+            std::memcpy(record.digest, digests[i]->data(), digests[i]->size());
+            ++digestCount;
+        }
+    }
+    strings.resize((strings.size() + sizeof(uint64_t) - 1) / sizeof(uint64_t) * sizeof(uint64_t), '\0');
+
+    SnapshotHeader header = {};
+    std::memcpy(header.magic, SNAPSHOT_MAGIC, sizeof(SNAPSHOT_MAGIC));
+    header.version = SNAPSHOT_VERSION;
+    header.entryCount = count;
+    header.stringBytes = strings.size();
+    header.rootOffset = rootOffset;
+    header.rootLength = static_cast<uint32_t>(rootName.size());
+    header.createdTime = std::chrono::system_clock::now().time_since_epoch().count();
+    header.digestCount = digestCount;
+
+    fs::path tempPath = snapshotPath;
+    tempPath += L".tmp";
+
+    HANDLE hFile = CreateFileW(tempPath.c_str(), GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (hFile == INVALID_HANDLE_VALUE)
+    {
+        printMessage(onMessage, L"Error: Could not create ", tempPath.wstring());
+        return false;
+    }
+
+    bool written = writeAll(hFile, &header, sizeof(header))
+        && writeAll(hFile, records.data(), records.size() * sizeof(SnapshotRecord))
+        && writeAll(hFile, strings.data(), strings.size())
+        && FlushFileBuffers(hFile);
+    CloseHandle(hFile);
+
+    if (!written)
+    {
+        printMessage(onMessage, L"Error: Could not write ", tempPath.wstring());
+        DeleteFileW(tempPath.c_str());
+        return false;
+    }
+
+    if (!MoveFileExW(tempPath.c_str(), snapshotPath.c_str(), MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH))
+    {
+        DWORD error = GetLastError();
+        printMessage(onMessage, L"Error: Could not replace ", snapshotPath.wstring(), L" (Error code: ", std::to_wstring(error), L")");
+        DeleteFileW(tempPath.c_str());
+        return false;
+    }
+    return true;
+}
+
+std::vector<DuplicateGroup> groupByDigest(const std::vector<fs::path>& paths, const std::vector<ScanNode>& nodes,
+    const std::vector<std::optional<Sha256Digest>>& digests)
+{
+    // Sorted by size like the size runs of a hashing pass, so the groups come out in a comparable order
+    std::map<std::pair<uint64_t, Sha256Digest>, DuplicateGroup> bySizeAndDigest;
+    for (size_t i = 0; i < paths.size() && i < nodes.size() && i < digests.size(); ++i)
+    {
+        if (nodes[i].isDirectory || !digests[i]) continue;
+
+        // Only the listed size and write time are known, so removal checks just those
+        DuplicateGroup& group = bySizeAndDigest[{ nodes[i].size, *digests[i] }];
+        group.fileSize = nodes[i].size;
+        group.files.push_back(paths[i]);
+        group.fingerprints.push_back({ nodes[i].size, nodes[i].writeTime });
+    }
+
+    std::vector<DuplicateGroup> groups;
+    for (auto& [key, group] : bySizeAndDigest)
+    {
+        if (group.files.size() < 2) continue;
+        group.hash = key.first == 0 ? "empty_file" : digestToHex(key.second);
+        groups.push_back(std::move(group));
+    }
+    return groups;
+}
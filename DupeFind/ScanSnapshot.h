@@ -0,0 +1,58 @@
+#pragma once
+
+#include "HashCalculator.h"
+#include "FileScanner.h"
+
+#include <filesystem>
+#include <optional>
+#include <string>
+#include <vector>
+#include <cstdint>
+
+namespace fs = std::filesystem;
+
+// A finished scan and its digests, saved so grouping, reporting and removal can run again without rescanning,
+// and so two scans can be compared without touching the filesystem.
+//
+// One file, memory-mapped for reading: a header, one fixed 72-byte record per scanned entry in the scanner's
+// depth-first order, and a table of UTF-8 names. A record holds the entry's parent index, size, write time and
+// digest if it has one, so paths are rebuilt from the names and nothing has to be parsed.
+class ScanSnapshot
+{
+public:
+    // Errors go to onMessage, or the console without one
+    explicit ScanSnapshot(MessageHandler onMessage = {}) : onMessage(std::move(onMessage)) {}
+    ~ScanSnapshot();
+
+    ScanSnapshot(const ScanSnapshot&) = delete;
+    ScanSnapshot& operator=(const ScanSnapshot&) = delete;
+
+    // Fails on a missing, damaged or newer-version file
+    bool open(const fs::path& snapshotPath);
+    void close();
+
+    fs::path root() const;
+    int64_t createdTime() const; // system_clock ticks when the snapshot was written
+    size_t entryCount() const;
+    size_t digestCount() const;  // entries saved with a digest
+
+    // The scan as getAllFilesAndDirectories and streamFilesByHash returned it
+    bool load(std::vector<fs::path>& paths, std::vector<ScanNode>& nodes, std::vector<std::optional<Sha256Digest>>& digests) const;
+
+private:
+    std::string_view stringAt(uint64_t offset, uint32_t length) const;
+
+    MessageHandler onMessage;
+    void* fileHandle = nullptr;
+    void* mappingHandle = nullptr;
+    const unsigned char* view = nullptr;
+    uint64_t viewSize = 0;
+};
+
+// Writes the snapshot to a temporary file next to snapshotPath and swaps it in once complete
+bool writeScanSnapshot(const fs::path& snapshotPath, const fs::path& root, const std::vector<fs::path>& paths, const std::vector<ScanNode>& nodes,
+    const std::vector<std::optional<Sha256Digest>>& digests, const MessageHandler* onMessage = nullptr);
+
+// The duplicate groups a hashing pass would have reported for these digests, by size and then digest
+std::vector<DuplicateGroup> groupByDigest(const std::vector<fs::path>& paths, const std::vector<ScanNode>& nodes,
+    const std::vector<std::optional<Sha256Digest>>& digests);
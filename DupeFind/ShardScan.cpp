@@ -0,0 +1,432 @@
+#include "ShardScan.h"
+#include "FileScanner.h"
+#include "FileFilter.h"
+#include "SortGrouping.h"
+#include "DigestIndex.h"
+#include "ReportGenerator.h"
+#include "Utilities.h"
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <map>
+#include <unordered_map>
+#include <cstring>
+#include <cwctype>
+#include <algorithm>
+
+#define WIN32_LEAN_AND_MEAN
+#include <Windows.h>
+
+namespace
+{
+    const char PARTIAL_MAGIC[4] = { 'D', 'F', 'P', '1' };
+
+    void putU32(std::string& out, uint32_t value) { out.append(reinterpret_cast<const char*>(&value), sizeof(value)); }
+    void putU64(std::string& out, uint64_t value) { out.append(reinterpret_cast<const char*>(&value), sizeof(value)); }
+
+    struct PartialReader
+    {
+        const std::string& data;
+        size_t offset = 0;
+        bool ok = true;
+
+        bool take(void* target, size_t count)
+        {
+            if (!ok || data.size() - offset < count)
+            {
+                ok = false;
+                return false;
+            }
+            std::memcpy(target, data.data() + offset, count);
+            offset += count;
+            return true;
+        }
+
+        uint32_t u32() { uint32_t v = 0; take(&v, sizeof(v)); return v; }
+        uint64_t u64() { uint64_t v = 0; take(&v, sizeof(v)); return v; }
+    };
+
+    // Hashes the selected entries through the I/O scheduler. A head digest that could not be computed clears the
+    // entry's flag in valid; a full digest that could not be computed leaves hasDigest unset.
+    void hashEntries(std::vector<PartialEntry>& entries, const std::vector<size_t>& selected, bool headDigest, const HashOptions& options,
+        std::vector<char>& valid)
+    {
+        std::vector<ReadJob> jobs;
+        jobs.reserve(selected.size());
+        for (size_t index : selected)
+        {
+            jobs.push_back({ entries[index].path, entries[index].size });
+        }
+
+        runScheduledReads(jobs, [&](size_t job) -> uint64_t
+        {
+            PartialEntry& entry = entries[selected[job]];
+            ReadStats stats;
+
+            if (headDigest)
+            {
+                valid[selected[job]] = calculateHeadDigest(jobs[job].path, entry.headDigest, options.readPolicy, &stats);
+            }
+            else
+            {
+                entry.hasDigest = calculateSHA256(jobs[job].path, entry.digest, options.readPolicy, &stats);
+            }
+            return stats.bytesRead;
+        }, options.scheduling);
+    }
+
+    // Runs of valid entries that share (size, head digest) with at least one other entry
+    std::vector<RecordRun> findHeadCollisions(const std::vector<PartialEntry>& entries, const std::vector<char>& valid, std::vector<GroupRecord>& records)
+    {
+        records.clear();
+        for (size_t i = 0; i < entries.size(); ++i)
+        {
+            if (valid[i]) records.push_back({ entries[i].size, entries[i].headDigest, static_cast<uint32_t>(i) });
+        }
+        return findEqualKeyRuns(records);
+    }
+
+    void addFileEntry(const fs::path& path, std::vector<PartialEntry>& entries)
+    {
+        PartialEntry entry;
+        std::error_code ec;
+        entry.size = fs::file_size(path, ec);
+        if (ec || entry.size == 0) return; // directories and empty files
+
+        entry.path = path.wstring();
+        entries.push_back(std::move(entry));
+    }
+
+    std::vector<PartialEntry> scanShard(const std::vector<fs::path>& roots, unsigned shardIndex, unsigned shardCount, const FileFilter& filter)
+    {
+        std::vector<PartialEntry> entries;
+
+        for (const auto& root : roots)
+        {
+            if (shardCount == 1)
+            {
+                for (const auto& path : getAllFilesAndDirectories(root, nullptr, &filter)) addFileEntry(path, entries);
+                continue;
+            }
+
+            // The files directly in a root belong to the root's shard, every subtree below it to the shard of its top directory
+            bool ownsRoot = shardOfDirectory(root, shardCount) == shardIndex;
+            std::error_code ec;
+            for (const auto& child : fs::directory_iterator(root, fs::directory_options::skip_permission_denied, ec))
+            {
+                std::error_code entryError;
+                const std::wstring childPath = child.path().wstring();
+
+                if (child.is_directory(entryError) && !child.is_symlink(entryError))
+                {
+                    if (shardOfDirectory(child.path(), shardCount) != shardIndex || filter.shouldPruneDirectory(childPath)) continue;
+
+                    for (const auto& path : getAllFilesAndDirectories(child.path(), nullptr, &filter)) addFileEntry(path, entries);
+                }
+                else if (ownsRoot && child.is_regular_file(entryError))
+                {
+                    uintmax_t size = child.file_size(entryError);
+                    if (!entryError && !filter.shouldSkipFile(childPath, size)) addFileEntry(child.path(), entries);
+                }
+            }
+
+            if (ec)
+            {
+                printUnicodeMulti(true, L"Error accessing directory: ", root.wstring());
+            }
+        }
+
+        return entries;
+    }
+
+    std::vector<fs::path> canonicalRoots(const std::vector<std::wstring>& arguments)
+    {
+        std::vector<fs::path> roots;
+        for (const auto& argument : arguments)
+        {
+            std::error_code ec;
+            fs::path root = fs::canonical(argument, ec);
+            if (ec || !fs::is_directory(root, ec))
+            {
+                printUnicodeMulti(true, L"Skipping ", argument, L": not a folder");
+                continue;
+            }
+            roots.push_back(root);
+        }
+        return roots;
+    }
+
+    int scanCommand(const ProgramOptions& options)
+    {
+        std::vector<fs::path> roots = canonicalRoots(std::vector<std::wstring>(options.command.begin() + 2, options.command.end()));
+        if (roots.empty())
+        {
+            printUnicode(L"shard scan needs at least one folder.", true);
+            return 1;
+        }
+
+        fs::path outputPath = options.outputPath;
+        if (outputPath.empty())
+        {
+            outputPath = L"shard_" + std::to_wstring(options.shardIndex) + L"_of_" + std::to_wstring(options.shardCount) + L".dfp";
+        }
+
+        FileFilter filter = loadFileFilter(L"dupefind_filters.txt");
+
+        PartialResult result;
+        result.shardIndex = options.shardIndex;
+        result.shardCount = options.shardCount;
+        result.entries = scanShard(roots, options.shardIndex, options.shardCount, filter);
+
+        printUnicodeMulti(true, L"Shard ", std::to_wstring(options.shardIndex), L"/", std::to_wstring(options.shardCount), L": ",
+            std::to_wstring(result.entries.size()), L" files, reading their heads...");
+
+        // Every file gets a head digest, since its duplicate may be in another shard
+        std::vector<size_t> all(result.entries.size());
+        for (size_t i = 0; i < all.size(); ++i) all[i] = i;
+        std::vector<char> valid(result.entries.size(), 0);
+        hashEntries(result.entries, all, true, options.hashOptions, valid);
+
+        // Full digests only where this shard alone already has a collision
+        std::vector<GroupRecord> records;
+        std::vector<size_t> collisions;
+        for (const auto& run : findHeadCollisions(result.entries, valid, records))
+        {
+            for (size_t i = run.begin; i < run.end; ++i) collisions.push_back(records[i].entryIndex);
+        }
+        hashEntries(result.entries, collisions, false, options.hashOptions, valid);
+
+        // Files whose head could not be read are dropped here; they would be unreadable for the merge as well
+        size_t kept = 0;
+        for (size_t i = 0; i < result.entries.size(); ++i)
+        {
+            if (valid[i]) result.entries[kept++] = std::move(result.entries[i]);
+        }
+        result.entries.resize(kept);
+
+        if (!writePartialResult(outputPath, result)) return 1;
+
+        printUnicodeMulti(true, L"Wrote ", std::to_wstring(result.entries.size()), L" entries (", std::to_wstring(collisions.size()),
+            L" fully hashed) to ", outputPath.wstring());
+        return 0;
+    }
+
+    int mergeCommand(const ProgramOptions& options)
+    {
+        std::vector<std::wstring> inputs(options.command.begin() + 2, options.command.end());
+        if (inputs.empty())
+        {
+            printUnicode(L"shard merge needs at least one partial result.", true);
+            return 1;
+        }
+
+        std::vector<PartialEntry> entries;
+        std::unordered_map<std::wstring, size_t> byPath;
+        std::map<uint32_t, std::vector<bool>> shardsSeen;
+
+        for (const auto& input : inputs)
+        {
+            PartialResult result;
+            if (!readPartialResult(input, result))
+            {
+                printUnicodeMulti(true, L"Error: ", input, L" is not a readable partial result.");
+                return 1;
+            }
+
+            auto& seen = shardsSeen[result.shardCount];
+            seen.resize(result.shardCount);
+            seen[result.shardIndex] = true;
+
+            // Overlapping shards list a file twice; keep the entry that already has a full digest
+            for (auto& entry : result.entries)
+            {
+                auto known = byPath.find(entry.path);
+                if (known == byPath.end())
+                {
+                    byPath.emplace(entry.path, entries.size());
+                    entries.push_back(std::move(entry));
+                }
+                else if (!entries[known->second].hasDigest && entry.hasDigest)
+                {
+                    entries[known->second] = std::move(entry);
+                }
+            }
+        }
+
+        for (const auto& [count, seen] : shardsSeen)
+        {
+            for (uint32_t i = 0; i < count; ++i)
+            {
+                if (!seen[i]) printUnicodeMulti(true, L"Warning: shard ", std::to_wstring(i), L"/", std::to_wstring(count), L" is missing from the merge.");
+            }
+        }
+
+        // Candidates are files that share (size, head digest) with a file from any shard
+        std::vector<char> valid(entries.size(), 1);
+        std::vector<GroupRecord> records;
+        std::vector<RecordRun> runs = findHeadCollisions(entries, valid, records);
+
+        std::vector<size_t> missingDigests;
+        for (const auto& run : runs)
+        {
+            for (size_t i = run.begin; i < run.end; ++i)
+            {
+                if (!entries[records[i].entryIndex].hasDigest) missingDigests.push_back(records[i].entryIndex);
+            }
+        }
+
+        printUnicodeMulti(true, L"Merged ", std::to_wstring(entries.size()), L" files from ", std::to_wstring(inputs.size()), L" partial results; ",
+            std::to_wstring(missingDigests.size()), L" cross-shard candidates need a full hash.");
+        hashEntries(entries, missingDigests, false, options.hashOptions, valid);
+
+        // Merge reads the candidates through the paths the shards recorded; any it cannot open stay out of the groups
+        size_t unhashed = 0;
+        for (size_t index : missingDigests)
+        {
+            if (!entries[index].hasDigest) ++unhashed;
+        }
+        if (unhashed > 0)
+        {
+            printUnicodeMulti(true, L"Warning: ", std::to_wstring(unhashed), L" cross-shard candidates could not be hashed from this machine and were left out of the groups.");
+        }
+
+        std::vector<DuplicateGroup> duplicateGroups;
+        for (const auto& run : runs)
+        {
+            std::map<std::string, std::vector<fs::path>> runGroups;
+            for (size_t i = run.begin; i < run.end; ++i)
+            {
+                const PartialEntry& entry = entries[records[i].entryIndex];
+                if (entry.hasDigest) runGroups[digestToHex(entry.digest)].push_back(entry.path);
+            }
+
+            for (auto& [digest, paths] : runGroups)
+            {
+                if (paths.size() > 1) duplicateGroups.push_back({ digest, std::move(paths), entries[records[run.begin].entryIndex].size });
+            }
+        }
+
+        resetLogFiles();
+        processDuplicateGroups(duplicateGroups, options.topGroups);
+        return 0;
+    }
+}
+
+bool writePartialResult(const fs::path& resultPath, const PartialResult& result)
+{
+    std::string data(PARTIAL_MAGIC, sizeof(PARTIAL_MAGIC));
+    putU32(data, result.shardIndex);
+    putU32(data, result.shardCount);
+    putU64(data, result.entries.size());
+
+    for (const auto& entry : result.entries)
+    {
+        std::string path = wstringToUtf8(entry.path);
+
+        putU64(data, entry.size);
+        putU64(data, entry.headDigest);
+        data.push_back(entry.hasDigest ? 1 : 0);
+        if (entry.hasDigest) data.append(reinterpret_cast<const char*>(entry.digest.data()), entry.digest.size());
+        putU32(data, static_cast<uint32_t>(path.size()));
+        data.append(path);
+    }
+
+    HANDLE hFile = CreateFileW(resultPath.c_str(), GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (hFile == INVALID_HANDLE_VALUE)
+    {
+        printUnicodeMulti(true, L"Error: Could not create ", resultPath.wstring());
+        return false;
+    }
+
+    bool written = true;
+    for (size_t offset = 0; written && offset < data.size(); )
+    {
+        DWORD chunk = static_cast<DWORD>(std::min<size_t>(data.size() - offset, 1u << 30));
+        DWORD count = 0;
+        written = WriteFile(hFile, data.data() + offset, chunk, &count, nullptr) && count == chunk;
+        offset += chunk;
+    }
+    CloseHandle(hFile);
+
+    if (!written) printUnicodeMulti(true, L"Error: Could not write ", resultPath.wstring());
+    return written;
+}
+
+bool readPartialResult(const fs::path& resultPath, PartialResult& result)
+{
+    HANDLE hFile = CreateFileW(resultPath.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if (hFile == INVALID_HANDLE_VALUE) return false;
+
+    LARGE_INTEGER fileSize;
+    std::string data;
+    bool ok = GetFileSizeEx(hFile, &fileSize) != FALSE;
+    if (ok)
+    {
+        data.resize(static_cast<size_t>(fileSize.QuadPart));
+        for (size_t offset = 0; ok && offset < data.size(); )
+        {
+            DWORD count = 0;
+            ok = ReadFile(hFile, data.data() + offset, static_cast<DWORD>(std::min<size_t>(data.size() - offset, 1u << 30)), &count, nullptr) && count > 0;
+            offset += count;
+        }
+    }
+    CloseHandle(hFile);
+
+    if (!ok || data.size() < sizeof(PARTIAL_MAGIC) || std::memcmp(data.data(), PARTIAL_MAGIC, sizeof(PARTIAL_MAGIC)) != 0) return false;
+
+    PartialReader reader{ data, sizeof(PARTIAL_MAGIC) };
+    result.shardIndex = reader.u32();
+    result.shardCount = reader.u32();
+    uint64_t count = reader.u64();
+    if (!reader.ok || result.shardCount == 0 || result.shardIndex >= result.shardCount) return false;
+
+    result.entries.clear();
+    for (uint64_t i = 0; i < count && reader.ok; ++i)
+    {
+        PartialEntry entry;
+        entry.size = reader.u64();
+        entry.headDigest = reader.u64();
+
+        char hasDigest = 0;
+        reader.take(&hasDigest, 1);
+        entry.hasDigest = hasDigest != 0;
+        if (entry.hasDigest) reader.take(entry.digest.data(), entry.digest.size());
+
+        uint32_t length = reader.u32();
+        if (!reader.ok || length > data.size() - reader.offset)
+        {
+            reader.ok = false;
+            break;
+        }
+
+        entry.path = utf8ToWstring(std::string_view(data).substr(reader.offset, length));
+        reader.offset += length;
+        result.entries.push_back(std::move(entry));
+    }
+
+    return reader.ok;
+}
+
+unsigned shardOfDirectory(const fs::path& directory, unsigned shardCount)
+{
+    // Case-insensitive like the filesystem, so "D:\Data" and "d:\data" land in the same shard
+    uint64_t hash = 14695981039346656037ull;
+    for (wchar_t c : directory.wstring())
+    {
+        hash ^= static_cast<uint64_t>(std::towlower(c));
+        hash *= 1099511628211ull;
+    }
+    return static_cast<unsigned>(hash % shardCount);
+}
+
+int runShardCommand(const ProgramOptions& options)
+{
+    const std::wstring subcommand = options.command.size() > 1 ? options.command[1] : L"";
+
+    if (subcommand == L"scan") return scanCommand(options);
+    if (subcommand == L"merge") return mergeCommand(options);
+
+    printUnicodeMulti(true, L"Unknown shard command: ", subcommand, L" (expected scan or merge)");
+    return 1;
+}
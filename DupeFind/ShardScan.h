@@ -0,0 +1,39 @@
+#pragma once
+
+#include "Options.h"
+#include "HashCalculator.h"
+
+#include <filesystem>
+#include <string>
+#include <vector>
+#include <cstdint>
+
+namespace fs = std::filesystem;
+
+// One file in a partial result. Every file has a head digest; the full digest is only computed when another
+// file in the same shard shares its size and head digest, the rest is left to the merge.
+struct PartialEntry
+{
+    uint64_t size = 0;
+    uint64_t headDigest = 0;
+    bool hasDigest = false;
+    Sha256Digest digest = {};
+    std::wstring path;
+};
+
+struct PartialResult
+{
+    uint32_t shardIndex = 0;
+    uint32_t shardCount = 1;
+    std::vector<PartialEntry> entries;
+};
+
+bool writePartialResult(const fs::path& resultPath, const PartialResult& result);
+bool readPartialResult(const fs::path& resultPath, PartialResult& result);
+
+// Directories are assigned to shards by a hash of their path, so every worker computes the same split
+// without talking to the others
+unsigned shardOfDirectory(const fs::path& directory, unsigned shardCount);
+
+// Runs "DupeFind shard scan|merge ..." and returns the process exit code
+int runShardCommand(const ProgramOptions& options);
@@ -0,0 +1,220 @@
+#include "SnapshotCommands.h"
+#include "ScanSnapshot.h"
+#include "FileScanner.h"
+#include "FileFilter.h"
+#include "Utilities.h"
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <optional>
+#include <unordered_map>
+#include <unordered_set>
+#include <chrono>
+#include <ctime>
+#include <iomanip>
+#include <sstream>
+
+namespace
+{
+    struct LoadedSnapshot
+    {
+        fs::path root;
+        int64_t createdTime = 0;
+        std::vector<fs::path> paths;
+        std::vector<ScanNode> nodes;
+        std::vector<std::optional<Sha256Digest>> digests;
+    };
+
+    bool loadSnapshot(const fs::path& snapshotPath, LoadedSnapshot& loaded)
+    {
+        ScanSnapshot snapshot;
+        if (!snapshot.open(snapshotPath)) return false;
+
+        loaded.root = snapshot.root();
+        loaded.createdTime = snapshot.createdTime();
+        if (!snapshot.load(loaded.paths, loaded.nodes, loaded.digests))
+        {
+            printUnicodeMulti(true, L"Error: ", snapshotPath.wstring(), L" is damaged.");
+            return false;
+        }
+        return true;
+    }
+
+    // The path below the snapshot's root, so snapshots of a folder that moved still line up
+    std::wstring relativePath(const LoadedSnapshot& snapshot, size_t index)
+    {
+        const std::wstring& path = snapshot.paths[index].native();
+        size_t rootLength = snapshot.root.native().size();
+        if (path.size() > rootLength && (path[rootLength] == L'\\' || path[rootLength] == L'/')) ++rootLength;
+        return path.substr(std::min<size_t>(rootLength, path.size()));
+    }
+
+    int saveCommand(const ProgramOptions& options)
+    {
+        if (options.command.size() != 3)
+        {
+            printUnicode(L"snapshot save needs exactly one folder.", true);
+            return 1;
+        }
+
+        std::error_code ec;
+        fs::path root = fs::canonical(options.command[2], ec);
+        if (ec || !fs::is_directory(root, ec))
+        {
+            printUnicodeMulti(true, L"Error: ", options.command[2], L" is not a folder.");
+            return 1;
+        }
+
+        fs::path outputPath = options.outputPath.empty() ? fs::path(DEFAULT_SNAPSHOT_FILE) : options.outputPath;
+        FileFilter filter = loadFileFilter(L"dupefind_filters.txt");
+
+        std::unique_ptr<IoExecutor> executor;
+        if (options.engine == ExecutionEngine::Coroutines)
+        {
+            executor = std::make_unique<IoExecutor>();
+        }
+
+        std::vector<ScanNode> nodes;
+        std::vector<fs::path> paths = getAllFilesAndDirectories(root, nullptr, &filter, executor.get(), &nodes);
+        printUnicodeMulti(true, L"Scanned ", std::to_wstring(paths.size()), L" files and folders in ", root.wstring());
+
+        // The groups themselves are not needed here, they are formed again from the digests when the snapshot is used
+        HashOptions hashOptions = options.hashOptions;
+        hashOptions.executor = executor.get();
+        std::vector<std::optional<Sha256Digest>> digests;
+        streamFilesByHash(paths, nodes, nullptr, hashOptions, [](DuplicateGroup&&) {}, &digests);
+
+        if (!writeScanSnapshot(outputPath, root, paths, nodes, digests)) return 1;
+
+        printUnicodeMulti(true, L"Saved the scan to ", outputPath.wstring());
+        return 0;
+    }
+
+    int infoCommand(const ProgramOptions& options)
+    {
+        if (options.command.size() != 3)
+        {
+            printUnicode(L"snapshot info needs exactly one snapshot file.", true);
+            return 1;
+        }
+
+        ScanSnapshot snapshot;
+        if (!snapshot.open(options.command[2])) return 1;
+
+        printUnicodeMulti(true, L"Snapshot: ", options.command[2]);
+        printUnicodeMulti(true, L"Folder: ", snapshot.root().wstring());
+        printUnicodeMulti(true, L"Saved: ", formatSnapshotTime(snapshot.createdTime()));
+        printUnicodeMulti(true, L"Entries: ", std::to_wstring(snapshot.entryCount()), L", ", std::to_wstring(snapshot.digestCount()), L" with a digest");
+        return 0;
+    }
+
+    int diffCommand(const ProgramOptions& options)
+    {
+        if (options.command.size() != 4)
+        {
+            printUnicode(L"snapshot diff needs the older and the newer snapshot file.", true);
+            return 1;
+        }
+
+        LoadedSnapshot before;
+        LoadedSnapshot after;
+        if (!loadSnapshot(options.command[2], before) || !loadSnapshot(options.command[3], after)) return 1;
+
+        printUnicodeMulti(true, L"Comparing ", before.root.wstring(), L" (", formatSnapshotTime(before.createdTime), L") with ",
+            after.root.wstring(), L" (", formatSnapshotTime(after.createdTime), L")");
+
+        std::unordered_map<std::wstring, size_t> beforeByPath;
+        beforeByPath.reserve(before.paths.size());
+        for (size_t i = 0; i < before.paths.size(); ++i)
+        {
+            beforeByPath.emplace(relativePath(before, i), i);
+        }
+
+        // A file changed if its size or write time differs, or both scans hashed it and the digests differ
+        size_t added = 0;
+        size_t changed = 0;
+        std::vector<char> matched(before.paths.size(), 0);
+        for (size_t i = 0; i < after.paths.size(); ++i)
+        {
+            auto found = beforeByPath.find(relativePath(after, i));
+            if (found == beforeByPath.end())
+            {
+                printUnicodeMulti(true, L"NEW      ", after.paths[i].wstring());
+                ++added;
+                continue;
+            }
+
+            size_t old = found->second;
+            matched[old] = 1;
+
+            const ScanNode& oldNode = before.nodes[old];
+            const ScanNode& newNode = after.nodes[i];
+            bool differs = oldNode.isDirectory != newNode.isDirectory
+                || (!newNode.isDirectory && (oldNode.size != newNode.size || oldNode.writeTime != newNode.writeTime
+                    || (before.digests[old] && after.digests[i] && *before.digests[old] != *after.digests[i])));
+            if (differs)
+            {
+                printUnicodeMulti(true, L"CHANGED  ", after.paths[i].wstring());
+                ++changed;
+            }
+        }
+
+        size_t removed = 0;
+        for (size_t i = 0; i < before.paths.size(); ++i)
+        {
+            if (matched[i]) continue;
+            printUnicodeMulti(true, L"REMOVED  ", before.paths[i].wstring());
+            ++removed;
+        }
+
+        // A group is new if the older scan did not already have two files with its contents
+        std::unordered_set<std::string> knownGroups;
+        for (const auto& group : groupByDigest(before.paths, before.nodes, before.digests))
+        {
+            knownGroups.insert(group.hash);
+        }
+
+        size_t newGroups = 0;
+        for (const auto& group : groupByDigest(after.paths, after.nodes, after.digests))
+        {
+            if (knownGroups.count(group.hash)) continue;
+
+            printUnicodeMulti(true, L"NEW GROUP ", utf8ToWstring(group.hash), L" (", std::to_wstring(group.files.size()), L" files)");
+            for (const auto& file : group.files)
+            {
+                printUnicodeMulti(true, L"  ", file.wstring());
+            }
+            ++newGroups;
+        }
+
+        printUnicodeMulti(true, L"\n", std::to_wstring(added), L" new, ", std::to_wstring(removed), L" removed, ", std::to_wstring(changed),
+            L" changed, ", std::to_wstring(newGroups), L" new duplicate groups");
+        return 0;
+    }
+}
+
+std::wstring formatSnapshotTime(int64_t createdTime)
+{
+    std::chrono::system_clock::time_point saved{ std::chrono::system_clock::duration(createdTime) };
+    std::time_t savedTime = std::chrono::system_clock::to_time_t(saved);
+
+    struct tm localTime;
+    localtime_s(&localTime, &savedTime);
+
+    std::wstringstream wss;
+    wss << std::put_time(&localTime, L"%Y-%m-%d %H:%M:%S");
+    return wss.str();
+}
+
+int runSnapshotCommand(const ProgramOptions& options)
+{
+    const std::wstring subcommand = options.command.size() > 1 ? options.command[1] : L"";
+
+    if (subcommand == L"save") return saveCommand(options);
+    if (subcommand == L"diff") return diffCommand(options);
+    if (subcommand == L"info") return infoCommand(options);
+
+    printUnicodeMulti(true, L"Unknown snapshot command: ", subcommand, L" (expected save, diff or info)");
+    return 1;
+}
@@ -0,0 +1,12 @@
+#pragma once
+
+#include "Options.h"
+
+// Default file for snapshot save
+const wchar_t* const DEFAULT_SNAPSHOT_FILE = L"dupefind_snapshot.dfs";
+
+// Runs "DupeFind snapshot ..." and returns the process exit code
+int runSnapshotCommand(const ProgramOptions& options);
+
+// The local time a snapshot was written, for messages
+std::wstring formatSnapshotTime(int64_t createdTime);
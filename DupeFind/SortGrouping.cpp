@@ -0,0 +1,139 @@
+#include "SortGrouping.h"
+
+#include <vector>
+#include <array>
+#include <thread>
+#include <algorithm>
+
+namespace
+{
+    const size_t KEY_BYTES = 16;
+    const size_t RADIX = 256;
+    const size_t PARALLEL_THRESHOLD = 1 << 16; // below this the thread start-up costs more than it saves
+
+    using Histogram = std::array<size_t, RADIX>;
+
+    uint8_t keyByte(const GroupRecord& record, size_t pass)
+    {
+        // Least significant byte first: the digest prefix, then the size
+        return pass < 8
+            ? static_cast<uint8_t>(record.digestPrefix >> (8 * pass))
+            : static_cast<uint8_t>(record.size >> (8 * (pass - 8)));
+    }
+
+    template <typename Work>
+    void runOnThreads(unsigned threadCount, Work&& work)
+    {
+        std::vector<std::thread> threads;
+        threads.reserve(threadCount - 1);
+        for (unsigned t = 1; t < threadCount; ++t)
+        {
+            threads.emplace_back(work, t);
+        }
+        work(0);
+        for (auto& thread : threads)
+        {
+            thread.join();
+        }
+    }
+}
+
+void radixSortRecords(std::vector<GroupRecord>& records, unsigned threadCount)
+{
+    const size_t count = records.size();
+    if (count < 2) return;
+
+    if (threadCount == 0) threadCount = std::max<unsigned>(1, std::thread::hardware_concurrency());
+    if (count < PARALLEL_THRESHOLD) threadCount = 1;
+
+    // Each thread owns one contiguous slice; scattering slices in thread order keeps the sort stable
+    const size_t sliceSize = (count + threadCount - 1) / threadCount;
+    auto sliceBegin = [&](unsigned t) { return std::min<size_t>(count, t * sliceSize); };
+    auto sliceEnd = [&](unsigned t) { return std::min<size_t>(count, (t + 1) * sliceSize); };
+
+    std::vector<GroupRecord> scratch(count);
+    GroupRecord* source = records.data();
+    GroupRecord* target = scratch.data();
+    std::vector<Histogram> histograms(threadCount);
+
+    for (size_t pass = 0; pass < KEY_BYTES; ++pass)
+    {
+        runOnThreads(threadCount, [&](unsigned t)
+        {
+            Histogram& histogram = histograms[t];
+            histogram.fill(0);
+            for (size_t i = sliceBegin(t); i < sliceEnd(t); ++i)
+            {
+                ++histogram[keyByte(source[i], pass)];
+            }
+        });
+
+        // Turn the counts into starting offsets: digit-major, thread-minor
+        size_t offset = 0;
+        bool allSameByte = false;
+        for (size_t digit = 0; digit < RADIX; ++digit)
+        {
+            size_t digitTotal = 0;
+            for (unsigned t = 0; t < threadCount; ++t)
+            {
+                size_t digitCount = histograms[t][digit];
+                histograms[t][digit] = offset;
+                offset += digitCount;
+                digitTotal += digitCount;
+            }
+            if (digitTotal == count) allSameByte = true;
+        }
+
+        if (allSameByte) continue; // this byte cannot change the order
+
+        runOnThreads(threadCount, [&](unsigned t)
+        {
+            Histogram& position = histograms[t];
+            for (size_t i = sliceBegin(t); i < sliceEnd(t); ++i)
+            {
+                target[position[keyByte(source[i], pass)]++] = source[i];
+            }
+        });
+
+        std::swap(source, target);
+    }
+
+    if (source != records.data())
+    {
+        records.swap(scratch);
+    }
+}
+
+std::vector<RecordRun> findEqualKeyRuns(std::vector<GroupRecord>& records, size_t minRunLength, unsigned threadCount)
+{
+    radixSortRecords(records, threadCount);
+
+    std::vector<RecordRun> runs;
+    size_t runStart = 0;
+    for (size_t i = 1; i <= records.size(); ++i)
+    {
+        bool runEnds = i == records.size()
+            || records[i].size != records[runStart].size
+            || records[i].digestPrefix != records[runStart].digestPrefix;
+
+        if (!runEnds) continue;
+
+        if (i - runStart >= minRunLength)
+        {
+            runs.push_back({ runStart, i });
+        }
+        runStart = i;
+    }
+
+    return runs;
+}
+
+uint64_t digestPrefixOf(const std::array<unsigned char, 32>& digest)
+{
+    uint64_t prefix = 0;
+    for (size_t i = 0; i < sizeof(prefix); ++i)
+    {
+        prefix = (prefix << 8) | digest[i];
+    }
+    return prefix;
+}
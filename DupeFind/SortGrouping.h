@@ -0,0 +1,34 @@
+﻿#pragma once
+
+#include <vector>
+#include <string>
+#include <array>
+#include <cstdint>
+#include <cstddef>
+
+// Fixed-width grouping record. The key is (size, digest prefix), the payload is the index of the entry it describes.
+// The size stage leaves digestPrefix at 0.
+struct GroupRecord
+{
+    uint64_t size = 0;
+    uint64_t digestPrefix = 0;
+    uint32_t entryIndex = 0;
+};
+
+// Records [begin, end) that share a key after sorting
+struct RecordRun
+{
+    size_t begin = 0;
+    size_t end = 0;
+};
+
+// Stable LSD radix sort over the 16-byte key, one byte per pass. Passes where every record has the same
+// byte are skipped. Large inputs are histogrammed and scattered by several threads.
+void radixSortRecords(std::vector<GroupRecord>& records, unsigned threadCount = 0);
+
+// Sorts the records and returns every run of at least minRunLength records with equal keys,
+// found by one linear scan over adjacent records
+std::vector<RecordRun> findEqualKeyRuns(std::vector<GroupRecord>& records, size_t minRunLength = 2, unsigned threadCount = 0);
+
+// First 8 bytes of a SHA-256 digest as a big-endian number, so digests sort the same way as their hex text
+uint64_t digestPrefixOf(const std::array<unsigned char, 32>& digest);
@@ -0,0 +1,375 @@
+#include "TestCommands.h"
+#include "ArchiveTestVectors.h"
+#include "ArchiveScan.h"
+#include "Inflate.h"
+#include "HashCalculator.h"
+#include "ReadPolicy.h"
+#include "ResultStore.h"
+#include "Utilities.h"
+
+#include <algorithm>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+#define WIN32_LEAN_AND_MEAN
+#include <Windows.h>
+
+namespace fs = std::filesystem;
+
+namespace
+{
+    // Input is handed to the decoder in pieces this small, so bit reads and stored blocks cross piece boundaries
+    const size_t TEST_INPUT_PIECE = 7;
+
+    using Bytes = std::vector<unsigned char>;
+
+    // The contents the vectors hold, built the same way as when they were written
+    const std::string HELLO_TEXT = "Hello, DupeFind!\n";
+
+    std::string abcText()
+    {
+        std::string text;
+        for (int i = 0; i < 20; ++i) text += "abc";
+        return text + "\n";
+    }
+
+    std::string linesText()
+    {
+        std::string text;
+        for (int i = 0; i < 40; ++i) text += "line " + std::to_string(i) + ": the quick brown fox jumps over the lazy dog\n";
+        return text;
+    }
+
+    Bytes bytesOf(const unsigned char* data, size_t length)
+    {
+        return Bytes(data, data + length);
+    }
+
+    template <size_t N>
+    Bytes bytesOf(const unsigned char (&data)[N])
+    {
+        return bytesOf(data, N);
+    }
+
+    InflateResult inflateBytes(const Bytes& input, std::string& output)
+    {
+        size_t position = 0;
+        output.clear();
+        return inflateRaw([&](unsigned char* buffer, size_t capacity)
+        {
+            size_t length = std::min<size_t>({ capacity, TEST_INPUT_PIECE, input.size() - position });
+            std::copy_n(input.begin() + position, length, buffer);
+            position += length;
+            return length;
+        },
+        [&](const unsigned char* data, size_t length)
+        {
+            output.append(reinterpret_cast<const char*>(data), length);
+            return true;
+        });
+    }
+
+    const wchar_t* resultName(InflateResult result)
+    {
+        switch (result)
+        {
+        case InflateResult::Done: return L"done";
+        case InflateResult::Corrupt: return L"corrupt";
+        case InflateResult::Truncated: return L"truncated";
+        case InflateResult::Stopped: return L"stopped";
+        }
+        return L"?";
+    }
+
+    class TestRun
+    {
+    public:
+        void check(bool passed, const std::wstring& name, const std::wstring& detail = L"")
+        {
+            checks++;
+            if (passed) return;
+            failures++;
+            printUnicodeMulti(true, L"  FAILED: ", name, detail.empty() ? L"" : L" (", detail, detail.empty() ? L"" : L")");
+        }
+
+        bool passed() const { return failures == 0; }
+
+        void summary() const
+        {
+            printUnicodeMulti(true, std::to_wstring(checks - failures), L" of ", std::to_wstring(checks), L" checks passed.");
+        }
+
+    private:
+        size_t checks = 0;
+        size_t failures = 0;
+    };
+
+    void checkInflate(TestRun& run, const wchar_t* name, const Bytes& input, InflateResult expected, const std::string& expectedOutput = "")
+    {
+        std::string output;
+        InflateResult result = inflateBytes(input, output);
+        run.check(result == expected, name, std::wstring(L"expected ") + resultName(expected) + L", got " + resultName(result));
+        if (expected == InflateResult::Done) run.check(output == expectedOutput, name, L"wrong output");
+    }
+
+    void testInflate(TestRun& run)
+    {
+        printUnicode(L"Deflate:", true);
+
+        // The check value every CRC-32 implementation gives for "123456789", fed in two pieces
+        const unsigned char digits[] = { '1', '2', '3', '4', '5', '6', '7', '8', '9' };
+        run.check(crc32Update(crc32Update(0, digits, 4), digits + 4, 5) == 0xCBF43926, L"crc32 of 123456789");
+
+        std::string window;
+        for (int i = 0; i < 30; ++i) window += linesText();
+
+        checkInflate(run, L"stored block", bytesOf(DEFLATE_STORED), InflateResult::Done, HELLO_TEXT);
+        checkInflate(run, L"fixed Huffman block", bytesOf(DEFLATE_FIXED), InflateResult::Done, abcText());
+        checkInflate(run, L"dynamic Huffman block", bytesOf(DEFLATE_DYNAMIC), InflateResult::Done, linesText());
+        checkInflate(run, L"output across the window", bytesOf(DEFLATE_WINDOW), InflateResult::Done, window);
+        checkInflate(run, L"truncated stream", bytesOf(DEFLATE_TRUNCATED), InflateResult::Truncated);
+        checkInflate(run, L"empty input", Bytes(), InflateResult::Truncated);
+        checkInflate(run, L"reserved block type", bytesOf(DEFLATE_BAD_BLOCK), InflateResult::Corrupt);
+        checkInflate(run, L"stored length mismatch", bytesOf(DEFLATE_BAD_LENGTH), InflateResult::Corrupt);
+    }
+
+    struct ExpectedMember
+    {
+        std::wstring name;
+        std::string contents;
+        bool readable = true; // false where the test damaged the member
+    };
+
+    struct ArchiveCase
+    {
+        const wchar_t* fileName;
+        Bytes bytes;
+        bool listable = true;
+        std::vector<ExpectedMember> members;
+    };
+
+    bool writeTestFile(const fs::path& filePath, const Bytes& bytes)
+    {
+        HANDLE hFile = CreateFileW(filePath.c_str(), GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+        if (hFile == INVALID_HANDLE_VALUE) return false;
+
+        DWORD written = 0;
+        bool ok = WriteFile(hFile, bytes.data(), static_cast<DWORD>(bytes.size()), &written, nullptr) && written == bytes.size();
+        CloseHandle(hFile);
+        return ok;
+    }
+
+    // The archive is written to folder, listed, and every member hashed and compared with the digest of its contents
+    void checkArchive(TestRun& run, const fs::path& folder, const ArchiveCase& test)
+    {
+        const fs::path archivePath = folder / test.fileName;
+        if (!writeTestFile(archivePath, test.bytes))
+        {
+            run.check(false, test.fileName, L"could not write the test file");
+            return;
+        }
+
+        ArchiveKind kind = archiveKindOf(archivePath);
+        std::vector<ArchiveMember> members;
+        bool listed = listArchiveMembers(archivePath, kind, members);
+        run.check(listed == test.listable, test.fileName, test.listable ? L"not listed" : L"listed although damaged");
+        if (!listed) return;
+
+        run.check(members.size() == test.members.size(), test.fileName,
+            L"expected " + std::to_wstring(test.members.size()) + L" members, got " + std::to_wstring(members.size()));
+        if (members.size() != test.members.size()) return;
+
+        HANDLE hFile = openForRead(archivePath, ReadPolicy::Sequential);
+        if (hFile == INVALID_HANDLE_VALUE)
+        {
+            run.check(false, test.fileName, L"could not open the test file");
+            return;
+        }
+
+        Sha256Hasher hasher;
+        for (size_t i = 0; i < members.size(); ++i)
+        {
+            const ExpectedMember& expected = test.members[i];
+            const std::wstring name = std::wstring(test.fileName) + L"!/" + expected.name;
+            run.check(members[i].name == expected.name, name, L"listed as " + members[i].name);
+            run.check(members[i].size == expected.contents.size(), name, L"size " + std::to_wstring(members[i].size));
+
+            Sha256Digest expectedDigest{};
+            hasher.begin();
+            hasher.update(expected.contents.data(), expected.contents.size());
+            hasher.finish(expectedDigest);
+
+            Sha256Digest digest{};
+            bool hashed = hashArchiveMember(hFile, kind, members[i], digest);
+            if (!expected.readable) run.check(!hashed, name, L"read although damaged");
+            else run.check(hashed && digest == expectedDigest, name, hashed ? L"wrong contents" : L"could not be read");
+        }
+        CloseHandle(hFile);
+    }
+
+    // Cut out a range, or flip bits at an offset, so a damaged case stays next to the vector it comes from
+    Bytes cut(Bytes bytes, size_t from, size_t length)
+    {
+        bytes.erase(bytes.begin() + from, bytes.begin() + std::min<size_t>(from + length, bytes.size()));
+        return bytes;
+    }
+
+    Bytes flip(Bytes bytes, size_t offset)
+    {
+        bytes[offset] ^= 0x55;
+        return bytes;
+    }
+
+    bool inflateTar(TestRun& run, const wchar_t* name, const Bytes& deflated, size_t size, Bytes& tar)
+    {
+        std::string output;
+        bool inflated = inflateBytes(deflated, output) == InflateResult::Done && output.size() == size;
+        run.check(inflated, name, L"the stored vector did not inflate");
+        tar.assign(output.begin(), output.end());
+        return inflated;
+    }
+
+    void testArchives(TestRun& run, const fs::path& folder)
+    {
+        printUnicode(L"Archives:", true);
+
+        const std::string abc = abcText();
+        const std::string lines = linesText();
+        const Bytes basicZip = bytesOf(BASIC_ZIP);
+
+        std::vector<ArchiveCase> cases;
+        cases.push_back({ L"basic.zip", basicZip, true,
+            { { L"hello.txt", HELLO_TEXT }, { L"dir/abc.txt", abc }, { L"lines.txt", lines }, { L"caf\u00E9.txt", abc } } });
+        cases.push_back({ L"damaged.zip", flip(flip(basicZip, BASIC_ZIP_HELLO_CRC), BASIC_ZIP_LINES_DATA), true,
+            { { L"hello.txt", HELLO_TEXT, false }, { L"dir/abc.txt", abc }, { L"lines.txt", lines, false }, { L"caf\u00E9.txt", abc } } });
+        cases.push_back({ L"truncated-end.zip", cut(basicZip, basicZip.size() - 10, 10), false, {} });
+        cases.push_back({ L"truncated-directory.zip", cut(basicZip, BASIC_ZIP_DIRECTORY + 20, 40), false, {} });
+        cases.push_back({ L"zip64.zip", bytesOf(ZIP64_ZIP), true, { { L"big/one.txt", HELLO_TEXT }, { L"two.txt", lines } } });
+
+        Bytes ustar;
+        if (inflateTar(run, L"ustar.tar", bytesOf(USTAR_TAR_DEFLATED), USTAR_TAR_SIZE, ustar))
+        {
+            const std::wstring deepName = L"deep/" + std::wstring(60, L'd') + L"/" + std::wstring(60, L'n') + L".txt";
+            cases.push_back({ L"ustar.tar", ustar, true,
+                { { L"hello.txt", HELLO_TEXT }, { deepName, abc }, { L"lines.txt", lines } } });
+            // Members cut off by the end of the file are left out, the ones before them are still listed
+            cases.push_back({ L"truncated.tar", cut(ustar, USTAR_TAR_LINES_CONTENT + 100, ustar.size()), true,
+                { { L"hello.txt", HELLO_TEXT }, { deepName, abc } } });
+            cases.push_back({ L"bad-checksum.tar", flip(ustar, 0), false, {} });
+        }
+
+        Bytes gnu;
+        if (inflateTar(run, L"gnu.tar", bytesOf(GNU_TAR_DEFLATED), GNU_TAR_SIZE, gnu))
+        {
+            cases.push_back({ L"gnu.tar", gnu, true, { { std::wstring(150, L'g') + L".txt", abc }, { L"hello.txt", HELLO_TEXT } } });
+        }
+
+        Bytes pax;
+        if (inflateTar(run, L"pax.tar", bytesOf(PAX_TAR_DEFLATED), PAX_TAR_SIZE, pax))
+        {
+            cases.push_back({ L"pax.tar", pax, true, { { L"\u00FCnic\u00F6de.txt", abc }, { L"sized.txt", HELLO_TEXT } } });
+        }
+
+        for (const auto& test : cases)
+        {
+            checkArchive(run, folder, test);
+        }
+    }
+
+    int archivesCommand()
+    {
+        const fs::path folder = fs::temp_directory_path() / L"DupeFind-test";
+        std::error_code error;
+        fs::create_directories(folder, error);
+        if (error)
+        {
+            printUnicodeMulti(true, L"Could not create ", folder.wstring());
+            return 1;
+        }
+
+        TestRun run;
+        testInflate(run);
+        testArchives(run, folder);
+
+        fs::remove_all(folder, error);
+        run.summary();
+        return run.passed() ? 0 : 1;
+    }
+
+    void checkUnder(TestRun& run, const std::wstring& path, const std::wstring& prefix, bool expected)
+    {
+        run.check(pathUnderPrefix(path, prefix) == expected, path + L" under " + prefix, expected ? L"not matched" : L"matched");
+    }
+
+    // A folder filter takes in the folder and what is below it, never a sibling whose name starts the same way
+    void testFolderFilter(TestRun& run, const fs::path& folder)
+    {
+        printUnicode(L"Folder filter:", true);
+
+        checkUnder(run, L"C:\\X\\a.txt", L"C:\\X", true);
+        checkUnder(run, L"C:\\X\\sub\\a.txt", L"C:\\X", true);
+        checkUnder(run, L"C:\\X", L"C:\\X", true);
+        checkUnder(run, L"c:/x/a.txt", L"C:\\X\\", true);
+        checkUnder(run, L"C:\\X Old\\a.txt", L"C:\\X", false);
+        checkUnder(run, L"C:\\X Old\\a.txt", L"C:\\X Old", true);
+        checkUnder(run, L"C:\\X2\\a.txt", L"C:\\X", false);
+        checkUnder(run, L"C:\\", L"C:\\X", false);
+
+        // The same through a stored result file, where review and remove all filter
+        const fs::path storePath = folder / L"filter.dfr";
+        ResultStoreWriter writer;
+        bool written = writer.create(storePath);
+        if (written)
+        {
+            writer.addGroup(DuplicateGroup{ "old", { L"C:\\X Old\\b.txt", L"C:\\Y\\b.txt" }, 200 });
+            writer.addGroup(DuplicateGroup{ "new", { L"C:\\X\\a.txt", L"C:\\Y\\a.txt" }, 100 });
+            written = writer.finish();
+        }
+        ResultStore store;
+        if (!written || !store.open(storePath))
+        {
+            run.check(false, L"filter.dfr", L"could not write the result file");
+            return;
+        }
+
+        ResultFilter filter;
+        filter.pathPrefix = L"C:\\X";
+        run.check(store.nextMatch(0, filter) == 1 && store.nextMatch(2, filter) == store.groupCount(), L"stored groups under C:\\X",
+            L"first match " + std::to_wstring(store.nextMatch(0, filter)));
+        filter.pathPrefix = L"C:\\X Old";
+        run.check(store.nextMatch(0, filter) == 0 && store.nextMatch(1, filter) == store.groupCount(), L"stored groups under C:\\X Old",
+            L"first match " + std::to_wstring(store.nextMatch(0, filter)));
+        store.close();
+    }
+
+    int filtersCommand()
+    {
+        const fs::path folder = fs::temp_directory_path() / L"DupeFind-test";
+        std::error_code error;
+        fs::create_directories(folder, error);
+        if (error)
+        {
+            printUnicodeMulti(true, L"Could not create ", folder.wstring());
+            return 1;
+        }
+
+        TestRun run;
+        testFolderFilter(run, folder);
+
+        fs::remove_all(folder, error);
+        run.summary();
+        return run.passed() ? 0 : 1;
+    }
+}
+
+int runTestCommand(const ProgramOptions& options)
+{
+    const std::wstring subcommand = options.command.size() > 1 ? options.command[1] : L"";
+
+    if (subcommand == L"archives") return archivesCommand();
+    if (subcommand == L"filters") return filtersCommand();
+
+    printUnicodeMulti(true, L"Unknown test command: ", subcommand, L" (expected archives or filters)");
+    return 1;
+}
@@ -0,0 +1,6 @@
+#pragma once
+
+#include "Options.h"
+
+// Runs "DupeFind test ..." and returns the process exit code
+int runTestCommand(const ProgramOptions& options);
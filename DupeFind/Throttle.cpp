@@ -0,0 +1,345 @@
+#include "Throttle.h"
+#include "Utilities.h"
+
+#include <algorithm>
+#include <cwctype>
+#include <vector>
+
+#define WIN32_LEAN_AND_MEAN
+#include <Windows.h>
+
+namespace
+{
+    // Load samples in a row, one a second, before the scan pauses or resumes
+    const unsigned LOAD_SAMPLES_TO_SWITCH = 3;
+
+    // The scan resumes once the load is this many points under the pause threshold, so it does not flap around it
+    const unsigned LOAD_RESUME_MARGIN = 10;
+
+    std::wstring_view trim(std::wstring_view text)
+    {
+        size_t start = text.find_first_not_of(L" \t\r\n");
+        if (start == std::wstring_view::npos) return {};
+        size_t end = text.find_last_not_of(L" \t\r\n");
+        return text.substr(start, end - start + 1);
+    }
+
+    std::wstring lowercase(std::wstring_view text)
+    {
+        std::wstring result(text);
+        std::transform(result.begin(), result.end(), result.begin(), [](wchar_t c) { return static_cast<wchar_t>(std::towlower(c)); });
+        return result;
+    }
+
+    uint64_t fileTimeTicks(const FILETIME& time)
+    {
+        return static_cast<uint64_t>(time.dwHighDateTime) << 32 | time.dwLowDateTime;
+    }
+
+    // Same encodings as the filter rules file: UTF-16 from Notepad, or UTF-8 with or without BOM
+    bool readTextFile(const fs::path& filePath, std::wstring& text)
+    {
+        HANDLE hFile = CreateFileW(filePath.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+        if (hFile == INVALID_HANDLE_VALUE) return false;
+
+        std::string bytes;
+        char buffer[4096];
+        DWORD bytesRead = 0;
+        while (ReadFile(hFile, buffer, sizeof(buffer), &bytesRead, NULL) && bytesRead > 0)
+        {
+            bytes.append(buffer, bytesRead);
+        }
+        CloseHandle(hFile);
+
+        if (bytes.size() >= 2 && static_cast<unsigned char>(bytes[0]) == 0xFF && static_cast<unsigned char>(bytes[1]) == 0xFE)
+        {
+            text.assign(reinterpret_cast<const wchar_t*>(bytes.data() + 2), (bytes.size() - 2) / sizeof(wchar_t));
+        }
+        else
+        {
+            if (bytes.size() >= 3 && bytes.compare(0, 3, "\xEF\xBB\xBF") == 0) bytes.erase(0, 3);
+            text = utf8ToWstring(bytes);
+        }
+        return true;
+    }
+
+    std::wstring describeLimit(uint64_t rate, bool isBytes)
+    {
+        if (rate == 0) return L"unlimited";
+        return isBytes ? utf8ToWstring(formatFileSize(rate)) + L"/s" : std::to_wstring(rate) + L"/s";
+    }
+}
+
+bool parseRate(std::wstring_view text, uint64_t& rate)
+{
+    std::wstring value = lowercase(trim(text));
+    size_t unitStart = value.find_first_not_of(L"0123456789.");
+    std::wstring number = value.substr(0, unitStart);
+    std::wstring unit = unitStart == std::wstring::npos ? L"" : std::wstring(trim(std::wstring_view(value).substr(unitStart)));
+    if (number.empty()) return false;
+
+    double amount = 0;
+    try
+    {
+        size_t used = 0;
+        amount = std::stod(number, &used);
+        if (used != number.size()) return false;
+    }
+    catch (const std::exception&)
+    {
+        return false;
+    }
+
+    double multiplier = 1;
+    if (unit == L"k" || unit == L"kb") multiplier = 1024.0;
+    else if (unit == L"m" || unit == L"mb") multiplier = 1024.0 * 1024;
+    else if (unit == L"g" || unit == L"gb") multiplier = 1024.0 * 1024 * 1024;
+    else if (!unit.empty() && unit != L"b") return false;
+
+    double result = amount * multiplier;
+    if (result < 0 || result >= 1.8e19) return false;
+    rate = static_cast<uint64_t>(result);
+    return true;
+}
+
+void TokenBucket::setRate(uint64_t perSecond)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    // A new limit starts with a full second's allowance, a lowered one keeps no more than that
+    tokens = rate == 0 ? static_cast<double>(perSecond) : std::min<double>(tokens, static_cast<double>(perSecond));
+    rate = perSecond;
+    refilled = std::chrono::steady_clock::now();
+}
+
+std::chrono::nanoseconds TokenBucket::take(uint64_t count)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    if (rate == 0) return std::chrono::nanoseconds(0);
+
+    auto now = std::chrono::steady_clock::now();
+    double elapsed = std::chrono::duration<double>(now - refilled).count();
+    refilled = now;
+
+    tokens = std::min<double>(static_cast<double>(rate), tokens + elapsed * static_cast<double>(rate));
+    tokens -= static_cast<double>(count);
+    if (tokens >= 0) return std::chrono::nanoseconds(0);
+
+    // The debt is what the next callers find missing, so they queue up behind this one in turn
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::duration<double>(-tokens / static_cast<double>(rate)));
+}
+
+void IoThrottle::setLimits(const ThrottleLimits& limits)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    byteBucket.setRate(limits.bytesPerSecond);
+    fileBucket.setRate(limits.filesPerSecond);
+    metadataBucket.setRate(limits.metadataPerSecond);
+
+    limited = limits.bytesPerSecond != 0 || limits.filesPerSecond != 0 || limits.metadataPerSecond != 0;
+    active.store(limited || pauseReasons.load(std::memory_order_relaxed) != 0, std::memory_order_relaxed);
+}
+
+void IoThrottle::setPaused(PauseReason reason, bool paused)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    unsigned reasons = pauseReasons.load(std::memory_order_relaxed);
+    reasons = paused ? reasons | reason : reasons & ~static_cast<unsigned>(reason);
+    pauseReasons.store(reasons, std::memory_order_relaxed);
+
+    active.store(limited || reasons != 0, std::memory_order_relaxed);
+    if (reasons == 0) resumed.notify_all();
+}
+
+void IoThrottle::beforeOpen()
+{
+    wait(fileBucket, 1);
+}
+
+void IoThrottle::beforeRead(uint64_t bytes)
+{
+    wait(byteBucket, bytes);
+}
+
+void IoThrottle::beforeMetadata(uint64_t operations)
+{
+    wait(metadataBucket, operations);
+}
+
+void IoThrottle::wait(TokenBucket& bucket, uint64_t count)
+{
+    if (!active.load(std::memory_order_relaxed)) return;
+
+    if (paused())
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        resumed.wait(lock, [this] { return pauseReasons.load(std::memory_order_relaxed) == 0; });
+    }
+
+    std::chrono::nanoseconds delay = bucket.take(count);
+    if (delay.count() > 0) std::this_thread::sleep_for(delay);
+}
+
+IoThrottle& ioThrottle()
+{
+    static IoThrottle throttle;
+    return throttle;
+}
+
+bool enterBackgroundMode()
+{
+    return SetPriorityClass(GetCurrentProcess(), PROCESS_MODE_BACKGROUND_BEGIN) != FALSE;
+}
+
+ThrottleMonitor::ThrottleMonitor(const fs::path& controlFile, unsigned pauseAbovePercent, const ThrottleLimits& startLimits, MessageHandler onMessage)
+    : controlFile(controlFile), pauseAbovePercent(pauseAbovePercent), startLimits(startLimits), onMessage(std::move(onMessage))
+{
+    // The first load sample only sets the baseline the next one is measured against
+    if (pauseAbovePercent > 0) checkLoad();
+    if (!controlFile.empty()) readControlFile();
+
+    thread = std::jthread([this](std::stop_token stopToken) { run(stopToken); });
+}
+
+ThrottleMonitor::~ThrottleMonitor()
+{
+    thread.request_stop();
+    if (thread.joinable()) thread.join();
+
+    // Nothing may stay paused once no one is left to resume it
+    ioThrottle().setPaused(PauseRequested, false);
+    ioThrottle().setPaused(PauseForLoad, false);
+}
+
+void ThrottleMonitor::run(std::stop_token stopToken)
+{
+    std::mutex sleepMutex;
+    std::condition_variable_any sleeper;
+    std::unique_lock<std::mutex> lock(sleepMutex);
+
+    while (!stopToken.stop_requested())
+    {
+        sleeper.wait_for(lock, stopToken, std::chrono::seconds(1), [] { return false; });
+        if (stopToken.stop_requested()) break;
+
+        if (!controlFile.empty()) readControlFile();
+        if (pauseAbovePercent > 0) checkLoad();
+    }
+}
+
+void ThrottleMonitor::readControlFile()
+{
+    std::error_code ec;
+    fs::file_time_type writeTime = fs::last_write_time(controlFile, ec);
+    if (ec)
+    {
+        // Deleting the file is how its settings are dropped
+        if (!controlFileSeen) return;
+        controlFileSeen = false;
+        ioThrottle().setLimits(startLimits);
+        ioThrottle().setPaused(PauseRequested, false);
+        printMessage(&onMessage, L"Throttle control file removed, back to the command line limits");
+        return;
+    }
+
+    if (controlFileSeen && writeTime == controlFileTime) return;
+
+    std::wstring text;
+    if (!readTextFile(controlFile, text)) return; // still being written; tried again in a second
+
+    controlFileSeen = true;
+    controlFileTime = writeTime;
+
+    ThrottleLimits limits = startLimits;
+    bool pause = false;
+
+    size_t lineStart = 0;
+    while (lineStart <= text.size())
+    {
+        size_t lineEnd = text.find(L'\n', lineStart);
+        if (lineEnd == std::wstring::npos) lineEnd = text.size();
+        std::wstring_view line(text.data() + lineStart, lineEnd - lineStart);
+        lineStart = lineEnd + 1;
+
+        size_t comment = line.find(L'#');
+        if (comment != std::wstring_view::npos) line = line.substr(0, comment);
+        line = trim(line);
+        if (line.empty()) continue;
+
+        size_t equals = line.find(L'=');
+        std::wstring name = equals == std::wstring_view::npos ? L"" : lowercase(trim(line.substr(0, equals)));
+        std::wstring_view value = equals == std::wstring_view::npos ? std::wstring_view() : trim(line.substr(equals + 1));
+
+        bool ok = true;
+        if (name == L"bytes") ok = parseRate(value, limits.bytesPerSecond);
+        else if (name == L"files") ok = parseRate(value, limits.filesPerSecond);
+        else if (name == L"metadata") ok = parseRate(value, limits.metadataPerSecond);
+        else if (name == L"pause")
+        {
+            std::wstring flag = lowercase(value);
+            pause = flag == L"yes" || flag == L"on" || flag == L"true" || flag == L"1";
+            ok = pause || flag == L"no" || flag == L"off" || flag == L"false" || flag == L"0";
+        }
+        else ok = false;
+
+        if (!ok) printMessage(&onMessage, L"Ignoring throttle control line: ", std::wstring(line));
+    }
+
+    ioThrottle().setLimits(limits);
+    ioThrottle().setPaused(PauseRequested, pause);
+    printMessage(&onMessage, L"Throttle: read ", describeLimit(limits.bytesPerSecond, true), L", open ", describeLimit(limits.filesPerSecond, false),
+        L", metadata ", describeLimit(limits.metadataPerSecond, false), pause ? L", paused" : L"");
+}
+
+void ThrottleMonitor::checkLoad()
+{
+    FILETIME idle, kernel, user;
+    FILETIME created, exited, processKernel, processUser;
+    if (!GetSystemTimes(&idle, &kernel, &user) || !GetProcessTimes(GetCurrentProcess(), &created, &exited, &processKernel, &processUser)) return;
+
+    // System kernel time includes the idle time; the scan's own CPU time is left out so it cannot pause itself
+    uint64_t systemTotal = fileTimeTicks(kernel) + fileTimeTicks(user);
+    uint64_t systemBusy = systemTotal - fileTimeTicks(idle);
+    uint64_t processBusy = fileTimeTicks(processKernel) + fileTimeTicks(processUser);
+
+    bool baseline = lastSystemTotal == 0;
+    uint64_t totalDelta = systemTotal - lastSystemTotal;
+    uint64_t busyDelta = systemBusy - lastSystemBusy;
+    uint64_t processDelta = processBusy - lastProcessBusy;
+    lastSystemTotal = systemTotal;
+    lastSystemBusy = systemBusy;
+    lastProcessBusy = processBusy;
+    if (baseline || totalDelta == 0) return;
+
+    uint64_t othersBusy = busyDelta > processDelta ? busyDelta - processDelta : 0;
+    unsigned percent = static_cast<unsigned>(othersBusy * 100 / totalDelta);
+    unsigned resumeBelow = pauseAbovePercent > LOAD_RESUME_MARGIN ? pauseAbovePercent - LOAD_RESUME_MARGIN : pauseAbovePercent / 2;
+
+    if (percent > pauseAbovePercent)
+    {
+        samplesAbove++;
+        samplesBelow = 0;
+    }
+    else if (percent < resumeBelow)
+    {
+        samplesBelow++;
+        samplesAbove = 0;
+    }
+    else
+    {
+        samplesAbove = 0;
+        samplesBelow = 0;
+    }
+
+    if (!pausedForLoad && samplesAbove >= LOAD_SAMPLES_TO_SWITCH)
+    {
+        pausedForLoad = true;
+        ioThrottle().setPaused(PauseForLoad, true);
+        printMessage(&onMessage, L"System load at ", std::to_wstring(percent), L"%, pausing the scan");
+    }
+    else if (pausedForLoad && samplesBelow >= LOAD_SAMPLES_TO_SWITCH)
+    {
+        pausedForLoad = false;
+        ioThrottle().setPaused(PauseForLoad, false);
+        printMessage(&onMessage, L"System load down to ", std::to_wstring(percent), L"%, resuming the scan");
+    }
+}
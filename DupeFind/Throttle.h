@@ -0,0 +1,129 @@
+#pragma once
+
+#include <filesystem>
+#include <string>
+#include <string_view>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <thread>
+#include <stop_token>
+#include <cstdint>
+
+#include "Utilities.h"
+
+namespace fs = std::filesystem;
+
+// Budgets for scanning on a machine that has other work to do. Every limit is per second and 0 means no limit.
+struct ThrottleLimits
+{
+    uint64_t bytesPerSecond = 0;    // bytes read while hashing
+    uint64_t filesPerSecond = 0;    // files opened for hashing
+    uint64_t metadataPerSecond = 0; // directory listings and size or attribute lookups
+};
+
+// Reads "250", "50MB" or "1.5gb" (units of 1024). False on anything else.
+bool parseRate(std::wstring_view text, uint64_t& rate);
+
+// Hands out up to one second's worth of tokens at once. A request larger than that is granted and paid back by
+// waiting, so a big read is delayed instead of stuck.
+class TokenBucket
+{
+public:
+    void setRate(uint64_t perSecond);
+
+    // How long the caller must wait before using count tokens; zero if they were available
+    std::chrono::nanoseconds take(uint64_t count);
+
+private:
+    std::mutex mutex;
+    uint64_t rate = 0;
+    double tokens = 0;
+    std::chrono::steady_clock::time_point refilled = std::chrono::steady_clock::now();
+};
+
+// Why the throttle is holding every reader and the walker; the pause lasts while any reason is set
+enum PauseReason : unsigned
+{
+    PauseRequested = 1,  // "pause" in the control file
+    PauseForLoad = 2     // the rest of the system is busier than --pause-above allows
+};
+
+// One per process, shared by the scanner and every reader. Callers block before the work they are about to do, so
+// coroutine engine threads block too: throttled that engine runs at the budget, not at the number of files in flight.
+class IoThrottle
+{
+public:
+    void setLimits(const ThrottleLimits& limits);
+
+    void setPaused(PauseReason reason, bool paused);
+    bool paused() const { return pauseReasons.load(std::memory_order_relaxed) != 0; }
+
+    void beforeOpen();
+    void beforeRead(uint64_t bytes);
+    void beforeMetadata(uint64_t operations = 1);
+
+private:
+    void wait(TokenBucket& bucket, uint64_t count);
+
+    // Set while any limit or pause is, so an unthrottled run only pays for one load per call
+    std::atomic<bool> active{ false };
+    std::atomic<unsigned> pauseReasons{ 0 };
+
+    std::mutex mutex;
+    std::condition_variable resumed;
+    bool limited = false; // any rate set; guarded by mutex
+
+    TokenBucket byteBucket;
+    TokenBucket fileBucket;
+    TokenBucket metadataBucket;
+};
+
+IoThrottle& ioThrottle();
+
+// Lowers the whole process to background priority: idle CPU priority, very low I/O priority and low memory priority,
+// so the scan yields to everything else on the machine. False if Windows refused.
+bool enterBackgroundMode();
+
+// Once a second, applies changes from the control file and checks how busy the rest of the system is. The control
+// file holds one "name = value" per line and is read again whenever it is saved, e.g.
+//   bytes = 50MB
+//   files = 200
+//   metadata = 1000
+//   pause = yes
+// A name left out goes back to the limit given on the command line. Load is the CPU time used by other processes;
+// the scan pauses after it stays above the threshold for a few seconds and resumes once it drops well below.
+class ThrottleMonitor
+{
+public:
+    // controlFile may be empty, and pauseAbovePercent 0 to not watch the load. Changes of limits and pauses are
+    // reported to onMessage, from the monitor's thread, or the console without one.
+    ThrottleMonitor(const fs::path& controlFile, unsigned pauseAbovePercent, const ThrottleLimits& startLimits, MessageHandler onMessage = {});
+    ~ThrottleMonitor();
+
+    ThrottleMonitor(const ThrottleMonitor&) = delete;
+    ThrottleMonitor& operator=(const ThrottleMonitor&) = delete;
+
+private:
+    void run(std::stop_token stopToken);
+    void readControlFile();
+    void checkLoad();
+
+    fs::path controlFile;
+    unsigned pauseAbovePercent;
+    ThrottleLimits startLimits;
+    MessageHandler onMessage;
+
+    fs::file_time_type controlFileTime{};
+    bool controlFileSeen = false;
+
+    uint64_t lastSystemBusy = 0;
+    uint64_t lastSystemTotal = 0;
+    uint64_t lastProcessBusy = 0;
+    unsigned samplesAbove = 0;
+    unsigned samplesBelow = 0;
+    bool pausedForLoad = false;
+
+    std::jthread thread;
+};
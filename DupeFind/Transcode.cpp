@@ -0,0 +1,239 @@
+#include "Transcode.h"
+
+#include <cstdint>
+#include <cstring>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE2__)
+#define DUPEFIND_SSE2 1
+#include <emmintrin.h>
+#endif
+
+namespace
+{
+    const uint32_t REPLACEMENT_CHARACTER = 0xFFFD;
+
+    // Copies the ASCII prefix of input to output and returns its length
+    template <typename Unit>
+    size_t widenAscii(const unsigned char* input, size_t length, Unit* output)
+    {
+        size_t i = 0;
+
+#if DUPEFIND_SSE2
+        const __m128i zero = _mm_setzero_si128();
+        for (; i + 16 <= length; i += 16)
+        {
+            __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(input + i));
+            if (_mm_movemask_epi8(bytes) != 0) break; // a byte with the high bit set starts a multi-byte sequence
+
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(output + i), _mm_unpacklo_epi8(bytes, zero));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(output + i + 8), _mm_unpackhi_epi8(bytes, zero));
+        }
+#else
+        for (; i + 8 <= length; i += 8)
+        {
+            uint64_t word;
+            std::memcpy(&word, input + i, sizeof(word));
+            if (word & 0x8080808080808080ull) break;
+
+            for (size_t j = 0; j < 8; ++j) output[i + j] = static_cast<Unit>(input[i + j]);
+        }
+#endif
+
+        while (i < length && input[i] < 0x80)
+        {
+            output[i] = static_cast<Unit>(input[i]);
+            ++i;
+        }
+        return i;
+    }
+
+    template <typename Unit>
+    size_t narrowAscii(const Unit* input, size_t length, unsigned char* output)
+    {
+        size_t i = 0;
+
+#if DUPEFIND_SSE2
+        const __m128i highBits = _mm_set1_epi16(static_cast<short>(0xFF80));
+        const __m128i zero = _mm_setzero_si128();
+        for (; i + 16 <= length; i += 16)
+        {
+            __m128i low = _mm_loadu_si128(reinterpret_cast<const __m128i*>(input + i));
+            __m128i high = _mm_loadu_si128(reinterpret_cast<const __m128i*>(input + i + 8));
+            __m128i outside = _mm_and_si128(_mm_or_si128(low, high), highBits);
+            if (_mm_movemask_epi8(_mm_cmpeq_epi16(outside, zero)) != 0xFFFF) break;
+
+            // Every unit is below 0x80, so the saturating pack is exact
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(output + i), _mm_packus_epi16(low, high));
+        }
+#else
+        for (; i + 4 <= length; i += 4)
+        {
+            uint64_t word;
+            std::memcpy(&word, input + i, sizeof(word));
+            if (word & 0xFF80FF80FF80FF80ull) break;
+
+            for (size_t j = 0; j < 4; ++j) output[i + j] = static_cast<unsigned char>(input[i + j]);
+        }
+#endif
+
+        while (i < length && static_cast<uint16_t>(input[i]) < 0x80)
+        {
+            output[i] = static_cast<unsigned char>(input[i]);
+            ++i;
+        }
+        return i;
+    }
+
+    // Decodes one multi-byte sequence starting at input[i] (input[i] >= 0x80) and advances i past it.
+    // Invalid or truncated sequences consume one byte and decode to U+FFFD.
+    uint32_t decodeSequence(const unsigned char* input, size_t length, size_t& i)
+    {
+        unsigned char lead = input[i];
+        size_t needed;
+        uint32_t codePoint;
+        uint32_t minimum;
+
+        if (lead >= 0xC2 && lead <= 0xDF) { needed = 1; codePoint = lead & 0x1F; minimum = 0x80; }
+        else if (lead >= 0xE0 && lead <= 0xEF) { needed = 2; codePoint = lead & 0x0F; minimum = 0x800; }
+        else if (lead >= 0xF0 && lead <= 0xF4) { needed = 3; codePoint = lead & 0x07; minimum = 0x10000; }
+        else
+        {
+            ++i;
+            return REPLACEMENT_CHARACTER;
+        }
+
+        if (length - i <= needed)
+        {
+            ++i;
+            return REPLACEMENT_CHARACTER;
+        }
+
+        for (size_t j = 1; j <= needed; ++j)
+        {
+            unsigned char continuation = input[i + j];
+            if ((continuation & 0xC0) != 0x80)
+            {
+                ++i;
+                return REPLACEMENT_CHARACTER;
+            }
+            codePoint = (codePoint << 6) | (continuation & 0x3F);
+        }
+
+        // Overlong forms, UTF-16 surrogates and values past U+10FFFF are not valid UTF-8
+        if (codePoint < minimum || (codePoint >= 0xD800 && codePoint <= 0xDFFF) || codePoint > 0x10FFFF)
+        {
+            ++i;
+            return REPLACEMENT_CHARACTER;
+        }
+
+        i += needed + 1;
+        return codePoint;
+    }
+
+    size_t encodeUtf8(uint32_t codePoint, unsigned char* output)
+    {
+        if (codePoint < 0x80)
+        {
+            output[0] = static_cast<unsigned char>(codePoint);
+            return 1;
+        }
+        if (codePoint < 0x800)
+        {
+            output[0] = static_cast<unsigned char>(0xC0 | (codePoint >> 6));
+            output[1] = static_cast<unsigned char>(0x80 | (codePoint & 0x3F));
+            return 2;
+        }
+        if (codePoint < 0x10000)
+        {
+            output[0] = static_cast<unsigned char>(0xE0 | (codePoint >> 12));
+            output[1] = static_cast<unsigned char>(0x80 | ((codePoint >> 6) & 0x3F));
+            output[2] = static_cast<unsigned char>(0x80 | (codePoint & 0x3F));
+            return 3;
+        }
+        output[0] = static_cast<unsigned char>(0xF0 | (codePoint >> 18));
+        output[1] = static_cast<unsigned char>(0x80 | ((codePoint >> 12) & 0x3F));
+        output[2] = static_cast<unsigned char>(0x80 | ((codePoint >> 6) & 0x3F));
+        output[3] = static_cast<unsigned char>(0x80 | (codePoint & 0x3F));
+        return 4;
+    }
+}
+
+template <typename Unit>
+size_t transcodeUtf8ToUtf16(const char* input, size_t length, Unit* output)
+{
+    static_assert(sizeof(Unit) == 2, "UTF-16 needs a 16-bit code unit");
+
+    const unsigned char* bytes = reinterpret_cast<const unsigned char*>(input);
+    size_t i = 0;
+    size_t written = 0;
+
+    while (i < length)
+    {
+        size_t ascii = widenAscii(bytes + i, length - i, output + written);
+        i += ascii;
+        written += ascii;
+
+        // Decode multi-byte sequences until the next ASCII byte, then go back to the fast path
+        while (i < length && bytes[i] >= 0x80)
+        {
+            uint32_t codePoint = decodeSequence(bytes, length, i);
+            if (codePoint >= 0x10000)
+            {
+                codePoint -= 0x10000;
+                output[written++] = static_cast<Unit>(0xD800 | (codePoint >> 10));
+                output[written++] = static_cast<Unit>(0xDC00 | (codePoint & 0x3FF));
+            }
+            else
+            {
+                output[written++] = static_cast<Unit>(codePoint);
+            }
+        }
+    }
+
+    return written;
+}
+
+template <typename Unit>
+size_t transcodeUtf16ToUtf8(const Unit* input, size_t length, char* output)
+{
+    static_assert(sizeof(Unit) == 2, "UTF-16 needs a 16-bit code unit");
+
+    unsigned char* bytes = reinterpret_cast<unsigned char*>(output);
+    size_t i = 0;
+    size_t written = 0;
+
+    while (i < length)
+    {
+        size_t ascii = narrowAscii(input + i, length - i, bytes + written);
+        i += ascii;
+        written += ascii;
+
+        while (i < length && static_cast<uint16_t>(input[i]) >= 0x80)
+        {
+            uint32_t unit = static_cast<uint16_t>(input[i++]);
+            uint32_t codePoint = unit;
+
+            if (unit >= 0xD800 && unit <= 0xDBFF && i < length
+                && static_cast<uint16_t>(input[i]) >= 0xDC00 && static_cast<uint16_t>(input[i]) <= 0xDFFF)
+            {
+                codePoint = 0x10000 + ((unit - 0xD800) << 10) + (static_cast<uint16_t>(input[i++]) - 0xDC00);
+            }
+            else if (unit >= 0xD800 && unit <= 0xDFFF)
+            {
+                codePoint = REPLACEMENT_CHARACTER; // unpaired surrogate
+            }
+
+            written += encodeUtf8(codePoint, bytes + written);
+        }
+    }
+
+    return written;
+}
+
+template size_t transcodeUtf8ToUtf16<char16_t>(const char*, size_t, char16_t*);
+template size_t transcodeUtf16ToUtf8<char16_t>(const char16_t*, size_t, char*);
+
+#if WCHAR_MAX <= 0xFFFF
+template size_t transcodeUtf8ToUtf16<wchar_t>(const char*, size_t, wchar_t*);
+template size_t transcodeUtf16ToUtf8<wchar_t>(const wchar_t*, size_t, char*);
+#endif
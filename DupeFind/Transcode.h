@@ -0,0 +1,21 @@
+#pragma once
+
+#include <cstddef>
+
+// UTF-8 <-> UTF-16 transcoding without going through the Windows API. Paths are mostly ASCII, so runs of
+// ASCII are converted 16 characters at a time with SSE2 (8 at a time with plain 64-bit words where SSE2 is
+// not available); everything else goes through a scalar decoder. Invalid input becomes U+FFFD, which is
+// what MultiByteToWideChar and WideCharToMultiByte do without their strict flags.
+//
+// Unit is a 16-bit code unit: wchar_t on Windows, char16_t everywhere.
+
+// Output buffers of these sizes are always large enough, so a conversion needs a single pass
+inline size_t utf16LengthBound(size_t utf8Length) { return utf8Length; }
+inline size_t utf8LengthBound(size_t utf16Length) { return utf16Length * 3; }
+
+// Both return the number of code units written
+template <typename Unit>
+size_t transcodeUtf8ToUtf16(const char* input, size_t length, Unit* output);
+
+template <typename Unit>
+size_t transcodeUtf16ToUtf8(const Unit* input, size_t length, char* output);
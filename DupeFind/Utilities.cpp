@@ -1,10 +1,12 @@
 ﻿#include "Utilities.h"
+#include "Transcode.h"
 
 #include <iomanip>
 #include <sstream>
 #include <string>
 #include <filesystem>
 #include <fstream>
+#include <exception>
 
 #define WIN32_LEAN_AND_MEAN
 #include <windows.h>
@@ -31,77 +33,47 @@ std::string formatFileSize(uintmax_t bytes)
     return oss.str();
 }
 
-std::string wstringToUtf8(const std::wstring& wstr)
+std::string wstringToUtf8(std::wstring_view wstr)
 {
     if (wstr.empty()) return std::string();
 
-    // Just calculating the size needed for the UTF-8 string, conversion will be done in the next step
-    int size_needed = WideCharToMultiByte(
-        CP_UTF8,
-        0,
-        wstr.data(),
-        (int)wstr.size(),
-        nullptr,
-        0,
-        nullptr, nullptr
-    );
-
-    if (size_needed <= 0)
-        return std::string(); // conversion failed, return empty string
-
-    std::string utf8str(size_needed, 0);
-
-    // Actually converting the wide string to UTF-8
-    int converted_chars = WideCharToMultiByte(
-        CP_UTF8,
-        0,
-        wstr.data(),
-        (int)wstr.size(),
-        utf8str.data(),
-        size_needed,
-        nullptr,
-        nullptr
-    );
-
-    if (converted_chars <= 0)
-        return std::string();
-
+    // Converted in a single pass into a buffer that is always large enough, then trimmed
+    std::string utf8str(utf8LengthBound(wstr.size()), 0);
+    utf8str.resize(transcodeUtf16ToUtf8(wstr.data(), wstr.size(), utf8str.data()));
     return utf8str;
 }
 
-std::wstring utf8ToWstring(const std::string& str)
+std::wstring utf8ToWstring(std::string_view str)
 {
     if (str.empty()) return std::wstring();
 
-    // Calculate the size needed for the wide string buffer
-    int size_needed = MultiByteToWideChar(
-        CP_UTF8,
-        0,
-        str.data(),
-        (int)str.size(),
-        nullptr,
-        0
-    );
-
-    if (size_needed <= 0)
-        return std::wstring();
+    std::wstring wstr(utf16LengthBound(str.size()), 0);
+    wstr.resize(transcodeUtf8ToUtf16(str.data(), str.size(), wstr.data()));
+    return wstr;
+}
 
-    std::wstring wstr(size_needed, 0);
+namespace
+{
+    std::wstring codePageToWstring(std::string_view str)
+    {
+        if (str.empty()) return std::wstring();
 
-    // Perform the conversion from UTF-8 to wide char
-    int converted_chars = MultiByteToWideChar(
-        CP_UTF8,
-        0,
-        str.data(),
-        (int)str.size(),
-        &wstr[0],
-        size_needed
-    );
+        int length = MultiByteToWideChar(CP_ACP, 0, str.data(), static_cast<int>(str.size()), nullptr, 0);
+        std::wstring wstr(static_cast<size_t>(length), 0);
+        MultiByteToWideChar(CP_ACP, 0, str.data(), static_cast<int>(str.size()), wstr.data(), length);
+        return wstr;
+    }
+}
 
-    if (converted_chars <= 0)
-        return std::wstring();
+std::wstring errorMessage(const std::exception& exception)
+{
+    const auto* filesystemError = dynamic_cast<const fs::filesystem_error*>(&exception);
+    if (!filesystemError) return codePageToWstring(exception.what());
 
-    return wstr;
+    std::wstring message = codePageToWstring(filesystemError->code().message());
+    if (!filesystemError->path1().empty()) message += L": \"" + filesystemError->path1().wstring() + L"\"";
+    if (!filesystemError->path2().empty()) message += L", \"" + filesystemError->path2().wstring() + L"\"";
+    return message;
 }
 
 void printUnicode(const std::wstring& text, bool newline)
@@ -109,12 +81,9 @@ void printUnicode(const std::wstring& text, bool newline)
 	static HANDLE hConsole = GetStdHandle(STD_OUTPUT_HANDLE);
     DWORD written;
 
-    WriteConsoleW(hConsole, text.c_str(), (DWORD)text.length(), &written, nullptr);
-
-    if (newline)
-    {
-        WriteConsoleW(hConsole, L"\n", 1, &written, nullptr);
-    }
+    // One write per line, so lines printed by different hashing threads do not run into each other
+    std::wstring line = newline ? text + L"\n" : text;
+    WriteConsoleW(hConsole, line.c_str(), (DWORD)line.length(), &written, nullptr);
 }
 
 void printUnicode(const wchar_t* text, bool newline)
@@ -122,6 +91,21 @@ void printUnicode(const wchar_t* text, bool newline)
     printUnicode(std::wstring(text), newline);
 }
 
+void printOutputLine(const std::wstring& text)
+{
+    static HANDLE hOutput = GetStdHandle(STD_OUTPUT_HANDLE);
+    static const bool toConsole = [] { DWORD mode = 0; return GetConsoleMode(hOutput, &mode) != 0; }();
+    if (toConsole)
+    {
+        printUnicode(text, true);
+        return;
+    }
+
+    std::string line = wstringToUtf8(text) + "\r\n";
+    DWORD written = 0;
+    WriteFile(hOutput, line.data(), static_cast<DWORD>(line.size()), &written, nullptr);
+}
+
 void writeUnicodeToFile(const std::wstring& text, const std::wstring& filePath, bool newline, bool append)
 {
     HANDLE hFile = CreateFileW(
@@ -1,17 +1,30 @@
 ﻿#pragma once
 
 #include <string>
+#include <string_view>
+#include <exception>
+#include <functional>
 #include <cstdint>
 
 
-std::string wstringToUtf8(const std::wstring& wstr);
-std::wstring utf8ToWstring(const std::string& str);
+// Paths stay in their native form (fs::path, UTF-16 on Windows) through the pipeline and are only converted
+// here, at the console, report and file-format boundaries
+std::string wstringToUtf8(std::wstring_view wstr);
+std::wstring utf8ToWstring(std::string_view str);
+
+// Exception messages from the standard library are in the ANSI code page, not UTF-8. Filesystem errors are built
+// from their error code and paths instead, so paths the code page cannot hold still show correctly.
+std::wstring errorMessage(const std::exception& exception);
 
 std::string formatFileSize(uintmax_t bytes);
 
 void printUnicode(const std::wstring& text, bool newline = false);
 void printUnicode(const wchar_t* text, bool newline = false);
 
+// A line of a command's results, which may be redirected or piped: the console gets it like printUnicode, a file or
+// pipe gets it as UTF-8 (printUnicode writes to the console only, so its lines are lost there)
+void printOutputLine(const std::wstring& text);
+
 void writeUnicodeToFile(const std::wstring& text, const std::wstring& filePath, bool newline = true, bool append = true);
 
 template <typename... Args>
@@ -22,5 +35,18 @@ void printUnicodeMulti(bool newline, Args&&... args)
     printUnicode(combinedText, newline);
 }
 
+// Where libdupefind's status and error lines go. Programs linking it set one so nothing reaches their console;
+// a null or empty handler prints the line, as the command-line tool wants.
+using MessageHandler = std::function<void(const std::wstring& line)>;
+
+template <typename... Args>
+void printMessage(const MessageHandler* onMessage, Args&&... args)
+{
+    std::wstring line;
+    ((line += std::forward<Args>(args)), ...);
+    if (onMessage && *onMessage) (*onMessage)(line);
+    else printUnicode(line, true);
+}
+
 
 
@@ -0,0 +1,165 @@
+#include "WasteAnalytics.h"
+
+#include <algorithm>
+#include <cwctype>
+
+namespace
+{
+    bool lessWasted(const WastedGroup& a, const WastedGroup& b)
+    {
+        return a.wastedBytes > b.wastedBytes; // reversed, so the heap functions keep the smallest on top
+    }
+
+    std::wstring extensionKey(const fs::path& file)
+    {
+        std::wstring extension = file.extension().native();
+        if (extension.empty()) return L"(none)";
+        std::transform(extension.begin(), extension.end(), extension.begin(), [](wchar_t c) { return static_cast<wchar_t>(std::towlower(c)); });
+        return extension;
+    }
+}
+
+HeavyHitters::HeavyHitters(size_t capacity)
+    : capacity(std::max<size_t>(capacity, 1))
+{
+    slots.reserve(this->capacity);
+}
+
+void HeavyHitters::add(const std::wstring& key, uint64_t weight)
+{
+    if (weight == 0) return;
+    total += weight;
+
+    auto found = slots.find(key);
+    if (found != slots.end())
+    {
+        uint64_t newWeight = found->second.position->first + weight;
+        byWeight.erase(found->second.position);
+        found->second.position = byWeight.emplace(newWeight, &found->first);
+        found->second.count++;
+        return;
+    }
+
+    uint64_t inherited = 0;
+    if (slots.size() >= capacity)
+    {
+        auto lightest = byWeight.begin();
+        inherited = lightest->first;
+        auto evictedSlot = slots.find(*lightest->second);
+        byWeight.erase(lightest);
+        slots.erase(evictedSlot);
+        anyEvicted = true;
+    }
+
+    auto [inserted, added] = slots.emplace(key, Slot{});
+    inserted->second.count = 1;
+    inserted->second.overcount = inherited;
+    inserted->second.position = byWeight.emplace(inherited + weight, &inserted->first);
+}
+
+std::vector<HeavyHitters::Entry> HeavyHitters::top(size_t count) const
+{
+    std::vector<Entry> entries;
+    for (auto it = byWeight.rbegin(); it != byWeight.rend() && entries.size() < count; ++it)
+    {
+        const Slot& slot = slots.at(*it->second);
+        entries.push_back({ *it->second, it->first, slot.count, slot.overcount });
+    }
+    return entries;
+}
+
+uint64_t WasteAnalytics::bucketLowerBound(size_t bucket)
+{
+    return bucket == 0 ? 0 : 4096ull << (4 * (bucket - 1));
+}
+
+WasteAnalytics::WasteAnalytics(size_t topCount, size_t rollupKeys, const fs::path& scanRoot)
+    : topCount(topCount), scanRoot(scanRoot.lexically_normal()), folderBytes(rollupKeys), extensionBytes(rollupKeys)
+{
+    largest.reserve(topCount);
+
+    // "D:\Photos\" and "D:\Photos" name the same root, and the parents of its files are written the second way
+    if (this->scanRoot.filename().empty() && this->scanRoot.has_relative_path()) this->scanRoot = this->scanRoot.parent_path();
+}
+
+void WasteAnalytics::addGroup(const std::string& hash, const std::vector<fs::path>& files, uint64_t fileSize, uint64_t wastedBytes)
+{
+    if (files.size() < 2) return;
+
+    groupsSeen++;
+    wastedTotal += wastedBytes;
+
+    size_t bucket = 0;
+    while (bucket + 1 < SIZE_BUCKETS && fileSize >= bucketLowerBound(bucket + 1)) ++bucket;
+    histogram[bucket].groups++;
+    histogram[bucket].files += files.size();
+    histogram[bucket].wastedBytes += wastedBytes;
+
+    for (const auto& file : files)
+    {
+        addToFolders(file.parent_path(), fileSize);
+    }
+    extensionBytes.add(extensionKey(files[0]), wastedBytes);
+
+    offer({ groupsSeen, hash, files[0], files.size(), fileSize, wastedBytes, false });
+}
+
+void WasteAnalytics::addDirectoryGroup(const std::string& hash, const std::vector<fs::path>& directories, uint64_t bytes)
+{
+    if (directories.size() < 2) return;
+
+    groupsSeen++;
+    uint64_t wastedBytes = bytes * (directories.size() - 1);
+    wastedTotal += wastedBytes;
+
+    for (const auto& directory : directories)
+    {
+        addToFolders(directory, bytes);
+    }
+
+    offer({ groupsSeen, hash, directories[0], directories.size(), bytes, wastedBytes, true });
+}
+
+// Counted for the folder and each one above it, so a tree whose copies are spread over many small folders still
+// shows up as a whole
+void WasteAnalytics::addToFolders(const fs::path& folder, uint64_t bytes)
+{
+    fs::path current = folder;
+    while (true)
+    {
+        folderBytes.add(current.native(), bytes);
+        if (current == scanRoot || !current.has_relative_path()) break;
+
+        fs::path parent = current.parent_path();
+        if (parent == current) break;
+        current = std::move(parent);
+    }
+}
+
+std::vector<WastedGroup> WasteAnalytics::topGroups() const
+{
+    std::vector<WastedGroup> groups = largest;
+    std::sort(groups.begin(), groups.end(), [](const WastedGroup& a, const WastedGroup& b)
+    {
+        return a.wastedBytes != b.wastedBytes ? a.wastedBytes > b.wastedBytes : a.number < b.number;
+    });
+    return groups;
+}
+
+void WasteAnalytics::offer(WastedGroup&& group)
+{
+    if (topCount == 0) return;
+
+    if (largest.size() < topCount)
+    {
+        largest.push_back(std::move(group));
+        std::push_heap(largest.begin(), largest.end(), lessWasted);
+        return;
+    }
+
+    if (group.wastedBytes <= largest.front().wastedBytes) return;
+
+    std::pop_heap(largest.begin(), largest.end(), lessWasted);
+    largest.back() = std::move(group);
+    std::push_heap(largest.begin(), largest.end(), lessWasted);
+}
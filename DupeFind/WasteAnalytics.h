@@ -0,0 +1,120 @@
+#pragma once
+
+#include <filesystem>
+#include <string>
+#include <vector>
+#include <map>
+#include <unordered_map>
+#include <array>
+#include <cstdint>
+
+namespace fs = std::filesystem;
+
+// Where a run's wasted space is, collected group by group as groups are confirmed, so the answer is ready when
+// hashing ends. Memory stays bounded however many groups there are: only the largest groups are kept, and the
+// folder and extension rollups keep only their heaviest keys.
+
+const size_t DEFAULT_TOP_GROUPS = 20;
+const size_t DEFAULT_ROLLUP_KEYS = 1024;
+
+struct WastedGroup
+{
+    size_t number = 0;        // arrival order counting from 1, which is the number the duplicate log gives the group
+    std::string hash;
+    fs::path firstCopy;
+    size_t copies = 0;
+    uint64_t size = 0;        // of one copy
+    uint64_t wastedBytes = 0; // freed by keeping one copy
+    bool isDirectory = false;
+};
+
+// Space-Saving summary of weights per key in a fixed number of slots. When it is full, a new key takes the slot of
+// the lightest one and inherits that weight as a possible overcount. Every key heavier than total / capacity is
+// certain to be kept, and no kept weight is ever too low.
+class HeavyHitters
+{
+public:
+    struct Entry
+    {
+        std::wstring key;
+        uint64_t weight = 0;
+        uint64_t count = 0;     // additions since the key got its slot
+        uint64_t overcount = 0; // at most this much of weight belongs to keys that were evicted
+    };
+
+    explicit HeavyHitters(size_t capacity);
+
+    void add(const std::wstring& key, uint64_t weight);
+
+    // Heaviest first
+    std::vector<Entry> top(size_t count) const;
+
+    uint64_t totalWeight() const { return total; }
+    bool evicted() const { return anyEvicted; }
+
+private:
+    struct Slot
+    {
+        uint64_t count = 0;
+        uint64_t overcount = 0;
+        std::multimap<uint64_t, const std::wstring*>::iterator position;
+    };
+
+    size_t capacity;
+    uint64_t total = 0;
+    bool anyEvicted = false;
+    std::unordered_map<std::wstring, Slot> slots;
+    std::multimap<uint64_t, const std::wstring*> byWeight; // the lightest slot is the next to be taken over
+};
+
+struct SizeBucket
+{
+    size_t groups = 0;
+    size_t files = 0;
+    uint64_t wastedBytes = 0;
+};
+
+class WasteAnalytics
+{
+public:
+    // Files of under 4 KB, then each bucket 16 times the size of the one before; the last has no upper bound
+    static const size_t SIZE_BUCKETS = 7;
+    static uint64_t bucketLowerBound(size_t bucket);
+
+    // Folder totals are rolled up to scanRoot, or to the top of each volume without one
+    explicit WasteAnalytics(size_t topCount = DEFAULT_TOP_GROUPS, size_t rollupKeys = DEFAULT_ROLLUP_KEYS, const fs::path& scanRoot = {});
+
+    // wastedBytes is what removing all but one copy frees, less any blocks the copies already share on disk
+    void addGroup(const std::string& hash, const std::vector<fs::path>& files, uint64_t fileSize, uint64_t wastedBytes);
+
+    // Identical folders; bytes is the size of one copy. The files inside have sizes of their own, so folder groups
+    // stay out of the size histogram and the extension rollup.
+    void addDirectoryGroup(const std::string& hash, const std::vector<fs::path>& directories, uint64_t bytes);
+
+    // Most wasted first
+    std::vector<WastedGroup> topGroups() const;
+
+    // Bytes in each folder and below it that have an identical copy elsewhere; whole duplicate folders count as themselves
+    const HeavyHitters& folders() const { return folderBytes; }
+
+    // Wasted bytes per lowercase extension
+    const HeavyHitters& extensions() const { return extensionBytes; }
+
+    const std::array<SizeBucket, SIZE_BUCKETS>& sizeHistogram() const { return histogram; }
+
+    size_t groupCount() const { return groupsSeen; }
+    uint64_t totalWasted() const { return wastedTotal; }
+
+private:
+    void offer(WastedGroup&& group);
+    void addToFolders(const fs::path& folder, uint64_t bytes);
+
+    size_t topCount;
+    fs::path scanRoot;
+    std::vector<WastedGroup> largest; // min-heap on wastedBytes, so the smallest kept group is the one to replace
+    HeavyHitters folderBytes;
+    HeavyHitters extensionBytes;
+    std::array<SizeBucket, SIZE_BUCKETS> histogram = {};
+    size_t groupsSeen = 0;
+    uint64_t wastedTotal = 0;
+};